@@ -0,0 +1,356 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Throughput and misdecode rate of ir_protocol_parse(), run with
+ * "make -C host_test bench".
+ *
+ * Generated frames of every protocol are decoded with growing edge jitter,
+ * then with one corrupted, dropped or cut symbol, and random noise bursts.
+ * A misdecode is a frame accepted with the wrong type or bytes, a rejected
+ * clean frame is counted as lost.
+ *
+ * Captured frames can be added as arguments: the text the #if 0 dump in
+ * ir_parse_ir_frame() prints, one "{level:duration},{level:duration}" line
+ * per symbol and "IR frame start" before each frame. Their decode result is
+ * listed since there is no ground truth.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ir_protocol.h"
+#include "rmt.h"
+
+#define BENCH_FRAMES        20000   /* Per protocol and case */
+#define BENCH_MAX_SYMBOLS   512
+
+typedef struct
+{
+    rmt_symbol_word_t symbols[BENCH_MAX_SYMBOLS];
+    size_t num;
+    char type;
+    uint8_t data[IR_PROTOCOL_MAX_PAYLOAD];
+    uint8_t time[IR_PROTOCOL_MAX_TIME];
+} bench_frame_t;
+
+typedef struct
+{
+    unsigned long ok;
+    unsigned long lost;
+    unsigned long misdecoded;
+    unsigned long rejected;
+} bench_count_t;
+
+static bench_frame_t *gframes;
+static uint32_t grandom = 2463534242UL;
+
+static uint32_t random_u32(void)
+{
+    grandom ^= grandom << 13;
+    grandom ^= grandom >> 17;
+    grandom ^= grandom << 5;
+    return grandom;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* A clean frame of proto with random bytes, as the receiver would decode it */
+static void make_frame(const ir_protocol_t *proto, bench_frame_t *frame)
+{
+    uint8_t payload[IR_PROTOCOL_MAX_PAYLOAD + IR_PROTOCOL_MAX_TIME];
+    size_t length = 0;
+
+    for (int i = 0; i < IR_PROTOCOL_MAX_PAYLOAD; i++)
+    {
+        frame->data[i] = random_u32();
+    }
+    for (int i = 0; i < IR_PROTOCOL_MAX_TIME; i++)
+    {
+        frame->time[i] = random_u32();
+    }
+    if (proto->checksum == IR_PROTOCOL_CHECKSUM_INV_PAIRS)
+    {
+        for (int i = proto->checksum_offset + 1; i < proto->data_len; i += 2)
+        {
+            frame->data[i] = ~frame->data[i - 1];
+        }
+        for (int i = proto->checksum_offset + 1; i < proto->time_len; i += 2)
+        {
+            frame->time[i] = ~frame->time[i - 1];
+        }
+    }
+    length = ir_protocol_pack(proto, frame->data, frame->time, payload);
+    frame->num = ir_protocol_fill_symbols(proto, IR_RESOLUTION_HZ, payload,
+                                          length, frame->symbols,
+                                          BENCH_MAX_SYMBOLS);
+    frame->type = proto->type;
+}
+
+/* Uniform jitter in [-jitter, jitter] on every edge */
+static void jitter_frame(bench_frame_t *frame, int jitter)
+{
+    int d = 0;
+
+    if (jitter == 0)
+    {
+        return;
+    }
+    for (size_t i = 0; i < frame->num; i++)
+    {
+        d = frame->symbols[i].duration0 +
+            (int)(random_u32() % (2 * jitter + 1)) - jitter;
+        frame->symbols[i].duration0 = (d > 1) ? d : 1;
+        if (frame->symbols[i].duration1 == 0)
+        {
+            continue;
+        }
+        d = frame->symbols[i].duration1 +
+            (int)(random_u32() % (2 * jitter + 1)) - jitter;
+        frame->symbols[i].duration1 = (d > 1) ? d : 1;
+    }
+}
+
+static rmt_symbol_word_t random_symbol(void)
+{
+    return (rmt_symbol_word_t){
+        .level0 = 1,
+        .duration0 = 100 + random_u32() % 9900,
+        .level1 = 0,
+        .duration1 = 100 + random_u32() % 9900,
+    };
+}
+
+/* One damaged symbol after the leading code: replaced, dropped or the
+   frame cut there */
+static void damage_frame(bench_frame_t *frame, int how)
+{
+    size_t at = 1 + random_u32() % (frame->num - 1);
+
+    switch (how)
+    {
+        case 0:
+            frame->symbols[at] = random_symbol();
+            break;
+        case 1:
+            memmove(&frame->symbols[at], &frame->symbols[at + 1],
+                    (frame->num - at - 1) * sizeof(rmt_symbol_word_t));
+            frame->num--;
+            break;
+        default:
+            frame->num = at;
+            break;
+    }
+}
+
+static void noise_frame(bench_frame_t *frame)
+{
+    frame->num = 2 + random_u32() % 100;
+    for (size_t i = 0; i < frame->num; i++)
+    {
+        frame->symbols[i] = random_symbol();
+    }
+    frame->type = 0;
+}
+
+static bool same_frame(const bench_frame_t *frame,
+                       const ir_protocol_result_t *result)
+{
+    const ir_protocol_t *proto = ir_protocol_get(frame->type);
+
+    return (result->type == frame->type) &&
+           (memcmp(result->data, frame->data, proto->data_len) == 0) &&
+           (memcmp(result->time, frame->time, proto->time_len) == 0);
+}
+
+/* Decode all frames, count them and return the time per frame in ns */
+static double run(int nframes, bench_count_t *count, bool clean)
+{
+    ir_protocol_result_t result;
+    double start = 0, elapsed = 0;
+    bool accepted[BENCH_FRAMES];
+    ir_protocol_result_t *results = NULL;
+
+    results = malloc(nframes * sizeof(ir_protocol_result_t));
+    start = now_ns();
+    for (int i = 0; i < nframes; i++)
+    {
+        accepted[i] = ir_protocol_parse(gframes[i].symbols, gframes[i].num,
+                                        &results[i]);
+    }
+    elapsed = now_ns() - start;
+
+    memset(count, 0, sizeof(bench_count_t));
+    for (int i = 0; i < nframes; i++)
+    {
+        result = results[i];
+        if (!accepted[i])
+        {
+            if (clean)
+            {
+                count->lost++;
+            }
+            else
+            {
+                count->rejected++;
+            }
+        }
+        else if ((gframes[i].type != 0) && same_frame(&gframes[i], &result))
+        {
+            count->ok++;
+        }
+        else
+        {
+            count->misdecoded++;
+        }
+    }
+    free(results);
+    return elapsed / nframes;
+}
+
+static void report(const char *name, const char *label, int nframes,
+                   const bench_count_t *count, double ns_per_frame)
+{
+    printf("%-8s %-11s %7.1f ns/frame %6.2f Mframe/s  ok %6.2f%%  "
+           "lost %6.2f%%  rejected %6.2f%%  misdecoded %6.3f%%\n",
+           name, label, ns_per_frame, 1e3 / ns_per_frame,
+           100.0 * count->ok / nframes, 100.0 * count->lost / nframes,
+           100.0 * count->rejected / nframes,
+           100.0 * count->misdecoded / nframes);
+}
+
+static void bench_generated(void)
+{
+    static const char *damage_name[] = {"replaced", "dropped", "cut"};
+    const ir_protocol_t *proto = NULL;
+    bench_count_t count;
+    double ns = 0;
+    char label[32];
+
+    for (int p = 0; p < ir_protocol_num(); p++)
+    {
+        proto = ir_protocol_get_by_index(p);
+        for (int step = 0; step <= 4; step++)
+        {
+            /* Up to the margin, then past it */
+            int jitter = proto->margin * step / 4 + (step == 4) * 100;
+            for (int i = 0; i < BENCH_FRAMES; i++)
+            {
+                make_frame(proto, &gframes[i]);
+                jitter_frame(&gframes[i], jitter);
+            }
+            ns = run(BENCH_FRAMES, &count, true);
+            snprintf(label, sizeof(label), "jitter %d", jitter);
+            report(proto->name, label, BENCH_FRAMES, &count, ns);
+        }
+        for (int how = 0; how < 3; how++)
+        {
+            for (int i = 0; i < BENCH_FRAMES; i++)
+            {
+                make_frame(proto, &gframes[i]);
+                jitter_frame(&gframes[i], proto->margin / 4);
+                damage_frame(&gframes[i], how);
+            }
+            ns = run(BENCH_FRAMES, &count, false);
+            report(proto->name, damage_name[how], BENCH_FRAMES, &count, ns);
+        }
+    }
+
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        noise_frame(&gframes[i]);
+    }
+    ns = run(BENCH_FRAMES, &count, false);
+    report("-", "noise", BENCH_FRAMES, &count, ns);
+}
+
+/* Decode the frames of a dump file */
+static void bench_capture(const char *path)
+{
+    const ir_protocol_t *proto = NULL;
+    ir_protocol_result_t result;
+    bench_frame_t *frame = &gframes[0];
+    char line[128];
+    int level0 = 0, duration0 = 0, level1 = 0, duration1 = 0;
+    int nframe = 0;
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        perror(path);
+        return;
+    }
+    frame->num = 0;
+    for (;;)
+    {
+        bool eof = (fgets(line, sizeof(line), file) == NULL);
+        if (eof || strstr(line, "frame start"))
+        {
+            if (frame->num > 0)
+            {
+                nframe++;
+                if (ir_protocol_parse(frame->symbols, frame->num, &result))
+                {
+                    proto = ir_protocol_get(result.type);
+                    printf("%s frame %d: %zu symbols, %s", path, nframe,
+                           frame->num, proto->name);
+                    for (int i = 0; i < result.data_len; i++)
+                    {
+                        printf("%s%02X", (i % 4) ? "" : " ", result.data[i]);
+                    }
+                    printf("\n");
+                }
+                else
+                {
+                    printf("%s frame %d: %zu symbols, not decoded\n", path,
+                           nframe, frame->num);
+                }
+            }
+            frame->num = 0;
+            if (eof)
+            {
+                break;
+            }
+            continue;
+        }
+        if ((sscanf(line, "{%d:%d},{%d:%d}", &level0, &duration0, &level1,
+                    &duration1) == 4) &&
+            (frame->num < BENCH_MAX_SYMBOLS))
+        {
+            frame->symbols[frame->num++] = (rmt_symbol_word_t){
+                .level0 = level0,
+                .duration0 = duration0,
+                .level1 = level1,
+                .duration1 = duration1,
+            };
+        }
+    }
+    fclose(file);
+}
+
+int main(int argc, char *argv[])
+{
+    gframes = calloc(BENCH_FRAMES, sizeof(bench_frame_t));
+    if (gframes == NULL)
+    {
+        return 1;
+    }
+    ir_protocol_init();
+    bench_generated();
+    for (int i = 1; i < argc; i++)
+    {
+        bench_capture(argv[i]);
+    }
+    free(gframes);
+    return 0;
+}
@@ -0,0 +1,16 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+/* Host stub, see stubs/README */
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+typedef struct {
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+} esp_netif_ip_info_t;
@@ -0,0 +1,12 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+/* Host stub, see stubs/README */
+#include <stdint.h>
+
+/* Defined by the test that needs it */
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,20 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+/* Host stub, see stubs/README */
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef void *SemaphoreHandle_t;
+typedef void *QueueHandle_t;
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE         0
+#define pdTRUE          1
+#define portMAX_DELAY   ((TickType_t)0xFFFFFFFF)
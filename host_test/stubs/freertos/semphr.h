@@ -0,0 +1,14 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+/* Host stub, see stubs/README */
+#include "freertos/FreeRTOS.h"
+
+/* Defined by the test that needs them */
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sema, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sema);
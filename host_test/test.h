@@ -0,0 +1,44 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+/*
+ * Minimal checks for the host tests, a failed check is printed and the test
+ * program exits with 1 at the end.
+ */
+#include <stdio.h>
+#include <string.h>
+
+static int gtest_failed = 0;
+static int gtest_checks = 0;
+
+#define TEST_CHECK(cond)                                                  \
+    do                                                                    \
+    {                                                                     \
+        gtest_checks++;                                                   \
+        if (!(cond))                                                      \
+        {                                                                 \
+            gtest_failed++;                                               \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        }                                                                 \
+    } while (0)
+
+#define TEST_CHECK_STR(actual, expected)                                  \
+    do                                                                    \
+    {                                                                     \
+        gtest_checks++;                                                   \
+        if (strcmp((actual), (expected)) != 0)                            \
+        {                                                                 \
+            gtest_failed++;                                               \
+            printf("%s:%d: \"%s\" != \"%s\"\n", __FILE__, __LINE__,       \
+                   (actual), (expected));                                 \
+        }                                                                 \
+    } while (0)
+
+#define TEST_END()                                                        \
+    (printf("%s: %d checks, %d failed\n", __FILE__, gtest_checks,         \
+            gtest_failed),                                                \
+     gtest_failed ? 1 : 0)
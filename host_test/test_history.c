@@ -0,0 +1,409 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * The history rings of history.c, sampled by calling the timer wheel
+ * callback directly with sensor values and uptime set by the test.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "airquality.h"
+#include "dht22.h"
+#include "history.h"
+#include "nu_ld2410.h"
+#include "syslog.h"
+#include "system.h"
+#include "timer_wheel.h"
+#include "test.h"
+
+#define TEST_CHUNK 32       /* What http_api_history reads at once */
+
+static timer_wheel_cb_t gsample_cb = NULL;
+static int gtimer_starts = 0;
+static int gsema_taken = 0;
+static uint32_t gnow_s = 0;
+static float gtemperature = 0;
+static float ghumidity = 0;
+static float gpred = 0;
+static int gvoc = 0;
+static int gnox = 0;
+
+void syslog_handler(uint32_t facility, uint32_t level, const char *fmt, ...)
+{
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)gnow_s * 1000000;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    gsema_taken = 1;
+    return &gsema_taken;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sema, TickType_t ticks)
+{
+    TEST_CHECK(gsema_taken == 0);
+    gsema_taken = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sema)
+{
+    TEST_CHECK(gsema_taken == 1);
+    gsema_taken = 0;
+    return pdTRUE;
+}
+
+int timer_wheel_add(timer_wheel_cb_t callback, void *arg, const char *name,
+                    int *id)
+{
+    gsample_cb = callback;
+    *id = 1;
+    return SYSTEM_ERROR_NONE;
+}
+
+int timer_wheel_start(int id, uint32_t delay_ms)
+{
+    TEST_CHECK((id == 1) && (delay_ms == 1000));
+    gtimer_starts++;
+    return SYSTEM_ERROR_NONE;
+}
+
+int dht22_getcurrenttemperature(float *value)
+{
+    *value = gtemperature;
+    return SYSTEM_ERROR_NONE;
+}
+
+int dht22_getcurrenthumidity(float *value)
+{
+    *value = ghumidity;
+    return SYSTEM_ERROR_NONE;
+}
+
+int airquality_get_voc_index(int *value)
+{
+    *value = gvoc;
+    return SYSTEM_ERROR_NONE;
+}
+
+int airquality_get_nox_index(int *value)
+{
+    *value = gnox;
+    return SYSTEM_ERROR_NONE;
+}
+
+int nu_ld2410_getPred(float *value)
+{
+    *value = gpred;
+    return SYSTEM_ERROR_NONE;
+}
+
+/* Seconds value of sample k, with steps up and down */
+static int32_t voc_at(uint32_t k)
+{
+    return (int32_t)((k * 37) % 500) - 100;
+}
+
+/* One tick of the timer wheel, a second after the previous one */
+static void sample(int32_t voc)
+{
+    gnow_s++;
+    gvoc = voc;
+    gnox = -voc;
+    gsample_cb(NULL);
+}
+
+/* All samples held, read in chunks like http_api_history */
+static int read_all(int level, int metric, int first, int32_t *values,
+                    int num)
+{
+    int total = 0, read = 0;
+
+    do
+    {
+        TEST_CHECK(history_read(level, metric, first + total, &values[total],
+                                MIN(TEST_CHUNK, num - total),
+                                &read) == SYSTEM_ERROR_NONE);
+        total += read;
+    } while ((read > 0) && (total < num));
+    return total;
+}
+
+static void test_not_ready(void)
+{
+    history_info_t info;
+    int32_t values[4];
+    int read = 0;
+
+    TEST_CHECK(history_get_info(HISTORY_LEVEL_SECOND, &info) ==
+               SYSTEM_ERROR_NOT_READY);
+    TEST_CHECK(history_read(HISTORY_LEVEL_SECOND, HISTORY_METRIC_VOC, 0,
+                            values, 4, &read) == SYSTEM_ERROR_NOT_READY);
+}
+
+static void test_empty(void)
+{
+    static const uint16_t sizes[HISTORY_LEVEL_MAX] = {
+        HISTORY_SECOND_SAMPLES, HISTORY_MINUTE_SAMPLES,
+        HISTORY_QUARTER_SAMPLES};
+    static const uint32_t periods[HISTORY_LEVEL_MAX] = {1, 60, 900};
+    history_info_t info;
+    int32_t values[4];
+    int read = -1;
+
+    for (int level = 0; level < HISTORY_LEVEL_MAX; level++)
+    {
+        TEST_CHECK(history_get_info(level, &info) == SYSTEM_ERROR_NONE);
+        TEST_CHECK((info.count == 0) && (info.end_s == 0));
+        TEST_CHECK((info.size == sizes[level]) &&
+                   (info.period_s == periods[level]));
+        TEST_CHECK(history_read(level, HISTORY_METRIC_VOC, 0, values, 4,
+                                &read) == SYSTEM_ERROR_NONE);
+        TEST_CHECK(read == 0);
+    }
+
+    TEST_CHECK(history_get_info(HISTORY_LEVEL_MAX, &info) ==
+               SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(history_get_info(-1, &info) == SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(history_get_info(0, NULL) == SYSTEM_ERROR_INVALID_POINTER);
+    TEST_CHECK(history_read(HISTORY_LEVEL_MAX, 0, 0, values, 4, &read) ==
+               SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(history_read(0, HISTORY_METRIC_MAX, 0, values, 4, &read) ==
+               SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(history_read(0, -1, 0, values, 4, &read) ==
+               SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(history_read(0, 0, -1, values, 4, &read) ==
+               SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(history_read(0, 0, 0, values, -1, &read) ==
+               SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(history_read(0, 0, 0, NULL, 4, &read) ==
+               SYSTEM_ERROR_INVALID_POINTER);
+    TEST_CHECK(history_read(0, 0, 0, values, 4, NULL) ==
+               SYSTEM_ERROR_INVALID_POINTER);
+}
+
+/* Seconds from the first sample on, up to wrapping twice */
+static void test_seconds(void)
+{
+    int32_t values[HISTORY_SECOND_SAMPLES + 1];
+    history_info_t info;
+    uint32_t start_s = gnow_s;
+    uint32_t k = 0;
+    int read = 0, num = 0;
+    bool same = true;
+
+    for (k = 0; k < 2 * HISTORY_SECOND_SAMPLES + 7; k++)
+    {
+        gtemperature = -5.25f + k * 0.5f;
+        ghumidity = 40.0f + (k % 3);
+        gpred = 0.25f;
+        sample(voc_at(k));
+
+        TEST_CHECK(history_get_info(HISTORY_LEVEL_SECOND, &info) ==
+                   SYSTEM_ERROR_NONE);
+        TEST_CHECK(info.end_s == gnow_s);
+        TEST_CHECK(info.count == MIN(k + 1, HISTORY_SECOND_SAMPLES));
+        num = read_all(HISTORY_LEVEL_SECOND, HISTORY_METRIC_VOC, 0, values,
+                       HISTORY_SECOND_SAMPLES + 1);
+        same = same && (num == info.count);
+        for (int i = 0; same && (i < num); i++)
+        {
+            same = (values[i] == voc_at(k + 1 - num + i));
+        }
+    }
+    TEST_CHECK(same);
+    TEST_CHECK(gtimer_starts == 1 + k);
+
+    /* Every metric has its own ring, in its unit */
+    num = read_all(HISTORY_LEVEL_SECOND, HISTORY_METRIC_NOX, 0, values,
+                   HISTORY_SECOND_SAMPLES);
+    TEST_CHECK((num == HISTORY_SECOND_SAMPLES) &&
+               (values[0] == -voc_at(k - num)));
+    num = read_all(HISTORY_LEVEL_SECOND, HISTORY_METRIC_TEMPERATURE, 0, values,
+                   HISTORY_SECOND_SAMPLES);
+    TEST_CHECK(values[num - 1] == (int32_t)(-52.5f + (k - 1) * 5 + 0.5f));
+    TEST_CHECK(history_read(HISTORY_LEVEL_SECOND, HISTORY_METRIC_HUMIDITY,
+                            num - 1, values, 1, &read) == SYSTEM_ERROR_NONE);
+    TEST_CHECK((read == 1) && (values[0] == 400 + 10 * ((k - 1) % 3)));
+    TEST_CHECK(history_read(HISTORY_LEVEL_SECOND, HISTORY_METRIC_PRED, 0,
+                            values, 1, &read) == SYSTEM_ERROR_NONE);
+    TEST_CHECK((read == 1) && (values[0] == 250));
+
+    /* From a later sample, and past the newest */
+    TEST_CHECK(history_read(HISTORY_LEVEL_SECOND, HISTORY_METRIC_VOC,
+                            HISTORY_SECOND_SAMPLES - 3, values, 10, &read) ==
+               SYSTEM_ERROR_NONE);
+    TEST_CHECK((read == 3) && (values[0] == voc_at(k - 3)) &&
+               (values[2] == voc_at(k - 1)));
+    TEST_CHECK(history_read(HISTORY_LEVEL_SECOND, HISTORY_METRIC_VOC,
+                            HISTORY_SECOND_SAMPLES, values, 10, &read) ==
+               SYSTEM_ERROR_NONE);
+    TEST_CHECK(read == 0);
+    TEST_CHECK(history_read(HISTORY_LEVEL_SECOND, HISTORY_METRIC_VOC, 0,
+                            values, 0, &read) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(read == 0);
+
+    /* The minute ring got the average of every 60 seconds */
+    TEST_CHECK(history_get_info(HISTORY_LEVEL_MINUTE, &info) ==
+               SYSTEM_ERROR_NONE);
+    TEST_CHECK(info.count == k / 60);
+    TEST_CHECK(info.end_s == start_s + 60 * info.count);
+    num = read_all(HISTORY_LEVEL_MINUTE, HISTORY_METRIC_VOC, 0, values,
+                   info.count);
+    for (int i = 0; i < num; i++)
+    {
+        int32_t sum = 0;
+
+        for (int s = 0; s < 60; s++)
+        {
+            sum += voc_at(i * 60 + s);
+        }
+        TEST_CHECK(values[i] == sum / 60);
+    }
+}
+
+/* A step too large for a delta is caught up by the next samples */
+static void test_large_step(void)
+{
+    int32_t values[HISTORY_SECOND_SAMPLES];
+    int num = 0;
+
+    for (int i = 0; i < 5; i++)
+    {
+        sample((i == 0) ? 0 : 100000);
+    }
+    sample(-100000);
+    sample(-100000);
+    num = read_all(HISTORY_LEVEL_SECOND, HISTORY_METRIC_VOC, 0, values,
+                   HISTORY_SECOND_SAMPLES);
+    TEST_CHECK(num == HISTORY_SECOND_SAMPLES);
+    TEST_CHECK(values[num - 7] == 0);
+    TEST_CHECK(values[num - 6] == INT16_MAX);
+    TEST_CHECK(values[num - 5] == 2 * INT16_MAX);
+    TEST_CHECK(values[num - 4] == 3 * INT16_MAX);
+    TEST_CHECK(values[num - 3] == 100000);
+    TEST_CHECK(values[num - 2] == 100000 + INT16_MIN);
+    TEST_CHECK(values[num - 1] == 100000 + 2 * INT16_MIN);
+
+    /* Once the step drops out of the ring the base is still right */
+    for (int i = 0; i < HISTORY_SECOND_SAMPLES - 2; i++)
+    {
+        sample(-100000);
+    }
+    num = read_all(HISTORY_LEVEL_SECOND, HISTORY_METRIC_VOC, 0, values,
+                   HISTORY_SECOND_SAMPLES);
+    TEST_CHECK((values[0] == 100000 + INT16_MIN) &&
+               (values[1] == 100000 + 2 * INT16_MIN));
+    TEST_CHECK(values[num - 1] == -100000);
+}
+
+/* Quarters fill from minutes, and the quarter ring wraps too */
+static void test_levels(void)
+{
+    int32_t values[HISTORY_QUARTER_SAMPLES];
+    history_info_t second, minute, quarter;
+    uint32_t quarters = 0;
+    int num = 0;
+
+    /* Line up with a quarter */
+    TEST_CHECK(history_get_info(HISTORY_LEVEL_QUARTER, &quarter) ==
+               SYSTEM_ERROR_NONE);
+    quarters = quarter.count;
+    do
+    {
+        sample(7);
+        history_get_info(HISTORY_LEVEL_QUARTER, &quarter);
+    } while (quarter.count == quarters);
+
+    for (uint32_t q = 0; q < HISTORY_QUARTER_SAMPLES + 10; q++)
+    {
+        for (int s = 0; s < 900; s++)
+        {
+            sample(1000 + 10 * (q % 50));
+        }
+    }
+    TEST_CHECK(history_get_info(HISTORY_LEVEL_SECOND, &second) ==
+               SYSTEM_ERROR_NONE);
+    TEST_CHECK(history_get_info(HISTORY_LEVEL_MINUTE, &minute) ==
+               SYSTEM_ERROR_NONE);
+    TEST_CHECK(history_get_info(HISTORY_LEVEL_QUARTER, &quarter) ==
+               SYSTEM_ERROR_NONE);
+    TEST_CHECK(second.count == HISTORY_SECOND_SAMPLES);
+    TEST_CHECK(minute.count == HISTORY_MINUTE_SAMPLES);
+    TEST_CHECK(quarter.count == HISTORY_QUARTER_SAMPLES);
+    TEST_CHECK((second.end_s == gnow_s) && (minute.end_s == gnow_s) &&
+               (quarter.end_s == gnow_s));
+
+    num = read_all(HISTORY_LEVEL_QUARTER, HISTORY_METRIC_VOC, 0, values,
+                   HISTORY_QUARTER_SAMPLES);
+    TEST_CHECK(num == HISTORY_QUARTER_SAMPLES);
+    for (int i = 0; i < num; i++)
+    {
+        TEST_CHECK(values[i] == 1000 + 10 * ((i + 10) % 50));
+    }
+    num = read_all(HISTORY_LEVEL_MINUTE, HISTORY_METRIC_VOC, 0, values,
+                   HISTORY_MINUTE_SAMPLES);
+    TEST_CHECK((num == HISTORY_MINUTE_SAMPLES) &&
+               (values[num - 1] == 1000 + 10 * ((HISTORY_QUARTER_SAMPLES + 9) %
+                                                50)));
+}
+
+/* What http_api_history does with since= */
+static void test_since(void)
+{
+    history_info_t info = {.period_s = 1, .end_s = 1000, .count = 120,
+                           .size = 120};
+
+    TEST_CHECK(history_first_since(&info, 0) == 0);
+    TEST_CHECK(history_first_since(NULL, 10) == 0);
+    TEST_CHECK(history_first_since(&info, 1000) == 120);
+    TEST_CHECK(history_first_since(&info, 5000) == 120);
+    TEST_CHECK(history_first_since(&info, 999) == 119);
+    TEST_CHECK(history_first_since(&info, 990) == 110);
+    TEST_CHECK(history_first_since(&info, 881) == 1);
+    TEST_CHECK(history_first_since(&info, 880) == 0);
+    TEST_CHECK(history_first_since(&info, 1) == 0);
+
+    /* Minutes: 600 is the newest, 540 the one before */
+    info.period_s = 60;
+    info.end_s = 600;
+    info.count = 10;
+    TEST_CHECK(history_first_since(&info, 600) == 10);
+    TEST_CHECK(history_first_since(&info, 599) == 9);
+    TEST_CHECK(history_first_since(&info, 550) == 9);
+    TEST_CHECK(history_first_since(&info, 540) == 9);
+    TEST_CHECK(history_first_since(&info, 539) == 8);
+    TEST_CHECK(history_first_since(&info, 61) == 1);
+    TEST_CHECK(history_first_since(&info, 59) == 0);
+
+    /* Nothing held yet */
+    info.count = 0;
+    TEST_CHECK(history_first_since(&info, 550) == 0);
+    TEST_CHECK(history_first_since(&info, 700) == 0);
+}
+
+int main(void)
+{
+    test_not_ready();
+    history_init();
+    TEST_CHECK(gsample_cb != NULL);
+    TEST_CHECK(gtimer_starts == 1);
+    test_empty();
+    test_seconds();
+    test_large_step();
+    test_levels();
+    test_since();
+    TEST_CHECK(gsema_taken == 0);
+    return TEST_END();
+}
@@ -0,0 +1,609 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * The learned command codec of ir_learn.c: frames are fed like task_rmt does,
+ * with the clock and the semaphore under the test's control, then read back
+ * with ir_learn_get_frame(). IR_LEARN_FILE is a file in the build directory.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "ir_learn.h"
+#include "syslog.h"
+#include "system.h"
+#include "test.h"
+
+#define TEST_FRAME_GAP_MS   40
+#define TEST_MAX_SYMBOLS    128
+
+typedef struct
+{
+    rmt_symbol_word_t symbols[IR_LEARN_MAX_FRAMES][TEST_MAX_SYMBOLS];
+    size_t num[IR_LEARN_MAX_FRAMES];
+    int frames;
+} test_command_t;
+
+/* Far enough apart not to cluster, short enough to keep frames short */
+static const uint16_t gdurations[] = {300, 420, 590, 830, 1160, 1620, 2270,
+                                      3180};
+
+static int64_t gnow_ms = 1000;
+static int gsema_created = 0;
+static int gsema_taken = 0;
+static int gsyslog_count = 0;
+
+/* Key press of an air conditioner remote, from the example test of the
+   learn/ component: 4 frames, the long spaces are the gaps between them */
+static const uint16_t gsample[] = {
+    9000,   4500,   550,    1660,   550,    550,    550,    550,    550,    1660,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    1660,   550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    1660,   550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    1660,
+    550,    550,    550,    1660,   550,    550,    550,    550,    550,    1660,
+    550,    550,    610,    20194,
+
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    1660,   550,    550,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    1660,   550,    550,
+    550,    550,    550,    1660,   610,    40455,
+
+    9000,   4500,   550,    1660,   550,    550,    550,    550,    550,    1660,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    1660,   550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    1660,   550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    1660,
+    550,    1660,   550,    1660,   550,    550,    550,    550,    550,    1660,
+    550,    550,    610,    20194,
+
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    550,    550,    550,
+    550,    550,    550,    550,    550,    550,    550,    1660,   550,    1660,
+    550,    1660,   550,    550,    550,    0,
+};
+
+void syslog_handler(uint32_t facility, uint32_t level, const char *fmt, ...)
+{
+    gsyslog_count++;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return gnow_ms * 1000;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    gsema_created++;
+    gsema_taken = 1;
+    return &gsema_taken;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sema, TickType_t ticks)
+{
+    /* Single task, taking it twice would block forever on the device */
+    TEST_CHECK(gsema_taken == 0);
+    gsema_taken = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sema)
+{
+    TEST_CHECK(gsema_taken == 1);
+    gsema_taken = 0;
+    return pdTRUE;
+}
+
+static bool near(uint32_t a, uint32_t b)
+{
+    return ((a > b) ? (a - b) : (b - a)) <= IR_LEARN_MARGIN_US;
+}
+
+/* The RX channel ends a frame at the first long space, with duration 0 */
+static void command_from_sample(test_command_t *cmd)
+{
+    size_t num = 0;
+
+    memset(cmd, 0, sizeof(test_command_t));
+    for (size_t i = 0; i < sizeof(gsample) / sizeof(gsample[0]); i += 2)
+    {
+        rmt_symbol_word_t *symbol = &cmd->symbols[cmd->frames][num++];
+
+        symbol->level0 = 1;
+        symbol->duration0 = gsample[i];
+        symbol->level1 = 0;
+        symbol->duration1 = (gsample[i + 1] > 15000) ? 0 : gsample[i + 1];
+        if ((gsample[i + 1] > 15000) || (gsample[i + 1] == 0))
+        {
+            cmd->num[cmd->frames++] = num;
+            num = 0;
+        }
+    }
+}
+
+/* Every symbol differs from the one before, so nothing codes as a run */
+static void command_no_runs(test_command_t *cmd, int frames, size_t num,
+                            int seed)
+{
+    memset(cmd, 0, sizeof(test_command_t));
+    cmd->frames = frames;
+    for (int f = 0; f < frames; f++)
+    {
+        cmd->num[f] = num;
+        for (size_t i = 0; i < num; i++)
+        {
+            cmd->symbols[f][i].level0 = 1;
+            cmd->symbols[f][i].duration0 = gdurations[(i + seed) % 7];
+            cmd->symbols[f][i].level1 = 0;
+            cmd->symbols[f][i].duration1 = gdurations[(i / 7 + seed) % 8];
+        }
+    }
+}
+
+static uint32_t frame_ms(const rmt_symbol_word_t *symbols, size_t num)
+{
+    uint32_t duration = 0;
+
+    for (size_t i = 0; i < num; i++)
+    {
+        duration += symbols[i].duration0 + symbols[i].duration1;
+    }
+    return duration / 1000;
+}
+
+/* One key press, the frames arrive TEST_FRAME_GAP_MS apart */
+static void press(const test_command_t *cmd)
+{
+    for (int f = 0; f < cmd->frames; f++)
+    {
+        if (f > 0)
+        {
+            gnow_ms += frame_ms(cmd->symbols[f], cmd->num[f]) +
+                       TEST_FRAME_GAP_MS;
+        }
+        ir_learn_feed(cmd->symbols[f], cmd->num[f]);
+    }
+    /* No more frames, task_rmt polls and closes the press */
+    gnow_ms += IR_LEARN_FRAME_GAP_MS + 1;
+    ir_learn_poll();
+    gnow_ms += 2000;
+}
+
+static int learn(const char *name, const test_command_t *cmd)
+{
+    int state = 0, presses = 0;
+
+    TEST_CHECK(ir_learn_start(name) == SYSTEM_ERROR_NONE);
+    for (int i = 0; i < IR_LEARN_PRESS_COUNT; i++)
+    {
+        press(cmd);
+    }
+    TEST_CHECK(ir_learn_getstatus(&state, &presses) == SYSTEM_ERROR_NONE);
+    return state;
+}
+
+/* Learned frames play back as fed, within the margin of the dictionary */
+static bool same_command(int index, const test_command_t *cmd)
+{
+    rmt_symbol_word_t symbols[TEST_MAX_SYMBOLS];
+    uint32_t gap_ms = 0;
+    size_t num = 0;
+
+    for (int f = 0; f < cmd->frames; f++)
+    {
+        num = ir_learn_get_frame(index, f, symbols, TEST_MAX_SYMBOLS, &gap_ms);
+        if ((num != cmd->num[f]) ||
+            (gap_ms != ((f == 0) ? 0 : TEST_FRAME_GAP_MS)))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < num; i++)
+        {
+            if ((symbols[i].level0 != 1) || (symbols[i].level1 != 0) ||
+                !near(symbols[i].duration0, cmd->symbols[f][i].duration0) ||
+                !near(symbols[i].duration1, cmd->symbols[f][i].duration1))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void clear_all(void)
+{
+    int count = 0, used = 0;
+
+    ir_learn_getusage(&count, &used);
+    while (count-- > 0)
+    {
+        ir_learn_delete(0);
+    }
+}
+
+static void test_not_ready(void)
+{
+    rmt_symbol_word_t symbols[4];
+    int state = 0, presses = 0, count = 0, used = 0;
+    uint32_t gap_ms = 0;
+
+    TEST_CHECK(ir_learn_start("fan") == SYSTEM_ERROR_NOT_READY);
+    TEST_CHECK(ir_learn_getstatus(&state, &presses) ==
+               SYSTEM_ERROR_NOT_READY);
+    TEST_CHECK(ir_learn_getusage(&count, &used) == SYSTEM_ERROR_NOT_READY);
+    TEST_CHECK(ir_learn_delete(0) == SYSTEM_ERROR_NOT_READY);
+    TEST_CHECK(ir_learn_find("fan") == -1);
+    TEST_CHECK(ir_learn_generation() == 0);
+    TEST_CHECK(!ir_learn_isactive());
+    TEST_CHECK(ir_learn_get_frame(0, 0, symbols, 4, &gap_ms) == 0);
+}
+
+static void test_names(void)
+{
+    TEST_CHECK(ir_learn_start(NULL) == SYSTEM_ERROR_INVALID_POINTER);
+    TEST_CHECK(ir_learn_start("") == SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(ir_learn_start("0123456789abcdef") ==
+               SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(ir_learn_start("fan/on") == SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(ir_learn_start("fan\"on") == SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(!ir_learn_isactive());
+    TEST_CHECK(ir_learn_start("Fan on_2-a") == SYSTEM_ERROR_NONE);
+    TEST_CHECK(ir_learn_isactive());
+    TEST_CHECK(ir_learn_stop() == SYSTEM_ERROR_NONE);
+    TEST_CHECK(!ir_learn_isactive());
+}
+
+static void test_round_trip(void)
+{
+    static test_command_t cmd;
+    rmt_symbol_word_t symbols[TEST_MAX_SYMBOLS];
+    ir_learn_entry_t entry = {};
+    uint32_t generation = ir_learn_generation();
+    uint32_t gap_ms = 0;
+    int count = 0, used = 0, symbols_total = 0;
+
+    command_from_sample(&cmd);
+    TEST_CHECK(cmd.frames == 4);
+    for (int f = 0; f < cmd.frames; f++)
+    {
+        symbols_total += cmd.num[f];
+    }
+
+    TEST_CHECK(learn("ac cool", &cmd) == IR_LEARN_STATE_DONE);
+    TEST_CHECK(!ir_learn_isactive());
+    TEST_CHECK(ir_learn_generation() != generation);
+    TEST_CHECK(ir_learn_getusage(&count, &used) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(count == 1);
+    TEST_CHECK(ir_learn_getentry(0, &entry) == SYSTEM_ERROR_NONE);
+    TEST_CHECK_STR(entry.name, "ac cool");
+    TEST_CHECK(entry.frames == 4);
+    TEST_CHECK(entry.symbols == symbols_total);
+    TEST_CHECK((entry.offset == 0) && (entry.length == used));
+    /* Dictionary and runs: far below the 4 bytes of a raw symbol */
+    TEST_CHECK(used < symbols_total);
+    TEST_CHECK(ir_learn_getentry(1, &entry) == SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(ir_learn_find("ac cool") == 0);
+    TEST_CHECK(ir_learn_find("ac heat") == -1);
+    TEST_CHECK(same_command(0, &cmd));
+
+    /* Too small a buffer, no such frame or command */
+    TEST_CHECK(ir_learn_get_frame(0, 0, symbols, cmd.num[0] - 1, &gap_ms) ==
+               0);
+    TEST_CHECK(ir_learn_get_frame(0, 4, symbols, TEST_MAX_SYMBOLS, &gap_ms) ==
+               0);
+    TEST_CHECK(ir_learn_get_frame(1, 0, symbols, TEST_MAX_SYMBOLS, &gap_ms) ==
+               0);
+    TEST_CHECK(ir_learn_get_frame(-1, 0, symbols, TEST_MAX_SYMBOLS, &gap_ms) ==
+               0);
+    TEST_CHECK(ir_learn_get_frame(0, 0, symbols, TEST_MAX_SYMBOLS, NULL) == 0);
+    TEST_CHECK(ir_learn_get_frame(0, 0, symbols, cmd.num[0], &gap_ms) ==
+               cmd.num[0]);
+    clear_all();
+}
+
+static void test_runs(void)
+{
+    static test_command_t cmd;
+    rmt_symbol_word_t symbols[TEST_MAX_SYMBOLS];
+    int count = 0, used = 0;
+    uint32_t gap_ms = 0;
+
+    /* 100 equal symbols: a code and a run of up to 16 more per 17 */
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.frames = 1;
+    cmd.num[0] = 100;
+    for (int i = 0; i < 100; i++)
+    {
+        cmd.symbols[0][i].level0 = 1;
+        cmd.symbols[0][i].duration0 = 560;
+        cmd.symbols[0][i].duration1 = 1690;
+    }
+    TEST_CHECK(learn("runs", &cmd) == IR_LEARN_STATE_DONE);
+    ir_learn_getusage(&count, &used);
+    TEST_CHECK(used == 2 + 2 * 2 + 6 + 2 * ((100 + 16) / 17));
+    TEST_CHECK(ir_learn_get_frame(0, 0, symbols, TEST_MAX_SYMBOLS, &gap_ms) ==
+               100);
+    TEST_CHECK((symbols[99].duration0 == 560) &&
+               (symbols[99].duration1 == 1690));
+    clear_all();
+}
+
+static void test_presses(void)
+{
+    static test_command_t cmd, other;
+    rmt_symbol_word_t symbols[TEST_MAX_SYMBOLS];
+    uint32_t gap_ms = 0;
+    int state = 0, presses = 0;
+
+    /* The two presses are averaged */
+    command_no_runs(&cmd, 1, 20, 0);
+    other = cmd;
+    for (int i = 0; i < 20; i++)
+    {
+        other.symbols[0][i].duration0 += 60;
+    }
+    TEST_CHECK(ir_learn_start("avg") == SYSTEM_ERROR_NONE);
+    press(&cmd);
+    TEST_CHECK(ir_learn_getstatus(&state, &presses) == SYSTEM_ERROR_NONE);
+    TEST_CHECK((state == IR_LEARN_STATE_WAITING) && (presses == 1));
+    press(&other);
+    TEST_CHECK(ir_learn_getstatus(&state, &presses) == SYSTEM_ERROR_NONE);
+    TEST_CHECK((state == IR_LEARN_STATE_DONE) && (presses == 2));
+    TEST_CHECK(ir_learn_get_frame(0, 0, symbols, TEST_MAX_SYMBOLS, &gap_ms) ==
+               20);
+    /* Between the presses, the 300 us spaces share its dictionary entry */
+    TEST_CHECK((symbols[0].duration0 > gdurations[0]) &&
+               (symbols[0].duration0 < gdurations[0] + 60));
+    clear_all();
+
+    /* Durations too far apart */
+    for (int i = 0; i < 20; i++)
+    {
+        other.symbols[0][i].duration0 += 400;
+    }
+    TEST_CHECK(ir_learn_start("far") == SYSTEM_ERROR_NONE);
+    press(&cmd);
+    press(&other);
+    TEST_CHECK(ir_learn_getstatus(&state, &presses) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(state == IR_LEARN_STATE_FAIL);
+
+    /* Another frame count, then another symbol count */
+    command_no_runs(&other, 2, 20, 0);
+    TEST_CHECK(ir_learn_start("frames") == SYSTEM_ERROR_NONE);
+    press(&cmd);
+    press(&other);
+    TEST_CHECK(ir_learn_getstatus(&state, &presses) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(state == IR_LEARN_STATE_FAIL);
+    command_no_runs(&other, 1, 21, 0);
+    TEST_CHECK(ir_learn_start("symbols") == SYSTEM_ERROR_NONE);
+    press(&cmd);
+    press(&other);
+    TEST_CHECK(ir_learn_getstatus(&state, &presses) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(state == IR_LEARN_STATE_FAIL);
+
+    /* Short frames are noise, nothing comes: time out */
+    TEST_CHECK(ir_learn_start("noise") == SYSTEM_ERROR_NONE);
+    ir_learn_feed(cmd.symbols[0], IR_LEARN_MIN_SYMBOLS - 1);
+    ir_learn_poll();
+    TEST_CHECK(ir_learn_isactive());
+    gnow_ms += IR_LEARN_TIMEOUT_MS + 1;
+    ir_learn_poll();
+    TEST_CHECK(ir_learn_getstatus(&state, &presses) == SYSTEM_ERROR_NONE);
+    TEST_CHECK((state == IR_LEARN_STATE_FAIL) && (presses == 0));
+}
+
+static void test_dictionary_full(void)
+{
+    static const uint16_t durations[16] = {
+        200, 400, 700, 1000, 1400, 1900, 2500, 3200, 4000, 5000, 6200, 7600,
+        9300, 11300, 13700, 16600};
+    static test_command_t cmd;
+    int state = 0, presses = 0, count = 0, used = 0;
+
+    /* 16 durations, one more than the dictionary holds */
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.frames = 1;
+    cmd.num[0] = 8;
+    for (int i = 0; i < 8; i++)
+    {
+        cmd.symbols[0][i].level0 = 1;
+        cmd.symbols[0][i].duration0 = durations[i];
+        cmd.symbols[0][i].duration1 = durations[i + 8];
+    }
+    TEST_CHECK(learn("dict", &cmd) == IR_LEARN_STATE_FAIL);
+    TEST_CHECK(ir_learn_getusage(&count, &used) == SYSTEM_ERROR_NONE);
+    TEST_CHECK((count == 0) && (used == 0));
+
+    cmd.symbols[0][7].duration1 = durations[0];
+    TEST_CHECK(learn("dict", &cmd) == IR_LEARN_STATE_DONE);
+    TEST_CHECK(ir_learn_getstatus(&state, &presses) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(same_command(0, &cmd));
+    clear_all();
+}
+
+static void test_delete(void)
+{
+    static test_command_t a, b, c, b2;
+    ir_learn_entry_t entry_a = {}, entry_b = {}, entry_c = {};
+    uint32_t generation = 0;
+    int count = 0, used = 0;
+
+    command_no_runs(&a, 1, 30, 1);
+    command_no_runs(&b, 2, 40, 2);
+    command_no_runs(&c, 3, 50, 3);
+    TEST_CHECK(learn("a", &a) == IR_LEARN_STATE_DONE);
+    TEST_CHECK(learn("b", &b) == IR_LEARN_STATE_DONE);
+    TEST_CHECK(learn("c", &c) == IR_LEARN_STATE_DONE);
+    ir_learn_getentry(0, &entry_a);
+    ir_learn_getentry(1, &entry_b);
+    ir_learn_getentry(2, &entry_c);
+    TEST_CHECK(entry_b.offset == entry_a.length);
+    TEST_CHECK(entry_c.offset == entry_a.length + entry_b.length);
+
+    /* The middle one: c moves down into its place */
+    generation = ir_learn_generation();
+    TEST_CHECK(ir_learn_delete(1) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(ir_learn_generation() != generation);
+    TEST_CHECK(ir_learn_getusage(&count, &used) == SYSTEM_ERROR_NONE);
+    TEST_CHECK((count == 2) && (used == entry_a.length + entry_c.length));
+    TEST_CHECK(ir_learn_find("b") == -1);
+    TEST_CHECK(ir_learn_find("c") == 1);
+    ir_learn_getentry(1, &entry_c);
+    TEST_CHECK(entry_c.offset == entry_a.length);
+    TEST_CHECK(same_command(0, &a));
+    TEST_CHECK(same_command(1, &c));
+    TEST_CHECK(ir_learn_delete(2) == SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(ir_learn_delete(-1) == SYSTEM_ERROR_INVALID_PARAMETER);
+
+    /* Learning a name again replaces it, at the end of the arena */
+    command_no_runs(&b2, 1, 10, 4);
+    TEST_CHECK(learn("a", &b2) == IR_LEARN_STATE_DONE);
+    TEST_CHECK(ir_learn_find("a") == 1);
+    TEST_CHECK(same_command(0, &c));
+    TEST_CHECK(same_command(1, &b2));
+    ir_learn_getentry(0, &entry_c);
+    TEST_CHECK(entry_c.offset == 0);
+
+    /* The first one */
+    TEST_CHECK(ir_learn_delete(0) == SYSTEM_ERROR_NONE);
+    ir_learn_getentry(0, &entry_b);
+    TEST_CHECK(entry_b.offset == 0);
+    TEST_CHECK(same_command(0, &b2));
+    clear_all();
+    TEST_CHECK(ir_learn_getusage(&count, &used) == SYSTEM_ERROR_NONE);
+    TEST_CHECK((count == 0) && (used == 0));
+}
+
+static void test_arena_full(void)
+{
+    static test_command_t cmd;
+    ir_learn_entry_t entry = {};
+    int count = 0, used = 0, last_count = 0, last_used = 0;
+    char name[32];
+
+    /* Commands of 522 bytes until one doesn't fit */
+    command_no_runs(&cmd, IR_LEARN_MAX_FRAMES, 120, 0);
+    for (int i = 0; i < IR_LEARN_MAX_ENTRIES; i++)
+    {
+        snprintf(name, sizeof(name), "big%d", i);
+        if (learn(name, &cmd) != IR_LEARN_STATE_DONE)
+        {
+            break;
+        }
+        last_count = i + 1;
+    }
+    TEST_CHECK(ir_learn_getusage(&count, &used) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(count == last_count);
+    TEST_CHECK((count > 0) && (count < IR_LEARN_MAX_ENTRIES));
+    TEST_CHECK(used <= IR_LEARN_ARENA_SIZE);
+    ir_learn_getentry(0, &entry);
+    TEST_CHECK(used + entry.length > IR_LEARN_ARENA_SIZE);
+    TEST_CHECK(ir_learn_find(name) == -1);
+    TEST_CHECK(same_command(count - 1, &cmd));
+
+    /* Failing didn't touch the arena, deleting makes room again */
+    last_used = used;
+    TEST_CHECK(learn(name, &cmd) == IR_LEARN_STATE_FAIL);
+    ir_learn_getusage(&count, &used);
+    TEST_CHECK((count == last_count) && (used == last_used));
+    TEST_CHECK(ir_learn_delete(0) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(learn(name, &cmd) == IR_LEARN_STATE_DONE);
+    ir_learn_getusage(&count, &used);
+    TEST_CHECK((count == last_count) && (used == last_used));
+    TEST_CHECK(same_command(count - 1, &cmd));
+    clear_all();
+
+    /* The directory fills before the arena with small commands */
+    command_no_runs(&cmd, 1, 8, 0);
+    for (int i = 0; i < IR_LEARN_MAX_ENTRIES; i++)
+    {
+        snprintf(name, sizeof(name), "small%d", i);
+        TEST_CHECK(learn(name, &cmd) == IR_LEARN_STATE_DONE);
+    }
+    TEST_CHECK(learn("one more", &cmd) == IR_LEARN_STATE_FAIL);
+    ir_learn_getusage(&count, &used);
+    TEST_CHECK(count == IR_LEARN_MAX_ENTRIES);
+    /* Replacing one still works when full */
+    TEST_CHECK(learn("small3", &cmd) == IR_LEARN_STATE_DONE);
+    TEST_CHECK(ir_learn_find("small3") == IR_LEARN_MAX_ENTRIES - 1);
+    clear_all();
+}
+
+static void test_file(void)
+{
+    static test_command_t a, b;
+    int count = 0, used = 0, saved_used = 0;
+    FILE *file = NULL;
+
+    command_no_runs(&a, 2, 33, 5);
+    command_from_sample(&b);
+    TEST_CHECK(learn("a", &a) == IR_LEARN_STATE_DONE);
+    TEST_CHECK(learn("b", &b) == IR_LEARN_STATE_DONE);
+    TEST_CHECK(ir_learn_delete(0) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(learn("a", &a) == IR_LEARN_STATE_DONE);
+    ir_learn_getusage(&count, &saved_used);
+
+    /* As after a reboot */
+    ir_learn_init();
+    TEST_CHECK(ir_learn_getusage(&count, &used) == SYSTEM_ERROR_NONE);
+    TEST_CHECK((count == 2) && (used == saved_used));
+    TEST_CHECK(ir_learn_find("b") == 0);
+    TEST_CHECK(same_command(0, &b));
+    TEST_CHECK(same_command(1, &a));
+
+    /* A cut file is dropped as a whole */
+    file = fopen(IR_LEARN_FILE, "r+b");
+    TEST_CHECK(file != NULL);
+    if (file != NULL)
+    {
+        TEST_CHECK(ftruncate(fileno(file), 40) == 0);
+        fclose(file);
+    }
+    ir_learn_init();
+    ir_learn_getusage(&count, &used);
+    TEST_CHECK((count == 0) && (used == 0));
+    TEST_CHECK(ir_learn_find("b") == -1);
+
+    /* No file at all */
+    remove(IR_LEARN_FILE);
+    ir_learn_init();
+    ir_learn_getusage(&count, &used);
+    TEST_CHECK((count == 0) && (used == 0));
+}
+
+int main(void)
+{
+    remove(IR_LEARN_FILE);
+    test_not_ready();
+    ir_learn_init();
+    TEST_CHECK(gsema_created == 1);
+    TEST_CHECK(gsema_taken == 0);
+    TEST_CHECK(ir_learn_generation() != 0);
+    test_names();
+    test_round_trip();
+    test_runs();
+    test_presses();
+    test_dictionary_full();
+    test_delete();
+    test_arena_full();
+    test_file();
+    TEST_CHECK(gsema_taken == 0);
+    TEST_CHECK(gsyslog_count > 0);
+    return TEST_END();
+}
@@ -0,0 +1,267 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include "ir_protocol.h"
+#include "rmt.h"
+#include "test.h"
+
+#define TEST_MAX_SYMBOLS 512
+
+static rmt_symbol_word_t gsymbols[TEST_MAX_SYMBOLS];
+
+/* Encode data (and time) of type into gsymbols */
+static size_t encode(char type, const uint8_t *data, const uint8_t *time)
+{
+    const ir_protocol_t *proto = ir_protocol_get(type);
+    uint8_t payload[IR_PROTOCOL_MAX_PAYLOAD + IR_PROTOCOL_MAX_TIME];
+    size_t length = 0;
+
+    if (proto == NULL)
+    {
+        return 0;
+    }
+    length = ir_protocol_pack(proto, data, time, payload);
+    return ir_protocol_fill_symbols(proto, IR_RESOLUTION_HZ, payload, length,
+                                    gsymbols, TEST_MAX_SYMBOLS);
+}
+
+/* Move every edge by up to jitter us, like a real receiver */
+static void shake(size_t num, int jitter)
+{
+    for (size_t i = 0; i < num; i++)
+    {
+        int sign = (i % 2) ? 1 : -1;
+        if (gsymbols[i].duration0 > jitter)
+        {
+            gsymbols[i].duration0 += sign * jitter;
+        }
+        if (gsymbols[i].duration1 > jitter)
+        {
+            gsymbols[i].duration1 -= sign * jitter;
+        }
+    }
+}
+
+/* What the receiver sees of bytes, the encoder rewrites checksum bytes */
+static void expect_bytes(const ir_protocol_t *proto, const uint8_t *bytes,
+                         size_t length, uint8_t *expected)
+{
+    memcpy(expected, bytes, length);
+    if (proto->checksum != IR_PROTOCOL_CHECKSUM_INV_PAIRS)
+    {
+        return;
+    }
+    for (size_t i = proto->checksum_offset + 1; i < length; i += 2)
+    {
+        expected[i] = ~expected[i - 1];
+    }
+}
+
+/* xorshift32, the same frames on every run */
+static uint32_t grandom = 2463534242UL;
+
+static uint8_t random_byte(void)
+{
+    grandom ^= grandom << 13;
+    grandom ^= grandom >> 17;
+    grandom ^= grandom << 5;
+    return (uint8_t)grandom;
+}
+
+static void test_table(void)
+{
+    const ir_protocol_t *proto = NULL;
+    const ir_protocol_t *other = NULL;
+    int num = ir_protocol_num();
+
+    TEST_CHECK((num > 0) && (num < IR_TYPE_MAX));
+    TEST_CHECK(ir_protocol_get_by_index(-1) == NULL);
+    TEST_CHECK(ir_protocol_get_by_index(num) == NULL);
+    TEST_CHECK(ir_protocol_get(0) == NULL);
+    TEST_CHECK(ir_protocol_get(IR_TYPE_LEARN) == NULL);
+    for (int i = 0; i < num; i++)
+    {
+        proto = ir_protocol_get_by_index(i);
+        TEST_CHECK(proto != NULL);
+        TEST_CHECK(proto->name != NULL);
+        TEST_CHECK((proto->type > 0) && (proto->type < IR_TYPE_MAX));
+        TEST_CHECK(ir_protocol_get(proto->type) == proto);
+        TEST_CHECK((proto->nelem > 0) &&
+                   (proto->nelem <= IR_PROTOCOL_MAX_ELEM));
+        TEST_CHECK(proto->elem[0] == IR_PROTOCOL_ELEM_LEADING);
+        TEST_CHECK(proto->elem[proto->nelem - 1] == IR_PROTOCOL_ELEM_ENDING);
+        TEST_CHECK(proto->data_len <= IR_PROTOCOL_MAX_PAYLOAD);
+        TEST_CHECK(proto->time_len <= IR_PROTOCOL_MAX_TIME);
+        TEST_CHECK(ir_protocol_frame_symbols(proto) <= TEST_MAX_SYMBOLS);
+        /* A bit decodes as zero or one, never both */
+        TEST_CHECK((abs(proto->one.duration0 - proto->zero.duration0) >=
+                    2 * proto->margin) ||
+                   (abs(proto->one.duration1 - proto->zero.duration1) >=
+                    2 * proto->margin));
+        /* The leading code picks exactly this protocol */
+        gsymbols[0] = (rmt_symbol_word_t){
+            .level0 = 1,
+            .duration0 = proto->leading.duration0,
+            .level1 = 0,
+            .duration1 = proto->leading.duration1,
+        };
+        TEST_CHECK(ir_protocol_classify(gsymbols) == proto);
+        for (int j = 0; j < num; j++)
+        {
+            other = ir_protocol_get_by_index(j);
+            TEST_CHECK((j == i) || (other->type != proto->type));
+        }
+    }
+}
+
+static void test_roundtrip(void)
+{
+    const ir_protocol_t *proto = NULL;
+    ir_protocol_result_t result;
+    uint8_t data[IR_PROTOCOL_MAX_PAYLOAD];
+    uint8_t time[IR_PROTOCOL_MAX_TIME];
+    uint8_t expected[IR_PROTOCOL_MAX_PAYLOAD];
+    size_t num = 0;
+
+    for (int i = 0; i < ir_protocol_num(); i++)
+    {
+        proto = ir_protocol_get_by_index(i);
+        for (int round = 0; round < 50; round++)
+        {
+            for (int j = 0; j < IR_PROTOCOL_MAX_PAYLOAD; j++)
+            {
+                data[j] = random_byte();
+            }
+            for (int j = 0; j < IR_PROTOCOL_MAX_TIME; j++)
+            {
+                time[j] = random_byte();
+            }
+            num = encode(proto->type, data, time);
+            TEST_CHECK(num == ir_protocol_frame_symbols(proto));
+            shake(num, (round % 4) * (proto->margin - 1) / 3);
+            memset(&result, 0xA5, sizeof(result));
+            TEST_CHECK(ir_protocol_parse(gsymbols, num, &result));
+            TEST_CHECK(result.type == proto->type);
+            TEST_CHECK(result.data_len == proto->data_len);
+            TEST_CHECK(result.time_len == proto->time_len);
+            expect_bytes(proto, data, proto->data_len, expected);
+            TEST_CHECK(memcmp(result.data, expected, proto->data_len) == 0);
+            expect_bytes(proto, time, proto->time_len, expected);
+            TEST_CHECK(memcmp(result.time, expected, proto->time_len) == 0);
+        }
+    }
+}
+
+static void test_reject(void)
+{
+    const ir_protocol_t *hitachi = ir_protocol_get(IR_TYPE_HITACHI);
+    ir_protocol_result_t result;
+    uint8_t data[IR_PROTOCOL_MAX_PAYLOAD] = {0};
+    uint8_t payload[IR_PROTOCOL_MAX_PAYLOAD];
+    size_t num = 0;
+
+    /* Buffer too small for the frame */
+    ir_protocol_pack(hitachi, data, NULL, payload);
+    TEST_CHECK(ir_protocol_fill_symbols(hitachi, IR_RESOLUTION_HZ, payload,
+                                        hitachi->data_len, gsymbols,
+                                        ir_protocol_frame_symbols(hitachi) -
+                                            1) == 0);
+    /* Payload shorter than the protocol */
+    TEST_CHECK(ir_protocol_fill_symbols(hitachi, IR_RESOLUTION_HZ, payload,
+                                        hitachi->data_len - 1, gsymbols,
+                                        TEST_MAX_SYMBOLS) == 0);
+
+    TEST_CHECK(!ir_protocol_parse(NULL, 10, &result));
+    TEST_CHECK(!ir_protocol_parse(gsymbols, 1, &result));
+
+    /* Unknown leading code */
+    num = encode(IR_TYPE_HITACHI, data, NULL);
+    gsymbols[0].duration0 = 12000;
+    TEST_CHECK(!ir_protocol_parse(gsymbols, num, &result));
+    TEST_CHECK(ir_protocol_classify(gsymbols) == NULL);
+
+    /* A mark that is no bit, repeat or ending */
+    num = encode(IR_TYPE_HITACHI, data, NULL);
+    gsymbols[5].duration0 = 2000;
+    TEST_CHECK(!ir_protocol_parse(gsymbols, num, &result));
+
+    /* Checksum byte not the inverse of the one before */
+    num = encode(IR_TYPE_HITACHI, data, NULL);
+    gsymbols[1 + (hitachi->checksum_offset + 1) * 8] =
+        gsymbols[1 + hitachi->checksum_offset * 8];
+    TEST_CHECK(!ir_protocol_parse(gsymbols, num, &result));
+
+    /* Cut before the ending code, or inside a field */
+    for (int i = 0; i < ir_protocol_num(); i++)
+    {
+        const ir_protocol_t *proto = ir_protocol_get_by_index(i);
+
+        num = encode(proto->type, data, data);
+        TEST_CHECK(!ir_protocol_parse(gsymbols, num - 1, &result));
+        num = encode(proto->type, data, data);
+        gsymbols[num / 2] = gsymbols[num - 1];
+        TEST_CHECK(!ir_protocol_parse(gsymbols, num / 2 + 1, &result));
+    }
+
+    /* One bit dropped, the ending code comes early */
+    num = encode(IR_TYPE_DYSON, data, NULL);
+    gsymbols[num - 2] = gsymbols[num - 1];
+    TEST_CHECK(!ir_protocol_parse(gsymbols, num - 1, &result));
+
+    /* Delta without the timer code, after the middle gap or without it */
+    num = encode(IR_TYPE_DELTA, data, data);
+    gsymbols[35] = gsymbols[num - 1];
+    TEST_CHECK(!ir_protocol_parse(gsymbols, 36, &result));
+    gsymbols[33] = gsymbols[num - 1];
+    TEST_CHECK(!ir_protocol_parse(gsymbols, 34, &result));
+
+    /* More bits than the spec */
+    num = encode(IR_TYPE_DYSON, data, NULL);
+    gsymbols[num] = gsymbols[num - 1];
+    gsymbols[num - 1] = gsymbols[1];
+    TEST_CHECK(!ir_protocol_parse(gsymbols, num + 1, &result));
+}
+
+static void test_dyson_roundtrip(void)
+{
+    /* Any address and key have to survive, the real codes are learned */
+    static const uint8_t codes[][3] = {
+        {0x00, 0x00, 0x00}, {0xFF, 0xFF, 0xFF}, {0x20, 0x9E, 0x08},
+        {0x55, 0xAA, 0x5A}, {0x01, 0x80, 0x7E},
+    };
+    const ir_protocol_t *proto = ir_protocol_get(IR_TYPE_DYSON);
+    ir_protocol_result_t result;
+    size_t num = 0;
+
+    TEST_CHECK(proto != NULL);
+    for (size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); i++)
+    {
+        for (int jitter = 0; jitter < proto->margin; jitter += 100)
+        {
+            num = encode(IR_TYPE_DYSON, codes[i], NULL);
+            TEST_CHECK(num == ir_protocol_frame_symbols(proto));
+            shake(num, jitter);
+            memset(&result, 0, sizeof(result));
+            TEST_CHECK(ir_protocol_classify(gsymbols) == proto);
+            TEST_CHECK(ir_protocol_parse(gsymbols, num, &result));
+            TEST_CHECK(result.type == IR_TYPE_DYSON);
+            TEST_CHECK(result.data_len == 3);
+            TEST_CHECK(result.repeat == 0);
+            TEST_CHECK(memcmp(result.data, codes[i], 3) == 0);
+        }
+    }
+}
+
+int main(void)
+{
+    ir_protocol_init();
+    test_table();
+    test_roundtrip();
+    test_reject();
+    test_dyson_roundtrip();
+    return TEST_END();
+}
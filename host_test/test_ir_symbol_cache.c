@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include "ir_symbol_cache.h"
+#include "rmt.h"
+#include "syslog.h"
+#include "test.h"
+
+static int gsyslog_count = 0;
+
+void syslog_handler(uint32_t facility, uint32_t level, const char *fmt, ...)
+{
+    gsyslog_count++;
+}
+
+/* Symbols the cache has to hand out for payload */
+static bool same_as_fill(const ir_protocol_t *proto, const uint8_t *payload,
+                         size_t length, const rmt_symbol_word_t *symbols,
+                         size_t num)
+{
+    rmt_symbol_word_t expected[512];
+    size_t expected_num = ir_protocol_fill_symbols(
+        proto, IR_RESOLUTION_HZ, payload, length, expected, 512);
+
+    return (expected_num == num) &&
+           (memcmp(expected, symbols, num * sizeof(rmt_symbol_word_t)) == 0);
+}
+
+static void test_hit_miss(void)
+{
+    const ir_protocol_t *dyson = ir_protocol_get(IR_TYPE_DYSON);
+    const rmt_symbol_word_t *first = NULL;
+    const rmt_symbol_word_t *again = NULL;
+    uint8_t payload[3] = {0x12, 0x34, 0x56};
+    uint32_t hit = 0, miss = 0;
+    size_t num = 0;
+
+    ir_symbol_cache_init(IR_RESOLUTION_HZ);
+    first = ir_symbol_cache_get(dyson, payload, sizeof(payload), &num);
+    TEST_CHECK(first != NULL);
+    TEST_CHECK(num == ir_protocol_frame_symbols(dyson));
+    TEST_CHECK(same_as_fill(dyson, payload, sizeof(payload), first, num));
+    ir_symbol_cache_getstats(&hit, &miss);
+    TEST_CHECK((hit == 0) && (miss == 1));
+
+    again = ir_symbol_cache_get(dyson, payload, sizeof(payload), &num);
+    TEST_CHECK(again == first);
+    ir_symbol_cache_getstats(&hit, &miss);
+    TEST_CHECK((hit == 1) && (miss == 1));
+
+    /* One bit off is another frame */
+    payload[2] ^= 0x01;
+    again = ir_symbol_cache_get(dyson, payload, sizeof(payload), &num);
+    TEST_CHECK((again != NULL) && (again != first));
+    TEST_CHECK(same_as_fill(dyson, payload, sizeof(payload), again, num));
+    ir_symbol_cache_getstats(&hit, &miss);
+    TEST_CHECK((hit == 1) && (miss == 2));
+
+    /* The same bytes of another protocol are another frame too */
+    again = ir_symbol_cache_get(ir_protocol_get(IR_TYPE_ZERO), payload, 2,
+                                &num);
+    TEST_CHECK(again != NULL);
+    TEST_CHECK(num == ir_protocol_frame_symbols(ir_protocol_get(IR_TYPE_ZERO)));
+    ir_symbol_cache_getstats(&hit, &miss);
+    TEST_CHECK((hit == 1) && (miss == 3));
+}
+
+static void test_lru(void)
+{
+    const ir_protocol_t *zero = ir_protocol_get(IR_TYPE_ZERO);
+    uint8_t payload[2] = {0x76, 0};
+    uint32_t hit = 0, miss = 0, hit0 = 0, miss0 = 0;
+    size_t num = 0;
+
+    ir_symbol_cache_init(IR_RESOLUTION_HZ);
+    ir_symbol_cache_getstats(&hit0, &miss0);
+    for (int i = 0; i < IR_SYMBOL_CACHE_SIZE; i++)
+    {
+        payload[1] = i;
+        TEST_CHECK(ir_symbol_cache_get(zero, payload, 2, &num) != NULL);
+    }
+    /* Touch entry 0 so entry 1 is the oldest */
+    payload[1] = 0;
+    ir_symbol_cache_get(zero, payload, 2, &num);
+    payload[1] = IR_SYMBOL_CACHE_SIZE;
+    ir_symbol_cache_get(zero, payload, 2, &num);
+    ir_symbol_cache_getstats(&hit, &miss);
+    TEST_CHECK(hit - hit0 == 1);
+    TEST_CHECK(miss - miss0 == IR_SYMBOL_CACHE_SIZE + 1);
+
+    /* 0 and the newest stay, 1 was evicted */
+    payload[1] = 0;
+    ir_symbol_cache_get(zero, payload, 2, &num);
+    payload[1] = IR_SYMBOL_CACHE_SIZE;
+    ir_symbol_cache_get(zero, payload, 2, &num);
+    ir_symbol_cache_getstats(&hit, &miss);
+    TEST_CHECK(hit - hit0 == 3);
+    payload[1] = 1;
+    ir_symbol_cache_get(zero, payload, 2, &num);
+    ir_symbol_cache_getstats(&hit, &miss);
+    TEST_CHECK(miss - miss0 == IR_SYMBOL_CACHE_SIZE + 2);
+}
+
+static void test_grow(void)
+{
+    const ir_protocol_t *hitachi = ir_protocol_get(IR_TYPE_HITACHI);
+    const ir_protocol_t *zero = ir_protocol_get(IR_TYPE_ZERO);
+    const rmt_symbol_word_t *symbols = NULL;
+    uint8_t payload[IR_PROTOCOL_MAX_PAYLOAD];
+    size_t num = 0;
+
+    /* Fill every entry with short frames, then a long frame has to get a
+       larger buffer than the entry it replaces */
+    ir_symbol_cache_init(IR_RESOLUTION_HZ);
+    for (int i = 0; i < IR_SYMBOL_CACHE_SIZE; i++)
+    {
+        payload[0] = i;
+        ir_symbol_cache_get(zero, payload, zero->data_len, &num);
+    }
+    for (int i = 0; i < IR_PROTOCOL_MAX_PAYLOAD; i++)
+    {
+        payload[i] = i * 7;
+    }
+    symbols = ir_symbol_cache_get(hitachi, payload, hitachi->data_len, &num);
+    TEST_CHECK(symbols != NULL);
+    TEST_CHECK(num == ir_protocol_frame_symbols(hitachi));
+    TEST_CHECK(same_as_fill(hitachi, payload, hitachi->data_len, symbols, num));
+}
+
+static void test_invalid(void)
+{
+    const ir_protocol_t *dyson = ir_protocol_get(IR_TYPE_DYSON);
+    uint8_t payload[IR_SYMBOL_CACHE_MAX_PAYLOAD + 1] = {0};
+    size_t num = 0;
+
+    TEST_CHECK(ir_symbol_cache_get(NULL, payload, 3, &num) == NULL);
+    TEST_CHECK(ir_symbol_cache_get(dyson, NULL, 3, &num) == NULL);
+    TEST_CHECK(ir_symbol_cache_get(dyson, payload, 3, NULL) == NULL);
+    TEST_CHECK(ir_symbol_cache_get(dyson, payload, sizeof(payload), &num) ==
+               NULL);
+    /* Shorter than the protocol, nothing to send */
+    TEST_CHECK(ir_symbol_cache_get(dyson, payload, 2, &num) == NULL);
+}
+
+int main(void)
+{
+    ir_protocol_init();
+    test_hit_miss();
+    test_lru();
+    test_grow();
+    test_invalid();
+    /* Free the buffers for the leak check */
+    ir_symbol_cache_init(IR_RESOLUTION_HZ);
+    return TEST_END();
+}
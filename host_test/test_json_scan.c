@@ -0,0 +1,392 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdint.h>
+#include "http_form.h"
+#include "json_scan.h"
+#include "system.h"
+#include "test.h"
+
+#define SCAN_MAX_MEMBERS 16
+
+typedef struct
+{
+    char key[JSON_SCAN_MAXLEN_KEY + 1];
+    int type;
+    char value[JSON_SCAN_MAXLEN_VALUE + 1];
+    int len;
+} member_t;
+
+typedef struct
+{
+    member_t members[SCAN_MAX_MEMBERS];
+    int num;
+} scanned_t;
+
+static void scan_member(void *arg, const char *key, int type,
+                        const char *value, int len)
+{
+    scanned_t *scanned = (scanned_t *)arg;
+    member_t *member = NULL;
+
+    TEST_CHECK(scanned->num < SCAN_MAX_MEMBERS);
+    TEST_CHECK((int)strlen(value) == len);
+    if (scanned->num >= SCAN_MAX_MEMBERS)
+    {
+        return;
+    }
+    member = &scanned->members[scanned->num++];
+    strcpy(member->key, key);
+    member->type = type;
+    memcpy(member->value, value, len + 1);
+    member->len = len;
+}
+
+/* Scanned in one piece, then again cut after every byte */
+static int scan(const char *text, scanned_t *scanned)
+{
+    json_scan_t state;
+    scanned_t again = {0};
+    int ret = SYSTEM_ERROR_NONE, ret_again = SYSTEM_ERROR_NONE;
+    bool done = false;
+
+    memset(scanned, 0, sizeof(*scanned));
+    json_scan_init(&state, scan_member, scanned);
+    ret = json_scan_feed(&state, text, strlen(text));
+    done = json_scan_done(&state);
+
+    json_scan_init(&state, scan_member, &again);
+    for (size_t i = 0; (i < strlen(text)) && (ret_again == SYSTEM_ERROR_NONE);
+         i++)
+    {
+        ret_again = json_scan_feed(&state, &text[i], 1);
+    }
+    TEST_CHECK(ret_again == ret);
+    TEST_CHECK(json_scan_done(&state) == done);
+    TEST_CHECK(memcmp(&again, scanned, sizeof(again)) == 0);
+
+    if (ret != SYSTEM_ERROR_NONE)
+    {
+        return ret;
+    }
+    return done ? SYSTEM_ERROR_NONE : SYSTEM_ERROR_NOT_READY;
+}
+
+static bool has(const scanned_t *scanned, int index, const char *key, int type,
+                const char *value)
+{
+    const member_t *member = &scanned->members[index];
+
+    return (index < scanned->num) && (strcmp(member->key, key) == 0) &&
+           (member->type == type) && (strcmp(member->value, value) == 0);
+}
+
+static void test_flat(void)
+{
+    scanned_t scanned;
+
+    TEST_CHECK(scan(" {\"s\": \"text\", \"n\":-12.5e3 ,\"t\":true,"
+                    "\"f\" : false, \"z\":null, \"e\": \"\"}\r\n",
+                    &scanned) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(scanned.num == 6);
+    TEST_CHECK(has(&scanned, 0, "s", JSON_SCAN_STRING, "text"));
+    TEST_CHECK(has(&scanned, 1, "n", JSON_SCAN_NUMBER, "-12.5e3"));
+    TEST_CHECK(has(&scanned, 2, "t", JSON_SCAN_TRUE, "true"));
+    TEST_CHECK(has(&scanned, 3, "f", JSON_SCAN_FALSE, "false"));
+    TEST_CHECK(has(&scanned, 4, "z", JSON_SCAN_NULL, "null"));
+    TEST_CHECK(has(&scanned, 5, "e", JSON_SCAN_STRING, ""));
+
+    TEST_CHECK(scan("{}", &scanned) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(scanned.num == 0);
+    TEST_CHECK(scan("{\"n\":7}", &scanned) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(has(&scanned, 0, "n", JSON_SCAN_NUMBER, "7"));
+}
+
+static void test_escapes(void)
+{
+    scanned_t scanned;
+
+    TEST_CHECK(scan("{\"a\\\"b\": \"q\\\"\\\\\\/\\b\\f\\n\\r\\t!\","
+                    "\"u\": \"x\\u00e9y\"}",
+                    &scanned) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(scanned.num == 2);
+    TEST_CHECK(has(&scanned, 0, "a\"b", JSON_SCAN_STRING,
+                   "q\"\\/\b\f\n\r\t!"));
+    /* Settings are ASCII, \u is a placeholder */
+    TEST_CHECK(has(&scanned, 1, "u", JSON_SCAN_STRING, "x?y"));
+}
+
+static void test_nested(void)
+{
+    scanned_t scanned;
+
+    /* Skipped without a callback, brackets in strings don't count */
+    TEST_CHECK(scan("{\"a\": 1, \"o\": {\"x\": [1, {\"y\": \"}]\\\"{\"}], "
+                    "\"z\": {}}, \"l\": [[], [\"]\"], {}], \"b\": \"2\"}",
+                    &scanned) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(scanned.num == 2);
+    TEST_CHECK(has(&scanned, 0, "a", JSON_SCAN_NUMBER, "1"));
+    TEST_CHECK(has(&scanned, 1, "b", JSON_SCAN_STRING, "2"));
+
+    TEST_CHECK(scan("{\"o\": {\"a\": 1}", &scanned) ==
+               SYSTEM_ERROR_NOT_READY);
+    TEST_CHECK(scan("[1, 2]", &scanned) == SYSTEM_ERROR_INVALID_PARAMETER);
+}
+
+static void test_too_long(void)
+{
+    char text[256];
+    char key[JSON_SCAN_MAXLEN_KEY + 2];
+    char value[JSON_SCAN_MAXLEN_VALUE + 2];
+    scanned_t scanned;
+
+    /* One over is dropped, the members after it are kept */
+    memset(key, 'k', sizeof(key) - 1);
+    key[sizeof(key) - 1] = '\0';
+    memset(value, 'v', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+    snprintf(text, sizeof(text),
+             "{\"%s\": 1, \"a\": \"%s\", \"b\": \"%s\", \"c\": 3}", key, value,
+             value + 1);
+    TEST_CHECK(scan(text, &scanned) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(scanned.num == 2);
+    TEST_CHECK(has(&scanned, 0, "b", JSON_SCAN_STRING, value + 1));
+    TEST_CHECK(has(&scanned, 1, "c", JSON_SCAN_NUMBER, "3"));
+    TEST_CHECK(scanned.members[0].len == JSON_SCAN_MAXLEN_VALUE);
+
+    key[sizeof(key) - 2] = '\0';
+    snprintf(text, sizeof(text), "{\"%s\": 1}", key);
+    TEST_CHECK(scan(text, &scanned) == SYSTEM_ERROR_NONE);
+    TEST_CHECK(has(&scanned, 0, key, JSON_SCAN_NUMBER, "1"));
+}
+
+static void test_bad_input(void)
+{
+    static const char *const bad[] = {
+        "x{}",
+        "{\"a\" 1}",
+        "{\"a\": 1 \"b\": 2}",
+        "{\"a\": 1,}",
+        "{,\"a\": 1}",
+        "{\"a\": tru}",
+        "{\"a\": nul}",
+        "{\"a\": .5}",
+        "{\"a\": 'b'}",
+        "{a: 1}",
+        "{\"a\": 1}}",
+        "{\"a\": 1} x",
+        "{\"a\": 1}{}",
+    };
+    static const char *const cut[] = {
+        "",
+        "  ",
+        "{",
+        "{\"a",
+        "{\"a\":",
+        "{\"a\": \"b",
+        "{\"a\": \"b\\\"}",
+        "{\"a\": 1",
+        "{\"a\": [1, 2}",
+    };
+    scanned_t scanned;
+    json_scan_t state;
+
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        TEST_CHECK(scan(bad[i], &scanned) == SYSTEM_ERROR_INVALID_PARAMETER);
+    }
+    for (size_t i = 0; i < sizeof(cut) / sizeof(cut[0]); i++)
+    {
+        TEST_CHECK(scan(cut[i], &scanned) == SYSTEM_ERROR_NOT_READY);
+    }
+
+    /* An error sticks */
+    json_scan_init(&state, scan_member, &scanned);
+    TEST_CHECK(json_scan_feed(&state, "{\"a\" x", 6) ==
+               SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(json_scan_feed(&state, "}", 1) ==
+               SYSTEM_ERROR_INVALID_PARAMETER);
+    TEST_CHECK(!json_scan_done(&state));
+    TEST_CHECK(json_scan_feed(NULL, "{}", 2) == SYSTEM_ERROR_INVALID_POINTER);
+    TEST_CHECK(json_scan_feed(&state, NULL, 2) ==
+               SYSTEM_ERROR_INVALID_POINTER);
+    TEST_CHECK(!json_scan_done(NULL));
+}
+
+static bool sorted(const json_field_t *fields, int num, size_t base_size)
+{
+    for (int i = 0; i < num; i++)
+    {
+        if (((i > 0) && (strcmp(fields[i - 1].name, fields[i].name) >= 0)) ||
+            (json_field_find(fields, num, fields[i].name) != &fields[i]) ||
+            (fields[i].id >= 32) ||
+            (fields[i].offset + fields[i].size > base_size))
+        {
+            printf("Field %d \"%s\" is out of order or place\n", i,
+                   fields[i].name);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_tables(void)
+{
+    TEST_CHECK(sorted(ghttp_form_fields,
+                      sizeof(ghttp_form_fields) / sizeof(ghttp_form_fields[0]),
+                      sizeof(http_form_t)));
+    TEST_CHECK(sorted(ghttp_occupancy_fields,
+                      sizeof(ghttp_occupancy_fields) /
+                          sizeof(ghttp_occupancy_fields[0]),
+                      sizeof(http_form_t)));
+    TEST_CHECK(sorted(ghttp_airquality_fields,
+                      sizeof(ghttp_airquality_fields) /
+                          sizeof(ghttp_airquality_fields[0]),
+                      sizeof(http_form_t)));
+
+    /* Keys are case sensitive, unknown keys aren't found */
+    TEST_CHECK(json_field_find(ghttp_form_fields,
+                               sizeof(ghttp_form_fields) /
+                                   sizeof(ghttp_form_fields[0]),
+                               "humiHigh") == NULL);
+    TEST_CHECK(json_field_find(ghttp_form_fields,
+                               sizeof(ghttp_form_fields) /
+                                   sizeof(ghttp_form_fields[0]),
+                               "") == NULL);
+    TEST_CHECK(json_field_find(ghttp_form_fields,
+                               sizeof(ghttp_form_fields) /
+                                   sizeof(ghttp_form_fields[0]),
+                               "zzz") == NULL);
+    TEST_CHECK(json_field_find(ghttp_form_fields, 0, "apikey") == NULL);
+    TEST_CHECK(json_field_find(NULL, 3, "apikey") == NULL);
+    TEST_CHECK(json_field_find(ghttp_form_fields, 3, NULL) == NULL);
+}
+
+static bool store(const char *key, int type, const char *value,
+                  http_form_t *form)
+{
+    const json_field_t *field = json_field_find(
+        ghttp_form_fields,
+        sizeof(ghttp_form_fields) / sizeof(ghttp_form_fields[0]), key);
+
+    return (field != NULL) &&
+           json_field_store(field, form, type, value, strlen(value));
+}
+
+static void test_store(void)
+{
+    http_form_t form = {0};
+    char long_ip[SYSLOG_MAXLEN_IP + 2];
+
+    TEST_CHECK(store("temphigh", JSON_SCAN_NUMBER, "28", &form));
+    TEST_CHECK(form.temp_high == 28);
+    TEST_CHECK(store("temphigh", JSON_SCAN_STRING, "-3", &form));
+    TEST_CHECK(form.temp_high == -3);
+    TEST_CHECK(store("temphigh", JSON_SCAN_NUMBER, "2147483647", &form));
+    TEST_CHECK(form.temp_high == INT32_MAX);
+    TEST_CHECK(store("templow", JSON_SCAN_NUMBER, "-2147483648", &form));
+    TEST_CHECK(form.temp_low == INT32_MIN);
+
+    /* Refused values leave the field as it was */
+    form.temp_high = 5;
+    TEST_CHECK(!store("temphigh", JSON_SCAN_NUMBER, "2147483648", &form));
+    TEST_CHECK(!store("temphigh", JSON_SCAN_NUMBER, "-2147483649", &form));
+    TEST_CHECK(!store("temphigh", JSON_SCAN_NUMBER, "99999999999999999999",
+                      &form));
+    TEST_CHECK(!store("temphigh", JSON_SCAN_NUMBER, "-99999999999999999999",
+                      &form));
+    TEST_CHECK(!store("temphigh", JSON_SCAN_NUMBER, "1.5", &form));
+    TEST_CHECK(!store("temphigh", JSON_SCAN_STRING, "12a", &form));
+    TEST_CHECK(!store("temphigh", JSON_SCAN_STRING, "", &form));
+    TEST_CHECK(!store("temphigh", JSON_SCAN_TRUE, "true", &form));
+    TEST_CHECK(!store("temphigh", JSON_SCAN_NULL, "null", &form));
+    TEST_CHECK(form.temp_high == 5);
+
+    TEST_CHECK(store("level2", JSON_SCAN_TRUE, "true", &form));
+    TEST_CHECK(form.level[2] && !form.level[1] && !form.level[3]);
+    TEST_CHECK(store("level2", JSON_SCAN_FALSE, "false", &form));
+    TEST_CHECK(!form.level[2]);
+    TEST_CHECK(!store("level2", JSON_SCAN_STRING, "true", &form));
+    TEST_CHECK(!store("level2", JSON_SCAN_NUMBER, "1", &form));
+
+    TEST_CHECK(store("syslogIp", JSON_SCAN_STRING, "192.168.100.200", &form));
+    TEST_CHECK_STR(form.syslog_ip, "192.168.100.200");
+    memset(long_ip, '1', sizeof(long_ip) - 1);
+    long_ip[sizeof(long_ip) - 1] = '\0';
+    TEST_CHECK(!store("syslogIp", JSON_SCAN_STRING, long_ip, &form));
+    TEST_CHECK(!store("syslogIp", JSON_SCAN_NUMBER, "1", &form));
+    TEST_CHECK_STR(form.syslog_ip, "192.168.100.200");
+}
+
+typedef struct
+{
+    http_form_t form;
+    int unknown;
+    int invalid;
+} form_body_t;
+
+/* Like http_json_member() of webpages.c, without strict mode */
+static void form_member(void *arg, const char *key, int type,
+                        const char *value, int len)
+{
+    form_body_t *body = (form_body_t *)arg;
+    const json_field_t *field = json_field_find(
+        ghttp_form_fields,
+        sizeof(ghttp_form_fields) / sizeof(ghttp_form_fields[0]), key);
+
+    if (field == NULL)
+    {
+        body->unknown++;
+    }
+    else if (!json_field_store(field, &body->form, type, value, len))
+    {
+        body->invalid++;
+    }
+    else
+    {
+        body->form.present |= 1UL << field->id;
+    }
+}
+
+static void test_form(void)
+{
+    const char *text =
+        "{\"humihigh\": \"70\", \"humilow\": \"\", \"level0\": true, "
+        "\"level4\": false, \"syslogIp\": \"10.0.0.2\", \"unknown\": 1, "
+        "\"apikey\": {\"nested\": 1}, \"sgp41noxhigh\": 9999999999, "
+        "\"facility\": \"3\"}";
+    form_body_t body = {0};
+    json_scan_t state;
+
+    json_scan_init(&state, form_member, &body);
+    TEST_CHECK(json_scan_feed(&state, text, strlen(text)) ==
+               SYSTEM_ERROR_NONE);
+    TEST_CHECK(json_scan_done(&state));
+    TEST_CHECK(body.unknown == 1);
+    TEST_CHECK(body.invalid == 2);
+    TEST_CHECK(body.form.present ==
+               ((1UL << HTTP_FORM_HUMI_HIGH) | (1UL << (HTTP_FORM_LEVEL + 0)) |
+                (1UL << (HTTP_FORM_LEVEL + 4)) | (1UL << HTTP_FORM_SYSLOG_IP) |
+                (1UL << HTTP_FORM_FACILITY)));
+    TEST_CHECK(HTTP_FORM_HAS(&body.form, HTTP_FORM_HUMI_HIGH));
+    TEST_CHECK(!HTTP_FORM_HAS(&body.form, HTTP_FORM_APIKEY));
+    TEST_CHECK(body.form.humi_high == 70);
+    TEST_CHECK(body.form.facility == 3);
+    TEST_CHECK(body.form.level[0] && !body.form.level[4]);
+    TEST_CHECK_STR(body.form.syslog_ip, "10.0.0.2");
+}
+
+int main(void)
+{
+    test_flat();
+    test_escapes();
+    test_nested();
+    test_too_long();
+    test_bad_input();
+    test_tables();
+    test_store();
+    test_form();
+    return TEST_END();
+}
@@ -0,0 +1,136 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include "syslog_args.h"
+#include "test.h"
+
+static syslog_args_t gargs;
+static char gout[256];
+
+/* Capture then format, like syslog_handler and the syslog task do */
+static const char *format(const char *fmt, ...)
+{
+    va_list ap;
+
+    memset(&gargs, 0xA5, sizeof(gargs));
+    va_start(ap, fmt);
+    syslog_args_capture(&gargs, fmt, ap);
+    va_end(ap);
+    syslog_args_format(&gargs, gout, sizeof(gout));
+    return gout;
+}
+
+/* The same text snprintf gives */
+#define CHECK_LIKE_SNPRINTF(...)                                          \
+    do                                                                    \
+    {                                                                     \
+        char expected[256];                                               \
+        snprintf(expected, sizeof(expected), __VA_ARGS__);                \
+        TEST_CHECK_STR(format(__VA_ARGS__), expected);                    \
+        TEST_CHECK(!gargs.truncated);                                     \
+    } while (0)
+
+static void test_conversions(void)
+{
+    char stack[16] = "on the stack";
+
+    CHECK_LIKE_SNPRINTF("plain text");
+    CHECK_LIKE_SNPRINTF("100%% done");
+    CHECK_LIKE_SNPRINTF("%d %i %u %x %X %o %c", -12, 34, 56u, 0xab, 0xcd, 8, 'z');
+    CHECK_LIKE_SNPRINTF("%*d|%-*d|%.*d", 6, 42, 5, -7, 4, 3);
+    CHECK_LIKE_SNPRINTF("%*.*f", 10, 3, 3.14159);
+    CHECK_LIKE_SNPRINTF("%ld %lu", -123456789L, 4000000000UL);
+    CHECK_LIKE_SNPRINTF("%lld %llu", -1234567890123LL, 18446744073709551615ULL);
+    CHECK_LIKE_SNPRINTF("%zu %td %jd", (size_t)77, (ptrdiff_t)-5, (intmax_t)-99);
+    CHECK_LIKE_SNPRINTF("%f %.1f %e %g", 1.5, -20.25, 12345.678, 0.0001);
+    CHECK_LIKE_SNPRINTF("%s and %s", "literal", stack);
+    CHECK_LIKE_SNPRINTF("[%8s|%-8s|%.3s]", "ab", "cd", "efghij");
+    CHECK_LIKE_SNPRINTF("%p", (void *)&gargs);
+    TEST_CHECK_STR(format("%s", (char *)NULL), "(null)");
+    TEST_CHECK(gargs.fmt != NULL);
+}
+
+/* The string is copied, the caller's buffer may be gone when it's printed */
+static void test_string_copied(void)
+{
+    char stack[16] = "before";
+
+    memset(&gargs, 0, sizeof(gargs));
+    format("%s", stack);
+    strcpy(stack, "after");
+    syslog_args_format(&gargs, gout, sizeof(gout));
+    TEST_CHECK_STR(gout, "before");
+}
+
+static void test_overflow(void)
+{
+    char big[SYSLOG_ARG_MAXLEN * 2];
+    char expected[SYSLOG_ARG_MAXLEN * 2 + 8];
+    int len = 0;
+
+    /* A string fills the record exactly, with its NUL */
+    memset(big, 'a', sizeof(big));
+    big[SYSLOG_ARG_MAXLEN - 1] = '\0';
+    format("%s", big);
+    TEST_CHECK(!gargs.truncated);
+    TEST_CHECK(gargs.len == SYSLOG_ARG_MAXLEN);
+    TEST_CHECK_STR(gout, big);
+
+    /* One more character is cut */
+    memset(big, 'b', sizeof(big));
+    big[SYSLOG_ARG_MAXLEN] = '\0';
+    format("%s", big);
+    TEST_CHECK(gargs.truncated);
+    TEST_CHECK(gargs.len == SYSLOG_ARG_MAXLEN);
+    len = strlen(gout);
+    TEST_CHECK((len > 3) && (strcmp(&gout[len - 3], "...") == 0));
+
+    /* A full record then another %s, nothing may be written past data */
+    memset(big, 'c', sizeof(big));
+    big[SYSLOG_ARG_MAXLEN - 1] = '\0';
+    format("%s %s", big, "tail");
+    TEST_CHECK(gargs.truncated);
+    TEST_CHECK(gargs.len == SYSLOG_ARG_MAXLEN);
+    snprintf(expected, sizeof(expected), "%s ...", big);
+    TEST_CHECK_STR(gout, expected);
+
+    /* Numbers that don't fit are dropped as a whole */
+    memset(big, 'd', sizeof(big));
+    big[SYSLOG_ARG_MAXLEN - 5] = '\0';
+    format("%s %lld", big, 1LL);
+    TEST_CHECK(gargs.truncated);
+    TEST_CHECK(gargs.len == SYSLOG_ARG_MAXLEN - 4);
+
+    /* Many numbers */
+    format("%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld "
+           "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
+           1LL, 2LL, 3LL, 4LL, 5LL, 6LL, 7LL, 8LL, 9LL, 10LL, 11LL, 12LL,
+           13LL, 14LL, 15LL, 16LL, 17LL, 18LL, 19LL, 20LL, 21LL, 22LL);
+    TEST_CHECK(gargs.truncated);
+    TEST_CHECK(strncmp(gout, "1 2 3 4 5", 9) == 0);
+}
+
+/* The text is cut to the output buffer */
+static void test_small_output(void)
+{
+    char out[8];
+    int len = 0;
+
+    format("%s=%d", "temperature", 25);
+    len = syslog_args_format(&gargs, out, sizeof(out));
+    TEST_CHECK(len == (int)strlen(out));
+    TEST_CHECK(len < (int)sizeof(out));
+}
+
+int main(void)
+{
+    test_conversions();
+    test_string_copied();
+    test_overflow();
+    test_small_output();
+    return TEST_END();
+}
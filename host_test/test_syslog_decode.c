@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Round trip through syslog_decode.py: records are captured like
+ * syslog_handler does and written raw to argv[1], the text the device would
+ * send goes to argv[2]. Built without PIE so the format pointers in the
+ * records are the addresses in this ELF, the Makefile decodes argv[1] with
+ * it and compares.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "syslog_args.h"
+#include "test.h"
+
+#define DECODE_RECORDS 16
+
+static syslog_record_t grecords[DECODE_RECORDS];
+static int gnum = 0;
+
+static void record(uint8_t facility, uint8_t level, uint32_t sequence,
+                   const char *fmt, ...)
+{
+    syslog_record_t *rec = &grecords[gnum++];
+    va_list ap;
+
+    rec->facility = facility;
+    rec->level = level;
+    rec->time_ms = sequence * 1234567u;
+    rec->sequence = sequence;
+    va_start(ap, fmt);
+    syslog_args_capture(&rec->args, fmt, ap);
+    va_end(ap);
+}
+
+int main(int argc, char *argv[])
+{
+    char stack[16] = "on the stack";
+    char big[SYSLOG_ARG_MAXLEN * 2];
+    char text[512];
+    FILE *file = NULL;
+
+    if (argc != 3)
+    {
+        printf("Usage: %s <records> <expected text>\n", argv[0]);
+        return 1;
+    }
+    memset(big, 'x', sizeof(big));
+    big[sizeof(big) - 1] = '\0';
+
+    /* Out of order like a ring that wrapped, slot 2 never used */
+    record(11, 1, 7, "TX %d.%d bee %d Hz >%d pwr = %d,%d,%d", 1, 2, 3850,
+           200000, 12, -34, 56);
+    record(4, 4, 3, "%s took %lu ms, slow over %lu ms", "/fetchvue", 812UL,
+           200UL);
+    gnum++;
+    record(6, 0, 5, "%u %x %X %o %c|%5d|%-5d|%05d|%+d", 4000000000u, 0xbeef,
+           0xcafe, 8, 'z', 42, -7, 3, 9);
+    record(13, 2, 4, "%*d|%-*d|%.*d|%*.*f", 6, 42, 5, -7, 4, 3, 10, 3,
+           3.14159);
+    record(0, 3, 6, "%ld %lld %llu %zu %jd", -123456789L, -1234567890123LL,
+           18446744073709551615ULL, (size_t)77, (intmax_t)-99);
+    record(15, 1, 8, "%f %.1f %e %g %s [%8s|%-8s|%.3s] 100%%", 1.5, -20.25,
+           12345.678, 0.0001, stack, "ab", "cd", "efghij");
+    record(7, 4, 9, "%s %d", big, 1);
+    record(7, 4, 10, "%s", (char *)NULL);
+
+    file = fopen(argv[1], "wb");
+    TEST_CHECK(file != NULL);
+    if (file == NULL)
+    {
+        return TEST_END();
+    }
+    TEST_CHECK(fwrite(grecords, sizeof(syslog_record_t), gnum, file) ==
+               (size_t)gnum);
+    fclose(file);
+
+    /* In sequence order, as the decoder prints them */
+    file = fopen(argv[2], "w");
+    TEST_CHECK(file != NULL);
+    if (file == NULL)
+    {
+        return TEST_END();
+    }
+    for (uint32_t sequence = 0; sequence < 32; sequence++)
+    {
+        for (int i = 0; i < gnum; i++)
+        {
+            syslog_record_t *rec = &grecords[i];
+            if ((rec->args.fmt == NULL) || (rec->sequence != sequence))
+            {
+                continue;
+            }
+            syslog_args_format(&rec->args, text, sizeof(text));
+            fprintf(file, "%lu %lu.%03lu %d %d: %s\n",
+                    (unsigned long)rec->sequence,
+                    (unsigned long)(rec->time_ms / 1000),
+                    (unsigned long)(rec->time_ms % 1000), rec->facility,
+                    rec->level, text);
+        }
+    }
+    fclose(file);
+    TEST_CHECK(grecords[7].args.truncated);
+    return TEST_END();
+}
@@ -1,23 +0,0 @@
-/*
- * SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
- *
- * SPDX-License-Identifier: Apache-2.0
- */
-
-#pragma once
-
-#include "esp_check.h"
-#include "esp_log.h"
-
-#define IR_LEARN_CHECK(a, str, ret_val)                          \
-    if (!(a))                                                     \
-    {                                                             \
-        ESP_LOGE(TAG, "%s(%d): %s", __FUNCTION__, __LINE__, str); \
-        return (ret_val);                                         \
-    }
-
-#define IR_LEARN_CHECK_GOTO(a, str, err_code, label) if(!(a)) { \
-        ESP_LOGE(TAG,"%s:%d (%s):%s", __FILE__, __LINE__, __FUNCTION__, str); \
-        ret = err_code;\
-        goto label; \
-    }
\ No newline at end of file
@@ -0,0 +1,217 @@
+import argparse
+import http.client
+import random
+import re
+import socket
+import sys
+import threading
+import time
+
+# Read-only requests the page makes, weighted like a page left open plus
+# scrapers. Nothing here changes the device state.
+REQUESTS = [
+    ('/fetchvue?action=601', 10),     # Env update, polled by the page
+    ('/fetchvue?action=901', 2),      # Diagnostics
+    ('/fetchvue?action=806', 1),      # IR stats
+    ('/fetchvue?action=1001', 1),     # History
+    ('/api/airquality', 2),
+    ('/api/occupancy', 2),
+    ('/metrics', 2),
+    ('/vue', 1),
+]
+
+METRICS = ('roomassist_heap_free_bytes', 'roomassist_heap_min_free_bytes',
+           'roomassist_http_requests_total', 'roomassist_http_slow_requests_total')
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latency = {}
+        self.status = {}
+        self.errors = {}
+
+    def add(self, path, seconds, status):
+        with self.lock:
+            self.latency.setdefault(path, []).append(seconds)
+            self.status[status] = self.status.get(status, 0) + 1
+
+    def error(self, path, error):
+        name = type(error).__name__
+        with self.lock:
+            self.errors[name] = self.errors.get(name, 0) + 1
+
+
+def percentile(values, fraction):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * fraction))]
+
+
+def read_metrics(host, port, timeout):
+    conn = http.client.HTTPConnection(host, port, timeout=timeout)
+    try:
+        conn.request('GET', '/metrics')
+        text = conn.getresponse().read().decode()
+    finally:
+        conn.close()
+    values = {}
+    for name in METRICS:
+        match = re.search(rf'^{name} (\d+)', text, re.MULTILINE)
+        if match:
+            values[name] = int(match.group(1))
+    return values
+
+
+# One client: a keep-alive connection that reconnects when the server drops
+# it, like a browser tab
+def client(args, stats, stop):
+    paths = [path for path, weight in REQUESTS for _ in range(weight)]
+    conn = None
+    while not stop.is_set():
+        path = random.choice(paths)
+        start = time.monotonic()
+        try:
+            if conn is None:
+                conn = http.client.HTTPConnection(args.host, args.port,
+                                                  timeout=args.timeout)
+            conn.request('GET', path)
+            response = conn.getresponse()
+            response.read()
+            stats.add(path, time.monotonic() - start, response.status)
+            if response.will_close:
+                conn.close()
+                conn = None
+        except (OSError, http.client.HTTPException) as error:
+            stats.error(path, error)
+            if conn is not None:
+                conn.close()
+            conn = None
+            time.sleep(0.2)
+        time.sleep(random.uniform(0, args.think))
+    if conn is not None:
+        conn.close()
+
+
+# An open /events stream, the server keeps it until the socket is purged
+def event_stream(args, stats, stop):
+    while not stop.is_set():
+        sock = None
+        try:
+            sock = socket.create_connection((args.host, args.port),
+                                            timeout=args.timeout)
+            sock.sendall(f'GET /events HTTP/1.1\r\nHost: {args.host}\r\n'
+                         'Accept: text/event-stream\r\n\r\n'.encode())
+            while not stop.is_set():
+                if not sock.recv(1024):
+                    break
+        except OSError as error:
+            stats.error('/events', error)
+            time.sleep(1)
+        finally:
+            if sock is not None:
+                sock.close()
+
+
+def sample_metrics(args, samples, stop):
+    while not stop.is_set():
+        try:
+            samples.append((time.monotonic(),
+                            read_metrics(args.host, args.port, args.timeout)))
+        except (OSError, http.client.HTTPException):
+            pass
+        stop.wait(args.sample)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Load the web server with concurrent clients and watch '
+                    'the heap through /metrics')
+    parser.add_argument('host')
+    parser.add_argument('--port', type=int, default=8080)
+    parser.add_argument('--clients', type=int, default=16,
+                        help='Keep-alive clients, more than '
+                             'HTTP_MAX_OPEN_SOCKETS (12) exercises the LRU purge')
+    parser.add_argument('--events', type=int, default=3,
+                        help='Open /events streams (HTTP_SSE_MAX_CLIENTS 3)')
+    parser.add_argument('--duration', type=float, default=60)
+    parser.add_argument('--think', type=float, default=0.2,
+                        help='Longest pause between requests of a client')
+    parser.add_argument('--timeout', type=float, default=5)
+    parser.add_argument('--sample', type=float, default=2,
+                        help='Seconds between /metrics samples')
+    parser.add_argument('--cooldown', type=float, default=20,
+                        help='Seconds to let sockets close before the last '
+                             'heap sample')
+    parser.add_argument('--leak', type=int, default=4096,
+                        help='Free heap lost after the cooldown that fails '
+                             'the run')
+    parser.add_argument('--max-errors', type=float, default=1.0,
+                        help='Percent of failed requests that fails the run')
+    args = parser.parse_args()
+
+    try:
+        before = read_metrics(args.host, args.port, args.timeout)
+    except (OSError, http.client.HTTPException) as error:
+        print(f'{args.host}:{args.port}: {error}')
+        sys.exit(1)
+    print(f'Heap free {before.get(METRICS[0])} bytes, '
+          f'lowest {before.get(METRICS[1])} bytes')
+
+    stats = Stats()
+    samples = []
+    stop = threading.Event()
+    threads = [threading.Thread(target=sample_metrics,
+                                args=(args, samples, stop))]
+    threads += [threading.Thread(target=event_stream, args=(args, stats, stop))
+                for _ in range(args.events)]
+    threads += [threading.Thread(target=client, args=(args, stats, stop))
+                for _ in range(args.clients)]
+    for thread in threads:
+        thread.daemon = True
+        thread.start()
+    time.sleep(args.duration)
+    stop.set()
+    for thread in threads:
+        thread.join(args.timeout + 1)
+
+    time.sleep(args.cooldown)
+    after = read_metrics(args.host, args.port, args.timeout)
+
+    total = sum(len(values) for values in stats.latency.values())
+    failed = sum(stats.errors.values())
+    print(f'\n{total} requests in {args.duration:.0f} s '
+          f'({total / args.duration:.1f}/s), {failed} failed')
+    print(f'{"path":32} {"count":>6} {"p50 ms":>8} {"p95 ms":>8} '
+          f'{"p99 ms":>8} {"max ms":>8}')
+    for path, values in sorted(stats.latency.items()):
+        print(f'{path:32} {len(values):6} '
+              f'{percentile(values, 0.50) * 1000:8.1f} '
+              f'{percentile(values, 0.95) * 1000:8.1f} '
+              f'{percentile(values, 0.99) * 1000:8.1f} '
+              f'{max(values) * 1000:8.1f}')
+    print(f'Status {dict(sorted(stats.status.items()))}')
+    if stats.errors:
+        print(f'Errors {stats.errors}')
+
+    heap = [values[METRICS[0]] for _, values in samples if METRICS[0] in values]
+    if heap:
+        print(f'Heap free under load: min {min(heap)} max {max(heap)} bytes '
+              f'({len(heap)} samples)')
+    lost = before[METRICS[0]] - after[METRICS[0]]
+    print(f'Heap free after cooldown {after[METRICS[0]]} bytes '
+          f'({-lost:+d}), lowest since boot {after[METRICS[1]]} bytes')
+    print(f'Slow requests '
+          f'{after[METRICS[3]] - before[METRICS[3]]}')
+
+    ok = True
+    if lost > args.leak:
+        print(f'FAIL: {lost} bytes of heap not returned')
+        ok = False
+    if total + failed and failed * 100 / (total + failed) > args.max_errors:
+        print(f'FAIL: {failed * 100 / (total + failed):.1f}% of requests failed')
+        ok = False
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -13,6 +13,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
+#include "settings.h"
 #include "syslog.h"
 #include "system.h"
 #include "homekit.h"
@@ -53,13 +54,9 @@ static int s_voc_low = 60;
 static int s_nox_high = 3;
 static int s_nox_low = 1;
 
-// Timer handle for Fan
-static esp_timer_handle_t s_fan_timer_handle = NULL;
-
 // --- Helper Prototypes ---
 static void airquality_load_nvs(void);
 static void airquality_save_nvs(const char *key, int value);
-static void ir_sync_delta_exhaust_timer_callback(void *arg);
 
 // --- API Implementation ---
 
@@ -241,29 +238,14 @@ static void airquality_load_nvs(void)
 
 static void airquality_save_nvs(const char *key, int value)
 {
-    nvs_handle_t handle;
-    if (nvs_open(AIRQUALITY_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK)
+    if (settings_set_i32(AIRQUALITY_NVS_NAMESPACE, key, value) ==
+        SYSTEM_ERROR_NONE)
     {
-        nvs_set_i32(handle, key, value);
-        nvs_commit(handle);
-        nvs_close(handle);
         syslog_handler(SYSLOG_FACILITY_AIRQUALITY, SYSLOG_LEVEL_INFO,
                        "Config saved %s: %d", key, value);
     }
 }
 
-// --- Fan Control Logic ---
-
-static void ir_sync_delta_exhaust_timer_callback(void *arg)
-{
-    syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_INFO,
-                   "Timeout, turn off exhust fan");
-    ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_EXHAUST,
-                       IR_DELTA_FAN_TIGGER_ACTIVE_OFF,
-                       IR_DELTA_FAN_DURATION_FOREVER);
-    rmt_setexhaustfanstatus(false);
-}
-
 // --- Task Implementation ---
 
 void task_airquality(void *arg)
@@ -279,10 +261,6 @@ void task_airquality(void *arg)
 
     airquality_load_nvs();
 
-    // Timer Init
-    esp_timer_create_args_t timer_args = {
-        .callback = &ir_sync_delta_exhaust_timer_callback, .name = "fan_timer"};
-
     // System Ready Checks
     syslog_handler(SYSLOG_FACILITY_AIRQUALITY, SYSLOG_LEVEL_INFO,
                    "AirQuality Task Started");
@@ -399,9 +377,6 @@ void task_airquality(void *arg)
             {
                 if (!rmt_isexhaustfanactive())
                 {
-                    uint64_t duration = ((uint64_t)IR_DELTA_FAN_DURATION_1HR) *
-                                        60 * 60 * 1000 * 1000;
-
                     syslog_handler(
                         SYSLOG_FACILITY_AIRQUALITY, SYSLOG_LEVEL_INFO,
                         "ALARM! VOC=%d(Limit %d) NOx=%d(Limit %d). Fan ON.",
@@ -410,18 +385,6 @@ void task_airquality(void *arg)
                     ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_EXHAUST,
                                        IR_DELTA_FAN_TIGGER_ACTIVE_ON,
                                        IR_DELTA_FAN_DURATION_1HR);
-                    rmt_setexhaustfanstatus(true);
-
-                    // Start Timer
-                    if (s_fan_timer_handle == NULL)
-                    {
-                        esp_timer_create(&timer_args, &s_fan_timer_handle);
-                    }
-                    if (esp_timer_is_active(s_fan_timer_handle))
-                    {
-                        esp_timer_stop(s_fan_timer_handle);
-                    }
-                    esp_timer_start_once(s_fan_timer_handle, duration);
                 }
                 keeping_counter = 0;  // Reset off-delay
             }
@@ -445,13 +408,6 @@ void task_airquality(void *arg)
                         ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_EXHAUST,
                                            IR_DELTA_FAN_TIGGER_ACTIVE_OFF,
                                            IR_DELTA_FAN_DURATION_1HR);
-                        rmt_setexhaustfanstatus(false);
-
-                        if (s_fan_timer_handle &&
-                            esp_timer_is_active(s_fan_timer_handle))
-                        {
-                            esp_timer_stop(s_fan_timer_handle);
-                        }
                     }
                     else
                     {
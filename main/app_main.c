@@ -48,19 +48,23 @@
 #include "esp_system.h"
 #include "esp_task_wdt.h"
 #include "esp_timer.h"
+#include "history.h"
 #include "homekit.h"
 #include "ld2410.h"
+#include "logring.h"
 #include "max9814.h"
 #include "airquality.h"
 #include "oled.h"
 #include "ota.h"
 #include "rmt.h"
+#include "settings.h"
 #include "sntp.h"
 #include "syslog.h"
 #include "system.h"
 #include "task_monitor.h"
 #include "telnet.h"
 #include "thingspeak.h"
+#include "timer_wheel.h"
 #include "webpages.h"
 
 // Define Watchdog time 30 seconds
@@ -103,6 +107,9 @@ void app_main()
 
   // ESP_ERROR_CHECK(esp_wifi_get_mac(WIFI_IF_STA, gsys_mac));
 
+  // Open the flash log before the first message
+  logring_init();
+
   // Restore Syslog configuration
   syslog_restoreconfig();
 
@@ -163,12 +170,27 @@ void app_main()
     xSemaphoreGive(gsemaRmtZeroTig);
   }
 
+  gsemaRmtDysonTig = xSemaphoreCreateBinary();
+  if (gsemaRmtDysonTig != NULL)
+  {
+    xSemaphoreGive(gsemaRmtDysonTig);
+  }
+
   gsemaSYSTEMCfg = xSemaphoreCreateBinary();
   if (gsemaSYSTEMCfg != NULL)
   {
     xSemaphoreGive(gsemaSYSTEMCfg);
   }
 
+  // One shot timers of every task share one wheel
+  timer_wheel_init();
+
+  // Settings saved from now on are committed together
+  settings_init();
+
+  // Keep the history of the charts on the device
+  history_init();
+
   // Create Homekit Task
   system_task_creating(TASK_HOMEKIT_ID);
   xTaskCreate(task_homekit_init, HAP_ACC_TASK_NAME, HAP_ACC_TASK_STACKSIZE,
@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "cbor.h"
+
+#define CBOR_MAJOR_UINT             0
+#define CBOR_MAJOR_NINT             1
+#define CBOR_MAJOR_TEXT             3
+#define CBOR_MAJOR_ARRAY            4
+#define CBOR_MAJOR_MAP              5
+#define CBOR_MAJOR_TAG              6
+
+static void cbor_put_bytes(cbor_writer_t *writer, const void *data, int len)
+{
+    if (writer->overflow || (writer->len + len > writer->size))
+    {
+        writer->overflow = true;
+        return;
+    }
+    memcpy(&writer->buf[writer->len], data, len);
+    writer->len += len;
+}
+
+/* Initial byte and the shortest argument that holds value */
+static void cbor_put_head(cbor_writer_t *writer, uint8_t major, uint32_t value)
+{
+    uint8_t head[5];
+    int len = 1;
+
+    if (value < 24)
+    {
+        head[0] = (major << 5) | value;
+    }
+    else if (value <= 0xFF)
+    {
+        head[0] = (major << 5) | 24;
+        head[len++] = value;
+    }
+    else if (value <= 0xFFFF)
+    {
+        head[0] = (major << 5) | 25;
+        head[len++] = value >> 8;
+        head[len++] = value;
+    }
+    else
+    {
+        head[0] = (major << 5) | 26;
+        head[len++] = value >> 24;
+        head[len++] = value >> 16;
+        head[len++] = value >> 8;
+        head[len++] = value;
+    }
+    cbor_put_bytes(writer, head, len);
+}
+
+void cbor_init(cbor_writer_t *writer, uint8_t *buf, int size)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->buf = buf;
+    writer->size = size;
+}
+
+void cbor_put_map(cbor_writer_t *writer, uint32_t num)
+{
+    cbor_put_head(writer, CBOR_MAJOR_MAP, num);
+}
+
+void cbor_put_array(cbor_writer_t *writer, uint32_t num)
+{
+    cbor_put_head(writer, CBOR_MAJOR_ARRAY, num);
+}
+
+void cbor_put_int(cbor_writer_t *writer, int32_t value)
+{
+    if (value < 0)
+    {
+        /* -1 - n, written as n */
+        cbor_put_head(writer, CBOR_MAJOR_NINT, (uint32_t)(-1 - value));
+    }
+    else
+    {
+        cbor_put_head(writer, CBOR_MAJOR_UINT, (uint32_t)value);
+    }
+}
+
+void cbor_put_text(cbor_writer_t *writer, const char *text)
+{
+    int len = strlen(text);
+
+    cbor_put_head(writer, CBOR_MAJOR_TEXT, len);
+    cbor_put_bytes(writer, text, len);
+}
+
+void cbor_put_decimal(cbor_writer_t *writer, int32_t value, int exponent)
+{
+    cbor_put_head(writer, CBOR_MAJOR_TAG, CBOR_TAG_DECIMAL);
+    cbor_put_array(writer, 2);
+    cbor_put_int(writer, exponent);
+    cbor_put_int(writer, value);
+}
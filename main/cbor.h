@@ -0,0 +1,45 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CBOR_TAG_DECIMAL            4   /* [exponent, mantissa], RFC 8949 */
+
+/**
+ * @brief Writer of definite length items into a buffer of the caller
+ */
+typedef struct
+{
+    uint8_t *buf;
+    int size;
+    int len;
+    bool overflow;              /* An item did not fit, len stops before it */
+} cbor_writer_t;
+
+void cbor_init(cbor_writer_t *writer, uint8_t *buf, int size);
+
+/**
+ * @brief Start a map of num pairs, keys and values follow in turn
+ */
+void cbor_put_map(cbor_writer_t *writer, uint32_t num);
+void cbor_put_array(cbor_writer_t *writer, uint32_t num);
+void cbor_put_int(cbor_writer_t *writer, int32_t value);
+void cbor_put_text(cbor_writer_t *writer, const char *text);
+
+/**
+ * @brief value * 10^exponent as a tagged decimal fraction
+ */
+void cbor_put_decimal(cbor_writer_t *writer, int32_t value, int exponent);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,6 +7,7 @@
 #include <app_hap_setup_payload.h>
 #include <string.h>
 #include "dht22.h"
+#include "settings.h"
 #include "ld2410.h"
 #include "system.h"
 #include "syslog.h"
@@ -26,8 +27,6 @@ float ghumidityhistorydata[DHT22_SW_CFG_HISTORYTIME/DHT22_SW_CFG_IDELTIME] = {0}
 int ghumidityhistoryidx = 0;
 int ghumidityhistoryisfull = false;
 
-esp_timer_handle_t gsync_delta_dry_timer_handle = NULL;
-esp_timer_handle_t gsync_delta_warm_timer_handle = NULL;
 SemaphoreHandle_t gsemaDHT22Cfg = NULL;
 
 static void dht22_restoreconfig(void);
@@ -255,14 +254,6 @@ void task_dht22(void *arg)
     uint8_t sys_mac[6];
 
     ESP_ERROR_CHECK(esp_wifi_get_mac(WIFI_IF_STA, sys_mac));
-    esp_timer_create_args_t sync_delta_dry_timer_args = {
-        .callback = &ir_sync_delta_dry_timer_callback,
-        .name = "sync_delta_dry_timer"
-    };
-    esp_timer_create_args_t sync_delta_warm_timer_args = {
-        .callback = &ir_sync_delta_warm_timer_callback,
-        .name = "sync_delta_warm_timer"
-    };
     // Restore configuration
     dht22_restoreconfig();
 
@@ -313,49 +304,13 @@ void task_dht22(void *arg)
             {
                 if((ld2410_isOccupancyStatus())&&(temperature<=gtemplow))
                 {
-                    uint64_t duration = ((uint64_t)IR_DELTA_FAN_DURATION_1HR)*60*60*1000*1000;
                     syslog_handler(SYSLOG_FACILITY_TEMPERATURE, SYSLOG_LEVEL_INFO,"There are someone and temperature/humidity is %.1f/%.1f, turn on warm fan", temperature, humidity);
                     ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_WARM, IR_DELTA_FAN_TIGGER_ACTIVE_ON,IR_DELTA_FAN_DURATION_1HR);
-                    if (gsync_delta_warm_timer_handle!=NULL)
-                    {
-                        if(esp_timer_is_active(gsync_delta_warm_timer_handle))
-                        {
-                            syslog_handler(SYSLOG_FACILITY_HUMIDITY, SYSLOG_LEVEL_DEBUG,"Stop warm timer");
-                            ESP_ERROR_CHECK(esp_timer_stop(gsync_delta_warm_timer_handle));
-                        }
-                    }
-                    else
-                    {
-                        syslog_handler(SYSLOG_FACILITY_HUMIDITY, SYSLOG_LEVEL_DEBUG,"Create warm timer");
-                        ESP_ERROR_CHECK(esp_timer_create(&sync_delta_warm_timer_args, &gsync_delta_warm_timer_handle));
-                    }
-                    // Set working time is not forever, start timer
-                    syslog_handler(SYSLOG_FACILITY_HUMIDITY, SYSLOG_LEVEL_DEBUG,"Start warm timer %llu",duration);
-                    ESP_ERROR_CHECK(esp_timer_start_once(gsync_delta_warm_timer_handle, duration));
-                    rmt_setwarmfanstatus(true);
                 }
                 else
                 {
-                    uint64_t duration = ((uint64_t)IR_DELTA_FAN_DURATION_3HR)*60*60*1000*1000;
                     syslog_handler(SYSLOG_FACILITY_HUMIDITY, SYSLOG_LEVEL_INFO,"Humidity is %.1f, turn on dry fan", ghumidity);
                     ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_DRY, IR_DELTA_FAN_TIGGER_ACTIVE_ON,IR_DELTA_FAN_DURATION_3HR);
-                    if (gsync_delta_dry_timer_handle!=NULL)
-                    {
-                        if(esp_timer_is_active(gsync_delta_dry_timer_handle))
-                        {
-                            syslog_handler(SYSLOG_FACILITY_HUMIDITY, SYSLOG_LEVEL_DEBUG,"Stop dry timer");
-                            ESP_ERROR_CHECK(esp_timer_stop(gsync_delta_dry_timer_handle));
-                        }
-                    }
-                    else
-                    {
-                        syslog_handler(SYSLOG_FACILITY_HUMIDITY, SYSLOG_LEVEL_DEBUG,"Create dry timer");
-                        ESP_ERROR_CHECK(esp_timer_create(&sync_delta_dry_timer_args, &gsync_delta_dry_timer_handle));
-                    }
-                    // Set working time is not forever, start timer
-                    syslog_handler(SYSLOG_FACILITY_HUMIDITY, SYSLOG_LEVEL_DEBUG,"Start dry timer %llu",duration);
-                    ESP_ERROR_CHECK(esp_timer_start_once(gsync_delta_dry_timer_handle, duration));
-                    rmt_setdryfanstatus(true);
                 }
             }
 #if 0            
@@ -369,29 +324,11 @@ void task_dht22(void *arg)
                 {
                     syslog_handler(SYSLOG_FACILITY_HUMIDITY, SYSLOG_LEVEL_INFO,"Shower complete, turn off warm fan");
                     ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_WARM, IR_DELTA_FAN_TIGGER_ACTIVE_OFF, IR_DELTA_FAN_DURATION_3HR);
-                    if (gsync_delta_warm_timer_handle!=NULL)
-                    {
-                        if(esp_timer_is_active(gsync_delta_warm_timer_handle))
-                        {
-                            syslog_handler(SYSLOG_FACILITY_HUMIDITY, SYSLOG_LEVEL_DEBUG,"Stop warm timer");
-                            ESP_ERROR_CHECK(esp_timer_stop(gsync_delta_warm_timer_handle));
-                        }
-                    }
-                    rmt_setwarmfanstatus(false);
                 }
                 if(rmt_isdryfanactive())
                 {
                     syslog_handler(SYSLOG_FACILITY_HUMIDITY, SYSLOG_LEVEL_INFO,"Humidity is %.1f, turn off dry fan", ghumidity);
                     ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_DRY, IR_DELTA_FAN_TIGGER_ACTIVE_OFF, IR_DELTA_FAN_DURATION_3HR);
-                    if (gsync_delta_dry_timer_handle!=NULL)
-                    {
-                        if(esp_timer_is_active(gsync_delta_dry_timer_handle))
-                        {
-                            syslog_handler(SYSLOG_FACILITY_HUMIDITY, SYSLOG_LEVEL_DEBUG,"Stop dry timer");
-                            ESP_ERROR_CHECK(esp_timer_stop(gsync_delta_dry_timer_handle));
-                        }
-                    }
-                    rmt_setdryfanstatus(false);
                 }
             }
         } else {
@@ -471,39 +408,10 @@ static void dht22_restoreconfig(void)
 
 void dht22_saveconfig(char *key, int32_t data)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t ret;
-
-    ret = nvs_open(DHT22_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (ret != ESP_OK) {
-        syslog_handler(SYSLOG_FACILITY_TEMPERATURE, SYSLOG_LEVEL_ERROR,"NVS open failed: %s", esp_err_to_name(ret));
+    if (settings_set_i32(DHT22_NVS_NAMESPACE, key, data) != SYSTEM_ERROR_NONE) {
+        syslog_handler(SYSLOG_FACILITY_TEMPERATURE, SYSLOG_LEVEL_ERROR,"Config key %s invalid", key);
         return;
     }
-
-    int32_t value1 = data;
-    ret = nvs_set_i32(nvs_handle, key, value1);
-    if (ret != ESP_OK) {
-        syslog_handler(SYSLOG_FACILITY_TEMPERATURE, SYSLOG_LEVEL_ERROR,"NVS set failed for key: %s", esp_err_to_name(ret));
-    }    
-    nvs_close(nvs_handle);
     syslog_handler(SYSLOG_FACILITY_TEMPERATURE, SYSLOG_LEVEL_INFO,"Config saved %s %d", key, data);
     return;
 }
-
-void ir_sync_delta_dry_timer_callback()
-{
-    // Sync Delta fan status to scheduler
-    syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_INFO,"Timeout, turn off dry fan");
-    ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_DRY, IR_DELTA_FAN_TIGGER_ACTIVE_OFF,IR_DELTA_FAN_DURATION_FOREVER);
-    rmt_setdryfanstatus(false);
-    return;
-}
-
-void ir_sync_delta_warm_timer_callback()
-{
-    // Sync Delta fan status to scheduler
-    syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_INFO,"Timeout, turn off warm fan");
-    ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_WARM, IR_DELTA_FAN_TIGGER_ACTIVE_OFF,IR_DELTA_FAN_DURATION_FOREVER);
-    rmt_setwarmfanstatus(false);
-    return;
-}
\ No newline at end of file
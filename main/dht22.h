@@ -32,12 +32,8 @@ extern "C" {
 
 #define DHT22_MAX_ERROR_TIMES           3
 
-extern esp_timer_handle_t gsync_delta_warm_timer_handle;
-
 void task_dht22(void *arg);
 void dht22_saveconfig(char *key, int32_t data);
-void ir_sync_delta_dry_timer_callback();
-void ir_sync_delta_warm_timer_callback();
 int dht22_getcurrenttemperature(float *);
 int dht22_setcurrenttemperature(float );
 int dht22_getcurrenthumidity(float *);
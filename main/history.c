@@ -0,0 +1,241 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "airquality.h"
+#include "dht22.h"
+#include "history.h"
+#include "ld2410.h"
+#include "nu_ld2410.h"
+#include "system.h"
+#include "syslog.h"
+#include "timer_wheel.h"
+
+#define HISTORY_PERIOD_MS   1000
+
+typedef struct
+{
+    int16_t *delta;                     /* [HISTORY_METRIC_MAX][size] */
+    uint16_t size;
+    uint16_t count;
+    uint16_t head;                      /* Next write, the oldest once full */
+    uint16_t ratio;                     /* Samples averaged into the next level */
+    uint32_t period_s;
+    uint32_t end_s;
+    int32_t base[HISTORY_METRIC_MAX];   /* Oldest sample */
+    int32_t last[HISTORY_METRIC_MAX];   /* Newest sample */
+    int32_t sum[HISTORY_METRIC_MAX];
+    uint16_t summed;
+} history_level_t;
+
+static int16_t ghistory_second[HISTORY_METRIC_MAX][HISTORY_SECOND_SAMPLES];
+static int16_t ghistory_minute[HISTORY_METRIC_MAX][HISTORY_MINUTE_SAMPLES];
+static int16_t ghistory_quarter[HISTORY_METRIC_MAX][HISTORY_QUARTER_SAMPLES];
+static history_level_t ghistory_level[HISTORY_LEVEL_MAX] = {
+    {.delta = &ghistory_second[0][0], .size = HISTORY_SECOND_SAMPLES,
+     .ratio = 60, .period_s = 1},
+    {.delta = &ghistory_minute[0][0], .size = HISTORY_MINUTE_SAMPLES,
+     .ratio = 15, .period_s = 60},
+    {.delta = &ghistory_quarter[0][0], .size = HISTORY_QUARTER_SAMPLES,
+     .ratio = 0, .period_s = 900},
+};
+static int ghistory_timer = TIMER_WHEEL_INVALID;
+static SemaphoreHandle_t gsemaHistory = NULL;
+
+/* Call with gsemaHistory taken */
+static void history_push(int level, const int32_t *values, uint32_t now_s)
+{
+    history_level_t *ring = &ghistory_level[level];
+    int16_t *delta = NULL;
+    int32_t d = 0;
+
+    for (int m = 0; m < HISTORY_METRIC_MAX; m++)
+    {
+        delta = ring->delta + m * ring->size;
+        if (ring->count == 0)
+        {
+            ring->base[m] = ring->last[m] = values[m];
+            delta[ring->head] = 0;
+            continue;
+        }
+        if (ring->count == ring->size)
+        {
+            /* Drop the oldest, the next one becomes the base */
+            ring->base[m] += delta[(ring->head + 1) % ring->size];
+        }
+        /* A step too large for int16 is caught up by the next samples */
+        d = MIN(MAX(values[m] - ring->last[m], INT16_MIN), INT16_MAX);
+        delta[ring->head] = d;
+        ring->last[m] += d;
+    }
+    ring->head = (ring->head + 1) % ring->size;
+    ring->count = MIN(ring->count + 1, ring->size);
+    ring->end_s = now_s;
+
+    if (ring->ratio == 0)
+    {
+        return;
+    }
+    for (int m = 0; m < HISTORY_METRIC_MAX; m++)
+    {
+        ring->sum[m] += values[m];
+    }
+    if (++ring->summed == ring->ratio)
+    {
+        int32_t average[HISTORY_METRIC_MAX];
+
+        for (int m = 0; m < HISTORY_METRIC_MAX; m++)
+        {
+            average[m] = ring->sum[m] / ring->ratio;
+            ring->sum[m] = 0;
+        }
+        ring->summed = 0;
+        history_push(level + 1, average, now_s);
+    }
+}
+
+static void history_sample(void *arg)
+{
+    int32_t values[HISTORY_METRIC_MAX] = {0};
+    float temperature = 0, humidity = 0, pred = 0;
+    int voc = 0, nox = 0;
+
+    timer_wheel_start(ghistory_timer, HISTORY_PERIOD_MS);
+
+    dht22_getcurrenttemperature(&temperature);
+    dht22_getcurrenthumidity(&humidity);
+    airquality_get_voc_index(&voc);
+    airquality_get_nox_index(&nox);
+#if defined(LD2410_AUTOLEARN_NU)
+    nu_ld2410_getPred(&pred);
+#endif
+    values[HISTORY_METRIC_TEMPERATURE] =
+        (int32_t)(temperature * 10 + ((temperature < 0) ? -0.5f : 0.5f));
+    values[HISTORY_METRIC_HUMIDITY] = (int32_t)(humidity * 10 + 0.5f);
+    values[HISTORY_METRIC_VOC] = voc;
+    values[HISTORY_METRIC_NOX] = nox;
+    values[HISTORY_METRIC_PRED] = (int32_t)(pred * 1000 + 0.5f);
+
+    if (xSemaphoreTake(gsemaHistory, portMAX_DELAY) == pdTRUE)
+    {
+        history_push(HISTORY_LEVEL_SECOND, values,
+                     esp_timer_get_time() / 1000000);
+        xSemaphoreGive(gsemaHistory);
+    }
+}
+
+void history_init(void)
+{
+    if (gsemaHistory != NULL)
+    {
+        return;
+    }
+    gsemaHistory = xSemaphoreCreateBinary();
+    if (gsemaHistory == NULL)
+    {
+        return;
+    }
+    xSemaphoreGive(gsemaHistory);
+    if (timer_wheel_add(history_sample, NULL, "History", &ghistory_timer) ==
+        SYSTEM_ERROR_NONE)
+    {
+        timer_wheel_start(ghistory_timer, HISTORY_PERIOD_MS);
+    }
+}
+
+int history_get_info(int level, history_info_t *info)
+{
+    if (gsemaHistory == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (history %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (info == NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if ((level < 0) || (level >= HISTORY_LEVEL_MAX))
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    if (xSemaphoreTake(gsemaHistory, portMAX_DELAY) == pdTRUE)
+    {
+        info->period_s = ghistory_level[level].period_s;
+        info->end_s = ghistory_level[level].end_s;
+        info->count = ghistory_level[level].count;
+        info->size = ghistory_level[level].size;
+        xSemaphoreGive(gsemaHistory);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+int history_first_since(const history_info_t *info, uint32_t since_s)
+{
+    uint32_t newer = 0;
+
+    if ((info == NULL) || (since_s == 0) || (info->period_s == 0))
+    {
+        return 0;
+    }
+    /* Samples go back from end_s every period_s, so part of a period
+       after since_s still holds one */
+    if (info->end_s > since_s)
+    {
+        newer = (info->end_s - since_s + info->period_s - 1) / info->period_s;
+    }
+    return info->count - MIN(newer, info->count);
+}
+
+int history_read(int level, int metric, int first, int32_t *values, int num,
+                 int *read)
+{
+    history_level_t *ring = NULL;
+    const int16_t *delta = NULL;
+    int oldest = 0, n = 0;
+    int32_t value = 0;
+
+    if (gsemaHistory == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (history %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if ((values == NULL) || (read == NULL))
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if ((level < 0) || (level >= HISTORY_LEVEL_MAX) || (metric < 0) ||
+        (metric >= HISTORY_METRIC_MAX) || (first < 0) || (num < 0))
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    ring = &ghistory_level[level];
+    delta = ring->delta + metric * ring->size;
+    if (xSemaphoreTake(gsemaHistory, portMAX_DELAY) == pdTRUE)
+    {
+        oldest = (ring->count == ring->size) ? ring->head : 0;
+        value = ring->base[metric];
+        for (int i = 0; (i < ring->count) && (n < num); i++)
+        {
+            if (i > 0)
+            {
+                value += delta[(oldest + i) % ring->size];
+            }
+            if (i >= first)
+            {
+                values[n++] = value;
+            }
+        }
+        xSemaphoreGive(gsemaHistory);
+    }
+    *read = n;
+    return SYSTEM_ERROR_NONE;
+}
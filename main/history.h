@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HISTORY_METRIC_TEMPERATURE  0   /* 0.1 C */
+#define HISTORY_METRIC_HUMIDITY     1   /* 0.1 % */
+#define HISTORY_METRIC_VOC          2
+#define HISTORY_METRIC_NOX          3
+#define HISTORY_METRIC_PRED         4   /* 0.001 */
+#define HISTORY_METRIC_MAX          5
+
+#define HISTORY_LEVEL_SECOND        0
+#define HISTORY_LEVEL_MINUTE        1
+#define HISTORY_LEVEL_QUARTER       2
+#define HISTORY_LEVEL_MAX           3
+
+#define HISTORY_SECOND_SAMPLES      120 /* 2 min */
+#define HISTORY_MINUTE_SAMPLES      180 /* 3 h */
+#define HISTORY_QUARTER_SAMPLES     192 /* 48 h */
+
+/**
+ * @brief One resolution of the history
+ */
+typedef struct
+{
+    uint32_t period_s;  /* Between two samples */
+    uint32_t end_s;     /* Uptime of the newest sample */
+    uint16_t count;     /* Samples held */
+    uint16_t size;
+} history_info_t;
+
+/**
+ * @brief Sample every metric once a second on the timer wheel, call it after
+ *        timer_wheel_init()
+ *
+ * Every minute the average of the seconds goes to the minute ring and every
+ * 15 minutes the average of the minutes goes to the quarter ring. Rings hold
+ * the oldest value and int16 deltas.
+ */
+void history_init(void);
+
+int history_get_info(int level, history_info_t *info);
+
+/**
+ * @brief First sample newer than since_s, to start history_read() at
+ *
+ * @param[in] since_s Uptime in seconds, 0 for every sample held
+ * @return Index from the oldest sample, info->count if none is newer
+ */
+int history_first_since(const history_info_t *info, uint32_t since_s);
+
+/**
+ * @brief Rebuild samples of one metric
+ *
+ * @param[in] first 0 is the oldest sample held
+ * @param[out] values num samples at most
+ * @param[out] read Samples copied
+ */
+int history_read(int level, int metric, int first, int32_t *values, int num,
+                 int *read);
+
+#ifdef __cplusplus
+}
+#endif
@@ -12,11 +12,13 @@
 #include "system.h"
 #include "syslog.h"
 #include "rmt.h"
+#include "settings.h"
 #include "elf.h"
 #include "ld2410.h"
 #include "ir_hta_encoder.h"
 #include "ir_delta_encoder.h"
 #include "ir_zro_encoder.h"
+#include "ir_dyson_encoder.h"
 #include "esp_wifi.h"
 
 static int ghomekit_brgaid = 0;
@@ -25,6 +27,7 @@ static int ghomekit_acaid = 0;
 static int ghomekit_swaid = 0;
 static int ghomekit_fnaid = 0;
 static int ghomekit_dfnaid = 0;
+static int ghomekit_dyfnaid = 0;
 
 int ghomekitidx = 0;
 
@@ -36,6 +39,7 @@ hap_serv_t *ghomekit_ashs = NULL;
 hap_serv_t *ghomekit_hshs = NULL;
 hap_serv_t *ghomekit_fnhs = NULL;
 hap_serv_t *ghomekit_dfnhs = NULL;
+hap_serv_t *ghomekit_dyfnhs = NULL;
 hap_serv_t *ghomekit_clhs = NULL;
 
 hap_char_t *ghomekit_htaac_active_hc = NULL;
@@ -48,6 +52,9 @@ hap_char_t *ghomekit_zrofan_active_hc = NULL;
 hap_char_t *ghomekit_zrofan_fanspeed_hc = NULL;
 hap_char_t *ghomekit_zrofan_fanswing_hc = NULL;
 hap_char_t *ghomekit_deltafan_active_hc = NULL;
+hap_char_t *ghomekit_dysonfan_active_hc = NULL;
+hap_char_t *ghomekit_dysonfan_fanspeed_hc = NULL;
+hap_char_t *ghomekit_dysonfan_fanswing_hc = NULL;
 
 static char HOMEKIT_SetupCode[10][10]={"111-22-330","111-22-331","111-22-332","111-22-333","111-22-334","111-22-335","111-22-336","111-22-337","111-22-338","111-22-339"};
 static char HOMEKIT_SetupId[10][4]={"FH00","FH01","FH02","FH03","FH04","FH05","FH06","FH07","FH08","FH09"};
@@ -152,6 +159,25 @@ int hap_update_value(int accessory, int character, void *value)
                 new_val.i = *(int *)value;
                 hap_char_update_val(ghomekit_deltafan_active_hc, &new_val);
                 break;
+            case HAP_ACCESSORY_DYSON_FAN:
+                switch(character)
+                {
+                    case HAP_CHARACTER_ACTIVE:
+                        new_val.i = *(int *)value;
+                        hap_char_update_val(ghomekit_dysonfan_active_hc, &new_val);
+                        break;
+                    case HAP_CHARACTER_FAN_SWING:
+                        new_val.i = *(int *)value;
+                        hap_char_update_val(ghomekit_dysonfan_fanswing_hc, &new_val);
+                        break;
+                    case HAP_CHARACTER_FAN_SPEED:
+                        new_val.f = (float)(*(int *)value*10);
+                        hap_char_update_val(ghomekit_dysonfan_fanspeed_hc, &new_val);
+                        break;
+                    default:
+                        break;
+                }
+                break;
             case HAP_ACCESSORY_AIRQUALITY:
                 new_val.u = *(uint8_t *)value;
                 hap_char_update_val(hap_serv_get_char_by_uuid(ghomekit_ashs, HAP_CHAR_UUID_AIR_QUALITY), &new_val);
@@ -229,20 +255,10 @@ int hap_setelfoccupancyfanstatus(int value)
 
 void ac_saveconfig(char *key, int value)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t ret;
-
-    ret = nvs_open(AC_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG_NVS, "NVS open failed: %s", esp_err_to_name(ret));
+    if (settings_set_u32(AC_NVS_NAMESPACE, key, (uint32_t) value) != SYSTEM_ERROR_NONE) {
+        ESP_LOGE(TAG_NVS, "Config key %s invalid", key);
         return;
     }
-
-    ret = nvs_set_u32(nvs_handle, key, (uint32_t) value);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG_NVS, "NVS set failed for key1: %s", esp_err_to_name(ret));
-    }    
-    nvs_close(nvs_handle);
     syslog_handler(SYSLOG_FACILITY_HOMEKIT, SYSLOG_LEVEL_INFO,"Config saved %s %d",key,value);
     return;
 }
@@ -279,12 +295,14 @@ static int bridge_write(hap_write_data_t write_data[], int count,
     hap_write_data_t *write;
     rmt_hattg_msg_t tghitmsg;
     rmt_zftg_msg_t tgzfmsg;
-    int speed = 0, swing = 0;
+    rmt_dftg_msg_t tgdfmsg;
+    int speed = 0, swing = 0, dyspeed = 0;
     uint8_t sys_mac[6];
 
     ESP_ERROR_CHECK(esp_wifi_get_mac(WIFI_IF_STA, sys_mac));
     memset(&tghitmsg,0,sizeof(rmt_hattg_msg_t));
     memset(&tgzfmsg,0,sizeof(rmt_zftg_msg_t));    
+    memset(&tgdfmsg,0,sizeof(rmt_dftg_msg_t));
     for (i = 0; i < count; i++)
     {
         write = &write_data[i];
@@ -434,6 +452,51 @@ static int bridge_write(hap_write_data_t write_data[], int count,
             }
         }
 
+#if CONFIG_IR_DYSON_FAN_ENABLE
+        if((aid==ghomekit_dyfnaid)&&!(IS_BATHROOM(sys_mac))) // Dyson Fan
+        {
+            switch(iid)
+            {
+                case HAP_ACTIVE_OPERATION:   // on or off
+                    acval = (int)write->val.i;
+                    if(acval!=rmt_isdysonfanactive())
+                    {
+                        // Trun On/Off
+                        tgdfmsg.bactivech = true;
+                        tgdfmsg.active = acval;
+                    }
+                    syslog_handler(SYSLOG_FACILITY_HOMEKIT, SYSLOG_LEVEL_INFO,"HAP turn %s Dyson Fan", acval==1?"on":"off");
+                    break;
+                case HAP_FAN_FAN_SPEED_OPERATION:   // Fan speed
+                    acval = (int)write->val.f;
+                    acval = (acval+9)/10;
+                    acval = (acval<DYSON_FAN_MIN_SPEED)?DYSON_FAN_MIN_SPEED:((acval>DYSON_FAN_MAX_SPEED)?DYSON_FAN_MAX_SPEED:acval);
+                    rmt_getdysonfanspeed(&dyspeed);
+                    if(acval!=dyspeed)
+                    {
+                        tgdfmsg.bfanspeedch = true;
+                        tgdfmsg.fanspeed = acval-dyspeed;
+                        dyspeed = acval;
+                        syslog_handler(SYSLOG_FACILITY_HOMEKIT, SYSLOG_LEVEL_INFO,"HAP set Dyson Fan fan speed %d",tgdfmsg.fanspeed);
+                    }
+                    break;
+                case HAP_FAN_FAN_SWING_OPERATION:   // Fan Swing
+                    acval = (int)write->val.i;
+                    rmt_getdysonfanswing(&swing);
+                    if(acval!=swing)
+                    {
+                        // On or off
+                        tgdfmsg.bswingch = true;
+                        tgdfmsg.swing = acval;
+                        syslog_handler(SYSLOG_FACILITY_HOMEKIT, SYSLOG_LEVEL_INFO,"HAP set Dyson Fan swing %d",tgdfmsg.swing);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+#endif
+
         if((aid==ghomekit_dfnaid)&&((IS_BATHROOM(sys_mac))||(IS_SAMPLE(sys_mac)))) // Delta Fan
         {
             switch(iid)
@@ -484,6 +547,27 @@ static int bridge_write(hap_write_data_t write_data[], int count,
             }
         }
     }
+    if(tgdfmsg.bactivech||tgdfmsg.bfanspeedch||tgdfmsg.bswingch)
+    {
+        if(ir_dysonfan_tigger(tgdfmsg)==SYSTEM_ERROR_NONE)
+        {
+            if(tgdfmsg.bactivech)
+            {
+                rmt_setdysonfanstatus((bool)tgdfmsg.active);
+                dysonfan_saveconfig(DYSONFAN_NVS_STATUS_KEY,rmt_isdysonfanactive());
+            }
+            if(tgdfmsg.bfanspeedch)
+            {
+                rmt_setdysonfanspeed(dyspeed);
+                dysonfan_saveconfig(DYSONFAN_NVS_SPEED_KEY,dyspeed);
+            }
+            if(tgdfmsg.bswingch)
+            {
+                rmt_setdysonfanswing(tgdfmsg.swing);
+                dysonfan_saveconfig(DYSONFAN_NVS_SWING_KEY,tgdfmsg.swing);
+            }
+        }
+    }
     if(tghitmsg.bactivech||tghitmsg.bmodech||tghitmsg.bfanspeedch||tghitmsg.bswingch||tghitmsg.blowtempch||tghitmsg.bhightempch)
     {
         if(ir_hitachiac_tigger(tghitmsg)==SYSTEM_ERROR_NONE)
@@ -613,6 +697,14 @@ void task_homekit_init(void *p)
         ir_zerofan_restoreconfig();
     }
 
+#if CONFIG_IR_DYSON_FAN_ENABLE
+    // Restore Dyson fan configuration
+    if(!IS_BATHROOM(sys_mac))
+    {
+        ir_dysonfan_restoreconfig();
+    }
+#endif
+
     // Restore Delta fan configuration
     if(IS_BATHROOM(sys_mac)||IS_SAMPLE(sys_mac))
     {
@@ -943,6 +1035,63 @@ void task_homekit_init(void *p)
         hap_add_bridged_accessory(accessory, hap_get_unique_aid(accessory_name));
     }
 
+#if CONFIG_IR_DYSON_FAN_ENABLE
+    /* Create and add the Dyson Fan Accessory to the Bridge object*/
+    if(!IS_BATHROOM(sys_mac))
+    {
+        memset(accessory_name,0,sizeof(accessory_name));
+        memset(accessory_seriesnumber,0,sizeof(accessory_seriesnumber));
+        sprintf(accessory_name, "YFan-%02X%02X%02X",sys_mac[3],sys_mac[4],sys_mac[5]);
+        sprintf(accessory_seriesnumber,"YFNSN%02X%02X%02X",sys_mac[3],sys_mac[4],sys_mac[5]);
+        hap_acc_cfg_t bridge_cfg = {
+            .name = accessory_name,
+            .manufacturer = "Dyson",
+            .model = "123",
+            .serial_num = accessory_seriesnumber,
+            .fw_rev = "0.9.0",
+            .hw_rev = NULL,
+            .pv = "1.1.0",
+            .identify_routine = accessory_identify,
+            .cid = HAP_CID_BRIDGE,
+        };
+        /* Create accessory object */
+        accessory = hap_acc_create(&bridge_cfg);
+
+        /* Create the Dyson Fan Service. Include the "name" since this is a user visible service  */
+        ghomekit_dyfnhs = hap_serv_fan_v2_create(rmt_isdysonfanactive());
+
+        ghomekit_dysonfan_active_hc = hap_serv_get_char_by_uuid(ghomekit_dyfnhs, HAP_CHAR_UUID_ACTIVE);
+
+        hap_serv_add_char(ghomekit_dyfnhs, hap_char_name_create(accessory_name));
+        
+        // Add Fan speed, 1~10 steps
+        rmt_getdysonfanspeed(&speed);
+        ghomekit_dysonfan_fanspeed_hc = hap_char_rotation_speed_create(speed*10);
+        hap_serv_add_char(ghomekit_dyfnhs, ghomekit_dysonfan_fanspeed_hc);
+
+        // Add Fan swing
+        rmt_getdysonfanswing(&swing);
+        ghomekit_dysonfan_fanswing_hc = hap_char_swing_mode_create(swing);
+        hap_serv_add_char(ghomekit_dyfnhs, ghomekit_dysonfan_fanswing_hc);
+
+        /* Set the Accessory name as the Private data for the service,
+         * so that the correct accessory can be identified in the
+         * write callback
+         */
+        hap_serv_set_priv(ghomekit_dyfnhs, strdup(accessory_name));
+
+        /* Set the write callback for the service */
+        hap_serv_set_write_cb(ghomekit_dyfnhs, bridge_write);
+ 
+        /* Add the Fan Service to the Accessory Object */
+        hap_acc_add_serv(accessory, ghomekit_dyfnhs);
+
+        ghomekit_dyfnaid = hap_get_unique_aid(accessory_name);
+        /* Add the Accessory to the HomeKit Database */
+        hap_add_bridged_accessory(accessory, hap_get_unique_aid(accessory_name));
+    }
+#endif
+
     /* Create and add the Delta Fan Accessory to the Bridge object*/
     if(IS_BATHROOM(sys_mac)||IS_SAMPLE(sys_mac))
     {
@@ -1029,60 +1178,40 @@ void task_homekit_init(void *p)
 
 void zerofan_saveconfig(char *key, int value)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t ret;
-
-    ret = nvs_open(ZEROFAN_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG_NVS, "NVS open failed: %s", esp_err_to_name(ret));
+    if (settings_set_u32(ZEROFAN_NVS_NAMESPACE, key, (uint32_t) value) != SYSTEM_ERROR_NONE) {
+        ESP_LOGE(TAG_NVS, "Config key %s invalid", key);
         return;
     }
+    syslog_handler(SYSLOG_FACILITY_HOMEKIT, SYSLOG_LEVEL_INFO,"Config saved %s %d",key,value);
+    return;
+}
 
-    ret = nvs_set_u32(nvs_handle, key, (uint32_t) value);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG_NVS, "NVS set failed for key1: %s", esp_err_to_name(ret));
-    }    
-    nvs_close(nvs_handle);
+void dysonfan_saveconfig(char *key, int value)
+{
+    if (settings_set_u32(DYSONFAN_NVS_NAMESPACE, key, (uint32_t) value) != SYSTEM_ERROR_NONE) {
+        ESP_LOGE(TAG_NVS, "Config key %s invalid", key);
+        return;
+    }
     syslog_handler(SYSLOG_FACILITY_HOMEKIT, SYSLOG_LEVEL_INFO,"Config saved %s %d",key,value);
     return;
 }
 
 void deltafan_saveconfig(char *key, int value)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t ret;
-
-    ret = nvs_open(DELTAFAN_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG_NVS, "NVS open failed: %s", esp_err_to_name(ret));
+    if (settings_set_u32(DELTAFAN_NVS_NAMESPACE, key, (uint32_t) value) != SYSTEM_ERROR_NONE) {
+        ESP_LOGE(TAG_NVS, "Config key %s invalid", key);
         return;
     }
-
-    ret = nvs_set_u32(nvs_handle, key, (uint32_t) value);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG_NVS, "NVS set failed for key1: %s", esp_err_to_name(ret));
-    }    
-    nvs_close(nvs_handle);
     syslog_handler(SYSLOG_FACILITY_HOMEKIT, SYSLOG_LEVEL_INFO,"Config saved %s %d",key,value);
     return;
 }
 
 void elf_saveconfig(char *key, int value)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t ret;
-
-    ret = nvs_open(ELF_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG_NVS, "NVS open failed: %s", esp_err_to_name(ret));
+    if (settings_set_u32(ELF_NVS_NAMESPACE, key, (uint32_t) value) != SYSTEM_ERROR_NONE) {
+        ESP_LOGE(TAG_NVS, "Config key %s invalid", key);
         return;
     }
-
-    ret = nvs_set_u32(nvs_handle, key, (uint32_t) value);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG_NVS, "NVS set failed for key1: %s", esp_err_to_name(ret));
-    }    
-    nvs_close(nvs_handle);
     return;
 }
 
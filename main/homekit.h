@@ -64,6 +64,7 @@ extern "C"
 #define HAP_ACCESSORY_DELTA_FAN 6
 #define HAP_ACCESSORY_ZERO_FAN 7
 #define HAP_ACCESSORY_AIRQUALITY 8
+#define HAP_ACCESSORY_DYSON_FAN 9
 
 #define HAP_CHARACTER_IGNORE 0
 #define HAP_CHARACTER_ACTIVE 1
@@ -98,6 +99,7 @@ extern "C"
   void ac_saveconfig(char *key, int value);
   void task_homekit_init(void *p);
   void zerofan_saveconfig(char *key, int value);
+  void dysonfan_saveconfig(char *key, int value);
   void deltafan_saveconfig(char *key, int value);
   void elf_saveconfig(char *key, int value);
   void elf_restoreconfig(void);
@@ -0,0 +1,135 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "json_scan.h"
+#include "ota.h"
+#include "syslog.h"
+#include "thingspeak.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Fields of the settings form, ids are bits of http_form_t.present */
+typedef enum
+{
+    HTTP_FORM_APIKEY,
+    HTTP_FORM_FACILITY,
+    HTTP_FORM_FACILITY_LIST,
+    HTTP_FORM_FIRMWARE_FILENAME,
+    HTTP_FORM_FIRMWARE_IP,
+    HTTP_FORM_HUMI_HIGH,
+    HTTP_FORM_HUMI_LOW,
+    HTTP_FORM_IDEL_TIMES,
+    HTTP_FORM_LED_DISPLAY,
+    HTTP_FORM_LED_SNOOZE,
+    HTTP_FORM_LEVEL,    /* level0 to level4 follow */
+    HTTP_FORM_VOC_HIGH = HTTP_FORM_LEVEL + SYSLOG_LEVEL_MAXNUM,
+    HTTP_FORM_VOC_LOW,
+    HTTP_FORM_NOX_HIGH,
+    HTTP_FORM_NOX_LOW,
+    HTTP_FORM_SYSLOG_IP,
+    HTTP_FORM_TEMP_HIGH,
+    HTTP_FORM_TEMP_LOW,
+    HTTP_FORM_MAX
+} http_form_id_t;
+
+_Static_assert(HTTP_FORM_MAX <= 32, "Form fields must fit http_form_t.present");
+
+typedef struct
+{
+    uint32_t present;
+    int idel_times;
+    char syslog_ip[SYSLOG_MAXLEN_IP + 1];
+    char firmware_ip[OTA_MAXLEN_IP + 1];
+    char firmware_filename[OTA_MAXLEN_FILENAME + 1];
+    char apikey[THINGSPEAK_API_KEYLENGTH + 1];
+    int voc_high;
+    int voc_low;
+    int nox_high;
+    int nox_low;
+    int temp_high;
+    int temp_low;
+    int humi_high;
+    int humi_low;
+    int led_display;
+    int led_snooze;
+    int facility;
+    char facility_list[SYSLOG_FACILITY_MAXNUM * 4];
+    bool level[SYSLOG_LEVEL_MAXNUM];
+} http_form_t;
+
+#define HTTP_FORM_FIELD(name, type, id, member)                       \
+    {                                                                 \
+        name, type, id, offsetof(http_form_t, member),                \
+            sizeof(((http_form_t *)0)->member)                        \
+    }
+
+#define HTTP_FORM_HAS(form, id) (((form)->present & (1UL << (id))) != 0)
+
+/*
+ * Key tables of the form and of the /api resources. Only webpages.c uses
+ * them, they are here so host_test can check them.
+ */
+
+/* Sorted by name for json_field_find() */
+static const json_field_t ghttp_form_fields[] = {
+    HTTP_FORM_FIELD("apikey", JSON_FIELD_STR, HTTP_FORM_APIKEY, apikey),
+    HTTP_FORM_FIELD("facility", JSON_FIELD_INT, HTTP_FORM_FACILITY, facility),
+    HTTP_FORM_FIELD("facilityList", JSON_FIELD_STR, HTTP_FORM_FACILITY_LIST,
+                    facility_list),
+    HTTP_FORM_FIELD("firmwareFilename", JSON_FIELD_STR,
+                    HTTP_FORM_FIRMWARE_FILENAME, firmware_filename),
+    HTTP_FORM_FIELD("firmwareIp", JSON_FIELD_STR, HTTP_FORM_FIRMWARE_IP,
+                    firmware_ip),
+    HTTP_FORM_FIELD("humihigh", JSON_FIELD_INT, HTTP_FORM_HUMI_HIGH, humi_high),
+    HTTP_FORM_FIELD("humilow", JSON_FIELD_INT, HTTP_FORM_HUMI_LOW, humi_low),
+    HTTP_FORM_FIELD("idelTimes", JSON_FIELD_INT, HTTP_FORM_IDEL_TIMES,
+                    idel_times),
+    HTTP_FORM_FIELD("leddisplay", JSON_FIELD_INT, HTTP_FORM_LED_DISPLAY,
+                    led_display),
+    HTTP_FORM_FIELD("ledsnooze", JSON_FIELD_INT, HTTP_FORM_LED_SNOOZE,
+                    led_snooze),
+    HTTP_FORM_FIELD("level0", JSON_FIELD_BOOL, HTTP_FORM_LEVEL + 0, level[0]),
+    HTTP_FORM_FIELD("level1", JSON_FIELD_BOOL, HTTP_FORM_LEVEL + 1, level[1]),
+    HTTP_FORM_FIELD("level2", JSON_FIELD_BOOL, HTTP_FORM_LEVEL + 2, level[2]),
+    HTTP_FORM_FIELD("level3", JSON_FIELD_BOOL, HTTP_FORM_LEVEL + 3, level[3]),
+    HTTP_FORM_FIELD("level4", JSON_FIELD_BOOL, HTTP_FORM_LEVEL + 4, level[4]),
+    HTTP_FORM_FIELD("mq135high", JSON_FIELD_INT, HTTP_FORM_VOC_HIGH, voc_high),
+    HTTP_FORM_FIELD("mq135low", JSON_FIELD_INT, HTTP_FORM_VOC_LOW, voc_low),
+    HTTP_FORM_FIELD("sgp41noxhigh", JSON_FIELD_INT, HTTP_FORM_NOX_HIGH,
+                    nox_high),
+    HTTP_FORM_FIELD("sgp41noxlow", JSON_FIELD_INT, HTTP_FORM_NOX_LOW, nox_low),
+    HTTP_FORM_FIELD("syslogIp", JSON_FIELD_STR, HTTP_FORM_SYSLOG_IP, syslog_ip),
+    HTTP_FORM_FIELD("temphigh", JSON_FIELD_INT, HTTP_FORM_TEMP_HIGH, temp_high),
+    HTTP_FORM_FIELD("templow", JSON_FIELD_INT, HTTP_FORM_TEMP_LOW, temp_low),
+};
+
+/* Sorted by name for json_field_find() */
+static const json_field_t ghttp_occupancy_fields[] = {
+    HTTP_FORM_FIELD("leaveDelay", JSON_FIELD_INT, HTTP_FORM_IDEL_TIMES,
+                    idel_times),
+};
+
+static const json_field_t ghttp_airquality_fields[] = {
+    HTTP_FORM_FIELD("humiHigh", JSON_FIELD_INT, HTTP_FORM_HUMI_HIGH, humi_high),
+    HTTP_FORM_FIELD("humiLow", JSON_FIELD_INT, HTTP_FORM_HUMI_LOW, humi_low),
+    HTTP_FORM_FIELD("noxHigh", JSON_FIELD_INT, HTTP_FORM_NOX_HIGH, nox_high),
+    HTTP_FORM_FIELD("noxLow", JSON_FIELD_INT, HTTP_FORM_NOX_LOW, nox_low),
+    HTTP_FORM_FIELD("tempHigh", JSON_FIELD_INT, HTTP_FORM_TEMP_HIGH, temp_high),
+    HTTP_FORM_FIELD("tempLow", JSON_FIELD_INT, HTTP_FORM_TEMP_LOW, temp_low),
+    HTTP_FORM_FIELD("vocHigh", JSON_FIELD_INT, HTTP_FORM_VOC_HIGH, voc_high),
+    HTTP_FORM_FIELD("vocLow", JSON_FIELD_INT, HTTP_FORM_VOC_LOW, voc_low),
+};
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,236 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "http_job.h"
+#include "syslog.h"
+#include "system.h"
+
+typedef struct
+{
+    const char *name;
+    http_job_fn_t fn;
+    void *arg;
+    char *result;
+    int result_len;
+    uint16_t id;
+    uint8_t state;
+    int64_t queued_us;
+    int64_t started_us;
+    int64_t ended_us;
+} http_job_t;
+
+static http_job_t ghttp_jobs[HTTP_JOB_MAX];
+static uint16_t ghttp_job_id = 0;
+static QueueHandle_t gqueue_http_job = NULL;
+static SemaphoreHandle_t gsemaHttpJob = NULL;
+
+/* Call with gsemaHttpJob taken */
+static http_job_t *http_job_find(uint16_t id)
+{
+    for (int i = 0; (id != 0) && (i < HTTP_JOB_MAX); i++)
+    {
+        if ((ghttp_jobs[i].state != HTTP_JOB_STATE_FREE) &&
+            (ghttp_jobs[i].id == id))
+        {
+            return &ghttp_jobs[i];
+        }
+    }
+    return NULL;
+}
+
+/* Call with gsemaHttpJob taken */
+static void http_job_free(http_job_t *job)
+{
+    free(job->result);
+    memset(job, 0, sizeof(*job));
+}
+
+static void task_http_job(void *arg)
+{
+    http_job_t *job = NULL;
+    char *result = NULL;
+    int len = 0, ret = 0;
+
+    while (1)
+    {
+        if (xQueueReceive(gqueue_http_job, &job, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
+        xSemaphoreTake(gsemaHttpJob, portMAX_DELAY);
+        job->state = HTTP_JOB_STATE_RUNNING;
+        job->started_us = esp_timer_get_time();
+        xSemaphoreGive(gsemaHttpJob);
+
+        result = NULL;
+        len = 0;
+        ret = job->fn(job->arg, &result, &len);
+
+        xSemaphoreTake(gsemaHttpJob, portMAX_DELAY);
+        job->result = result;
+        job->result_len = (result != NULL) ? len : 0;
+        job->ended_us = esp_timer_get_time();
+        job->state = (ret == SYSTEM_ERROR_NONE) ? HTTP_JOB_STATE_DONE
+                                                : HTTP_JOB_STATE_FAILED;
+        syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_INFO,
+                       "Job %u %s %s in %lu ms", job->id, job->name,
+                       (ret == SYSTEM_ERROR_NONE) ? "done" : "failed",
+                       (uint32_t)((job->ended_us - job->started_us) / 1000));
+        xSemaphoreGive(gsemaHttpJob);
+    }
+}
+
+void http_job_init(void)
+{
+    if (gsemaHttpJob != NULL)
+    {
+        return;
+    }
+    gqueue_http_job = xQueueCreate(HTTP_JOB_MAX, sizeof(http_job_t *));
+    gsemaHttpJob = xSemaphoreCreateBinary();
+    if ((gqueue_http_job == NULL) || (gsemaHttpJob == NULL))
+    {
+        return;
+    }
+    xSemaphoreGive(gsemaHttpJob);
+    xTaskCreate(task_http_job, HTTP_JOB_TASK_NAME, HTTP_JOB_TASK_STACKSIZE,
+                NULL, HTTP_JOB_TASK_PRIORITY, NULL);
+}
+
+int http_job_submit(const char *name, http_job_fn_t fn, void *arg,
+                    uint16_t *id)
+{
+    http_job_t *job = NULL;
+
+    if (gsemaHttpJob == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (http_job %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if ((fn == NULL) || (id == NULL))
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    xSemaphoreTake(gsemaHttpJob, portMAX_DELAY);
+    for (int i = 0; i < HTTP_JOB_MAX; i++)
+    {
+        if (ghttp_jobs[i].state == HTTP_JOB_STATE_FREE)
+        {
+            job = &ghttp_jobs[i];
+            break;
+        }
+        /* Results nobody came for go first, oldest first */
+        if (((ghttp_jobs[i].state == HTTP_JOB_STATE_DONE) ||
+             (ghttp_jobs[i].state == HTTP_JOB_STATE_FAILED)) &&
+            ((job == NULL) || (ghttp_jobs[i].ended_us < job->ended_us)))
+        {
+            job = &ghttp_jobs[i];
+        }
+    }
+    if (job == NULL)
+    {
+        xSemaphoreGive(gsemaHttpJob);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    http_job_free(job);
+    if (++ghttp_job_id == 0)
+    {
+        ghttp_job_id = 1;
+    }
+    job->id = ghttp_job_id;
+    job->name = name;
+    job->fn = fn;
+    job->arg = arg;
+    job->state = HTTP_JOB_STATE_QUEUED;
+    job->queued_us = esp_timer_get_time();
+    *id = job->id;
+    xSemaphoreGive(gsemaHttpJob);
+
+    /* A free slot means there is room in the queue */
+    xQueueSend(gqueue_http_job, &job, 0);
+    return SYSTEM_ERROR_NONE;
+}
+
+int http_job_get_info(uint16_t id, http_job_info_t *info)
+{
+    http_job_t *job = NULL;
+    int64_t now = esp_timer_get_time();
+    int ret = SYSTEM_ERROR_INVALID_PARAMETER;
+
+    if (gsemaHttpJob == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (http_job %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (info == NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    xSemaphoreTake(gsemaHttpJob, portMAX_DELAY);
+    job = http_job_find(id);
+    if (job != NULL)
+    {
+        info->name = job->name;
+        info->id = job->id;
+        info->state = job->state;
+        info->wait_ms =
+            (((job->state == HTTP_JOB_STATE_QUEUED) ? now : job->started_us) -
+             job->queued_us) / 1000;
+        info->run_ms =
+            (job->state == HTTP_JOB_STATE_QUEUED)
+                ? 0
+                : (((job->state == HTTP_JOB_STATE_RUNNING) ? now
+                                                           : job->ended_us) -
+                   job->started_us) / 1000;
+        info->result_len = job->result_len;
+        ret = SYSTEM_ERROR_NONE;
+    }
+    xSemaphoreGive(gsemaHttpJob);
+    return ret;
+}
+
+int http_job_take_result(uint16_t id, char **result, int *len)
+{
+    http_job_t *job = NULL;
+    int ret = SYSTEM_ERROR_INVALID_PARAMETER;
+
+    if (gsemaHttpJob == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (http_job %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if ((result == NULL) || (len == NULL))
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    xSemaphoreTake(gsemaHttpJob, portMAX_DELAY);
+    job = http_job_find(id);
+    if ((job != NULL) && ((job->state == HTTP_JOB_STATE_DONE) ||
+                          (job->state == HTTP_JOB_STATE_FAILED)))
+    {
+        *result = job->result;
+        *len = job->result_len;
+        job->result = NULL;
+        http_job_free(job);
+        ret = SYSTEM_ERROR_NONE;
+    }
+    else if (job != NULL)
+    {
+        ret = SYSTEM_ERROR_NOT_READY;
+    }
+    xSemaphoreGive(gsemaHttpJob);
+    return ret;
+}
@@ -0,0 +1,68 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HTTP_JOB_MAX                4
+#define HTTP_JOB_TASK_NAME          "HttpJob"
+#define HTTP_JOB_TASK_STACKSIZE     6144
+#define HTTP_JOB_TASK_PRIORITY      4       /* Below the web server */
+
+#define HTTP_JOB_STATE_FREE         0
+#define HTTP_JOB_STATE_QUEUED       1
+#define HTTP_JOB_STATE_RUNNING      2
+#define HTTP_JOB_STATE_DONE         3
+#define HTTP_JOB_STATE_FAILED       4
+
+/**
+ * @brief Work of one job, it runs in the job task
+ *
+ * @param[out] result Text on the heap for the client, owned by the job table
+ * @return SYSTEM_ERROR_NONE if the job is done
+ */
+typedef int (*http_job_fn_t)(void *arg, char **result, int *len);
+
+typedef struct
+{
+    const char *name;
+    uint16_t id;
+    uint8_t state;
+    uint32_t wait_ms;       /* Queued behind other jobs */
+    uint32_t run_ms;
+    int result_len;
+} http_job_info_t;
+
+/**
+ * @brief Create the job task, jobs run one after the other
+ */
+void http_job_init(void);
+
+/**
+ * @brief Queue a job, the oldest finished job is dropped if the table is full
+ *
+ * @param[out] id Never 0
+ * @return SYSTEM_ERROR_NOT_READY if every job is queued or running
+ */
+int http_job_submit(const char *name, http_job_fn_t fn, void *arg,
+                    uint16_t *id);
+
+int http_job_get_info(uint16_t id, http_job_info_t *info);
+
+/**
+ * @brief Hand the result of a finished job over and free the job
+ *
+ * @param[out] result To free by the caller, NULL if the job has none
+ */
+int http_job_take_result(uint16_t id, char **result, int *len);
+
+#ifdef __cplusplus
+}
+#endif
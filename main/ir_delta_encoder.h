@@ -51,32 +51,11 @@ typedef struct {
     uint8_t data[4];
 } ir_delta_scan_code_t;
 
-/**
- * @brief Type of IR delta encoder configuration
- */
-typedef struct {
-    uint32_t resolution; /*!< Encoder resolution, in Hz */
-} ir_delta_encoder_config_t;
-
-/**
- * @brief Create RMT encoder for encoding IR delta frame into RMT symbols
- *
- * @param[in] config Encoder configuration
- * @param[out] ret_encoder Returned encoder handle
- * @return
- *      - ESP_ERR_INVALID_ARG for any invalid arguments
- *      - ESP_ERR_NO_MEM out of memory when creating IR NEC encoder
- *      - ESP_OK if creating encoder successfully
- */
-esp_err_t rmt_new_ir_delta_encoder(const ir_delta_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder);
 bool rmt_ismanualfanactive();
 bool rmt_isdryfanactive();
 bool rmt_iswarmfanactive();
 bool rmt_isexhaustfanactive();
 int rmt_setmanualfanstatus(bool );
-int rmt_setdryfanstatus(bool );
-int rmt_setwarmfanstatus(bool );
-int rmt_setexhaustfanstatus(bool );
 void ir_deltafan_restoreconfig(void);
 
 #ifdef __cplusplus
@@ -4,167 +4,238 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <string.h>
 #include "esp_check.h"
 #include "ir_dyson_encoder.h"
+#include "ir_learn.h"
+#include "ir_protocol.h"
+#include "rmt.h"
+#include "syslog.h"
+#include "system.h"
+#include "homekit.h"
 
-static const char *TAG = "dyson_encoder";
+SemaphoreHandle_t gsemaIRDYSONCfg = NULL;     //Created in rmt.c
 
-typedef struct {
-    rmt_encoder_t base;           // the base "class", declares the standard encoder interface
-    rmt_encoder_t *copy_encoder;  // use the copy_encoder to encode the leading and ending pulse
-    rmt_encoder_t *bytes_encoder; // use the bytes_encoder to encode the address and command data
-    rmt_symbol_word_t dyson_leading_symbol; // +-0 leading code with RMT representation
-    rmt_symbol_word_t dyson_repeat_symbol;  // +-0 leading code with RMT representation
-    rmt_symbol_word_t dyson_ending_symbol;  // +-0 ending code with RMT representation
-    int state;
-} rmt_ir_dyson_encoder_t;
+bool gdysonfanstatus = 0;
+int gdysonfanspeed = 0;
+int gdysonfanswing = 0;
 
-static size_t rmt_encode_ir_dyson(rmt_encoder_t *encoder, rmt_channel_handle_t channel, const void *primary_data, size_t data_size, rmt_encode_state_t *ret_state)
+static const char *gdysonfan_keyname[DYSON_KEY_MAX] = DYSON_KEY_NAMES;
+
+bool rmt_isdysonfanactive()
 {
-    rmt_ir_dyson_encoder_t *dyson_encoder = __containerof(encoder, rmt_ir_dyson_encoder_t, base);
-    rmt_encode_state_t session_state = RMT_ENCODING_RESET;
-    rmt_encode_state_t state = RMT_ENCODING_RESET;
-    size_t encoded_symbols = 0;
-    ir_dyson_scan_code_t *scan_code = (ir_dyson_scan_code_t *)primary_data;
-    rmt_encoder_handle_t copy_encoder = dyson_encoder->copy_encoder;
-    rmt_encoder_handle_t bytes_encoder = dyson_encoder->bytes_encoder;
-
-    switch (dyson_encoder->state) {
-        case 0: // send leading code
-            encoded_symbols += copy_encoder->encode(copy_encoder, channel, &dyson_encoder->dyson_leading_symbol,
-                                                sizeof(rmt_symbol_word_t), &session_state);
-            if (session_state & RMT_ENCODING_COMPLETE) {
-                dyson_encoder->state = 1; // we can only switch to next state when current encoder finished
-            }
-            if (session_state & RMT_ENCODING_MEM_FULL) {             
-                state |= RMT_ENCODING_MEM_FULL;
-                goto out; // yield if there's no free space to put other encoding artifacts
-            }
-            // fall-through
-        case 1: // send address
-            encoded_symbols += bytes_encoder->encode(bytes_encoder, channel, &scan_code->data, data_size/*sizeof(uint8_t)*/, &session_state);
-            if (session_state & RMT_ENCODING_COMPLETE) 
-            {
-                //dyson_encoder->state = 2; // we can only switch to next state when current encoder finished
-            }
-            for(int i=0;i<=0;i++)
-            {
-                encoded_symbols += copy_encoder->encode(copy_encoder, channel, &dyson_encoder->dyson_repeat_symbol,
-                    sizeof(rmt_symbol_word_t), &session_state);
-
-                encoded_symbols += copy_encoder->encode(copy_encoder, channel, &dyson_encoder->dyson_leading_symbol,
-                                                sizeof(rmt_symbol_word_t), &session_state);
-
-                encoded_symbols += bytes_encoder->encode(bytes_encoder, channel, &scan_code->data, data_size/*sizeof(uint8_t)*/, &session_state);
-            
-                if (session_state & RMT_ENCODING_MEM_FULL) 
-                {
-                    state |= RMT_ENCODING_MEM_FULL;
-                    goto out; // yield if there's no free space to put other encoding artifacts
-                }
-            }
-            if (session_state & RMT_ENCODING_COMPLETE) 
-            {
-                dyson_encoder->state = 2; // we can only switch to next state when current encoder finished
-            }
-            // fall-through
-        case 2: // send ending code
-            encoded_symbols += copy_encoder->encode(copy_encoder, channel, &dyson_encoder->dyson_ending_symbol,
-                                                sizeof(rmt_symbol_word_t), &session_state);
-            if (session_state & RMT_ENCODING_COMPLETE) {
-                dyson_encoder->state = RMT_ENCODING_RESET; // back to the initial encoding session
-                state |= RMT_ENCODING_COMPLETE;
-            }
-            if (session_state & RMT_ENCODING_MEM_FULL) {
-                state |= RMT_ENCODING_MEM_FULL;
-                goto out; // yield if there's no free space to put other encoding artifacts
-            }
+    bool ret = false;
+    if(gsemaIRDYSONCfg==NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR,SYSLOG_LEVEL_ERROR,"Semaphore not ready (dyson %d)",__LINE__);
+        return false;
+    }
+    if (xSemaphoreTake(gsemaIRDYSONCfg, portMAX_DELAY) == pdTRUE) 
+    {
+        ret = gdysonfanstatus;
+        xSemaphoreGive(gsemaIRDYSONCfg);
+    }
+    return ret;
+}
+
+int rmt_setdysonfanstatus(bool status)
+{
+    if(gsemaIRDYSONCfg==NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR,SYSLOG_LEVEL_ERROR,"Semaphore not ready (dyson %d)",__LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (xSemaphoreTake(gsemaIRDYSONCfg, portMAX_DELAY) == pdTRUE) 
+    {
+        gdysonfanstatus = status;
+        xSemaphoreGive(gsemaIRDYSONCfg);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+int rmt_getdysonfanspeed(int *value)
+{
+    if(gsemaIRDYSONCfg==NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR,SYSLOG_LEVEL_ERROR,"Semaphore not ready (dyson %d)",__LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (xSemaphoreTake(gsemaIRDYSONCfg, portMAX_DELAY) == pdTRUE) 
+    {
+        *value = gdysonfanspeed;
+        xSemaphoreGive(gsemaIRDYSONCfg);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+int rmt_setdysonfanspeed(int value)
+{
+    if(gsemaIRDYSONCfg==NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR,SYSLOG_LEVEL_ERROR,"Semaphore not ready (dyson %d)",__LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (xSemaphoreTake(gsemaIRDYSONCfg, portMAX_DELAY) == pdTRUE) 
+    {
+        gdysonfanspeed = value;
+        xSemaphoreGive(gsemaIRDYSONCfg);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+int rmt_getdysonfanswing(int *value)
+{
+    if(gsemaIRDYSONCfg==NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR,SYSLOG_LEVEL_ERROR,"Semaphore not ready (dyson %d)",__LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (xSemaphoreTake(gsemaIRDYSONCfg, portMAX_DELAY) == pdTRUE) 
+    {
+        *value = gdysonfanswing;
+        xSemaphoreGive(gsemaIRDYSONCfg);
     }
-    
-out:
-    *ret_state = state;
-    return encoded_symbols;
+    return SYSTEM_ERROR_NONE;
 }
 
-static esp_err_t rmt_del_ir_dyson_encoder(rmt_encoder_t *encoder)
+int rmt_setdysonfanswing(int value)
 {
-    rmt_ir_dyson_encoder_t *dyson_encoder = __containerof(encoder, rmt_ir_dyson_encoder_t, base);
-    rmt_del_encoder(dyson_encoder->copy_encoder);
-    rmt_del_encoder(dyson_encoder->bytes_encoder);
-    free(dyson_encoder);
-    return ESP_OK;
+    if(gsemaIRDYSONCfg==NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR,SYSLOG_LEVEL_ERROR,"Semaphore not ready (dyson %d)",__LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (xSemaphoreTake(gsemaIRDYSONCfg, portMAX_DELAY) == pdTRUE) 
+    {
+        gdysonfanswing = value;
+        xSemaphoreGive(gsemaIRDYSONCfg);
+    }
+    return SYSTEM_ERROR_NONE;
 }
 
-static esp_err_t rmt_ir_dyson_encoder_reset(rmt_encoder_t *encoder)
+void ir_dysonfan_restoreconfig(void)
 {
-    rmt_ir_dyson_encoder_t *dyson_encoder = __containerof(encoder, rmt_ir_dyson_encoder_t, base);
-    rmt_encoder_reset(dyson_encoder->copy_encoder);
-    rmt_encoder_reset(dyson_encoder->bytes_encoder);
-    dyson_encoder->state = RMT_ENCODING_RESET;
-    return ESP_OK;
+    nvs_handle_t nvs_handle;
+    esp_err_t ret;
+    uint32_t value1 = 0;
+    gsemaIRDYSONCfg = xSemaphoreCreateBinary();
+    if (gsemaIRDYSONCfg == NULL) {
+        return;        
+    }
+
+    ret = nvs_open(DYSONFAN_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG_NVS, "NVS open failed: %s", esp_err_to_name(ret));
+        xSemaphoreGive(gsemaIRDYSONCfg);
+        return;
+    }
+
+    ret = nvs_get_u32(nvs_handle, DYSONFAN_NVS_STATUS_KEY, &value1);
+    if ((ret == ESP_OK))
+    {
+        gdysonfanstatus = (bool)value1;
+    }
+    else
+    {
+        gdysonfanstatus = (bool)DYSON_FAN_DEFAULT_STATUS;
+        ESP_LOGE(TAG_NVS, "NVS get failed for key-key: %s", esp_err_to_name(ret));
+    }
+
+    ret = nvs_get_u32(nvs_handle, DYSONFAN_NVS_SPEED_KEY, &value1);
+    if ((ret == ESP_OK))
+    {
+        gdysonfanspeed = value1;
+    }
+    else
+    {
+        gdysonfanspeed = DYSON_FAN_DEFAULT_SPEED;
+        ESP_LOGE(TAG_NVS, "NVS get failed for key-key: %s", esp_err_to_name(ret));
+    }
+
+    ret = nvs_get_u32(nvs_handle, DYSONFAN_NVS_SWING_KEY, &value1);
+    if ((ret == ESP_OK))
+    {
+        gdysonfanswing = value1;
+    }
+    else
+    {
+        gdysonfanswing = DYSON_FAN_DEFAULT_SWING;
+        ESP_LOGE(TAG_NVS, "NVS get failed for key-key: %s", esp_err_to_name(ret));
+    }
+
+    nvs_close(nvs_handle);
+    xSemaphoreGive(gsemaIRDYSONCfg);
+    return;
 }
 
-esp_err_t rmt_new_ir_dyson_encoder(const ir_dyson_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+int ir_dysonfan_getkey(int key, uint8_t *data)
 {
-    esp_err_t ret = ESP_OK;
-    rmt_ir_dyson_encoder_t *dyson_encoder = NULL;
-    ESP_GOTO_ON_FALSE(config && ret_encoder, ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
-    dyson_encoder = calloc(1, sizeof(rmt_ir_dyson_encoder_t));
-    ESP_GOTO_ON_FALSE(dyson_encoder, ESP_ERR_NO_MEM, err, TAG, "no mem for ir dyson encoder");
-    dyson_encoder->base.encode = rmt_encode_ir_dyson;
-    dyson_encoder->base.del = rmt_del_ir_dyson_encoder;
-    dyson_encoder->base.reset = rmt_ir_dyson_encoder_reset;
-
-    rmt_copy_encoder_config_t copy_encoder_config = {};
-    ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_encoder_config, &dyson_encoder->copy_encoder), err, TAG, "create copy encoder failed");
-
-    // construct the leading code and ending code with RMT symbol format
-    dyson_encoder->dyson_leading_symbol = (rmt_symbol_word_t) {
-        .level0 = 1,
-        .duration0 = 2500ULL * config->resolution / 1000000,
-        .level1 = 0,
-        .duration1 = 3300ULL * config->resolution / 1000000,
-    };
-    dyson_encoder->dyson_repeat_symbol = (rmt_symbol_word_t) {
-        .level0 = 1,
-        .duration0 = 450ULL * config->resolution / 1000000,
-        .level1 = 0,
-        .duration1 = 6600ULL * config->resolution / 1000000,
-    };
-    dyson_encoder->dyson_ending_symbol = (rmt_symbol_word_t) {
-        .level0 = 1,
-        .duration0 = 450 * config->resolution / 1000000,
-        .level1 = 0,
-        .duration1 = 0,
-    };
-
-    rmt_bytes_encoder_config_t bytes_encoder_config = {
-        .bit0 = {
-            .level0 = 1,
-            .duration0 = 450 * config->resolution / 1000000, // T0H=420us
-            .level1 = 0,
-            .duration1 = 1200 * config->resolution / 1000000, // T0L=420us
-        },
-        .bit1 = {
-            .level0 = 1,
-            .duration0 = 1300 * config->resolution / 1000000,  // T1H=420us
-            .level1 = 0,
-            .duration1 = 400 * config->resolution / 1000000, // T1L=1300us
-        },
-    };
-    ESP_GOTO_ON_ERROR(rmt_new_bytes_encoder(&bytes_encoder_config, &dyson_encoder->bytes_encoder), err, TAG, "create bytes encoder failed");
-
-    *ret_encoder = &dyson_encoder->base;
-    return ESP_OK;
-err:
-    if (dyson_encoder) {
-        if (dyson_encoder->bytes_encoder) {
-            rmt_del_encoder(dyson_encoder->bytes_encoder);
+    rmt_symbol_word_t symbols[DYSON_KEY_MAX_SYMBOLS];
+    ir_protocol_result_t result;
+    uint32_t gap_ms = 0;
+    size_t num = 0;
+    int index = 0;
+
+    if (data == NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if ((key < 0) || (key >= DYSON_KEY_MAX))
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    index = ir_learn_find(gdysonfan_keyname[key]);
+    if (index < 0)
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    num = ir_learn_get_frame(index, 0, symbols, DYSON_KEY_MAX_SYMBOLS, &gap_ms);
+    if (!ir_protocol_parse(symbols, num, &result) ||
+        (result.type != IR_TYPE_DYSON) ||
+        (result.data_len != DYSON_IRP_DATA_LEN))
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Learned %s is not a Dyson frame",
+                       gdysonfan_keyname[key]);
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    memcpy(data, result.data, DYSON_IRP_DATA_LEN);
+    return SYSTEM_ERROR_NONE;
+}
+
+/* Only task_ir_rx calls it, the codes are decoded again after a change */
+int ir_dysonfan_findkey(const uint8_t *data)
+{
+#if CONFIG_IR_DYSON_FAN_ENABLE
+    static uint8_t codes[DYSON_KEY_MAX][DYSON_IRP_DATA_LEN];
+    static uint8_t learned = 0; /* Bit per key with a code in codes */
+    static uint32_t generation = 0;
+    uint32_t now = ir_learn_generation();
+
+    if (data == NULL)
+    {
+        return -1;
+    }
+    if (now != generation)
+    {
+        generation = now;
+        learned = 0;
+        for (int key = 0; key < DYSON_KEY_MAX; key++)
+        {
+            if (ir_dysonfan_getkey(key, codes[key]) == SYSTEM_ERROR_NONE)
+            {
+                learned |= 1 << key;
+            }
         }
-        if (dyson_encoder->copy_encoder) {
-            rmt_del_encoder(dyson_encoder->copy_encoder);
+    }
+    for (int key = 0; learned && (key < DYSON_KEY_MAX); key++)
+    {
+        if ((learned & (1 << key)) &&
+            (memcmp(codes[key], data, DYSON_IRP_DATA_LEN) == 0))
+        {
+            return key;
         }
-        free(dyson_encoder);
     }
-    return ret;
+#endif
+    return -1;
 }
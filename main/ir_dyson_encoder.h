@@ -6,14 +6,40 @@
 #pragma once
 
 #include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
 #include "driver/rmt_encoder.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define DYSONFAN_NVS_NAMESPACE   "DYSONFANCFG"
+#define DYSONFAN_NVS_STATUS_KEY  "status"
+#define DYSONFAN_NVS_SPEED_KEY   "speed"
+#define DYSONFAN_NVS_SWING_KEY   "swing"
+
+#define DYSON_FAN_MIN_SPEED      1
+#define DYSON_FAN_MAX_SPEED      10
+
+/* Dyson Fan keys. Their codes are not built in, each key is learned from
+   the real remote under the name below and its first frame is decoded as a
+   Dyson frame: data[0..1] is the address, data[2] is the key. */
+#define DYSON_IRP_DATA_LEN       3
+#define DYSON_KEY_POWER          0
+#define DYSON_KEY_SPEEDUP        1
+#define DYSON_KEY_SPEEDDN        2
+#define DYSON_KEY_SWING          3
+#define DYSON_KEY_MAX            4
+#define DYSON_KEY_NAMES          {"dyson-power", "dyson-speedup", \
+                                  "dyson-speeddown", "dyson-swing"}
+#define DYSON_KEY_MAX_SYMBOLS    64      /* One learned frame */
+
+extern SemaphoreHandle_t gsemaIRDYSONCfg;
+
 /**
- * @brief IR +-0 scan code representation
+ * @brief IR Dyson scan code representation
  */
 typedef struct {
    int repeat;
@@ -24,24 +50,29 @@ typedef struct {
     uint8_t data[3];
 } ir_dyson_scan_code_t;
 
+bool rmt_isdysonfanactive();
+int rmt_setdysonfanstatus(bool );
+int rmt_getdysonfanspeed(int *);
+int rmt_setdysonfanspeed(int );
+int rmt_getdysonfanswing(int *);
+int rmt_setdysonfanswing(int );
+void ir_dysonfan_restoreconfig(void);
+
 /**
- * @brief Type of IR +-0 encoder configuration
+ * @brief Get the code of a Dyson key from its learned command
+ *
+ * @param[out] data DYSON_IRP_DATA_LEN bytes
+ * @return SYSTEM_ERROR_INVALID_PARAMETER if the key isn't learned or its
+ *         frame doesn't decode as Dyson
  */
-typedef struct {
-    uint32_t resolution; /*!< Encoder resolution, in Hz */
-} ir_dyson_encoder_config_t;
+int ir_dysonfan_getkey(int key, uint8_t *data);
 
 /**
- * @brief Create RMT encoder for encoding IR HITACHI frame into RMT symbols
+ * @brief Match a received Dyson frame against the learned keys
  *
- * @param[in] config Encoder configuration
- * @param[out] ret_encoder Returned encoder handle
- * @return
- *      - ESP_ERR_INVALID_ARG for any invalid arguments
- *      - ESP_ERR_NO_MEM out of memory when creating IR NEC encoder
- *      - ESP_OK if creating encoder successfully
+ * @return DYSON_KEY_XXX, -1 if it isn't one of them
  */
-esp_err_t rmt_new_ir_dyson_encoder(const ir_dyson_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder);
+int ir_dysonfan_findkey(const uint8_t *data);
 
 #ifdef __cplusplus
 }
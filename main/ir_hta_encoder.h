@@ -52,24 +52,6 @@ typedef struct {
     uint8_t data[44];
 } ir_hta_scan_code_t;
 
-/**
- * @brief Type of IR NEC encoder configuration
- */
-typedef struct {
-    uint32_t resolution; /*!< Encoder resolution, in Hz */
-} ir_hta_encoder_config_t;
-
-/**
- * @brief Create RMT encoder for encoding IR HITACHI frame into RMT symbols
- *
- * @param[in] config Encoder configuration
- * @param[out] ret_encoder Returned encoder handle
- * @return
- *      - ESP_ERR_INVALID_ARG for any invalid arguments
- *      - ESP_ERR_NO_MEM out of memory when creating IR NEC encoder
- *      - ESP_OK if creating encoder successfully
- */
-esp_err_t rmt_new_ir_hta_encoder(const ir_hta_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder);
 bool rmt_isiracactive();
 int rmt_setiracstatus(bool );
 int rmt_getiracmode(int *);
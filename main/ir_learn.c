@@ -0,0 +1,828 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "ir_learn.h"
+#include "system.h"
+#include "syslog.h"
+
+#define IR_LEARN_FILE_MAGIC     0x4E4C5249  /* "IRLN" */
+#define IR_LEARN_FILE_VERSION   1
+#define IR_LEARN_RUN_MARK       0xF0
+#define IR_LEARN_RUN_MAX        16
+#define IR_LEARN_FRAME_HEADER   6           /* nsym, gap_ms, nbytes */
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint8_t count;
+    uint8_t reserved;
+    uint16_t used;
+    uint16_t size;
+} ir_learn_file_header_t;
+
+typedef struct
+{
+    uint16_t offset;    /* In gir_learn_capture */
+    uint16_t num;
+    uint32_t gap_ms;
+} ir_learn_frame_t;
+
+/* Learned commands, the blobs are packed back to back in one arena so
+   deleting compacts it instead of leaving holes in the heap */
+static uint8_t gir_learn_arena[IR_LEARN_ARENA_SIZE];
+static ir_learn_entry_t gir_learn_dir[IR_LEARN_MAX_ENTRIES];
+static int gir_learn_count = 0;
+static int gir_learn_used = 0;
+static uint32_t gir_learn_generation = 0;   /* Bumped on every change */
+static SemaphoreHandle_t gsemaIRLearn = NULL;
+
+/* Learning session, the first press is kept and later presses are
+   averaged into it */
+static rmt_symbol_word_t gir_learn_capture[IR_LEARN_MAX_SYMBOLS];
+static ir_learn_frame_t gir_learn_frames[IR_LEARN_MAX_FRAMES];
+static char gir_learn_name[IR_LEARN_NAME_LEN];
+static int gir_learn_state = IR_LEARN_STATE_IDLE;
+static int gir_learn_press = 0;     /* Press being received */
+static int gir_learn_frame = 0;     /* Frames received of that press */
+static int gir_learn_nframes = 0;   /* Frames of the first press */
+static int gir_learn_nsymbols = 0;  /* Symbols of the first press */
+static int64_t gir_learn_start_ms = 0;
+static int64_t gir_learn_last_ms = 0;
+
+static void ir_learn_put16(uint8_t *dst, uint16_t value)
+{
+    dst[0] = value & 0xFF;
+    dst[1] = value >> 8;
+}
+
+static uint16_t ir_learn_get16(const uint8_t *src)
+{
+    return src[0] | (src[1] << 8);
+}
+
+static bool ir_learn_match(uint32_t a, uint32_t b)
+{
+    uint32_t diff = (a > b) ? (a - b) : (b - a);
+    uint32_t margin = ((a > b) ? a : b) >> 3;
+
+    if (margin < IR_LEARN_MARGIN_US)
+    {
+        margin = IR_LEARN_MARGIN_US;
+    }
+    return diff <= margin;
+}
+
+static int ir_learn_dict_find(const uint16_t *dict, int ndict,
+                              uint32_t duration)
+{
+    uint32_t best = UINT32_MAX, diff = 0;
+    int index = -1;
+
+    for (int i = 0; i < ndict; i++)
+    {
+        diff = (dict[i] > duration) ? (dict[i] - duration)
+                                    : (duration - dict[i]);
+        if (diff < best)
+        {
+            best = diff;
+            index = i;
+        }
+    }
+    return index;
+}
+
+static void ir_learn_fail(const char *reason)
+{
+    gir_learn_state = IR_LEARN_STATE_FAIL;
+    syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_WARNING,
+                   "IR learn %s fail, %s", gir_learn_name, reason);
+}
+
+static bool ir_learn_emit(uint8_t *out, size_t size, size_t *pos,
+                          uint8_t value)
+{
+    if (*pos >= size)
+    {
+        return false;
+    }
+    out[(*pos)++] = value;
+    return true;
+}
+
+/**
+ * @brief Code the captured press into out
+ *
+ * Remotes only use a handful of distinct durations, so they are clustered
+ * into a dictionary and every symbol becomes one byte of two indexes. Runs
+ * of the same symbol, e.g. header bursts or repeated bits, become one more
+ * byte.
+ *
+ * @return Length of the blob, 0 if it doesn't fit or has too many durations
+ */
+static size_t ir_learn_compress(uint8_t *out, size_t size)
+{
+    uint32_t sum[IR_LEARN_MAX_DICT] = {0};
+    uint16_t cnt[IR_LEARN_MAX_DICT] = {0};
+    uint16_t dict[IR_LEARN_MAX_DICT] = {0};
+    rmt_symbol_word_t *symbol = NULL;
+    uint32_t duration = 0;
+    size_t pos = 0, lenpos = 0, start = 0;
+    int ndict = 0, index = 0, run = 0, prev = -1;
+    uint8_t code = 0;
+
+    for (int i = 0; i < gir_learn_nsymbols * 2; i++)
+    {
+        symbol = &gir_learn_capture[i / 2];
+        duration = (i & 1) ? symbol->duration1 : symbol->duration0;
+        index = ir_learn_dict_find(dict, ndict, duration);
+        if ((index < 0) || !ir_learn_match(dict[index], duration))
+        {
+            if (ndict >= IR_LEARN_MAX_DICT)
+            {
+                syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_WARNING,
+                               "IR learn more than %d durations",
+                               IR_LEARN_MAX_DICT);
+                return 0;
+            }
+            index = ndict++;
+        }
+        sum[index] += duration;
+        cnt[index]++;
+        dict[index] = sum[index] / cnt[index];
+    }
+
+    if (size < 2 + ndict * 2)
+    {
+        return 0;
+    }
+    out[pos++] = ndict;
+    out[pos++] = gir_learn_nframes;
+    for (int i = 0; i < ndict; i++)
+    {
+        ir_learn_put16(&out[pos], dict[i]);
+        pos += 2;
+    }
+
+    for (int f = 0; f < gir_learn_nframes; f++)
+    {
+        if (pos + IR_LEARN_FRAME_HEADER > size)
+        {
+            return 0;
+        }
+        ir_learn_put16(&out[pos], gir_learn_frames[f].num);
+        ir_learn_put16(&out[pos + 2],
+                       (gir_learn_frames[f].gap_ms > UINT16_MAX)
+                           ? UINT16_MAX
+                           : gir_learn_frames[f].gap_ms);
+        lenpos = pos + 4;
+        pos += IR_LEARN_FRAME_HEADER;
+        start = pos;
+        run = 0;
+        prev = -1;
+        for (int i = 0; i < gir_learn_frames[f].num; i++)
+        {
+            symbol = &gir_learn_capture[gir_learn_frames[f].offset + i];
+            code = (ir_learn_dict_find(dict, ndict, symbol->duration0) << 4) |
+                   ir_learn_dict_find(dict, ndict, symbol->duration1);
+            if ((code == prev) && (run < IR_LEARN_RUN_MAX))
+            {
+                run++;
+                continue;
+            }
+            if ((run > 0) &&
+                !ir_learn_emit(out, size, &pos, IR_LEARN_RUN_MARK | (run - 1)))
+            {
+                return 0;
+            }
+            run = 0;
+            if (!ir_learn_emit(out, size, &pos, code))
+            {
+                return 0;
+            }
+            prev = code;
+        }
+        if ((run > 0) &&
+            !ir_learn_emit(out, size, &pos, IR_LEARN_RUN_MARK | (run - 1)))
+        {
+            return 0;
+        }
+        ir_learn_put16(&out[lenpos], pos - start);
+    }
+    return pos;
+}
+
+/* Call with gsemaIRLearn taken */
+static void ir_learn_save(void)
+{
+    ir_learn_file_header_t header = {
+        .magic = IR_LEARN_FILE_MAGIC,
+        .version = IR_LEARN_FILE_VERSION,
+        .count = gir_learn_count,
+        .used = gir_learn_used,
+        .size = IR_LEARN_ARENA_SIZE,
+    };
+    FILE *f = fopen(IR_LEARN_FILE, "wb");
+
+    if (f == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Open %s failed, errno=%d (%s)", IR_LEARN_FILE, errno,
+                       strerror(errno));
+        return;
+    }
+    if ((fwrite(&header, sizeof(header), 1, f) != 1) ||
+        (fwrite(gir_learn_dir, sizeof(ir_learn_entry_t), gir_learn_count, f) !=
+         gir_learn_count) ||
+        (fwrite(gir_learn_arena, 1, gir_learn_used, f) != gir_learn_used))
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Write %s failed", IR_LEARN_FILE);
+    }
+    fclose(f);
+}
+
+/* Call with gsemaIRLearn taken */
+static void ir_learn_remove(int index)
+{
+    uint16_t offset = gir_learn_dir[index].offset;
+    uint16_t length = gir_learn_dir[index].length;
+
+    memmove(&gir_learn_arena[offset], &gir_learn_arena[offset + length],
+            gir_learn_used - offset - length);
+    gir_learn_used -= length;
+    for (int i = index; i < gir_learn_count - 1; i++)
+    {
+        gir_learn_dir[i] = gir_learn_dir[i + 1];
+    }
+    gir_learn_count--;
+    gir_learn_generation++;
+    memset(&gir_learn_dir[gir_learn_count], 0, sizeof(ir_learn_entry_t));
+    for (int i = 0; i < gir_learn_count; i++)
+    {
+        if (gir_learn_dir[i].offset > offset)
+        {
+            gir_learn_dir[i].offset -= length;
+        }
+    }
+}
+
+/* Call with gsemaIRLearn taken */
+static void ir_learn_finish(void)
+{
+    ir_learn_entry_t *entry = NULL;
+    size_t length = 0;
+
+    /* Learning the same name again replaces the command */
+    for (int i = 0; i < gir_learn_count; i++)
+    {
+        if (strcmp(gir_learn_dir[i].name, gir_learn_name) == 0)
+        {
+            ir_learn_remove(i);
+            break;
+        }
+    }
+    if (gir_learn_count >= IR_LEARN_MAX_ENTRIES)
+    {
+        ir_learn_fail("table is full");
+        return;
+    }
+
+    length = ir_learn_compress(&gir_learn_arena[gir_learn_used],
+                               IR_LEARN_ARENA_SIZE - gir_learn_used);
+    if (length == 0)
+    {
+        ir_learn_fail("can't store it");
+        return;
+    }
+
+    entry = &gir_learn_dir[gir_learn_count];
+    memset(entry, 0, sizeof(ir_learn_entry_t));
+    strncpy(entry->name, gir_learn_name, IR_LEARN_NAME_LEN - 1);
+    entry->offset = gir_learn_used;
+    entry->length = length;
+    entry->symbols = gir_learn_nsymbols;
+    entry->frames = gir_learn_nframes;
+    gir_learn_count++;
+    gir_learn_generation++;
+    gir_learn_used += length;
+    gir_learn_state = IR_LEARN_STATE_DONE;
+    syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_INFO,
+                   "IR learn %s, %d frames %d symbols in %d bytes",
+                   gir_learn_name, gir_learn_nframes, gir_learn_nsymbols,
+                   (int)length);
+    ir_learn_save();
+}
+
+/* Call with gsemaIRLearn taken */
+static void ir_learn_close_press(void)
+{
+    if (gir_learn_press == 0)
+    {
+        gir_learn_nframes = gir_learn_frame;
+    }
+    else if (gir_learn_frame != gir_learn_nframes)
+    {
+        ir_learn_fail("frames of presses don't match");
+        return;
+    }
+    syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
+                   "IR learn press %d, %d frames", gir_learn_press + 1,
+                   gir_learn_frame);
+    gir_learn_press++;
+    gir_learn_frame = 0;
+    if (gir_learn_press >= IR_LEARN_PRESS_COUNT)
+    {
+        ir_learn_finish();
+    }
+}
+
+/* Call with gsemaIRLearn taken */
+static void ir_learn_add_frame(const rmt_symbol_word_t *symbols, size_t num,
+                               int64_t now)
+{
+    ir_learn_frame_t *frame = NULL;
+    rmt_symbol_word_t *capture = NULL;
+    uint32_t gap = 0, duration = 0;
+
+    if (gir_learn_frame >= IR_LEARN_MAX_FRAMES)
+    {
+        ir_learn_fail("too many frames");
+        return;
+    }
+    frame = &gir_learn_frames[gir_learn_frame];
+
+    /* The RX done events come at the same idle time after each frame, the
+       gap is the time between them minus this frame */
+    if (gir_learn_frame > 0)
+    {
+        for (size_t i = 0; i < num; i++)
+        {
+            duration += symbols[i].duration0 + symbols[i].duration1;
+        }
+        duration /= 1000;
+        gap = (now - gir_learn_last_ms > duration)
+                  ? (now - gir_learn_last_ms - duration)
+                  : 0;
+    }
+
+    if (gir_learn_press == 0)
+    {
+        if (gir_learn_nsymbols + num > IR_LEARN_MAX_SYMBOLS)
+        {
+            ir_learn_fail("too long");
+            return;
+        }
+        frame->offset = gir_learn_nsymbols;
+        frame->num = num;
+        frame->gap_ms = gap;
+        memcpy(&gir_learn_capture[gir_learn_nsymbols], symbols,
+               num * sizeof(rmt_symbol_word_t));
+        gir_learn_nsymbols += num;
+    }
+    else
+    {
+        if ((gir_learn_frame >= gir_learn_nframes) || (frame->num != num))
+        {
+            ir_learn_fail("frames of presses don't match");
+            return;
+        }
+        capture = &gir_learn_capture[frame->offset];
+        for (size_t i = 0; i < num; i++)
+        {
+            if (!ir_learn_match(capture[i].duration0, symbols[i].duration0) ||
+                !ir_learn_match(capture[i].duration1, symbols[i].duration1))
+            {
+                ir_learn_fail("durations of presses don't match");
+                return;
+            }
+            capture[i].duration0 =
+                (capture[i].duration0 * gir_learn_press +
+                 symbols[i].duration0) / (gir_learn_press + 1);
+            capture[i].duration1 =
+                (capture[i].duration1 * gir_learn_press +
+                 symbols[i].duration1) / (gir_learn_press + 1);
+        }
+        frame->gap_ms =
+            (frame->gap_ms * gir_learn_press + gap) / (gir_learn_press + 1);
+    }
+    gir_learn_frame++;
+    gir_learn_last_ms = now;
+}
+
+void ir_learn_init(void)
+{
+    ir_learn_file_header_t header = {};
+    FILE *f = NULL;
+    bool valid = false;
+
+    if (gsemaIRLearn == NULL)
+    {
+        gsemaIRLearn = xSemaphoreCreateBinary();
+        if (gsemaIRLearn == NULL)
+        {
+            return;
+        }
+        xSemaphoreGive(gsemaIRLearn);
+    }
+
+    if (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) == pdTRUE)
+    {
+        gir_learn_count = 0;
+        gir_learn_used = 0;
+        f = fopen(IR_LEARN_FILE, "rb");
+        if (f != NULL)
+        {
+            valid = (fread(&header, sizeof(header), 1, f) == 1) &&
+                    (header.magic == IR_LEARN_FILE_MAGIC) &&
+                    (header.version == IR_LEARN_FILE_VERSION) &&
+                    (header.count <= IR_LEARN_MAX_ENTRIES) &&
+                    (header.used <= IR_LEARN_ARENA_SIZE) &&
+                    (fread(gir_learn_dir, sizeof(ir_learn_entry_t),
+                           header.count, f) == header.count) &&
+                    (fread(gir_learn_arena, 1, header.used, f) == header.used);
+            for (int i = 0; valid && (i < header.count); i++)
+            {
+                valid = (gir_learn_dir[i].offset + gir_learn_dir[i].length <=
+                         header.used);
+            }
+            fclose(f);
+            if (valid)
+            {
+                gir_learn_count = header.count;
+                gir_learn_used = header.used;
+            }
+            else
+            {
+                memset(gir_learn_dir, 0, sizeof(gir_learn_dir));
+                syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                               "Invalid %s, drop learned IR", IR_LEARN_FILE);
+            }
+        }
+        gir_learn_generation++;
+        xSemaphoreGive(gsemaIRLearn);
+    }
+    syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_INFO,
+                   "Load %d learned IR, %d/%d bytes", gir_learn_count,
+                   gir_learn_used, IR_LEARN_ARENA_SIZE);
+}
+
+int ir_learn_start(const char *name)
+{
+    size_t len = 0;
+
+    if (gsemaIRLearn == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (ir learn %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (name == NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    /* The name goes to JSON and the file as is */
+    len = strlen(name);
+    if ((len == 0) || (len >= IR_LEARN_NAME_LEN))
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!isalnum((unsigned char)name[i]) && (name[i] != '-') &&
+            (name[i] != '_') && (name[i] != ' '))
+        {
+            return SYSTEM_ERROR_INVALID_PARAMETER;
+        }
+    }
+
+    if (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) == pdTRUE)
+    {
+        memset(gir_learn_name, 0, sizeof(gir_learn_name));
+        memcpy(gir_learn_name, name, len);
+        gir_learn_press = 0;
+        gir_learn_frame = 0;
+        gir_learn_nframes = 0;
+        gir_learn_nsymbols = 0;
+        gir_learn_start_ms = esp_timer_get_time() / 1000;
+        gir_learn_last_ms = gir_learn_start_ms;
+        gir_learn_state = IR_LEARN_STATE_WAITING;
+        xSemaphoreGive(gsemaIRLearn);
+    }
+    syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_INFO,
+                   "IR learn %s, press the key %d times", name,
+                   IR_LEARN_PRESS_COUNT);
+    return SYSTEM_ERROR_NONE;
+}
+
+int ir_learn_stop(void)
+{
+    if (gsemaIRLearn == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (ir learn %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) == pdTRUE)
+    {
+        if (gir_learn_state == IR_LEARN_STATE_WAITING)
+        {
+            gir_learn_state = IR_LEARN_STATE_IDLE;
+        }
+        xSemaphoreGive(gsemaIRLearn);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+bool ir_learn_isactive(void)
+{
+    bool active = false;
+
+    if ((gsemaIRLearn != NULL) &&
+        (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) == pdTRUE))
+    {
+        active = (gir_learn_state == IR_LEARN_STATE_WAITING);
+        xSemaphoreGive(gsemaIRLearn);
+    }
+    return active;
+}
+
+void ir_learn_feed(const rmt_symbol_word_t *symbols, size_t num_symbols)
+{
+    int64_t now = esp_timer_get_time() / 1000;
+
+    if ((gsemaIRLearn == NULL) || (symbols == NULL) ||
+        (num_symbols < IR_LEARN_MIN_SYMBOLS))
+    {
+        return;
+    }
+    if (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) == pdTRUE)
+    {
+        if (gir_learn_state == IR_LEARN_STATE_WAITING)
+        {
+            if ((gir_learn_frame > 0) &&
+                (now - gir_learn_last_ms > IR_LEARN_FRAME_GAP_MS))
+            {
+                ir_learn_close_press();
+            }
+            if (gir_learn_state == IR_LEARN_STATE_WAITING)
+            {
+                ir_learn_add_frame(symbols, num_symbols, now);
+            }
+        }
+        xSemaphoreGive(gsemaIRLearn);
+    }
+}
+
+void ir_learn_poll(void)
+{
+    int64_t now = esp_timer_get_time() / 1000;
+
+    if (gsemaIRLearn == NULL)
+    {
+        return;
+    }
+    if (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) == pdTRUE)
+    {
+        if (gir_learn_state == IR_LEARN_STATE_WAITING)
+        {
+            if ((gir_learn_frame > 0) &&
+                (now - gir_learn_last_ms > IR_LEARN_FRAME_GAP_MS))
+            {
+                ir_learn_close_press();
+            }
+            else if (now - gir_learn_start_ms > IR_LEARN_TIMEOUT_MS)
+            {
+                ir_learn_fail("timeout");
+            }
+        }
+        xSemaphoreGive(gsemaIRLearn);
+    }
+}
+
+int ir_learn_getstatus(int *state, int *presses)
+{
+    if (gsemaIRLearn == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (ir learn %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if ((state == NULL) || (presses == NULL))
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) == pdTRUE)
+    {
+        *state = gir_learn_state;
+        *presses = gir_learn_press;
+        xSemaphoreGive(gsemaIRLearn);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+int ir_learn_getusage(int *count, int *used)
+{
+    if (gsemaIRLearn == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (ir learn %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if ((count == NULL) || (used == NULL))
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) == pdTRUE)
+    {
+        *count = gir_learn_count;
+        *used = gir_learn_used;
+        xSemaphoreGive(gsemaIRLearn);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+int ir_learn_getentry(int index, ir_learn_entry_t *entry)
+{
+    int ret = SYSTEM_ERROR_NONE;
+
+    if (gsemaIRLearn == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (ir learn %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (entry == NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) == pdTRUE)
+    {
+        if ((index >= 0) && (index < gir_learn_count))
+        {
+            memcpy(entry, &gir_learn_dir[index], sizeof(ir_learn_entry_t));
+        }
+        else
+        {
+            ret = SYSTEM_ERROR_INVALID_PARAMETER;
+        }
+        xSemaphoreGive(gsemaIRLearn);
+    }
+    return ret;
+}
+
+int ir_learn_find(const char *name)
+{
+    int index = -1;
+
+    if ((gsemaIRLearn == NULL) || (name == NULL))
+    {
+        return -1;
+    }
+    if (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) == pdTRUE)
+    {
+        for (int i = 0; i < gir_learn_count; i++)
+        {
+            if (strncmp(gir_learn_dir[i].name, name, IR_LEARN_NAME_LEN) == 0)
+            {
+                index = i;
+                break;
+            }
+        }
+        xSemaphoreGive(gsemaIRLearn);
+    }
+    return index;
+}
+
+uint32_t ir_learn_generation(void)
+{
+    uint32_t generation = 0;
+
+    if ((gsemaIRLearn != NULL) &&
+        (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) == pdTRUE))
+    {
+        generation = gir_learn_generation;
+        xSemaphoreGive(gsemaIRLearn);
+    }
+    return generation;
+}
+
+int ir_learn_delete(int index)
+{
+    int ret = SYSTEM_ERROR_NONE;
+
+    if (gsemaIRLearn == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (ir learn %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) == pdTRUE)
+    {
+        if ((index >= 0) && (index < gir_learn_count))
+        {
+            syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_INFO,
+                           "Delete learned IR %s", gir_learn_dir[index].name);
+            ir_learn_remove(index);
+            ir_learn_save();
+        }
+        else
+        {
+            ret = SYSTEM_ERROR_INVALID_PARAMETER;
+        }
+        xSemaphoreGive(gsemaIRLearn);
+    }
+    return ret;
+}
+
+size_t ir_learn_get_frame(int index, int frame, rmt_symbol_word_t *symbols,
+                          size_t max_symbols, uint32_t *gap_ms)
+{
+    const uint8_t *blob = NULL;
+    const uint8_t *dict = NULL;
+    size_t num = 0, pos = 0, length = 0, end = 0;
+    uint16_t nsym = 0, nbytes = 0;
+    int ndict = 0, repeat = 0;
+    uint8_t code = 0;
+
+    if ((gsemaIRLearn == NULL) || (symbols == NULL) || (gap_ms == NULL))
+    {
+        return 0;
+    }
+    if (xSemaphoreTake(gsemaIRLearn, portMAX_DELAY) != pdTRUE)
+    {
+        return 0;
+    }
+    if ((index < 0) || (index >= gir_learn_count) || (frame < 0) ||
+        (frame >= gir_learn_dir[index].frames))
+    {
+        xSemaphoreGive(gsemaIRLearn);
+        return 0;
+    }
+
+    blob = &gir_learn_arena[gir_learn_dir[index].offset];
+    length = gir_learn_dir[index].length;
+    ndict = blob[0];
+    dict = &blob[2];
+    pos = 2 + ndict * 2;
+    for (int f = 0; (f <= frame) && (pos + IR_LEARN_FRAME_HEADER <= length);
+         f++)
+    {
+        nsym = ir_learn_get16(&blob[pos]);
+        *gap_ms = ir_learn_get16(&blob[pos + 2]);
+        nbytes = ir_learn_get16(&blob[pos + 4]);
+        pos += IR_LEARN_FRAME_HEADER;
+        if (f < frame)
+        {
+            pos += nbytes;
+            continue;
+        }
+
+        end = (pos + nbytes <= length) ? (pos + nbytes) : length;
+        for (; (pos < end) && (num <= max_symbols); pos++)
+        {
+            if ((blob[pos] & IR_LEARN_RUN_MARK) == IR_LEARN_RUN_MARK)
+            {
+                repeat = (blob[pos] & 0x0F) + 1;
+            }
+            else
+            {
+                code = blob[pos];
+                repeat = 1;
+            }
+            if (((code >> 4) >= ndict) || ((code & 0x0F) >= ndict) ||
+                (num + repeat > max_symbols))
+            {
+                num = 0;
+                break;
+            }
+            for (; repeat > 0; repeat--, num++)
+            {
+                symbols[num].level0 = 1;
+                symbols[num].duration0 = ir_learn_get16(&dict[(code >> 4) * 2]);
+                symbols[num].level1 = 0;
+                symbols[num].duration1 =
+                    ir_learn_get16(&dict[(code & 0x0F) * 2]);
+            }
+        }
+        if (num != nsym)
+        {
+            syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                           "Learned IR %s frame %d is broken",
+                           gir_learn_dir[index].name, frame);
+            num = 0;
+        }
+    }
+    xSemaphoreGive(gsemaIRLearn);
+    return num;
+}
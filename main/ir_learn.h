@@ -0,0 +1,115 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/rmt_encoder.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef CONFIG_IR_LEARN_ARENA_SIZE
+#define IR_LEARN_ARENA_SIZE         CONFIG_IR_LEARN_ARENA_SIZE
+#else
+#define IR_LEARN_ARENA_SIZE         4096
+#endif
+#define IR_LEARN_MAX_ENTRIES        16      /* uint16_t replay mask in rmt_msg_t */
+#define IR_LEARN_NAME_LEN           16
+#define IR_LEARN_MAX_FRAMES         4
+#define IR_LEARN_MAX_SYMBOLS        512     /* All frames of one key press */
+#define IR_LEARN_MIN_SYMBOLS        4       /* Shorter frames are noise */
+#define IR_LEARN_PRESS_COUNT        2       /* Presses to match before saving */
+#define IR_LEARN_FRAME_GAP_MS       500     /* Closer frames are the same press */
+#define IR_LEARN_TIMEOUT_MS         20000
+#define IR_LEARN_MARGIN_US          100     /* Or 1/8 of the duration if larger */
+#define IR_LEARN_MAX_DICT           15      /* Nibble 0xF marks a run */
+#ifndef IR_LEARN_FILE
+#define IR_LEARN_FILE               "/spiffs/irlearn.bin"
+#endif
+
+#define IR_LEARN_STATE_IDLE         0
+#define IR_LEARN_STATE_WAITING      1
+#define IR_LEARN_STATE_DONE         2
+#define IR_LEARN_STATE_FAIL         3
+
+/**
+ * @brief Directory entry of a learned command
+ *
+ * The command itself is a blob at offset in the arena: the duration
+ * dictionary, then per frame the symbol count, the gap before it and the
+ * coded symbols. Each symbol is one byte of two dictionary indexes, a byte
+ * 0xFn repeats the previous symbol n+1 more times.
+ */
+typedef struct
+{
+    char name[IR_LEARN_NAME_LEN];
+    uint16_t offset;
+    uint16_t length;
+    uint16_t symbols;   /* All frames */
+    uint8_t frames;
+    uint8_t reserved;
+} ir_learn_entry_t;
+
+/**
+ * @brief Load learned commands from SPIFFS, called by task_rmt
+ */
+void ir_learn_init(void);
+
+/**
+ * @brief Start learning a command, task_rmt hands the next received frames
+ *        to ir_learn_feed() until it's done, failed or stopped
+ *
+ * @param[in] name Letters, digits, ' ', '-' and '_' only
+ */
+int ir_learn_start(const char *name);
+int ir_learn_stop(void);
+bool ir_learn_isactive(void);
+
+/**
+ * @brief Take one received frame, only task_rmt calls it
+ */
+void ir_learn_feed(const rmt_symbol_word_t *symbols, size_t num_symbols);
+
+/**
+ * @brief Close the last key press once no frame follows, and time out the
+ *        session, task_rmt calls it every loop
+ */
+void ir_learn_poll(void);
+
+int ir_learn_getstatus(int *state, int *presses);
+int ir_learn_getusage(int *count, int *used);
+int ir_learn_getentry(int index, ir_learn_entry_t *entry);
+
+/**
+ * @brief Find a learned command by name
+ *
+ * @return Index of the command, -1 if nothing was learned under that name
+ */
+int ir_learn_find(const char *name);
+
+/**
+ * @brief Count of changes to the learned commands, to know when a copy
+ *        taken from them is stale. 0 until they are loaded.
+ */
+uint32_t ir_learn_generation(void);
+int ir_learn_delete(int index);
+
+/**
+ * @brief Expand one frame of a learned command into TX symbols
+ *
+ * @param[out] gap_ms Silence to keep before the frame
+ * @return Number of symbols written, 0 if there isn't such frame or
+ *         max_symbols is too small
+ */
+size_t ir_learn_get_frame(int index, int frame, rmt_symbol_word_t *symbols,
+                          size_t max_symbols, uint32_t *gap_ms);
+
+#ifdef __cplusplus
+}
+#endif
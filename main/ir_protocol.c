@@ -0,0 +1,454 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "ir_protocol.h"
+#include "rmt.h"
+
+/* Protocol table, a new appliance only needs a new entry here */
+static const ir_protocol_t gir_protocols[] = {
+    {
+        .type = IR_TYPE_HITACHI,
+        .name = "Hitachi",
+        .leading = {HTA_LEADING_CODE_DURATION_0, HTA_LEADING_CODE_DURATION_1},
+        .zero = {HTA_PAYLOAD_ZERO_DURATION_0, HTA_PAYLOAD_ZERO_DURATION_1},
+        .one = {HTA_PAYLOAD_ONE_DURATION_0, HTA_PAYLOAD_ONE_DURATION_1},
+        .repeat = {0, 0},
+        .ending = {HTA_END_CODE_DURATION_0, HTA_END_CODE_DURATION_1},
+        .margin = IR_HTA_DECODE_MARGIN,
+        .msb_first = false,
+        .data_len = 44,
+        .time_len = 0,
+        .checksum = IR_PROTOCOL_CHECKSUM_INV_PAIRS,
+        .checksum_offset = 3,
+        .nelem = 3,
+        .elem = {IR_PROTOCOL_ELEM_LEADING, IR_PROTOCOL_ELEM_DATA,
+                 IR_PROTOCOL_ELEM_ENDING},
+    },
+    {
+        .type = IR_TYPE_ZERO,
+        .name = "+-0",
+        .leading = {ZERO_LEADING_CODE_DURATION_0, ZERO_LEADING_CODE_DURATION_1},
+        .zero = {ZERO_PAYLOAD_ZERO_DURATION_0, ZERO_PAYLOAD_ZERO_DURATION_1},
+        .one = {ZERO_PAYLOAD_ONE_DURATION_0, ZERO_PAYLOAD_ONE_DURATION_1},
+        .repeat = {ZERO_REPEAT_CODE_DURATION_0, ZERO_REPEAT_CODE_DURATION_1},
+        .ending = {ZERO_END_CODE_DURATION_0, ZERO_END_CODE_DURATION_1},
+        .margin = IR_ZERO_DECODE_MARGIN,
+        .msb_first = false,
+        .data_len = 2,
+        .time_len = 0,
+        .checksum = IR_PROTOCOL_CHECKSUM_NONE,
+        /* The code is sent twice */
+        .nelem = 6,
+        .elem = {IR_PROTOCOL_ELEM_LEADING, IR_PROTOCOL_ELEM_DATA,
+                 IR_PROTOCOL_ELEM_REPEAT, IR_PROTOCOL_ELEM_LEADING,
+                 IR_PROTOCOL_ELEM_DATA, IR_PROTOCOL_ELEM_ENDING},
+    },
+    {
+        .type = IR_TYPE_DELTA,
+        .name = "Delta",
+        .leading = {DELTA_LEADING_CODE_DURATION_0,
+                    DELTA_LEADING_CODE_DURATION_1},
+        .zero = {DELTA_PAYLOAD_ZERO_DURATION_0, DELTA_PAYLOAD_ZERO_DURATION_1},
+        .one = {DELTA_PAYLOAD_ONE_DURATION_0, DELTA_PAYLOAD_ONE_DURATION_1},
+        .repeat = {DELTA_REPEAT_CODE_DURATION_0, DELTA_REPEAT_CODE_DURATION_1},
+        .ending = {DELTA_END_CODE_DURATION_0, DELTA_END_CODE_DURATION_1},
+        .margin = IR_DELTA_DECODE_MARGIN,
+        .msb_first = false,
+        .data_len = 4,
+        .time_len = 4,
+        .checksum = IR_PROTOCOL_CHECKSUM_INV_PAIRS,
+        .checksum_offset = 2,
+        /* Mode code, middle gap, then the timer code */
+        .nelem = 6,
+        .elem = {IR_PROTOCOL_ELEM_LEADING, IR_PROTOCOL_ELEM_DATA,
+                 IR_PROTOCOL_ELEM_REPEAT, IR_PROTOCOL_ELEM_LEADING,
+                 IR_PROTOCOL_ELEM_TIME, IR_PROTOCOL_ELEM_ENDING},
+    },
+    {
+        .type = IR_TYPE_DYSON,
+        .name = "Dyson",
+        .leading = {DYSON_LEADING_CODE_DURATION_0,
+                    DYSON_LEADING_CODE_DURATION_1},
+        .zero = {DYSON_PAYLOAD_ZERO_DURATION_0, DYSON_PAYLOAD_ZERO_DURATION_1},
+        .one = {DYSON_PAYLOAD_ONE_DURATION_0, DYSON_PAYLOAD_ONE_DURATION_1},
+        .repeat = {0, 0},
+        .ending = {DYSON_END_CODE_DURATION_0, DYSON_END_CODE_DURATION_1},
+        .margin = IR_DYSON_DECODE_MARGIN,
+        .msb_first = false,
+        .data_len = 3,
+        .time_len = 0,
+        .checksum = IR_PROTOCOL_CHECKSUM_NONE,
+        .nelem = 3,
+        .elem = {IR_PROTOCOL_ELEM_LEADING, IR_PROTOCOL_ELEM_DATA,
+                 IR_PROTOCOL_ELEM_ENDING},
+    },
+};
+
+#define IR_PROTOCOL_NUM (sizeof(gir_protocols) / sizeof(gir_protocols[0]))
+
+_Static_assert(IR_PROTOCOL_NUM < IR_TYPE_MAX, "IR protocol table too large");
+
+const ir_protocol_t *ir_protocol_get(char type)
+{
+    for (int i = 0; i < IR_PROTOCOL_NUM; i++)
+    {
+        if (gir_protocols[i].type == type)
+        {
+            return &gir_protocols[i];
+        }
+    }
+    return NULL;
+}
+
+const ir_protocol_t *ir_protocol_get_by_index(int index)
+{
+    if ((index < 0) || (index >= IR_PROTOCOL_NUM))
+    {
+        return NULL;
+    }
+    return &gir_protocols[index];
+}
+
+int ir_protocol_num(void)
+{
+    return IR_PROTOCOL_NUM;
+}
+
+size_t ir_protocol_frame_symbols(const ir_protocol_t *proto)
+{
+    size_t num = 0;
+    for (int i = 0; i < proto->nelem; i++)
+    {
+        switch (proto->elem[i])
+        {
+            case IR_PROTOCOL_ELEM_DATA:
+                num += proto->data_len * 8;
+                break;
+            case IR_PROTOCOL_ELEM_TIME:
+                num += proto->time_len * 8;
+                break;
+            default:
+                num++;
+                break;
+        }
+    }
+    return num;
+}
+
+size_t ir_protocol_pack(const ir_protocol_t *proto, const uint8_t *data,
+                        const uint8_t *time, uint8_t *payload)
+{
+    memcpy(payload, data, proto->data_len);
+    if (proto->time_len && time)
+    {
+        memcpy(payload + proto->data_len, time, proto->time_len);
+    }
+    return proto->data_len + proto->time_len;
+}
+
+bool ir_protocol_verify_checksum(const ir_protocol_t *proto,
+                                 const uint8_t *bytes, size_t length)
+{
+    if (proto->checksum != IR_PROTOCOL_CHECKSUM_INV_PAIRS)
+    {
+        return true;
+    }
+    for (size_t i = proto->checksum_offset; i + 1 < length; i += 2)
+    {
+        if ((uint8_t)~bytes[i] != bytes[i + 1])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline rmt_symbol_word_t ir_protocol_symbol(ir_protocol_pulse_t pulse,
+                                                   uint32_t resolution)
+{
+    return (rmt_symbol_word_t){
+        .level0 = 1,
+        .duration0 = (uint64_t)pulse.duration0 * resolution / 1000000,
+        .level1 = 0,
+        .duration1 = (uint64_t)pulse.duration1 * resolution / 1000000,
+    };
+}
+
+static size_t ir_protocol_fill_bytes(const ir_protocol_t *proto,
+                                     const uint8_t *bytes, size_t length,
+                                     rmt_symbol_word_t bit0,
+                                     rmt_symbol_word_t bit1,
+                                     rmt_symbol_word_t *symbols)
+{
+    size_t num = 0;
+    uint8_t byte = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        byte = bytes[i];
+        if ((proto->checksum == IR_PROTOCOL_CHECKSUM_INV_PAIRS) &&
+            (i > proto->checksum_offset) &&
+            ((i - proto->checksum_offset) % 2 == 1))
+        {
+            byte = ~bytes[i - 1];
+        }
+        for (int bit = 0; bit < 8; bit++)
+        {
+            uint8_t mask = proto->msb_first ? (0x80 >> bit) : (1 << bit);
+            symbols[num++] = (byte & mask) ? bit1 : bit0;
+        }
+    }
+    return num;
+}
+
+size_t ir_protocol_fill_symbols(const ir_protocol_t *proto,
+                                uint32_t resolution, const uint8_t *payload,
+                                size_t length, rmt_symbol_word_t *symbols,
+                                size_t max_symbols)
+{
+    size_t num = 0;
+    rmt_symbol_word_t bit0, bit1;
+
+    if ((proto == NULL) ||
+        (length < (size_t)(proto->data_len + proto->time_len)) ||
+        (max_symbols < ir_protocol_frame_symbols(proto)))
+    {
+        return 0;
+    }
+    bit0 = ir_protocol_symbol(proto->zero, resolution);
+    bit1 = ir_protocol_symbol(proto->one, resolution);
+
+    for (int i = 0; i < proto->nelem; i++)
+    {
+        switch (proto->elem[i])
+        {
+            case IR_PROTOCOL_ELEM_LEADING:
+                symbols[num++] = ir_protocol_symbol(proto->leading, resolution);
+                break;
+            case IR_PROTOCOL_ELEM_DATA:
+                num += ir_protocol_fill_bytes(proto, payload, proto->data_len,
+                                              bit0, bit1, &symbols[num]);
+                break;
+            case IR_PROTOCOL_ELEM_TIME:
+                num += ir_protocol_fill_bytes(proto, payload + proto->data_len,
+                                              proto->time_len, bit0, bit1,
+                                              &symbols[num]);
+                break;
+            case IR_PROTOCOL_ELEM_REPEAT:
+                symbols[num++] = ir_protocol_symbol(proto->repeat, resolution);
+                break;
+            case IR_PROTOCOL_ELEM_ENDING:
+                symbols[num++] = ir_protocol_symbol(proto->ending, resolution);
+                break;
+            default:
+                break;
+        }
+    }
+    return num;
+}
+
+/* Decode tolerance windows, precomputed from the table */
+typedef struct
+{
+    uint16_t min0;
+    uint16_t max0;
+    uint16_t min1;
+    uint16_t max1;
+} ir_protocol_window_t;
+
+typedef struct
+{
+    ir_protocol_window_t leading;
+    ir_protocol_window_t zero;
+    ir_protocol_window_t one;
+    ir_protocol_window_t repeat;
+    ir_protocol_window_t ending;
+} ir_protocol_windows_t;
+
+static ir_protocol_windows_t gir_protocol_windows[IR_PROTOCOL_NUM];
+/* Bit n set if the leading mark of gir_protocols[n] can fall in the bucket */
+static uint8_t gir_protocol_lookup[IR_PROTOCOL_LOOKUP_SIZE];
+static bool gir_protocol_ready = false;
+
+_Static_assert(IR_PROTOCOL_NUM <= 8, "IR protocol lookup is a uint8_t mask");
+
+static ir_protocol_window_t ir_protocol_window(ir_protocol_pulse_t pulse,
+                                               uint16_t margin)
+{
+    ir_protocol_window_t window = {
+        .min0 = (pulse.duration0 > margin) ? (pulse.duration0 - margin) : 0,
+        .max0 = pulse.duration0 + margin,
+        .min1 = (pulse.duration1 > margin) ? (pulse.duration1 - margin) : 0,
+        .max1 = pulse.duration1 + margin,
+    };
+    return window;
+}
+
+void ir_protocol_init(void)
+{
+    const ir_protocol_t *proto = NULL;
+    ir_protocol_windows_t *windows = NULL;
+    int first = 0, last = 0;
+
+    if (gir_protocol_ready)
+    {
+        return;
+    }
+    memset(gir_protocol_lookup, 0, sizeof(gir_protocol_lookup));
+    for (int i = 0; i < IR_PROTOCOL_NUM; i++)
+    {
+        proto = &gir_protocols[i];
+        windows = &gir_protocol_windows[i];
+        windows->leading = ir_protocol_window(proto->leading, proto->margin);
+        windows->zero = ir_protocol_window(proto->zero, proto->margin);
+        windows->one = ir_protocol_window(proto->one, proto->margin);
+        windows->repeat = ir_protocol_window(proto->repeat, proto->margin);
+        windows->ending = ir_protocol_window(proto->ending, proto->margin);
+
+        first = windows->leading.min0 >> IR_PROTOCOL_LOOKUP_SHIFT;
+        last = windows->leading.max0 >> IR_PROTOCOL_LOOKUP_SHIFT;
+        for (int j = first; (j <= last) && (j < IR_PROTOCOL_LOOKUP_SIZE); j++)
+        {
+            gir_protocol_lookup[j] |= 1 << i;
+        }
+    }
+    gir_protocol_ready = true;
+}
+
+static inline bool ir_protocol_in_window(const rmt_symbol_word_t *symbol,
+                                         const ir_protocol_window_t *window)
+{
+    return (symbol->duration0 > window->min0) &&
+           (symbol->duration0 < window->max0) &&
+           (symbol->duration1 > window->min1) &&
+           (symbol->duration1 < window->max1);
+}
+
+static int ir_protocol_classify_index(const rmt_symbol_word_t *symbol)
+{
+    uint32_t bucket = symbol->duration0 >> IR_PROTOCOL_LOOKUP_SHIFT;
+    uint8_t candidates = 0;
+
+    if (!gir_protocol_ready || (bucket >= IR_PROTOCOL_LOOKUP_SIZE))
+    {
+        return -1;
+    }
+    candidates = gir_protocol_lookup[bucket];
+    for (int i = 0; candidates; i++, candidates >>= 1)
+    {
+        if ((candidates & 1) &&
+            ir_protocol_in_window(symbol, &gir_protocol_windows[i].leading))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const ir_protocol_t *ir_protocol_classify(const rmt_symbol_word_t *symbol)
+{
+    int index = ir_protocol_classify_index(symbol);
+    return (index < 0) ? NULL : &gir_protocols[index];
+}
+
+bool ir_protocol_parse(const rmt_symbol_word_t *symbols, size_t num_symbols,
+                       ir_protocol_result_t *result)
+{
+    const ir_protocol_t *proto = NULL;
+    const ir_protocol_windows_t *windows = NULL;
+    const rmt_symbol_word_t *cur = NULL;
+    const rmt_symbol_word_t *end = symbols + num_symbols;
+    uint8_t *field = NULL;
+    size_t field_bits = 0;
+    size_t loc = 0;
+    uint8_t byte = 0;
+    int index = 0;
+    bool in_time = false;
+    bool ended = false;
+
+    if ((symbols == NULL) || (result == NULL) || (num_symbols < 2))
+    {
+        return false;
+    }
+    index = ir_protocol_classify_index(symbols);
+    if (index < 0)
+    {
+        return false;
+    }
+    proto = &gir_protocols[index];
+    windows = &gir_protocol_windows[index];
+    result->type = proto->type;
+    result->repeat = 0;
+    field = result->data;
+    field_bits = proto->data_len * 8;
+
+    for (cur = symbols + 1; cur < end; cur++)
+    {
+        /* One bit per symbol, bytes are stored once they are complete */
+        if (ir_protocol_in_window(cur, &windows->one) ||
+            ir_protocol_in_window(cur, &windows->zero))
+        {
+            if (loc >= field_bits)
+            {
+                /* Longer than the spec */
+                return false;
+            }
+            if (ir_protocol_in_window(cur, &windows->one))
+            {
+                byte |= proto->msb_first ? (0x80 >> (loc % 8))
+                                         : (1 << (loc % 8));
+            }
+            loc++;
+            if (loc % 8 == 0)
+            {
+                field[loc / 8 - 1] = byte;
+                byte = 0;
+            }
+        }
+        else if (proto->repeat.duration0 &&
+                 ir_protocol_in_window(cur, &windows->repeat))
+        {
+            /* Every field is sent in full before the next code */
+            if (loc != field_bits)
+            {
+                return false;
+            }
+            result->repeat++;
+            if (proto->time_len && !in_time)
+            {
+                in_time = true;
+                field = result->time;
+                field_bits = proto->time_len * 8;
+            }
+            loc = 0;
+            byte = 0;
+            /* Skip the leading code after the repeat code */
+            cur++;
+        }
+        else if ((cur->duration0 > windows->ending.min0) &&
+                 (cur->duration0 < windows->ending.max0))
+        {
+            ended = true;
+            break;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    /* A frame cut short is dropped, the bytes it didn't carry are unknown
+       and a checksum can't tell, most protocols have none */
+    if (!ended || (loc != field_bits) || (proto->time_len && !in_time))
+    {
+        return false;
+    }
+    result->data_len = proto->data_len;
+    result->time_len = proto->time_len;
+
+    return ir_protocol_verify_checksum(proto, result->data, proto->data_len) &&
+           ir_protocol_verify_checksum(proto, result->time, proto->time_len);
+}
@@ -0,0 +1,124 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/rmt_encoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frame elements, a protocol frame is a short list of them */
+#define IR_PROTOCOL_ELEM_LEADING        0
+#define IR_PROTOCOL_ELEM_DATA           1   /* data_len bytes of data[] */
+#define IR_PROTOCOL_ELEM_TIME           2   /* time_len bytes of time[] */
+#define IR_PROTOCOL_ELEM_REPEAT         3   /* repeat or middle gap code */
+#define IR_PROTOCOL_ELEM_ENDING         4
+#define IR_PROTOCOL_MAX_ELEM            8
+
+/* Checksum rules */
+#define IR_PROTOCOL_CHECKSUM_NONE       0
+#define IR_PROTOCOL_CHECKSUM_INV_PAIRS  1   /* From checksum_offset, every
+                                               second byte is ~previous */
+
+#define IR_PROTOCOL_MAX_PAYLOAD         44
+#define IR_PROTOCOL_MAX_TIME            4
+
+/* Leading mark lookup, 256us buckets up to 16ms */
+#define IR_PROTOCOL_LOOKUP_SHIFT        8
+#define IR_PROTOCOL_LOOKUP_SIZE         64
+
+/**
+ * @brief One RMT symbol of the spec, mark then space in us
+ */
+typedef struct {
+    uint16_t duration0;
+    uint16_t duration1;
+} ir_protocol_pulse_t;
+
+/**
+ * @brief IR protocol descriptor, everything the encoder and decoder need
+ */
+typedef struct {
+    char type;                      /* IR_TYPE_XXX */
+    const char *name;
+    ir_protocol_pulse_t leading;
+    ir_protocol_pulse_t zero;
+    ir_protocol_pulse_t one;
+    ir_protocol_pulse_t repeat;     /* duration0 = 0 if not used */
+    ir_protocol_pulse_t ending;
+    uint16_t margin;                /* Decode tolerance in us */
+    bool msb_first;
+    uint8_t data_len;
+    uint8_t time_len;
+    uint8_t checksum;
+    uint8_t checksum_offset;
+    uint8_t nelem;
+    uint8_t elem[IR_PROTOCOL_MAX_ELEM];
+} ir_protocol_t;
+
+/**
+ * @brief Decoded frame, filled by ir_protocol_parse()
+ */
+typedef struct {
+    char type;                      /* IR_TYPE_XXX */
+    int repeat;                     /* Number of repeat codes seen */
+    uint8_t data_len;
+    uint8_t time_len;
+    uint8_t data[IR_PROTOCOL_MAX_PAYLOAD];
+    uint8_t time[IR_PROTOCOL_MAX_TIME];
+} ir_protocol_result_t;
+
+/**
+ * @brief Precompute decode windows and the leading code lookup, call it
+ *        before classify/parse
+ */
+void ir_protocol_init(void);
+
+const ir_protocol_t *ir_protocol_get(char type);
+const ir_protocol_t *ir_protocol_get_by_index(int index);
+int ir_protocol_num(void);
+size_t ir_protocol_frame_symbols(const ir_protocol_t *proto);
+size_t ir_protocol_pack(const ir_protocol_t *proto, const uint8_t *data,
+                        const uint8_t *time, uint8_t *payload);
+bool ir_protocol_verify_checksum(const ir_protocol_t *proto,
+                                 const uint8_t *bytes, size_t length);
+
+/**
+ * @brief Fill RMT symbols of a whole frame
+ *
+ * @param[in] payload data_len bytes followed by time_len bytes, see
+ *                    ir_protocol_pack()
+ * @return Number of symbols written, 0 if max_symbols is too small
+ */
+size_t ir_protocol_fill_symbols(const ir_protocol_t *proto,
+                                uint32_t resolution, const uint8_t *payload,
+                                size_t length, rmt_symbol_word_t *symbols,
+                                size_t max_symbols);
+
+/**
+ * @brief Match the leading code of a received frame
+ *
+ * @return Protocol of the frame, NULL if unknown
+ */
+const ir_protocol_t *ir_protocol_classify(const rmt_symbol_word_t *symbol);
+
+/**
+ * @brief Classify and decode a received frame in one pass
+ *
+ * @param[in] symbols Whole frame, leading code first
+ * @param[out] result Only valid if true is returned
+ * @return true if the frame is known, complete up to its ending code and
+ *         the checksum matches
+ */
+bool ir_protocol_parse(const rmt_symbol_word_t *symbols, size_t num_symbols,
+                       ir_protocol_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,281 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "ir_stats.h"
+#include "system.h"
+#include "syslog.h"
+
+_Static_assert(IR_STATS_MAX_ATTEMPTS >= RMT_RETRY_TIMES,
+               "IR stats attempt histogram too small");
+_Static_assert(IR_STATS_MAX_CHECKS >= RMT_CHECK_TIMES,
+               "IR stats check histogram too small");
+
+static const uint16_t gir_stats_confirm_bound[IR_STATS_CONFIRM_BUCKETS - 1] =
+    {250, 500, 1000, 2000, 4000};
+static const int8_t gir_stats_snr_bound[IR_STATS_SNR_BUCKETS - 1] =
+    {0, 3, 6, 10, 20};
+
+static ir_stats_t gir_stats[IR_TYPE_MAX];
+static ir_stats_record_t gir_stats_ring[IR_STATS_RING_SIZE];
+static int gir_stats_head = 0;      /* Next record to write */
+static int gir_stats_num = 0;
+static bool gir_stats_dirty = false;
+static int64_t gir_stats_saved_us = 0;
+static SemaphoreHandle_t gsemaIRStats = NULL;
+
+static int ir_stats_bucket_u16(const uint16_t *bound, int nbound,
+                               uint32_t value)
+{
+    int i = 0;
+
+    while ((i < nbound) && (value >= bound[i]))
+    {
+        i++;
+    }
+    return i;
+}
+
+static int ir_stats_bucket_s8(const int8_t *bound, int nbound, int value)
+{
+    int i = 0;
+
+    while ((i < nbound) && (value >= bound[i]))
+    {
+        i++;
+    }
+    return i;
+}
+
+/* Call with gsemaIRStats taken */
+static void ir_stats_save(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t ret;
+
+    ret = nvs_open(IR_STATS_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (ret != ESP_OK)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "NVS open %s failed: %s", IR_STATS_NVS_NAMESPACE,
+                       esp_err_to_name(ret));
+        return;
+    }
+    ret = nvs_set_u8(nvs_handle, "version", IR_STATS_VERSION);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_set_blob(nvs_handle, IR_STATS_NVS_COUNTER_KEY, gir_stats,
+                           sizeof(gir_stats));
+    }
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    if (ret != ESP_OK)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Save IR stats failed: %s", esp_err_to_name(ret));
+        return;
+    }
+    gir_stats_dirty = false;
+}
+
+void ir_stats_init(void)
+{
+    nvs_handle_t nvs_handle;
+    size_t size = sizeof(gir_stats);
+    uint8_t version = 0;
+
+    if (gsemaIRStats == NULL)
+    {
+        gsemaIRStats = xSemaphoreCreateBinary();
+        if (gsemaIRStats == NULL)
+        {
+            return;
+        }
+        xSemaphoreGive(gsemaIRStats);
+    }
+
+    if (xSemaphoreTake(gsemaIRStats, portMAX_DELAY) == pdTRUE)
+    {
+        memset(gir_stats, 0, sizeof(gir_stats));
+        if (nvs_open(IR_STATS_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) ==
+            ESP_OK)
+        {
+            /* A different layout starts from zero */
+            if ((nvs_get_u8(nvs_handle, "version", &version) != ESP_OK) ||
+                (version != IR_STATS_VERSION) ||
+                (nvs_get_blob(nvs_handle, IR_STATS_NVS_COUNTER_KEY, gir_stats,
+                              &size) != ESP_OK) ||
+                (size != sizeof(gir_stats)))
+            {
+                memset(gir_stats, 0, sizeof(gir_stats));
+            }
+            nvs_close(nvs_handle);
+        }
+        gir_stats_saved_us = esp_timer_get_time();
+        xSemaphoreGive(gsemaIRStats);
+    }
+}
+
+void ir_stats_record(char type, int attempts, int checks, int beep, int noise,
+                     int threshold, uint32_t confirm_ms)
+{
+    ir_stats_t *stats = NULL;
+    ir_stats_record_t *record = NULL;
+    int snr = 0;
+    bool measured = (beep > 0);
+    bool confirmed = measured && (beep >= threshold);
+
+    if ((gsemaIRStats == NULL) || (type <= 0) || (type >= IR_TYPE_MAX) ||
+        (attempts <= 0))
+    {
+        return;
+    }
+    if (measured)
+    {
+        snr = (noise > 0) ? (int)lroundf(10.0f * log10f((float)beep / noise))
+                          : INT8_MAX;
+        snr = (snr > INT8_MAX) ? INT8_MAX : ((snr < INT8_MIN) ? INT8_MIN : snr);
+    }
+
+    if (xSemaphoreTake(gsemaIRStats, portMAX_DELAY) == pdTRUE)
+    {
+        stats = &gir_stats[(int)type];
+        stats->frames++;
+        stats->attempts += attempts;
+        stats->retries += attempts - 1;
+        if (!measured)
+        {
+            stats->unchecked++;
+        }
+        else if (confirmed)
+        {
+            stats->confirmed++;
+            stats->attempt_hist[MIN(attempts, IR_STATS_MAX_ATTEMPTS) - 1]++;
+            if (checks > 0)
+            {
+                stats->check_hist[MIN(checks, IR_STATS_MAX_CHECKS) - 1]++;
+            }
+            stats->confirm_hist[ir_stats_bucket_u16(
+                gir_stats_confirm_bound, IR_STATS_CONFIRM_BUCKETS - 1,
+                confirm_ms)]++;
+        }
+        else
+        {
+            stats->unconfirmed++;
+        }
+        if (measured)
+        {
+            stats->snr_hist[ir_stats_bucket_s8(
+                gir_stats_snr_bound, IR_STATS_SNR_BUCKETS - 1, snr)]++;
+        }
+
+        record = &gir_stats_ring[gir_stats_head];
+        record->time = esp_timer_get_time() / 1000000;
+        record->type = type;
+        record->attempts = attempts;
+        record->checks = checks;
+        record->snr_db = snr;
+        record->confirm_ms = confirmed
+                                 ? MIN(confirm_ms, IR_STATS_UNCONFIRMED - 1)
+                                 : IR_STATS_UNCONFIRMED;
+        record->reserved = 0;
+        gir_stats_head = (gir_stats_head + 1) % IR_STATS_RING_SIZE;
+        if (gir_stats_num < IR_STATS_RING_SIZE)
+        {
+            gir_stats_num++;
+        }
+        gir_stats_dirty = true;
+        xSemaphoreGive(gsemaIRStats);
+    }
+}
+
+void ir_stats_poll(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (gsemaIRStats == NULL)
+    {
+        return;
+    }
+    if (now - gir_stats_saved_us < (int64_t)IR_STATS_SAVE_INTERVAL_S * 1000000)
+    {
+        return;
+    }
+    if (xSemaphoreTake(gsemaIRStats, portMAX_DELAY) == pdTRUE)
+    {
+        gir_stats_saved_us = now;
+        if (gir_stats_dirty)
+        {
+            ir_stats_save();
+        }
+        xSemaphoreGive(gsemaIRStats);
+    }
+}
+
+int ir_stats_get(char type, ir_stats_t *stats)
+{
+    if (gsemaIRStats == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (ir stats %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (stats == NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if ((type <= 0) || (type >= IR_TYPE_MAX))
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    if (xSemaphoreTake(gsemaIRStats, portMAX_DELAY) == pdTRUE)
+    {
+        memcpy(stats, &gir_stats[(int)type], sizeof(ir_stats_t));
+        xSemaphoreGive(gsemaIRStats);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+int ir_stats_get_recent(int index, ir_stats_record_t *record)
+{
+    int ret = SYSTEM_ERROR_NONE;
+
+    if (gsemaIRStats == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (ir stats %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (record == NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if (xSemaphoreTake(gsemaIRStats, portMAX_DELAY) == pdTRUE)
+    {
+        if ((index >= 0) && (index < gir_stats_num))
+        {
+            memcpy(record,
+                   &gir_stats_ring[(gir_stats_head + IR_STATS_RING_SIZE - 1 -
+                                    index) % IR_STATS_RING_SIZE],
+                   sizeof(ir_stats_record_t));
+        }
+        else
+        {
+            ret = SYSTEM_ERROR_INVALID_PARAMETER;
+        }
+        xSemaphoreGive(gsemaIRStats);
+    }
+    return ret;
+}
@@ -0,0 +1,89 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include "rmt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IR_STATS_NVS_NAMESPACE      "IRSTATS"
+#define IR_STATS_NVS_COUNTER_KEY    "counters"
+#define IR_STATS_VERSION            1
+#define IR_STATS_SAVE_INTERVAL_S    1800    /* Only if something was sent */
+#define IR_STATS_RING_SIZE          32      /* Recent transmissions */
+#define IR_STATS_MAX_ATTEMPTS       4       /* >= RMT_RETRY_TIMES */
+#define IR_STATS_MAX_CHECKS         4       /* >= RMT_CHECK_TIMES */
+#define IR_STATS_CONFIRM_BUCKETS    6       /* <250 <500 <1000 <2000 <4000 ms */
+#define IR_STATS_SNR_BUCKETS        6       /* <0 <3 <6 <10 <20 dB */
+#define IR_STATS_NOISE_FREQ_OFFSET  600     /* Noise band below the beep, most
+                                               beeps are close to Nyquist */
+#define IR_STATS_UNCONFIRMED        0xFFFF
+
+/**
+ * @brief Counters of one IR type, saved to NVS as is
+ */
+typedef struct
+{
+    uint32_t frames;        /* Frames to send */
+    uint32_t attempts;      /* Transmissions, retries included */
+    uint32_t retries;
+    uint32_t confirmed;     /* Beep heard */
+    uint32_t unconfirmed;   /* No beep after the last retry */
+    uint32_t unchecked;     /* Beep not measurable or not expected */
+    uint16_t attempt_hist[IR_STATS_MAX_ATTEMPTS];   /* Confirmed at attempt n */
+    uint16_t check_hist[IR_STATS_MAX_CHECKS];       /* Confirmed at check n */
+    uint16_t confirm_hist[IR_STATS_CONFIRM_BUCKETS];
+    uint16_t snr_hist[IR_STATS_SNR_BUCKETS];        /* Last check of a frame */
+} ir_stats_t;
+
+/**
+ * @brief One transmitted frame in the RAM ring
+ */
+typedef struct
+{
+    uint32_t time;          /* Seconds since boot */
+    uint8_t type;
+    uint8_t attempts;
+    uint8_t checks;         /* Checks of the last attempt */
+    int8_t snr_db;
+    uint16_t confirm_ms;    /* IR_STATS_UNCONFIRMED if not heard */
+    uint16_t reserved;
+} ir_stats_record_t;
+
+/**
+ * @brief Restore the counters from NVS, called by task_rmt
+ */
+void ir_stats_init(void);
+
+/**
+ * @brief Account one frame after task_rmt is done with its retries
+ *
+ * @param[in] beep Beep power of the last check, 0 if it couldn't be measured
+ * @param[in] noise Power next to the beep frequency of the last check
+ * @param[in] confirm_ms From the first transmission to the check that heard
+ *                       the beep
+ */
+void ir_stats_record(char type, int attempts, int checks, int beep, int noise,
+                     int threshold, uint32_t confirm_ms);
+
+/**
+ * @brief Save the counters once in a while, task_rmt calls it every loop
+ */
+void ir_stats_poll(void);
+
+int ir_stats_get(char type, ir_stats_t *stats);
+
+/**
+ * @param[in] index 0 is the latest frame
+ */
+int ir_stats_get_recent(int index, ir_stats_record_t *record);
+
+#ifdef __cplusplus
+}
+#endif
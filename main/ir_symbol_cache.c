@@ -0,0 +1,140 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ir_symbol_cache.h"
+#include "syslog.h"
+
+typedef struct
+{
+    char type;
+    uint32_t hash;
+    size_t length;
+    uint8_t payload[IR_SYMBOL_CACHE_MAX_PAYLOAD];
+    rmt_symbol_word_t *symbols;
+    size_t max_symbols;
+    size_t num_symbols;
+    uint32_t lastused;
+} ir_symbol_cache_entry_t;
+
+static ir_symbol_cache_entry_t gir_symbol_cache[IR_SYMBOL_CACHE_SIZE];
+static uint32_t gir_symbol_cache_resolution = 0;
+static uint32_t gir_symbol_cache_tick = 0;
+static uint32_t gir_symbol_cache_hit = 0;
+static uint32_t gir_symbol_cache_miss = 0;
+
+/* FNV-1a, the payload is at most 44 bytes */
+static uint32_t ir_symbol_cache_hash(char type, const uint8_t *data,
+                                     size_t length)
+{
+    uint32_t hash = 2166136261UL;
+    hash = (hash ^ (uint8_t)type) * 16777619UL;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619UL;
+    }
+    return hash;
+}
+
+void ir_symbol_cache_init(uint32_t resolution)
+{
+    gir_symbol_cache_resolution = resolution;
+    for (int i = 0; i < IR_SYMBOL_CACHE_SIZE; i++)
+    {
+        free(gir_symbol_cache[i].symbols);
+    }
+    memset(gir_symbol_cache, 0, sizeof(gir_symbol_cache));
+}
+
+const rmt_symbol_word_t *ir_symbol_cache_get(const ir_protocol_t *proto,
+                                             const uint8_t *payload,
+                                             size_t length,
+                                             size_t *num_symbols)
+{
+    ir_symbol_cache_entry_t *entry = NULL;
+    const uint8_t *data = payload;
+    size_t max_symbols = 0;
+    uint32_t hash = 0;
+    char type = 0;
+    int i = 0;
+
+    if ((proto == NULL) || (data == NULL) || (num_symbols == NULL) ||
+        (length > IR_SYMBOL_CACHE_MAX_PAYLOAD))
+    {
+        return NULL;
+    }
+    type = proto->type;
+    max_symbols = ir_protocol_frame_symbols(proto);
+
+    hash = ir_symbol_cache_hash(type, data, length);
+    gir_symbol_cache_tick++;
+    for (i = 0; i < IR_SYMBOL_CACHE_SIZE; i++)
+    {
+        entry = &gir_symbol_cache[i];
+        if ((entry->num_symbols > 0) && (entry->type == type) &&
+            (entry->hash == hash) && (entry->length == length) &&
+            (memcmp(entry->payload, data, length) == 0))
+        {
+            entry->lastused = gir_symbol_cache_tick;
+            gir_symbol_cache_hit++;
+            *num_symbols = entry->num_symbols;
+            return entry->symbols;
+        }
+    }
+
+    /* Miss, refill the least recently used entry */
+    entry = &gir_symbol_cache[0];
+    for (i = 1; i < IR_SYMBOL_CACHE_SIZE; i++)
+    {
+        if (gir_symbol_cache[i].lastused < entry->lastused)
+        {
+            entry = &gir_symbol_cache[i];
+        }
+    }
+
+    if (entry->max_symbols < max_symbols)
+    {
+        free(entry->symbols);
+        entry->symbols = malloc(max_symbols * sizeof(rmt_symbol_word_t));
+        entry->max_symbols = (entry->symbols != NULL) ? max_symbols : 0;
+    }
+    if (entry->symbols == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_ERROR,
+                       "No mem for IR symbol cache");
+        return NULL;
+    }
+
+    entry->num_symbols =
+        ir_protocol_fill_symbols(proto, gir_symbol_cache_resolution, data,
+                                 length, entry->symbols, entry->max_symbols);
+    if (entry->num_symbols == 0)
+    {
+        return NULL;
+    }
+    entry->type = type;
+    entry->hash = hash;
+    entry->length = length;
+    memcpy(entry->payload, data, length);
+    entry->lastused = gir_symbol_cache_tick;
+    gir_symbol_cache_miss++;
+
+    *num_symbols = entry->num_symbols;
+    return entry->symbols;
+}
+
+void ir_symbol_cache_getstats(uint32_t *hit, uint32_t *miss)
+{
+    if (hit != NULL)
+    {
+        *hit = gir_symbol_cache_hit;
+    }
+    if (miss != NULL)
+    {
+        *miss = gir_symbol_cache_miss;
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include "driver/rmt_encoder.h"
+#include "ir_protocol.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef CONFIG_IR_SYMBOL_CACHE_SIZE
+#define IR_SYMBOL_CACHE_SIZE        CONFIG_IR_SYMBOL_CACHE_SIZE
+#else
+#define IR_SYMBOL_CACHE_SIZE        4
+#endif
+#define IR_SYMBOL_CACHE_MAX_PAYLOAD IR_PROTOCOL_MAX_PAYLOAD
+
+/**
+ * @brief Get the ready-to-send RMT symbols of a frame
+ *
+ * The entry is keyed by IR type and payload hash. On a miss the least
+ * recently used entry is refilled from the protocol descriptor. Only task_rmt
+ * uses the cache, so there isn't any lock.
+ *
+ * @param[in] payload Packed by ir_protocol_pack()
+ * @param[out] num_symbols Number of symbols in the returned array
+ * @return Symbols to send with the copy encoder, NULL if not cacheable
+ */
+const rmt_symbol_word_t *ir_symbol_cache_get(const ir_protocol_t *proto,
+                                             const uint8_t *payload,
+                                             size_t length,
+                                             size_t *num_symbols);
+void ir_symbol_cache_init(uint32_t resolution);
+void ir_symbol_cache_getstats(uint32_t *hit, uint32_t *miss);
+
+#ifdef __cplusplus
+}
+#endif
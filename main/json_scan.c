@@ -0,0 +1,368 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "json_scan.h"
+#include "system.h"
+
+#define JSON_SCAN_STATE_START       0   /* Before the opening brace */
+#define JSON_SCAN_STATE_FIRST       1   /* First key or closing brace */
+#define JSON_SCAN_STATE_MEMBER      2   /* Key after a comma */
+#define JSON_SCAN_STATE_KEY         3
+#define JSON_SCAN_STATE_COLON       4
+#define JSON_SCAN_STATE_VALUE       5
+#define JSON_SCAN_STATE_STRING      6
+#define JSON_SCAN_STATE_LITERAL     7   /* Number, true, false or null */
+#define JSON_SCAN_STATE_NESTED      8
+#define JSON_SCAN_STATE_NEXT        9   /* Comma or closing brace */
+#define JSON_SCAN_STATE_DONE        10
+#define JSON_SCAN_STATE_ERROR       11
+
+#define JSON_SCAN_FLAG_ESCAPE       0x01
+#define JSON_SCAN_FLAG_OVERFLOW     0x02    /* Key or value dropped */
+#define JSON_SCAN_FLAG_QUOTED       0x04    /* In a string of a nested value */
+
+#define JSON_SCAN_IS_SPACE(c) \
+    (((c) == ' ') || ((c) == '\t') || ((c) == '\r') || ((c) == '\n'))
+#define JSON_SCAN_IS_LITERAL(c)                                   \
+    ((((c) >= '0') && ((c) <= '9')) || (((c) >= 'a') && ((c) <= 'z')) || \
+     ((c) == '-') || ((c) == '+') || ((c) == '.') || ((c) == 'E'))
+
+static void json_scan_put(json_scan_t *scan, char *buf, uint16_t *len,
+                          int max, char c)
+{
+    if (*len < max)
+    {
+        buf[(*len)++] = c;
+    }
+    else
+    {
+        scan->flags |= JSON_SCAN_FLAG_OVERFLOW;
+    }
+}
+
+/* True on the closing quote */
+static bool json_scan_string(json_scan_t *scan, char c, char *buf,
+                             uint16_t *len, int max)
+{
+    if (scan->hex > 0)
+    {
+        scan->hex--;
+        return false;
+    }
+    if (scan->flags & JSON_SCAN_FLAG_ESCAPE)
+    {
+        scan->flags &= ~JSON_SCAN_FLAG_ESCAPE;
+        switch (c)
+        {
+        case 'b':
+            c = '\b';
+            break;
+        case 'f':
+            c = '\f';
+            break;
+        case 'n':
+            c = '\n';
+            break;
+        case 'r':
+            c = '\r';
+            break;
+        case 't':
+            c = '\t';
+            break;
+        case 'u':
+            /* Settings are ASCII, keep a placeholder */
+            scan->hex = 4;
+            c = '?';
+            break;
+        default:
+            break;
+        }
+        json_scan_put(scan, buf, len, max, c);
+        return false;
+    }
+    if (c == '\\')
+    {
+        scan->flags |= JSON_SCAN_FLAG_ESCAPE;
+        return false;
+    }
+    if (c == '"')
+    {
+        return true;
+    }
+    json_scan_put(scan, buf, len, max, c);
+    return false;
+}
+
+static void json_scan_emit(json_scan_t *scan, int type)
+{
+    if (!(scan->flags & JSON_SCAN_FLAG_OVERFLOW))
+    {
+        scan->value[scan->value_len] = '\0';
+        scan->cb(scan->arg, scan->key, type, scan->value, scan->value_len);
+    }
+    scan->state = JSON_SCAN_STATE_NEXT;
+}
+
+static int json_scan_literal(json_scan_t *scan)
+{
+    scan->value[scan->value_len] = '\0';
+    if (strcmp(scan->value, "true") == 0)
+    {
+        return JSON_SCAN_TRUE;
+    }
+    if (strcmp(scan->value, "false") == 0)
+    {
+        return JSON_SCAN_FALSE;
+    }
+    if (strcmp(scan->value, "null") == 0)
+    {
+        return JSON_SCAN_NULL;
+    }
+    if ((scan->value[0] == '-') ||
+        ((scan->value[0] >= '0') && (scan->value[0] <= '9')))
+    {
+        return JSON_SCAN_NUMBER;
+    }
+    return -1;
+}
+
+void json_scan_init(json_scan_t *scan, json_scan_cb_t cb, void *arg)
+{
+    memset(scan, 0, sizeof(*scan));
+    scan->cb = cb;
+    scan->arg = arg;
+    scan->state = JSON_SCAN_STATE_START;
+}
+
+int json_scan_feed(json_scan_t *scan, const char *data, int len)
+{
+    int type = 0;
+    char c;
+
+    if ((scan == NULL) || (data == NULL))
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    for (int i = 0; (i < len) && (scan->state != JSON_SCAN_STATE_ERROR); i++)
+    {
+        c = data[i];
+        switch (scan->state)
+        {
+        case JSON_SCAN_STATE_START:
+            if (c == '{')
+            {
+                scan->state = JSON_SCAN_STATE_FIRST;
+            }
+            else if (!JSON_SCAN_IS_SPACE(c))
+            {
+                scan->state = JSON_SCAN_STATE_ERROR;
+            }
+            break;
+        case JSON_SCAN_STATE_FIRST:
+        case JSON_SCAN_STATE_MEMBER:
+            if (c == '"')
+            {
+                scan->flags = 0;
+                scan->key_len = 0;
+                scan->state = JSON_SCAN_STATE_KEY;
+            }
+            else if ((c == '}') && (scan->state == JSON_SCAN_STATE_FIRST))
+            {
+                scan->state = JSON_SCAN_STATE_DONE;
+            }
+            else if (!JSON_SCAN_IS_SPACE(c))
+            {
+                scan->state = JSON_SCAN_STATE_ERROR;
+            }
+            break;
+        case JSON_SCAN_STATE_KEY:
+            if (json_scan_string(scan, c, scan->key, &scan->key_len,
+                                 JSON_SCAN_MAXLEN_KEY))
+            {
+                scan->key[scan->key_len] = '\0';
+                scan->state = JSON_SCAN_STATE_COLON;
+            }
+            break;
+        case JSON_SCAN_STATE_COLON:
+            if (c == ':')
+            {
+                scan->value_len = 0;
+                scan->state = JSON_SCAN_STATE_VALUE;
+            }
+            else if (!JSON_SCAN_IS_SPACE(c))
+            {
+                scan->state = JSON_SCAN_STATE_ERROR;
+            }
+            break;
+        case JSON_SCAN_STATE_VALUE:
+            if (c == '"')
+            {
+                scan->state = JSON_SCAN_STATE_STRING;
+            }
+            else if ((c == '{') || (c == '['))
+            {
+                scan->depth = 1;
+                scan->state = JSON_SCAN_STATE_NESTED;
+            }
+            else if (JSON_SCAN_IS_LITERAL(c))
+            {
+                json_scan_put(scan, scan->value, &scan->value_len,
+                              JSON_SCAN_MAXLEN_VALUE, c);
+                scan->state = JSON_SCAN_STATE_LITERAL;
+            }
+            else if (!JSON_SCAN_IS_SPACE(c))
+            {
+                scan->state = JSON_SCAN_STATE_ERROR;
+            }
+            break;
+        case JSON_SCAN_STATE_STRING:
+            if (json_scan_string(scan, c, scan->value, &scan->value_len,
+                                 JSON_SCAN_MAXLEN_VALUE))
+            {
+                json_scan_emit(scan, JSON_SCAN_STRING);
+            }
+            break;
+        case JSON_SCAN_STATE_LITERAL:
+            if (JSON_SCAN_IS_LITERAL(c))
+            {
+                json_scan_put(scan, scan->value, &scan->value_len,
+                              JSON_SCAN_MAXLEN_VALUE, c);
+                break;
+            }
+            type = json_scan_literal(scan);
+            if (type < 0)
+            {
+                scan->state = JSON_SCAN_STATE_ERROR;
+                break;
+            }
+            json_scan_emit(scan, type);
+            /* The delimiter belongs to the next state */
+            i--;
+            break;
+        case JSON_SCAN_STATE_NESTED:
+            if (scan->flags & JSON_SCAN_FLAG_QUOTED)
+            {
+                if (scan->flags & JSON_SCAN_FLAG_ESCAPE)
+                {
+                    scan->flags &= ~JSON_SCAN_FLAG_ESCAPE;
+                }
+                else if (c == '\\')
+                {
+                    scan->flags |= JSON_SCAN_FLAG_ESCAPE;
+                }
+                else if (c == '"')
+                {
+                    scan->flags &= ~JSON_SCAN_FLAG_QUOTED;
+                }
+            }
+            else if (c == '"')
+            {
+                scan->flags |= JSON_SCAN_FLAG_QUOTED;
+            }
+            else if ((c == '{') || (c == '['))
+            {
+                scan->depth++;
+            }
+            else if (((c == '}') || (c == ']')) && (--scan->depth == 0))
+            {
+                scan->state = JSON_SCAN_STATE_NEXT;
+            }
+            break;
+        case JSON_SCAN_STATE_NEXT:
+            if (c == ',')
+            {
+                scan->state = JSON_SCAN_STATE_MEMBER;
+            }
+            else if (c == '}')
+            {
+                scan->state = JSON_SCAN_STATE_DONE;
+            }
+            else if (!JSON_SCAN_IS_SPACE(c))
+            {
+                scan->state = JSON_SCAN_STATE_ERROR;
+            }
+            break;
+        default:
+            /* Only blanks may follow the object */
+            if (!JSON_SCAN_IS_SPACE(c))
+            {
+                scan->state = JSON_SCAN_STATE_ERROR;
+            }
+            break;
+        }
+    }
+    return (scan->state == JSON_SCAN_STATE_ERROR)
+               ? SYSTEM_ERROR_INVALID_PARAMETER
+               : SYSTEM_ERROR_NONE;
+}
+
+bool json_scan_done(const json_scan_t *scan)
+{
+    return (scan != NULL) && (scan->state == JSON_SCAN_STATE_DONE);
+}
+
+static int json_field_compare(const void *key, const void *field)
+{
+    return strcmp((const char *)key, ((const json_field_t *)field)->name);
+}
+
+const json_field_t *json_field_find(const json_field_t *fields, int num,
+                                    const char *key)
+{
+    if ((fields == NULL) || (key == NULL))
+    {
+        return NULL;
+    }
+    return bsearch(key, fields, num, sizeof(*fields), json_field_compare);
+}
+
+bool json_field_store(const json_field_t *field, void *base, int type,
+                      const char *value, int len)
+{
+    char *dst = (char *)base + field->offset;
+    char *end = NULL;
+    long number = 0;
+
+    switch (field->type)
+    {
+    case JSON_FIELD_INT:
+        /* Form inputs post numbers as strings */
+        if (((type != JSON_SCAN_NUMBER) && (type != JSON_SCAN_STRING)) ||
+            (len == 0))
+        {
+            return false;
+        }
+        errno = 0;
+        number = strtol(value, &end, 10);
+        if ((end != value + len) || (errno == ERANGE) || (number > INT_MAX) ||
+            (number < INT_MIN))
+        {
+            return false;
+        }
+        *(int *)dst = (int)number;
+        return true;
+    case JSON_FIELD_BOOL:
+        if ((type != JSON_SCAN_TRUE) && (type != JSON_SCAN_FALSE))
+        {
+            return false;
+        }
+        *(bool *)dst = (type == JSON_SCAN_TRUE);
+        return true;
+    case JSON_FIELD_STR:
+        if ((type != JSON_SCAN_STRING) || (len >= field->size))
+        {
+            return false;
+        }
+        memcpy(dst, value, len + 1);
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JSON_SCAN_MAXLEN_KEY        23
+#define JSON_SCAN_MAXLEN_VALUE      63
+
+/* Type of a scanned value */
+#define JSON_SCAN_STRING            0
+#define JSON_SCAN_NUMBER            1
+#define JSON_SCAN_TRUE              2
+#define JSON_SCAN_FALSE             3
+#define JSON_SCAN_NULL              4
+
+/* Type of a field in a key table */
+#define JSON_FIELD_INT              0   /* int, from a number or a string */
+#define JSON_FIELD_BOOL             1   /* bool */
+#define JSON_FIELD_STR              2   /* char[size] */
+
+/**
+ * @brief Called for every member of the object, value is NUL terminated
+ */
+typedef void (*json_scan_cb_t)(void *arg, const char *key, int type,
+                               const char *value, int len);
+
+/**
+ * @brief Scanner state, lives on the caller's stack
+ */
+typedef struct
+{
+    json_scan_cb_t cb;
+    void *arg;
+    uint8_t state;
+    uint8_t flags;
+    uint8_t hex;                /* \u digits still to skip */
+    uint16_t depth;             /* Of a skipped object or array */
+    uint16_t key_len;
+    uint16_t value_len;
+    char key[JSON_SCAN_MAXLEN_KEY + 1];
+    char value[JSON_SCAN_MAXLEN_VALUE + 1];
+} json_scan_t;
+
+/**
+ * @brief One entry of a key table, tables are sorted by name
+ */
+typedef struct
+{
+    const char *name;
+    uint8_t type;
+    uint8_t id;
+    uint16_t offset;            /* In the destination struct */
+    uint16_t size;
+} json_field_t;
+
+/**
+ * @brief Start a scan of one flat JSON object
+ *
+ * Members whose key or value is too long, and objects or arrays nested in
+ * the values, are skipped without a callback.
+ */
+void json_scan_init(json_scan_t *scan, json_scan_cb_t cb, void *arg);
+
+/**
+ * @brief Scan the next part of the text, it can be cut anywhere
+ *
+ * @return SYSTEM_ERROR_INVALID_PARAMETER once the text is not JSON
+ */
+int json_scan_feed(json_scan_t *scan, const char *data, int len);
+
+/**
+ * @brief True once the closing brace of the object was scanned
+ */
+bool json_scan_done(const json_scan_t *scan);
+
+/**
+ * @brief Look a key up in a table sorted by name
+ */
+const json_field_t *json_field_find(const json_field_t *fields, int num,
+                                    const char *key);
+
+/**
+ * @brief Convert a scanned value into the field of base
+ *
+ * @return false if the value does not fit the field, base is then unchanged
+ */
+bool json_field_store(const json_field_t *field, void *base, int type,
+                      const char *value, int len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -10,11 +10,12 @@
 #include "syslog.h"
 #include "system.h"
 #include "rmt.h"
+#include "settings.h"
 #include "ir_delta_encoder.h"
 #include "oled.h"
 #include "dht22.h"
 #include "homekit.h"
-#include "esp_timer.h"
+#include "timer_wheel.h"
 #include "esp_wifi.h"
 
 /* LD2410 commands */
@@ -67,7 +68,7 @@ char LD2410_SetSensitivityCommand[LD2410_MaxDisIdelCommandLen] = {
 int gld2410_dbg_flag = 0;
 uint32_t approachcounter = 0;
 
-esp_timer_handle_t gnon_occupancy_delay_timer_handle = NULL;
+static int gnon_occupancy_delay_timer = TIMER_WHEEL_INVALID;
 SemaphoreHandle_t gsemaAutoLearn = NULL;
 SemaphoreHandle_t gsemaLD2410Cfg = NULL;
 /*
@@ -102,7 +103,6 @@ static void ld2410_nu_autolearningSomebody(uint8_t *data, int length);
 static void ld2410_nu_autolearningStillness(uint8_t *data, int length);
 static uint8_t ld2410_nu_checkreply(uint8_t *data, int length);
 static void ld2410_restoreconfig(void);
-extern esp_timer_handle_t gled_display_timer_handle;
 static void dbg_ld2410_autolearned_data(void)
 {
     int k = 0;
@@ -427,14 +427,10 @@ static uint8_t ld2410_nu_checkreply(uint8_t *data, int length)
 {
     int k = 0;
     uint8_t status = 0;
-    esp_timer_create_args_t led_display_timer_args = {
-        .callback = &led_display_app_timer_callback,
-        .name = "led_display_timer"};
     float data_with_ld2410[SENSOR_SIZE] = {0};
     int index = 0;
     float temperature = 0, humidity = 0;
     char ANType = 0;
-    int leddisplaytime = 0;
 
     ld2410_getANType(&ANType);
 
@@ -464,24 +460,7 @@ static uint8_t ld2410_nu_checkreply(uint8_t *data, int length)
                             }
                             xSemaphoreGive(gsemaLED);
                         }
-                        if (gled_display_timer_handle != NULL)
-                        {
-                            if (esp_timer_is_active(gled_display_timer_handle))
-                            {
-                                ESP_ERROR_CHECK(
-                                    esp_timer_stop(gled_display_timer_handle));
-                            }
-                        }
-                        else
-                        {
-                            ESP_ERROR_CHECK(
-                                esp_timer_create(&led_display_timer_args,
-                                                 &gled_display_timer_handle));
-                        }
-                        oled_getDisplayTime(&leddisplaytime);
-                        ESP_ERROR_CHECK(esp_timer_start_once(
-                            gled_display_timer_handle,
-                            (leddisplaytime * 1000 * 1000)));
+                        oled_display_timer_restart();
                     }
                 }
             }
@@ -547,23 +526,11 @@ static void ld2410_restoreconfig(void)
 
 void ld2410_saveconfig(char *key, uint32_t data)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t ret;
-
-    ret = nvs_open(LD2410_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (ret != ESP_OK)
+    if (settings_set_u32(LD2410_NVS_NAMESPACE, key, data) != SYSTEM_ERROR_NONE)
     {
-        ESP_LOGE(TAG_NVS, "NVS open failed: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG_NVS, "Config key %s invalid", key);
         return;
     }
-
-    uint32_t value1 = data;
-    ret = nvs_set_u32(nvs_handle, key, value1);
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG_NVS, "NVS set failed for key1: %s", esp_err_to_name(ret));
-    }
-    nvs_close(nvs_handle);
     syslog_handler(SYSLOG_FACILITY_OCCUPANCY, SYSLOG_LEVEL_INFO,
                    "Config saved %s %d", key, data);
     return;
@@ -708,6 +675,9 @@ void ld2410_uart_init(void)
     // Reset the pattern queue length to record at most 20 pattern positions.
     uart_pattern_queue_reset(gld2410_uart_num, 20);
 
+    timer_wheel_add(&non_occupancy_delay_timer_callback, NULL, "nonocc_timer",
+                    &gnon_occupancy_delay_timer);
+
     /* Configure LD2410 */
     ld2410_setstart(LD2410_INTERNALDELAY);
 }
@@ -721,12 +691,6 @@ void ld2410_updatestatus(uint8_t *data, int length)
 
     ESP_ERROR_CHECK(esp_wifi_get_mac(WIFI_IF_STA, sys_mac));
     memset(&msg, 0, sizeof(rmt_zftg_msg_t));
-    esp_timer_create_args_t non_occupancy_delay_timer_args = {
-        .callback = &non_occupancy_delay_timer_callback,
-        .name = "nonocc_timer"};
-    esp_timer_create_args_t sync_delta_warm_timer_args = {
-        .callback = &ir_sync_delta_warm_timer_callback,
-        .name = "sync_delta_warm_timer"};
     float temperature = 0, humidity = 0;
     int humihigh = 0, templow = 0;
 
@@ -784,17 +748,13 @@ void ld2410_updatestatus(uint8_t *data, int length)
 
             if (hap_iselfactive())  // If elf is enabled
             {
-                if (gnon_occupancy_delay_timer_handle !=
-                    NULL)  // During non occupancy delay time, stop timer
+                // During non occupancy delay time, stop timer
+                if (timer_wheel_is_active(gnon_occupancy_delay_timer))
                 {
-                    if (esp_timer_is_active(gnon_occupancy_delay_timer_handle))
-                    {
-                        ESP_ERROR_CHECK(
-                            esp_timer_stop(gnon_occupancy_delay_timer_handle));
-                        tigger_occupancy =
-                            false;  // Homekit status is occupancy, don't have
-                                    // to update.
-                    }
+                    timer_wheel_stop(gnon_occupancy_delay_timer);
+                    tigger_occupancy =
+                        false;  // Homekit status is occupancy, don't have
+                                // to update.
                 }
 
                 if (tigger_occupancy)  // Update homekit status
@@ -843,42 +803,11 @@ void ld2410_updatestatus(uint8_t *data, int length)
                         syslog_handler(SYSLOG_FACILITY_TEMPERATURE,
                                        SYSLOG_LEVEL_INFO,
                                        "Shower and temperature is cold %.1f, "
-                                       "turn on warm fan",
+                                       "humidity %.1f, turn on warm fan",
                                        temperature, humidity);
                         ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_WARM,
                                            IR_DELTA_FAN_TIGGER_ACTIVE_ON,
                                            IR_DELTA_FAN_DURATION_1HR);
-                        if (gsync_delta_warm_timer_handle != NULL)
-                        {
-                            if (esp_timer_is_active(
-                                    gsync_delta_warm_timer_handle))
-                            {
-                                syslog_handler(SYSLOG_FACILITY_OCCUPANCY,
-                                               SYSLOG_LEVEL_DEBUG,
-                                               "Stop warm timer");
-                                ESP_ERROR_CHECK(esp_timer_stop(
-                                    gsync_delta_warm_timer_handle));
-                            }
-                        }
-                        else
-                        {
-                            syslog_handler(SYSLOG_FACILITY_OCCUPANCY,
-                                           SYSLOG_LEVEL_DEBUG,
-                                           "Create warm timer");
-                            ESP_ERROR_CHECK(esp_timer_create(
-                                &sync_delta_warm_timer_args,
-                                &gsync_delta_warm_timer_handle));
-                        }
-                        ESP_ERROR_CHECK(esp_timer_start_once(
-                            gsync_delta_warm_timer_handle,
-                            ((uint64_t)IR_DELTA_FAN_DURATION_1HR * 60 * 60 *
-                             1000 * 1000)));
-                        syslog_handler(SYSLOG_FACILITY_OCCUPANCY,
-                                       SYSLOG_LEVEL_DEBUG,
-                                       "Start warm timer %llu",
-                                       ((uint64_t)IR_DELTA_FAN_DURATION_1HR) *
-                                           60 * 60 * 1000 * 1000);
-                        rmt_setwarmfanstatus(true);
                     }
                 }
             }
@@ -890,25 +819,10 @@ void ld2410_updatestatus(uint8_t *data, int length)
             if (hap_iselfactive())
             {
                 uint32_t delaytime = 0;
-                if (gnon_occupancy_delay_timer_handle != NULL)
-                {
-                    if (esp_timer_is_active(gnon_occupancy_delay_timer_handle))
-                    {
-                        ESP_ERROR_CHECK(
-                            esp_timer_stop(gnon_occupancy_delay_timer_handle));
-                    }
-                }
-                else
-                {
-                    ESP_ERROR_CHECK(
-                        esp_timer_create(&non_occupancy_delay_timer_args,
-                                         &gnon_occupancy_delay_timer_handle));
-                }
-                // Start non occupancy delay timer
+                // (Re)start non occupancy delay timer
                 ld2410_getLeaveDelayTime(&delaytime);
-                ESP_ERROR_CHECK(
-                    esp_timer_start_once(gnon_occupancy_delay_timer_handle,
-                                         (delaytime * 1000 * 1000)));
+                timer_wheel_start(gnon_occupancy_delay_timer,
+                                  delaytime * 1000);
             }
         }
     }
@@ -1107,20 +1021,11 @@ void non_occupancy_delay_timer_callback()
     {
         if (rmt_iswarmfanactive())
         {
-            rmt_setwarmfanstatus(false);
             syslog_handler(SYSLOG_FACILITY_TEMPERATURE, SYSLOG_LEVEL_INFO,
                            "Shower complete, turn off warm fan");
             ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_WARM,
                                IR_DELTA_FAN_TIGGER_ACTIVE_OFF,
                                IR_DELTA_FAN_DURATION_1HR);
-            if (gsync_delta_warm_timer_handle != NULL)
-            {
-                if (esp_timer_is_active(gsync_delta_warm_timer_handle))
-                {
-                    ESP_ERROR_CHECK(
-                        esp_timer_stop(gsync_delta_warm_timer_handle));
-                }
-            }
         }
     }
     /* If elf is disabled, don't update the occupancy status.  */
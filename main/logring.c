@@ -0,0 +1,351 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "logring.h"
+#include "syslog.h"
+#include "system.h"
+
+#define LOGRING_ALIGN(x)    (((x) + 3) & ~3)
+
+_Static_assert(sizeof(logring_sector_t) % 4 == 0, "Sector header alignment");
+_Static_assert(sizeof(logring_record_t) % 4 == 0, "Record header alignment");
+_Static_assert(LOGRING_BUFFER_SIZE >=
+                   sizeof(logring_record_t) + LOGRING_ALIGN(LOGRING_TEXT_MAXLEN),
+               "A record must fit in the RAM buffer");
+
+/*
+ * Sectors are filled in turn and the oldest one is erased when the ring
+ * moves on, so every sector wears the same. Records never cross a sector.
+ */
+static const esp_partition_t *glogring_part = NULL;
+static int glogring_sectors = 0;
+static int glogring_sector = 0;         /* Being written */
+static uint32_t glogring_sequence = 0;  /* Of glogring_sector */
+static uint32_t glogring_offset = 0;    /* Flash end in glogring_sector */
+static uint16_t glogring_boot = 0;
+static uint8_t glogring_buffer[LOGRING_BUFFER_SIZE];
+static int glogring_buffered = 0;
+static int64_t glogring_buffered_us = 0;    /* First byte buffered */
+static bool glogring_urgent = false;
+static SemaphoreHandle_t gsemaLogRing = NULL;
+
+/* Call with gsemaLogRing taken */
+static void logring_write_buffer(void)
+{
+    esp_err_t ret;
+
+    if (glogring_buffered == 0)
+    {
+        return;
+    }
+    ret = esp_partition_write(glogring_part,
+                              glogring_sector * LOGRING_SECTOR_SIZE +
+                                  glogring_offset,
+                              glogring_buffer, glogring_buffered);
+    if (ret != ESP_OK)
+    {
+        /* Not through syslog, it would come back here */
+        ESP_LOGE("logring", "Write failed: %s", esp_err_to_name(ret));
+    }
+    glogring_offset += glogring_buffered;
+    glogring_buffered = 0;
+    glogring_urgent = false;
+}
+
+/* Call with gsemaLogRing taken */
+static void logring_next_sector(void)
+{
+    logring_sector_t header = {
+        .magic = LOGRING_SECTOR_MAGIC,
+        .sequence = glogring_sequence + 1,
+        .boot = glogring_boot,
+        .reserved = 0,
+    };
+
+    glogring_sector = (glogring_sector + 1) % glogring_sectors;
+    glogring_sequence = header.sequence;
+    glogring_offset = sizeof(header);
+    if ((esp_partition_erase_range(glogring_part,
+                                   glogring_sector * LOGRING_SECTOR_SIZE,
+                                   LOGRING_SECTOR_SIZE) != ESP_OK) ||
+        (esp_partition_write(glogring_part,
+                             glogring_sector * LOGRING_SECTOR_SIZE, &header,
+                             sizeof(header)) != ESP_OK))
+    {
+        ESP_LOGE("logring", "Sector %d erase failed", glogring_sector);
+    }
+}
+
+/* End of the records in the newest sector, or LOGRING_SECTOR_SIZE if bad */
+static uint32_t logring_scan_sector(int sector, uint16_t *boot)
+{
+    logring_record_t record;
+    uint32_t offset = sizeof(logring_sector_t);
+
+    while (offset + sizeof(record) <= LOGRING_SECTOR_SIZE)
+    {
+        if (esp_partition_read(glogring_part,
+                               sector * LOGRING_SECTOR_SIZE + offset, &record,
+                               sizeof(record)) != ESP_OK)
+        {
+            return LOGRING_SECTOR_SIZE;
+        }
+        if (record.magic == 0xFF)
+        {
+            break;
+        }
+        if (record.magic != LOGRING_RECORD_MAGIC)
+        {
+            /* Power was lost in the middle of a write */
+            return LOGRING_SECTOR_SIZE;
+        }
+        *boot = record.boot;
+        offset += sizeof(record) + LOGRING_ALIGN(record.len);
+    }
+    return offset;
+}
+
+static void logring_shutdown(void)
+{
+    if ((gsemaLogRing != NULL) &&
+        (xSemaphoreTake(gsemaLogRing, pdMS_TO_TICKS(100)) == pdTRUE))
+    {
+        logring_write_buffer();
+        xSemaphoreGive(gsemaLogRing);
+    }
+}
+
+void logring_init(void)
+{
+    logring_sector_t header;
+    uint32_t newest = 0;
+    uint16_t boot = 0;
+    bool found = false;
+
+    glogring_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                             LOGRING_PARTITION_SUBTYPE,
+                                             LOGRING_PARTITION_LABEL);
+    if (glogring_part == NULL)
+    {
+        ESP_LOGW("logring", "No %s partition", LOGRING_PARTITION_LABEL);
+        return;
+    }
+    glogring_sectors = glogring_part->size / LOGRING_SECTOR_SIZE;
+    if (glogring_sectors < 2)
+    {
+        glogring_part = NULL;
+        return;
+    }
+
+    for (int i = 0; i < glogring_sectors; i++)
+    {
+        if ((esp_partition_read(glogring_part, i * LOGRING_SECTOR_SIZE,
+                                &header, sizeof(header)) == ESP_OK) &&
+            (header.magic == LOGRING_SECTOR_MAGIC) &&
+            (!found || (int32_t)(header.sequence - newest) > 0))
+        {
+            found = true;
+            newest = header.sequence;
+            glogring_sector = i;
+            boot = header.boot;
+        }
+    }
+
+    if (found)
+    {
+        glogring_sequence = newest;
+        glogring_offset = logring_scan_sector(glogring_sector, &boot);
+        glogring_boot = boot + 1;
+        if (glogring_offset + sizeof(logring_record_t) > LOGRING_SECTOR_SIZE)
+        {
+            logring_next_sector();
+        }
+    }
+    else
+    {
+        /* Blank or foreign partition, start at sector 0 */
+        glogring_sector = glogring_sectors - 1;
+        glogring_boot = 1;
+        logring_next_sector();
+    }
+
+    gsemaLogRing = xSemaphoreCreateBinary();
+    if (gsemaLogRing != NULL)
+    {
+        xSemaphoreGive(gsemaLogRing);
+        esp_register_shutdown_handler(logring_shutdown);
+    }
+}
+
+void logring_append(uint32_t facility, uint32_t level, uint32_t sequence,
+                    uint32_t time_ms, const char *text, int len)
+{
+    logring_record_t record;
+    int size = 0;
+
+    if ((gsemaLogRing == NULL) || (text == NULL))
+    {
+        return;
+    }
+    len = (len < 0) ? 0 : ((len > LOGRING_TEXT_MAXLEN) ? LOGRING_TEXT_MAXLEN
+                                                          : len);
+    size = sizeof(record) + LOGRING_ALIGN(len);
+    record.magic = LOGRING_RECORD_MAGIC;
+    record.facility = facility;
+    record.level = level;
+    record.len = len;
+    record.boot = glogring_boot;
+    record.reserved = 0;
+    record.sequence = sequence;
+    record.time_ms = time_ms;
+
+    if (xSemaphoreTake(gsemaLogRing, portMAX_DELAY) == pdTRUE)
+    {
+        if (glogring_offset + glogring_buffered + size > LOGRING_SECTOR_SIZE)
+        {
+            logring_write_buffer();
+            logring_next_sector();
+        }
+        else if (glogring_buffered + size > LOGRING_BUFFER_SIZE)
+        {
+            logring_write_buffer();
+        }
+        if (glogring_buffered == 0)
+        {
+            glogring_buffered_us = esp_timer_get_time();
+        }
+        memcpy(&glogring_buffer[glogring_buffered], &record, sizeof(record));
+        memcpy(&glogring_buffer[glogring_buffered + sizeof(record)], text, len);
+        /* Padding as erased flash */
+        memset(&glogring_buffer[glogring_buffered + sizeof(record) + len], 0xFF,
+               LOGRING_ALIGN(len) - len);
+        glogring_buffered += size;
+        if (level >= SYSLOG_LEVEL_WARNING)
+        {
+            glogring_urgent = true;
+        }
+        xSemaphoreGive(gsemaLogRing);
+    }
+}
+
+void logring_poll(void)
+{
+    if (gsemaLogRing == NULL)
+    {
+        return;
+    }
+    if (xSemaphoreTake(gsemaLogRing, portMAX_DELAY) == pdTRUE)
+    {
+        if ((glogring_buffered > 0) &&
+            (glogring_urgent || (esp_timer_get_time() - glogring_buffered_us >=
+                                 (int64_t)LOGRING_FLUSH_MS * 1000)))
+        {
+            logring_write_buffer();
+        }
+        xSemaphoreGive(gsemaLogRing);
+    }
+}
+
+void logring_flush(void)
+{
+    if (gsemaLogRing == NULL)
+    {
+        return;
+    }
+    if (xSemaphoreTake(gsemaLogRing, portMAX_DELAY) == pdTRUE)
+    {
+        logring_write_buffer();
+        xSemaphoreGive(gsemaLogRing);
+    }
+}
+
+uint16_t logring_get_boot(void)
+{
+    return glogring_boot;
+}
+
+void logring_iter_init(logring_iter_t *iter)
+{
+    iter->sector = 0;
+    iter->sequence = 0;
+    iter->offset = 0;
+}
+
+bool logring_iter_next(logring_iter_t *iter, logring_record_t *record,
+                       char *text)
+{
+    logring_sector_t header;
+    int sector = 0;
+    bool found = false;
+
+    if ((gsemaLogRing == NULL) || (iter == NULL) || (record == NULL) ||
+        (text == NULL))
+    {
+        return false;
+    }
+    if (xSemaphoreTake(gsemaLogRing, portMAX_DELAY) != pdTRUE)
+    {
+        return false;
+    }
+    /* Oldest sector is the one after the newest */
+    while (!found && (iter->sector < glogring_sectors))
+    {
+        sector = (glogring_sector + 1 + iter->sector) % glogring_sectors;
+        if (iter->offset == 0)
+        {
+            if ((esp_partition_read(glogring_part,
+                                    sector * LOGRING_SECTOR_SIZE, &header,
+                                    sizeof(header)) != ESP_OK) ||
+                (header.magic != LOGRING_SECTOR_MAGIC))
+            {
+                iter->sector++;
+                continue;
+            }
+            iter->sequence = header.sequence;
+            iter->offset = sizeof(header);
+        }
+        else if (esp_partition_read(glogring_part, sector * LOGRING_SECTOR_SIZE,
+                                    &header, sizeof(header)) != ESP_OK ||
+                 header.sequence != iter->sequence)
+        {
+            /* Erased by the writer since the last call */
+            iter->sector++;
+            iter->offset = 0;
+            continue;
+        }
+
+        if ((sector == glogring_sector) &&
+            (iter->offset >= glogring_offset))
+        {
+            break;
+        }
+        if ((iter->offset + sizeof(*record) > LOGRING_SECTOR_SIZE) ||
+            (esp_partition_read(glogring_part,
+                                sector * LOGRING_SECTOR_SIZE + iter->offset,
+                                record, sizeof(*record)) != ESP_OK) ||
+            (record->magic != LOGRING_RECORD_MAGIC) ||
+            (esp_partition_read(glogring_part,
+                                sector * LOGRING_SECTOR_SIZE + iter->offset +
+                                    sizeof(*record),
+                                text, record->len) != ESP_OK))
+        {
+            iter->sector++;
+            iter->offset = 0;
+            continue;
+        }
+        text[record->len] = '\0';
+        iter->offset += sizeof(*record) + LOGRING_ALIGN(record->len);
+        found = true;
+    }
+    xSemaphoreGive(gsemaLogRing);
+    return found;
+}
@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOGRING_PARTITION_LABEL     "logring"
+#define LOGRING_PARTITION_SUBTYPE   0x40
+#define LOGRING_SECTOR_SIZE         4096
+#define LOGRING_SECTOR_MAGIC        0x52474F4C  /* "LOGR" */
+#define LOGRING_RECORD_MAGIC        0xA5
+#define LOGRING_BUFFER_SIZE         1024        /* Batched into one write */
+#define LOGRING_FLUSH_MS            5000        /* Warnings and errors sooner */
+#define LOGRING_TEXT_MAXLEN         255
+
+/**
+ * @brief Header of every sector, the highest sequence is written last
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t sequence;
+    uint16_t boot;
+    uint16_t reserved;
+} logring_sector_t;
+
+/**
+ * @brief One message, followed by its text padded to 4 bytes
+ */
+typedef struct
+{
+    uint8_t magic;
+    uint8_t facility;
+    uint8_t level;
+    uint8_t len;            /* Text bytes, no NUL */
+    uint16_t boot;          /* Counts up on every boot */
+    uint16_t reserved;
+    uint32_t sequence;      /* Syslog sequence */
+    uint32_t time_ms;       /* Since boot */
+} logring_record_t;
+
+typedef struct
+{
+    int sector;             /* Sectors walked so far, oldest first */
+    uint32_t sequence;      /* Of the sector being read */
+    uint32_t offset;
+} logring_iter_t;
+
+/**
+ * @brief Find the partition and the end of the ring, called once by app_main
+ */
+void logring_init(void);
+
+/**
+ * @brief Queue one message in RAM, the syslog task calls it for every
+ *        message at or above CONFIG_SYSLOG_FLASH_MIN_LEVEL
+ */
+void logring_append(uint32_t facility, uint32_t level, uint32_t sequence,
+                    uint32_t time_ms, const char *text, int len);
+
+/**
+ * @brief Write the RAM buffer once it's old enough, called by the syslog task
+ */
+void logring_poll(void);
+void logring_flush(void);
+
+uint16_t logring_get_boot(void);
+
+void logring_iter_init(logring_iter_t *iter);
+
+/**
+ * @param[out] text NUL terminated, LOGRING_TEXT_MAXLEN + 1 bytes
+ * @return false after the newest record
+ */
+bool logring_iter_next(logring_iter_t *iter, logring_record_t *record,
+                       char *text);
+
+#ifdef __cplusplus
+}
+#endif
@@ -247,11 +247,27 @@ void max9814_setup()
 #else
     max9814_init_fft();
 #endif
+
+    // Sampling is too fast for the timer wheel, keep one esp_timer around
+    if(max9814_sample_timer_handle==NULL)
+    {
+#ifdef FFT4REAL
+        ESP_ERROR_CHECK(esp_timer_create(&max9814_sample_timer4real_args, &max9814_sample_timer_handle));
+#else
+        ESP_ERROR_CHECK(esp_timer_create(&max9814_sample_timer_args, &max9814_sample_timer_handle));
+#endif
+    }
     return;
 }
 
 bool max9814_buildup4real()
 {
+    if(max9814_sample_timer_handle==NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_MAX9814,SYSLOG_LEVEL_ERROR,"Sample timer not ready %d",__LINE__);
+        return false;
+    }
+
     if(pginput_signal==NULL)
     {
         pginput_signal = (float *)malloc(SAMPLE_COUNT*sizeof(float));
@@ -277,11 +293,7 @@ bool max9814_buildup4real()
         }
     }
 
-    if(max9814_sample_timer_handle==NULL)
-    {
-        esp_timer_create(&max9814_sample_timer4real_args, &max9814_sample_timer_handle);
-    }
-    else
+    if(esp_timer_is_active(max9814_sample_timer_handle))
     {
         esp_timer_stop(max9814_sample_timer_handle);
     }
@@ -297,6 +309,12 @@ bool max9814_buildup4real()
 
 bool max9814_buildup()
 {
+    if(max9814_sample_timer_handle==NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_MAX9814,SYSLOG_LEVEL_ERROR,"Sample timer not ready %d",__LINE__);
+        return false;
+    }
+
     if(pginput_signal==NULL)
     {
         pginput_signal = (float *)malloc(SAMPLE_COUNT*2*sizeof(float));
@@ -322,11 +340,7 @@ bool max9814_buildup()
         }
     }
 
-    if(max9814_sample_timer_handle==NULL)
-    {
-        esp_timer_create(&max9814_sample_timer_args, &max9814_sample_timer_handle);
-    }
-    else
+    if(esp_timer_is_active(max9814_sample_timer_handle))
     {
         esp_timer_stop(max9814_sample_timer_handle);
     }
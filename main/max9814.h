@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include "esp_adc/adc_oneshot.h"
+#include "sdkconfig.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -17,10 +18,21 @@ extern "C"
 #define MAX9814_HITACHI_AC_BEE_FREQ 3900
 #define MAX9814_ZERO_FAN_BEE_FREQ 3850
 #define MAX9814_DELTA_FAN_BEE_FREQ 2380
+/* Set in menuconfig once measured, 0 sends the frame once without listening */
+#ifdef CONFIG_IR_DYSON_FAN_BEE_FREQ
+#define MAX9814_DYSON_FAN_BEE_FREQ CONFIG_IR_DYSON_FAN_BEE_FREQ
+#else
+#define MAX9814_DYSON_FAN_BEE_FREQ 0
+#endif
 
 #define MAX9814_HITACHI_AC_BEE_THRESHOLD 100000
 #define MAX9814_ZERO_FAN_BEE_THRESHOLD 200000
 #define MAX9814_DELTA_FAN_BEE_THRESHOLD 300000
+#ifdef CONFIG_IR_DYSON_FAN_BEE_THRESHOLD
+#define MAX9814_DYSON_FAN_BEE_THRESHOLD CONFIG_IR_DYSON_FAN_BEE_THRESHOLD
+#else
+#define MAX9814_DYSON_FAN_BEE_THRESHOLD 0
+#endif
     // #define FFT4REAL
 
     void max9814_sample_adc();
@@ -744,8 +744,9 @@ bool nu_ld2410_update(float *sensor_data, int human_present, int is_training)
             syslog_handler(
                 SYSLOG_FACILITY_ANN, SYSLOG_LEVEL_DEBUG,
                 "False pred %.2f time %d, istraining %d, someone %d", pred,
-                (gnuld2410_less_nooneth_time - gnuld2410_less_someoneth_time) /
-                    1000000,
+                (int)((gnuld2410_less_nooneth_time -
+                       gnuld2410_less_someoneth_time) /
+                      1000000),
                 is_training, human_present);
             return false;
         }
@@ -853,7 +854,7 @@ bool nu_ld2410_set_weights_from_base64(const char *w_ih_b64,
     if (ret != 0 || olen != sizeof(float) * INPUT_SIZE * HIDDEN_SIZE)
     {
         syslog_handler(SYSLOG_FACILITY_ANN, SYSLOG_LEVEL_ERROR,
-                       "Base64 decode w_ih failed: ret=%d, olen=%d", ret, olen);
+                       "Base64 decode w_ih failed: ret=%d, olen=%d", ret, (int)olen);
         xSemaphoreGive(gsemaNULD2410Cfg);
         return false;
     }
@@ -865,7 +866,7 @@ bool nu_ld2410_set_weights_from_base64(const char *w_ih_b64,
     if (ret != 0 || olen != sizeof(float) * HIDDEN_SIZE * OUTPUT_SIZE)
     {
         syslog_handler(SYSLOG_FACILITY_ANN, SYSLOG_LEVEL_ERROR,
-                       "Base64 decode w_ho failed: ret=%d, olen=%d", ret, olen);
+                       "Base64 decode w_ho failed: ret=%d, olen=%d", ret, (int)olen);
         xSemaphoreGive(gsemaNULD2410Cfg);
         return false;
     }
@@ -877,7 +878,7 @@ bool nu_ld2410_set_weights_from_base64(const char *w_ih_b64,
     if (ret != 0 || olen != sizeof(float) * HIDDEN_SIZE)
     {
         syslog_handler(SYSLOG_FACILITY_ANN, SYSLOG_LEVEL_ERROR,
-                       "Base64 decode b_h failed: ret=%d, olen=%d", ret, olen);
+                       "Base64 decode b_h failed: ret=%d, olen=%d", ret, (int)olen);
         xSemaphoreGive(gsemaNULD2410Cfg);
         return false;
     }
@@ -889,7 +890,7 @@ bool nu_ld2410_set_weights_from_base64(const char *w_ih_b64,
     if (ret != 0 || olen != sizeof(float) * OUTPUT_SIZE)
     {
         syslog_handler(SYSLOG_FACILITY_ANN, SYSLOG_LEVEL_ERROR,
-                       "Base64 decode b_o failed: ret=%d, olen=%d", ret, olen);
+                       "Base64 decode b_o failed: ret=%d, olen=%d", ret, (int)olen);
         xSemaphoreGive(gsemaNULD2410Cfg);
         return false;
     }
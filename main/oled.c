@@ -13,9 +13,11 @@
 #include "ota.h"
 #include "rmt.h"
 #include "sdkconfig.h"
+#include "settings.h"
 #include "sntp.h"
 #include "syslog.h"
 #include "system.h"
+#include "timer_wheel.h"
 #include "wifi_provisioning/manager.h"
 #include <freertos/FreeRTOS.h>
 #include <time.h>
@@ -24,7 +26,7 @@
 
 static void oled_restoreconfig(void);
 
-esp_timer_handle_t gled_display_timer_handle = NULL;
+static int gled_display_timer = TIMER_WHEEL_INVALID;
 int gleddisplaytime = LED_DISPLAY_TIME;
 int gledsnoozetime = LED_SNOOZE_TIME;
 int gleddisplaymode = LED_DISPLAY_MODE_TIME;
@@ -63,12 +65,9 @@ int oled_setDisplayMode(int mode)
   {
     gleddisplaymode = mode;
 
-    if (gled_display_timer_handle != NULL)
+    if (gled_display_timer != TIMER_WHEEL_INVALID)
     {
-      if (esp_timer_is_active(gled_display_timer_handle))
-      {
-        esp_timer_stop(gled_display_timer_handle);
-      }
+      timer_wheel_stop(gled_display_timer);
 
       int timer_duration = 0;
       switch (mode)
@@ -89,8 +88,7 @@ int oled_setDisplayMode(int mode)
 
       if (timer_duration > 0)
       {
-        esp_timer_start_once(gled_display_timer_handle,
-                             (uint64_t)timer_duration * 1000 * 1000);
+        timer_wheel_start(gled_display_timer, timer_duration * 1000);
       }
     }
     xSemaphoreGive(gsemaOLEDCfg);
@@ -98,6 +96,14 @@ int oled_setDisplayMode(int mode)
   return SYSTEM_ERROR_NONE;
 }
 
+void oled_display_timer_restart(void)
+{
+  int leddisplaytime = 0;
+
+  oled_getDisplayTime(&leddisplaytime);
+  timer_wheel_start(gled_display_timer, leddisplaytime * 1000);
+}
+
 void oled_fan_countdown_start(int seconds)
 {
   gfan_countdown_end_us = esp_timer_get_time() + (int64_t)seconds * 1000000;
@@ -204,15 +210,13 @@ void task_oled(void *pvParameter)
   bool bdrawed = false;
   float temperature = 0, humidity = 0;
   uint8_t sys_mac[6];
-  int leddisplaytime = 0, orileddisplaymode;
+  int orileddisplaymode;
   esp_netif_ip_info_t sys_ip_info;
   int loop_counter = 0;
   int mq135aqi = 0;
   int mq135nox = 0;
 
   ESP_ERROR_CHECK(esp_wifi_get_mac(WIFI_IF_STA, sys_mac));
-  esp_timer_create_args_t led_display_timer_args = {
-      .callback = &led_display_app_timer_callback, .name = "led_display_timer"};
 
   i2c_master_init(&leddev, CONFIG_SDA_GPIO, CONFIG_SCL_GPIO, CONFIG_RESET_GPIO);
   ssd1306_init(&leddev, 128, 64);
@@ -227,22 +231,9 @@ void task_oled(void *pvParameter)
   // system_task_all_ready();  // Wait will cause wifi provision password can't
   // display
 
-  if (gled_display_timer_handle != NULL)
-  {
-    if (esp_timer_is_active(gled_display_timer_handle))
-    {
-      ESP_ERROR_CHECK(esp_timer_stop(gled_display_timer_handle));
-    }
-  }
-  else
-  {
-    ESP_ERROR_CHECK(
-        esp_timer_create(&led_display_timer_args, &gled_display_timer_handle));
-  }
-
-  oled_getDisplayTime(&leddisplaytime);
-  ESP_ERROR_CHECK(esp_timer_start_once(gled_display_timer_handle,
-                                       (leddisplaytime * 1000 * 1000)));
+  timer_wheel_add(&led_display_app_timer_callback, NULL, "led_display_timer",
+                  &gled_display_timer);
+  oled_display_timer_restart();
 
   while (1)
   {
@@ -503,8 +494,7 @@ void task_oled(void *pvParameter)
           {
             gfan_countdown_end_us = 0;
             xSemaphoreGive(gsemaLED);
-            if (gled_display_timer_handle != NULL &&
-                esp_timer_is_active(gled_display_timer_handle))
+            if (timer_wheel_is_active(gled_display_timer))
             {
               oled_setDisplayMode(LED_DISPLAY_MODE_TIME);
             }
@@ -761,23 +751,11 @@ static void oled_restoreconfig(void)
 
 void oled_saveconfig(char *key, int32_t data)
 {
-  nvs_handle_t nvs_handle;
-  esp_err_t ret;
-
-  ret = nvs_open(OLED_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-  if (ret != ESP_OK)
+  if (settings_set_i32(OLED_NVS_NAMESPACE, key, data) != SYSTEM_ERROR_NONE)
   {
-    ESP_LOGE(TAG_NVS, "NVS open failed: %s", esp_err_to_name(ret));
+    ESP_LOGE(TAG_NVS, "Config key %s invalid", key);
     return;
   }
-
-  int32_t value1 = data;
-  ret = nvs_set_i32(nvs_handle, key, value1);
-  if (ret != ESP_OK)
-  {
-    ESP_LOGE(TAG_NVS, "NVS set failed for key1: %s", esp_err_to_name(ret));
-  }
-  nvs_close(nvs_handle);
   syslog_handler(SYSLOG_FACILITY_OLED, SYSLOG_LEVEL_INFO, "Config saved %s %d",
                  key, data);
   return;
@@ -26,6 +26,7 @@
 
 void led_display_app_timer_callback();
 void oled_saveconfig(char *key, int32_t data);
+void oled_display_timer_restart(void);
 void oled_fan_countdown_start(int seconds);
 void oled_fan_countdown_stop(void);
 void draw_qrcode_to_oled(SSD1306_t * dev, const uint8_t *qrcode, int size);
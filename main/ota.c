@@ -5,6 +5,7 @@
  */
 
 #include "ota.h"
+#include "settings.h"
 #include "syslog.h"
 #include "system.h"
 #include <errno.h>
@@ -298,7 +299,7 @@ void ota_restoreconfig(void) {
   if (gsemaOTA == NULL) {
     return;
   }
-  ret = nvs_open("OTACFG", NVS_READWRITE, &nvs_handle);
+  ret = nvs_open(OTA_NVS_CFG_NAMESPACE, NVS_READWRITE, &nvs_handle);
   if (ret != ESP_OK) {
     ESP_LOGE(TAG_NVS, "NVS open failed: %s", esp_err_to_name(ret));
     xSemaphoreGive(gsemaOTA);
@@ -325,21 +326,10 @@ void ota_restoreconfig(void) {
 }
 
 void ota_saveconfig(char *key, char *str) {
-  nvs_handle_t nvs_handle;
-  esp_err_t ret;
-
-  ret = nvs_open("OTACFG", NVS_READWRITE, &nvs_handle);
-  if (ret != ESP_OK) {
-    ESP_LOGE(TAG_NVS, "NVS open failed: %s", esp_err_to_name(ret));
-    xSemaphoreGive(gsemaOTA);
+  if (settings_set_str(OTA_NVS_CFG_NAMESPACE, key, str) != SYSTEM_ERROR_NONE) {
+    ESP_LOGE(TAG_NVS, "Config key %s invalid", key);
     return;
   }
-
-  ret = nvs_set_str(nvs_handle, key, str);
-  if (ret != ESP_OK) {
-    ESP_LOGE(TAG_NVS, "NVS set failed for key1: %s", esp_err_to_name(ret));
-  }
-  nvs_close(nvs_handle);
   syslog_handler(SYSLOG_FACILITY_OTA, SYSLOG_LEVEL_INFO, "Config saved %s",
                  key);
   return;
@@ -536,6 +526,10 @@ ota_update_index_html(const esp_http_client_config_t *base_cfg) {
     return ESP_FAIL;
   }
 
+  // The packed page of the SPIFFS image is older, serve this one instead
+  remove("/spiffs/index.html.gz");
+  remove("/spiffs/index.html.etag");
+
   syslog_handler(SYSLOG_FACILITY_OTA, SYSLOG_LEVEL_DEBUG,
                  "HTML OTA updated %u bytes", (unsigned int)total_written);
   return ESP_OK;
@@ -16,6 +16,7 @@ extern "C" {
 #endif
 
 #define OTA_NVS_NAMESPACE       "ota"
+#define OTA_NVS_CFG_NAMESPACE   "OTACFG"
 #define OTA_NVS_STATUS_KEY      "ota_status"
 #define OTA_NVS_SERVER_IP       "serverip"
 #define OTA_NVS_FILENAME        "filename"
@@ -6,6 +6,11 @@
 
 #include <string.h>
 #include "rmt.h"
+#include "ir_protocol.h"
+#include "ir_symbol_cache.h"
+#include "ir_learn.h"
+#include "ir_stats.h"
+#include "timer_wheel.h"
 #include "max9814.h"
 #include "system.h"
 #include "homekit.h"
@@ -32,40 +37,288 @@ uint8_t grmt_zroBuffer[2] = {0x76, 0x80};
 uint8_t grmt_deltaBuffer[4] = {0x00, 0x0F, 0x12, 0xED};
 uint8_t grmt_deltatimerBuffer[4] = {0x00, 0x0F, 0x05,
                                     0xFA}; /* Enable Delta Fan 4HR */
-uint8_t grmt_deltascheduler[IR_DELTA_FAN_TIGGER_MODE_MAX] = {
-    DELTA_FAN_SCHDULER_IDEL, DELTA_FAN_SCHDULER_IDEL, DELTA_FAN_SCHDULER_IDEL,
-    DELTA_FAN_SCHDULER_IDEL, DELTA_FAN_SCHDULER_IDEL};
 uint8_t grmt_deltaschedulerName[IR_DELTA_FAN_TIGGER_MODE_MAX + 1][10] = {
     "Manual", "Exhaust", "Warm", "Dry", "Homekit", "Off", "Keep"};
 QueueHandle_t gqueue_rmt_tx;
-ir_hta_scan_code_t grmt_hta_data;
-ir_zro_scan_code_t grmt_zro_data;
-ir_delta_scan_code_t grmt_delta_data;
-ir_dyson_scan_code_t grmt_dyson_data;
-esp_timer_handle_t ghitachiac_delay_timer_handle = NULL;
-esp_timer_handle_t gsync_delta_manual_timer_handle = NULL;
+static int ghitachiac_delay_timer = TIMER_WHEEL_INVALID;
 
 static void ir_update_hap_Hitachi_status(int active, int temp, int state,
                                          int speed, int swing);
 static void ir_update_hap_zerofan_status(int active, int speed, int swing);
+static void ir_update_hap_dysonfan_status(int active, int speed, int swing);
+
+/* Desired state per appliance. Producers merge into the slot and only post
+   the IR type to gqueue_rmt_tx when the slot turns pending, task_rmt sends
+   the latest state once. */
+static rmt_msg_t grmt_txslot[IR_TYPE_MAX];
+static bool grmt_txslot_pending[IR_TYPE_MAX] = {false};
+static SemaphoreHandle_t gsemaRmtTxSlot = NULL;
+
+/* RX ping-pong buffers. task_rmt keeps one armed and hands the received one
+   to task_ir_rx, which decodes it and does the HomeKit/NVS side effects, then
+   gives it back through gqueue_rmt_rx_free. */
+typedef struct
+{
+    uint8_t buffer;
+    size_t num_symbols;
+} rmt_rx_frame_t;
+
+static rmt_symbol_word_t grmt_rx_symbols[RMT_RX_BUFFER_NUM]
+                                        [RMT_RX_MEM_BLK_SYMB];
+static QueueHandle_t gqueue_rmt_rx_parse = NULL;
+static QueueHandle_t gqueue_rmt_rx_free = NULL;
+static uint32_t grmt_rx_frames = 0;
+static uint32_t grmt_rx_dropped = 0;
+
+/* Time from the first enqueue of a slot to its first frame on air, guarded
+   by gsemaRmtTxSlot */
+static rmt_tx_latency_t grmt_tx_latency[IR_TYPE_MAX];
+
+/* Delta Fan leases, guarded by gsemaRmtDeltaSche. Bit n of the mask is set
+   while mode n holds a lease, the lowest bit runs and the others pend. A
+   lease either lasts forever or ends with its timer in the wheel. */
+static uint8_t grmt_deltalease_mask = 0;
+static int grmt_deltalease_timer[IR_DELTA_FAN_TIGGER_MODE_OFF] = {
+    TIMER_WHEEL_INVALID, TIMER_WHEEL_INVALID, TIMER_WHEEL_INVALID,
+    TIMER_WHEEL_INVALID, TIMER_WHEEL_INVALID};
+
+static void rmt_merge_msg(rmt_msg_t *slot, const rmt_msg_t *msg)
+{
+    slot->type = msg->type;
+    slot->repeat = msg->repeat;
+    slot->targetfreq = msg->targetfreq;
+    slot->pwrthreshold = msg->pwrthreshold;
+
+    switch (msg->type)
+    {
+        case IR_TYPE_ZERO:
+        case IR_TYPE_DYSON:
+            /* +-0 and Dyson Fan keys are relative, power and swing toggle and
+               speed steps, so accumulate instead of overwrite */
+            if (msg->bstatusch)
+            {
+                slot->status = !slot->status;
+                slot->bstatusch = slot->status;
+            }
+            if (msg->bfanspeedch)
+            {
+                slot->fanspeed += msg->fanspeed;
+                slot->bfanspeedch = (slot->fanspeed != 0);
+            }
+            if (msg->bswingch)
+            {
+                slot->swing = !slot->swing;
+                slot->bswingch = slot->swing;
+            }
+            break;
+        case IR_TYPE_HITACHI:
+            if (msg->bstatusch)
+            {
+                slot->bstatusch = true;
+                slot->status = msg->status;
+            }
+            if (msg->bmodech)
+            {
+                slot->bmodech = true;
+                slot->mode = msg->mode;
+            }
+            if (msg->bfanspeedch)
+            {
+                slot->bfanspeedch = true;
+                slot->fanspeed = msg->fanspeed;
+            }
+            if (msg->bswingch)
+            {
+                slot->bswingch = true;
+                slot->swing = msg->swing;
+            }
+            /* Both thresholds write the same temperature bytes, keep the
+               latest one only */
+            if (msg->blothch)
+            {
+                slot->blothch = true;
+                slot->loth = msg->loth;
+                slot->bhithch = false;
+            }
+            if (msg->bhithch)
+            {
+                slot->bhithch = true;
+                slot->hith = msg->hith;
+                slot->blothch = false;
+            }
+            break;
+        case IR_TYPE_LEARN:
+            /* Every requested command is sent once */
+            slot->learnmask |= msg->learnmask;
+            break;
+        case IR_TYPE_DELTA:
+        default:
+            /* Absolute state, last writer wins */
+            memcpy(slot, msg, sizeof(rmt_msg_t));
+            break;
+    }
+}
 
 static bool rmt_enqueue_msg(const rmt_msg_t *msg)
 {
-    if (gqueue_rmt_tx == NULL)
+    char type = msg->type;
+    bool notify = false;
+    int64_t enqueue_us = esp_timer_get_time();
+
+    if ((gqueue_rmt_tx == NULL) || (gsemaRmtTxSlot == NULL))
     {
         syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_ERROR,
                        "TX queue not ready");
         return false;
     }
-    if (xQueueSend(gqueue_rmt_tx, msg, 0) != pdTRUE)
+    if ((type <= 0) || (type >= IR_TYPE_MAX))
     {
         syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_ERROR,
-                       "TX queue full");
+                       "Drop IR with invalid type %d", type);
         return false;
     }
+
+    if (xSemaphoreTake(gsemaRmtTxSlot, portMAX_DELAY) == pdTRUE)
+    {
+        /* Coalesced requests keep the time of the first one */
+        if (grmt_txslot_pending[(int)type])
+        {
+            enqueue_us = grmt_txslot[(int)type].enqueue_us;
+        }
+        rmt_merge_msg(&grmt_txslot[(int)type], msg);
+        grmt_txslot[(int)type].enqueue_us = enqueue_us;
+        if (!grmt_txslot_pending[(int)type])
+        {
+            grmt_txslot_pending[(int)type] = true;
+            notify = true;
+        }
+        xSemaphoreGive(gsemaRmtTxSlot);
+    }
+
+    if (notify)
+    {
+        /* At most one notification per type, queue can't be full */
+        if (xQueueSend(gqueue_rmt_tx, &type, 0) != pdTRUE)
+        {
+            syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_ERROR,
+                           "TX queue full");
+            if (xSemaphoreTake(gsemaRmtTxSlot, portMAX_DELAY) == pdTRUE)
+            {
+                grmt_txslot_pending[(int)type] = false;
+                memset(&grmt_txslot[(int)type], 0, sizeof(rmt_msg_t));
+                xSemaphoreGive(gsemaRmtTxSlot);
+            }
+            return false;
+        }
+    }
+    else
+    {
+        syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_DEBUG,
+                       "Coalesce IR %d into pending state", type);
+    }
     return true;
 }
 
+/**
+ * @brief Take the next frame to send from the slot of type
+ *
+ * @return true if the slot still has +-0 or Dyson Fan steps or learned
+ *         commands left
+ */
+static bool rmt_dequeue_msg(char type, rmt_msg_t *msg)
+{
+    bool more = false;
+    rmt_msg_t *slot = &grmt_txslot[(int)type];
+
+    memset(msg, 0, sizeof(rmt_msg_t));
+    if (xSemaphoreTake(gsemaRmtTxSlot, portMAX_DELAY) == pdTRUE)
+    {
+        if ((type == IR_TYPE_ZERO) || (type == IR_TYPE_DYSON))
+        {
+            /* One key per frame, the same order as the tigger */
+            msg->type = slot->type;
+            msg->targetfreq = slot->targetfreq;
+            msg->pwrthreshold = slot->pwrthreshold;
+            msg->enqueue_us = slot->enqueue_us;
+            slot->enqueue_us = 0;
+            if (slot->bstatusch)
+            {
+                msg->bstatusch = true;
+                slot->bstatusch = false;
+                slot->status = false;
+            }
+            else if (slot->bfanspeedch)
+            {
+                msg->bfanspeedch = true;
+                msg->fanspeed = (slot->fanspeed > 0) ? 1 : -1;
+                slot->fanspeed -= msg->fanspeed;
+                slot->bfanspeedch = (slot->fanspeed != 0);
+            }
+            else if (slot->bswingch)
+            {
+                msg->bswingch = true;
+                slot->bswingch = false;
+                slot->swing = false;
+            }
+            more = slot->bstatusch || slot->bfanspeedch || slot->bswingch;
+        }
+        else if (type == IR_TYPE_LEARN)
+        {
+            /* One learned command per call, lowest index first */
+            msg->type = slot->type;
+            msg->enqueue_us = slot->enqueue_us;
+            slot->enqueue_us = 0;
+            msg->learnmask = slot->learnmask & (~slot->learnmask + 1);
+            slot->learnmask &= ~msg->learnmask;
+            more = (slot->learnmask != 0);
+        }
+        else
+        {
+            memcpy(msg, slot, sizeof(rmt_msg_t));
+        }
+
+        if (!more)
+        {
+            memset(slot, 0, sizeof(rmt_msg_t));
+            grmt_txslot_pending[(int)type] = false;
+        }
+        xSemaphoreGive(gsemaRmtTxSlot);
+    }
+    return more;
+}
+
+/**
+ * @brief Account the enqueue-to-air time of a frame, only the first frame
+ *        of a slot carries enqueue_us
+ */
+static void rmt_tx_latency_record(rmt_msg_t *msg)
+{
+    rmt_tx_latency_t *latency = NULL;
+    int64_t elapsed = 0;
+
+    if ((msg->enqueue_us == 0) || (msg->type <= 0) ||
+        (msg->type >= IR_TYPE_MAX))
+    {
+        return;
+    }
+    elapsed = esp_timer_get_time() - msg->enqueue_us;
+    msg->enqueue_us = 0;
+    if (xSemaphoreTake(gsemaRmtTxSlot, portMAX_DELAY) == pdTRUE)
+    {
+        latency = &grmt_tx_latency[(int)msg->type];
+        latency->count++;
+        latency->last_us = elapsed;
+        latency->total_us += elapsed;
+        if (elapsed > latency->max_us)
+        {
+            latency->max_us = elapsed;
+        }
+        xSemaphoreGive(gsemaRmtTxSlot);
+    }
+    syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_DEBUG,
+                   "IR %d on air %lld us after enqueue", msg->type, elapsed);
+}
+
 static inline void rmt_rx_gpio_disable(void)
 {
     gpio_set_direction(RMT_RX_GPIO_NUM, GPIO_MODE_DISABLE);
@@ -80,16 +333,10 @@ static inline void rmt_rx_gpio_enable(void)
 SemaphoreHandle_t gsemaRMTCfg = NULL;
 
 static void dbg_ir_tx_rmt_dataraw(uint8_t *data, int length);
-static inline bool ir_check_in_range(uint32_t signal_duration,
-                                     uint32_t spec_duration);
-static bool ir_parse_frame_end(rmt_symbol_word_t *rmt_nec_symbols, char type);
-static bool ir_parse_frame_repeat(rmt_symbol_word_t *rmt_nec_symbols,
-                                  char type);
-static char ir_parse_frame(rmt_symbol_word_t *rmt_nec_symbols, int framelen);
+static char ir_parse_frame(rmt_symbol_word_t *rmt_nec_symbols, int framelen,
+                           ir_protocol_result_t *result);
 static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
                               size_t symbol_num);
-static bool ir_parse_logic0(rmt_symbol_word_t *rmt_nec_symbols, char type);
-static bool ir_parse_logic1(rmt_symbol_word_t *rmt_nec_symbols, char type);
 static bool ir_rmt_rx_done_callback(rmt_channel_handle_t channel,
                                     const rmt_rx_done_event_data_t *edata,
                                     void *user_data);
@@ -103,6 +350,15 @@ static void ir_update_deltafan_status(int active, int speed);
 static void rmt_restart_receive(rmt_channel_handle_t channel,
                                 rmt_symbol_word_t *symbols, size_t symbols_size,
                                 const rmt_receive_config_t *config);
+static void ir_deltafan_lease_expired(void *arg);
+static void ir_transmit_learn(rmt_channel_handle_t tx_channel,
+                              rmt_encoder_handle_t encoder,
+                              const rmt_transmit_config_t *config,
+                              QueueHandle_t transmit_queue, uint16_t learnmask,
+                              rmt_symbol_word_t *symbols, size_t max_symbols);
+static uint8_t rmt_rx_dispatch(uint8_t armed,
+                               const rmt_rx_done_event_data_t *rx_data);
+static void task_ir_rx(void *pvParameters);
 
 static void dbg_ir_tx_rmt_dataraw(uint8_t *data, int length)
 {
@@ -116,312 +372,40 @@ static void dbg_ir_tx_rmt_dataraw(uint8_t *data, int length)
 }
 
 /**
- * @brief Check whether a duration is within expected range
+ * @brief Decode RMT symbols with the protocol table
  */
-static inline bool ir_check_in_range(uint32_t signal_duration,
-                                     uint32_t spec_duration)
+static char ir_parse_frame(rmt_symbol_word_t *rmt_nec_symbols, int framelen,
+                           ir_protocol_result_t *result)
 {
-    return (signal_duration < (spec_duration + IR_HTA_DECODE_MARGIN)) &&
-           (signal_duration > ((spec_duration > IR_HTA_DECODE_MARGIN)
-                                   ? (spec_duration - IR_HTA_DECODE_MARGIN)
-                                   : 0));
-}
-
-/**
- * @brief Check whether the RMT symbols represent NEC repeat code
- */
-static bool ir_parse_frame_end(rmt_symbol_word_t *rmt_nec_symbols, char type)
-{
-    int end_dur_0 = 0;
-    int end_dur_1 = 0;
-    switch (type)
+    if (!ir_protocol_parse(rmt_nec_symbols, framelen, result))
     {
-        case IR_TYPE_HITACHI:
-            end_dur_0 = HTA_END_CODE_DURATION_0;
-            end_dur_1 = HTA_END_CODE_DURATION_1;
-            break;
-        case IR_TYPE_ZERO:
-            end_dur_0 = ZERO_END_CODE_DURATION_0;
-            end_dur_1 = ZERO_END_CODE_DURATION_1;
-            break;
-        case IR_TYPE_DELTA:
-            end_dur_0 = DELTA_END_CODE_DURATION_0;
-            end_dur_1 = DELTA_END_CODE_DURATION_1;
-            break;
-        case IR_TYPE_DYSON:
-            end_dur_0 = DYSON_END_CODE_DURATION_0;
-            end_dur_1 = DYSON_END_CODE_DURATION_0;
-            break;
-        default:
-            break;
+        return 0;
     }
-
-    return ((rmt_nec_symbols->duration0 < end_dur_0 + IR_HTA_DECODE_MARGIN) &&
-            (rmt_nec_symbols->duration0 > end_dur_0 - IR_HTA_DECODE_MARGIN));
-}
-
-/**
- * @brief Check whether the RMT symbols represent NEC repeat code
- */
-static bool ir_parse_frame_repeat(rmt_symbol_word_t *rmt_nec_symbols, char type)
-{
-    int rpt_dur_0 = 0;
-    int rpt_dur_1 = 0;
-    switch (type)
+#if 0
+    dbg_printf("\n IR %d pass \n", result->type);
+    for (int i = 0; i < result->data_len; i++)
     {
-        case IR_TYPE_HITACHI:
-            rpt_dur_0 = 0;
-            rpt_dur_1 = 0;
-            break;
-        case IR_TYPE_ZERO:
-            rpt_dur_0 = ZERO_REPEAT_CODE_DURATION_0;
-            rpt_dur_1 = ZERO_REPEAT_CODE_DURATION_1;
-            break;
-        case IR_TYPE_DELTA:
-            rpt_dur_0 = DELTA_REPEAT_CODE_DURATION_0;
-            rpt_dur_1 = DELTA_REPEAT_CODE_DURATION_1;
-            break;
-        default:
-            break;
+        if (i % 4 == 0) dbg_printf(" ");
+        dbg_printf("%02X", result->data[i]);
     }
-    return ir_check_in_range(rmt_nec_symbols->duration0, rpt_dur_0) &&
-           ir_check_in_range(rmt_nec_symbols->duration1, rpt_dur_1);
+    dbg_printf("\n Repeat %d\n", result->repeat);
+#endif
+    return result->type;
 }
 
 /**
- * @brief Decode RMT symbols into NEC address and command
+ * @brief Adopt a received Hitachi frame as the AC state
+ *
+ * task_ir_rx decodes while task_rmt forms frames from the same buffer, both
+ * sides hold gsemaRmtTxSlot around grmt_htaBuffer.
  */
-static char ir_parse_frame(rmt_symbol_word_t *rmt_nec_symbols, int framelen)
+static void rmt_store_hitachi(const uint8_t *data)
 {
-    int i = 0;
-    int loc = 0;
-    rmt_symbol_word_t *cur = rmt_nec_symbols;
-    char parse_type = 0;
-    bool valid_leading_code = false;
-    int counter1 = 0, counter0 = 0;
-
-    valid_leading_code =
-        ir_check_in_range(cur->duration0, HTA_LEADING_CODE_DURATION_0) &&
-        ir_check_in_range(cur->duration1, HTA_LEADING_CODE_DURATION_1);
-    if (valid_leading_code)
-    {
-        parse_type = IR_TYPE_HITACHI;
-    }
-
-    valid_leading_code =
-        ir_check_in_range(cur->duration0, ZERO_LEADING_CODE_DURATION_0) &&
-        ir_check_in_range(cur->duration1, ZERO_LEADING_CODE_DURATION_1);
-    if (valid_leading_code)
-    {
-        parse_type = IR_TYPE_ZERO;
-    }
-
-    valid_leading_code =
-        ir_check_in_range(cur->duration0, DELTA_LEADING_CODE_DURATION_0) &&
-        ir_check_in_range(cur->duration1, DELTA_LEADING_CODE_DURATION_1);
-    if (valid_leading_code)
+    if (xSemaphoreTake(gsemaRmtTxSlot, portMAX_DELAY) == pdTRUE)
     {
-        parse_type = IR_TYPE_DELTA;
+        memcpy(grmt_htaBuffer, data, sizeof(grmt_htaBuffer));
+        xSemaphoreGive(gsemaRmtTxSlot);
     }
-
-    valid_leading_code =
-        ir_check_in_range(cur->duration0, DYSON_LEADING_CODE_DURATION_0) &&
-        ir_check_in_range(cur->duration1, DYSON_LEADING_CODE_DURATION_1);
-    if (valid_leading_code)
-    {
-        parse_type = IR_TYPE_DYSON;
-    }
-
-    if (parse_type == 0)
-    {
-        return false;
-    }
-
-    cur++;
-    if (parse_type == IR_TYPE_HITACHI)
-    {
-        for (i = 0; i < framelen - 1; i++)
-        {
-            if (ir_parse_logic1(cur, parse_type))
-            {
-                grmt_hta_data.data[i / 8] |= 1 << (i % 8);
-            }
-            else if (ir_parse_logic0(cur, parse_type))
-            {
-                grmt_hta_data.data[i / 8] &= ~(1 << (i % 8));
-            }
-            else if (ir_parse_frame_end(cur, parse_type))
-            {
-                break;
-            }
-            else
-            {
-                return 0;
-            }
-            cur++;
-        }
-#if 0
-        dbg_printf("\n HITACHI pass \n");
-
-        for(i=0;i<44;i++)
-        {
-            if(i%4==0)
-                dbg_printf(" ");
-            dbg_printf("%02X",grmt_hta_data.data[i]);
-        }
-#endif
-    }
-    if (parse_type == IR_TYPE_ZERO)
-    {
-        for (i = 0; i < framelen - 1; i++)
-        {
-            if (ir_parse_logic1(cur, parse_type))
-            {
-                grmt_zro_data.data[loc / 8] |= 1 << (loc % 8);
-                loc++;
-            }
-            else if (ir_parse_logic0(cur, parse_type))
-            {
-                grmt_zro_data.data[loc / 8] &= ~(1 << (loc % 8));
-                loc++;
-            }
-            else if (ir_parse_frame_repeat(cur, parse_type))
-            {
-                grmt_zro_data.repeat++;
-                loc = 0;
-                cur++;
-            }
-            else if (ir_parse_frame_end(cur, parse_type))
-            {
-                break;
-            }
-            else
-            {
-                return 0;
-            }
-            cur++;
-        }
-#if 0
-        dbg_printf("\n ZERO pass \n");
-
-        for(i=0;i<2;i++)
-        {
-            if(i%4==0)
-                dbg_printf(" ");
-            dbg_printf("%02X",grmt_zro_data.data[i]);
-        }
-        printf("\n Repeat %d\n",grmt_zro_data.repeat);
-#endif
-    }
-    if (parse_type == IR_TYPE_DELTA)
-    {
-        int repeat = 0;
-        for (i = 0; i < framelen - 1; i++)
-        {
-            if (ir_parse_logic1(cur, parse_type))
-            {
-                if (repeat)
-                {
-                    grmt_delta_data.time[loc / 8] |= 1 << (loc % 8);
-                }
-                else
-                {
-                    grmt_delta_data.data[loc / 8] |= 1 << (loc % 8);
-                }
-                loc++;
-                counter1++;
-            }
-            else if (ir_parse_logic0(cur, parse_type))
-            {
-                if (repeat)
-                {
-                    grmt_delta_data.time[loc / 8] &= ~(1 << (loc % 8));
-                }
-                else
-                {
-                    grmt_delta_data.data[loc / 8] &= ~(1 << (loc % 8));
-                }
-                loc++;
-                counter0++;
-            }
-            else if (ir_parse_frame_repeat(cur, parse_type))
-            {
-                grmt_delta_data.repeat++;
-                repeat = 1;
-                loc = 0;
-                cur++;
-            }
-            else if (ir_parse_frame_end(cur, parse_type))
-            {
-                break;
-            }
-            else
-            {
-                return 0;
-            }
-            cur++;
-        }
-#if 0
-        dbg_printf("\n DELTA pass\n");
-        
-        for(i=0;i<4;i++)
-        {
-            if(i%4==0)
-                dbg_printf(" ");
-            dbg_printf("%02X",grmt_delta_data.data[i]);
-        }
-        for(i=0;i<4;i++)
-        {
-            if(i%4==0)
-                dbg_printf(" ");
-            dbg_printf("%02X",grmt_delta_data.time[i]);
-        }
-        dbg_printf("\n");
-#endif
-    }
-    if (parse_type == IR_TYPE_DYSON)
-    {
-        for (i = 0; i < framelen - 1; i++)
-        {
-            if (ir_parse_logic1(cur, parse_type))
-            {
-                grmt_dyson_data.data[loc / 8] |= 1 << (loc % 8);
-                loc++;
-            }
-            else if (ir_parse_logic0(cur, parse_type))
-            {
-                grmt_dyson_data.data[loc / 8] &= ~(1 << (loc % 8));
-                loc++;
-            }
-            else if (ir_parse_frame_repeat(cur, parse_type))
-            {
-                grmt_dyson_data.repeat++;
-                loc = 0;
-                cur++;
-            }
-            else if (ir_parse_frame_end(cur, parse_type))
-            {
-                break;
-            }
-            else
-            {
-                return 0;
-            }
-            cur++;
-        }
-#if 0
-        dbg_printf("\n DYSON pass \n");
-
-        for(i=0;i<3;i++)
-        {
-            if(i%4==0)
-                dbg_printf(" ");
-            dbg_printf("%02X",grmt_dyson_data.data[i]);
-        }
-        printf("\n Repeat %d\n",grmt_dyson_data.repeat);
-#endif
-    }
-    return parse_type;
 }
 
 /**
@@ -436,15 +420,11 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
     int speed = 0;
     int swing = -1;
     char irtype = 0;
+    ir_protocol_result_t ir_result;
     uint8_t sys_mac[6];
 
     ESP_ERROR_CHECK(esp_wifi_get_mac(WIFI_IF_STA, sys_mac));
 
-    esp_timer_create_args_t sync_delta_manual_timer_args = {
-        .callback = &ir_sync_delta_manual_timer_callback,
-        .name = "sync_delta_timer"  // 計時器名稱，用於調試
-    };
-
 #if 0
     printf("\n\nIR frame start---\r\n");
     for (size_t i = 0; i < symbol_num; i++) {
@@ -454,36 +434,32 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
     printf("--- frame end: %d\n\n",symbol_num);
 #endif
     // decode RMT symbols
-    memset(&grmt_hta_data, 0, sizeof(ir_hta_scan_code_t));
-    memset(&grmt_zro_data, 0, sizeof(ir_zro_scan_code_t));
-    irtype = ir_parse_frame(rmt_nec_symbols, symbol_num);
+    irtype = ir_parse_frame(rmt_nec_symbols, symbol_num, &ir_result);
     switch (irtype)
     {
         case IR_TYPE_HITACHI:
             if (!IS_BATHROOM(sys_mac))
             {
-                temp = (((grmt_hta_data.data[HITACHI_IRP_TEMPERATURE_BYTE_HI]
+                temp = (((ir_result.data[HITACHI_IRP_TEMPERATURE_BYTE_HI]
                           << 8) +
-                         grmt_hta_data.data[HITACHI_IRP_TEMPERATURE_BYTE_LO]) -
+                         ir_result.data[HITACHI_IRP_TEMPERATURE_BYTE_LO]) -
                         HITACHI_MIN_TEMPERATURE_HILO) /
                            HITACHI_GAP_TEMPERATURE +
                        HITACHI_MIN_TEMPERATURE;
-                switch (grmt_hta_data.data[HITACHI_IRP_ACTICE_BYTE])
+                switch (ir_result.data[HITACHI_IRP_ACTICE_BYTE])
                 {
                     case HITACHI_IRP_ACTIVE_VALUE:
                         active = 1;
-                        memcpy(grmt_htaBuffer, grmt_hta_data.data,
-                               sizeof(grmt_htaBuffer));
+                        rmt_store_hitachi(ir_result.data);
                         break;
                     case HITACHI_IRP_INACTIVE_VALUE:
                         active = 0;
-                        memcpy(grmt_htaBuffer, grmt_hta_data.data,
-                               sizeof(grmt_htaBuffer));
+                        rmt_store_hitachi(ir_result.data);
                         break;
                     default:
                         break;
                 }
-                switch (grmt_hta_data.data[HITACHI_IRP_STATE_BYTE] & 0x0F)
+                switch (ir_result.data[HITACHI_IRP_STATE_BYTE] & 0x0F)
                 {
                     case HITACHI_IRP_COOLER_VALUE:
                         mode = HITACHI_AC_MODE_COOLER;
@@ -495,7 +471,7 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
                         mode = HITACHI_AC_MODE_AUTO;
                         break;
                 }
-                switch (grmt_hta_data.data[HITACHI_IRP_STATE_BYTE] & 0xF0)
+                switch (ir_result.data[HITACHI_IRP_STATE_BYTE] & 0xF0)
                 {
                     case HITACHI_IRP_FANHI_VALUE:
                         speed = HITACHI_AC_MAX_FAN_SPEED;
@@ -513,10 +489,10 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
                         speed = HITACHI_AC_AUTO_FAN_SPEED;
                         break;
                 }
-                if (grmt_hta_data.data[HITACHI_IRP_OPCODE_BYTE] ==
+                if (ir_result.data[HITACHI_IRP_OPCODE_BYTE] ==
                     HITACHI_IRP_OPCODE_SWING_VALUE)
                 {
-                    switch (grmt_hta_data.data[HITACHI_IRP_SWING_UD_BYTE] &
+                    switch (ir_result.data[HITACHI_IRP_SWING_UD_BYTE] &
                             0x20)
                     {
                         case HITACHI_IRP_SWING_VALUE:
@@ -545,19 +521,14 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
                 }
                 else
                 {
-                    if (ghitachiac_delay_timer_handle != NULL)
+                    /* Received turn on from remote controller then stop
+                     * timer for fan only 5 min */
+                    if (timer_wheel_is_active(ghitachiac_delay_timer))
                     {
-                        /* Received turn on from remote controller then stop
-                         * timer for fan only 5 min */
-                        if (esp_timer_is_active(ghitachiac_delay_timer_handle))
-                        {
-                            syslog_handler(SYSLOG_FACILITY_RMT,
-                                           SYSLOG_LEVEL_DEBUG,
-                                           "IR stop fan only timer");
-                            ESP_ERROR_CHECK(
-                                esp_timer_stop(ghitachiac_delay_timer_handle));
-                            oled_fan_countdown_stop();
-                        }
+                        syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_DEBUG,
+                                       "IR stop fan only timer");
+                        timer_wheel_stop(ghitachiac_delay_timer);
+                        oled_fan_countdown_stop();
                     }
                     syslog_handler(
                         SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_INFO,
@@ -588,8 +559,8 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
         case IR_TYPE_ZERO:
             if (!IS_BATHROOM(sys_mac))
             {
-                if ((grmt_zro_data.data[0] == 0x76) &&
-                    (grmt_zro_data.data[1] == 0x80))
+                if ((ir_result.data[0] == 0x76) &&
+                    (ir_result.data[1] == 0x80))
                 {
                     active = rmt_iszerofanactive();
                     active = (active == 1) ? 0 : 1;
@@ -604,8 +575,8 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
                                    "IR change +-0 Fan status");
                     zerofan_saveconfig(ZEROFAN_NVS_STATUS_KEY, active);
                 }
-                if ((grmt_zro_data.data[0] == 0x76) &&
-                    (grmt_zro_data.data[1] == 0x40))
+                if ((ir_result.data[0] == 0x76) &&
+                    (ir_result.data[1] == 0x40))
                 {
                     rmt_getzerofanspeed(&speed);
                     speed = (speed + 1) > 9 ? 9 : (speed + 1);
@@ -614,8 +585,8 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
                                    "IR increase +-0 Fan speed");
                     zerofan_saveconfig(ZEROFAN_NVS_SPEED_KEY, speed);
                 }
-                if ((grmt_zro_data.data[0] == 0x76) &&
-                    (grmt_zro_data.data[1] == 0x62))
+                if ((ir_result.data[0] == 0x76) &&
+                    (ir_result.data[1] == 0x62))
                 {
                     rmt_getzerofanspeed(&speed);
                     speed = (speed - 1 > 0) ? (speed - 1) : 1;
@@ -624,8 +595,8 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
                                    "IR decrease +-0 Fan speed");
                     zerofan_saveconfig(ZEROFAN_NVS_SPEED_KEY, speed);
                 }
-                if ((grmt_zro_data.data[0] == 0x76) &&
-                    (grmt_zro_data.data[1] == 0xc2))
+                if ((ir_result.data[0] == 0x76) &&
+                    (ir_result.data[1] == 0xc2))
                 {
                     rmt_getzerofanswing(&swing);
                     swing = (swing) ? 0 : 1;
@@ -637,12 +608,66 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
                 ir_update_hap_zerofan_status(active, speed, swing);
             }
             break;
+#if CONFIG_IR_DYSON_FAN_ENABLE
+        case IR_TYPE_DYSON:
+            /* Only the keys learned from its remote belong to the fan */
+            int dysonkey = IS_BATHROOM(sys_mac)
+                               ? -1
+                               : ir_dysonfan_findkey(ir_result.data);
+            if (dysonkey >= 0)
+            {
+                /* Someone used the Dyson remote, follow it */
+                active = rmt_isdysonfanactive();
+                rmt_getdysonfanspeed(&speed);
+                rmt_getdysonfanswing(&swing);
+                switch (dysonkey)
+                {
+                    case DYSON_KEY_POWER:
+                        active = (active == 1) ? 0 : 1;
+                        rmt_setdysonfanstatus((bool)active);
+                        syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_INFO,
+                                       "IR change Dyson Fan status");
+                        dysonfan_saveconfig(DYSONFAN_NVS_STATUS_KEY, active);
+                        break;
+                    case DYSON_KEY_SPEEDUP:
+                        speed = (speed + 1) > DYSON_FAN_MAX_SPEED
+                                    ? DYSON_FAN_MAX_SPEED
+                                    : (speed + 1);
+                        rmt_setdysonfanspeed(speed);
+                        syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_INFO,
+                                       "IR increase Dyson Fan speed");
+                        dysonfan_saveconfig(DYSONFAN_NVS_SPEED_KEY, speed);
+                        break;
+                    case DYSON_KEY_SPEEDDN:
+                        speed = (speed - 1) < DYSON_FAN_MIN_SPEED
+                                    ? DYSON_FAN_MIN_SPEED
+                                    : (speed - 1);
+                        rmt_setdysonfanspeed(speed);
+                        syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_INFO,
+                                       "IR decrease Dyson Fan speed");
+                        dysonfan_saveconfig(DYSONFAN_NVS_SPEED_KEY, speed);
+                        break;
+                    case DYSON_KEY_SWING:
+                        swing = (swing) ? 0 : 1;
+                        rmt_setdysonfanswing(swing);
+                        syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_INFO,
+                                       "IR change Dyson Fan swing");
+                        dysonfan_saveconfig(DYSONFAN_NVS_SWING_KEY, swing);
+                        break;
+                    default:
+                        break;
+                }
+                ir_update_hap_dysonfan_status(active, speed, swing);
+            }
+            break;
+#endif
         case IR_TYPE_DELTA:
-            uint32_t deltaactivetimer = 0;
+            int deltaduration = IR_DELTA_FAN_DURATION_FOREVER;
+            bool deltamanualon = false;
             char syslogstr[128] = {};
             if (IS_BATHROOM(sys_mac) || IS_SAMPLE(sys_mac))
             {
-                switch (grmt_delta_data.data[2])
+                switch (ir_result.data[2])
                 {
                     case 0x12:
                         snprintf(syslogstr + strlen(syslogstr),
@@ -657,27 +682,21 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
                         snprintf(syslogstr + strlen(syslogstr),
                                  sizeof(syslogstr) - strlen(syslogstr),
                                  "IR turn on Delta fan exhaust");
-                        ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_MANUAL,
-                                           IR_DELTA_FAN_TIGGER_ACTIVE_ON,
-                                           IR_DELTA_FAN_DURATION_FOREVER);
+                        deltamanualon = true;
                         rmt_setmanualfanstatus(true);
                         break;
                     case 0x13:
                         snprintf(syslogstr + strlen(syslogstr),
                                  sizeof(syslogstr) - strlen(syslogstr),
                                  "IR turn on Delta fan warm");
-                        ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_MANUAL,
-                                           IR_DELTA_FAN_TIGGER_ACTIVE_ON,
-                                           IR_DELTA_FAN_DURATION_FOREVER);
+                        deltamanualon = true;
                         rmt_setmanualfanstatus(true);
                         break;
                     case 0x15:
                         snprintf(syslogstr + strlen(syslogstr),
                                  sizeof(syslogstr) - strlen(syslogstr),
                                  "IR turn on Delta fan dry");
-                        ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_MANUAL,
-                                           IR_DELTA_FAN_TIGGER_ACTIVE_ON,
-                                           IR_DELTA_FAN_DURATION_FOREVER);
+                        deltamanualon = true;
                         rmt_setmanualfanstatus(true);
                         break;
                     default:
@@ -691,86 +710,69 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
                                     rmt_ismanualfanactive());
                 if (rmt_ismanualfanactive())
                 {
-                    switch (grmt_delta_data.time[2])
+                    switch (ir_result.time[2])
                     {
                         case 0x01: /* 0.5HR */
                             snprintf(syslogstr + strlen(syslogstr),
                                      sizeof(syslogstr) - strlen(syslogstr),
                                      " 30 minutes manually");
-                            deltaactivetimer = (30 * 60); /* Sec */
+                            deltaduration = IR_DELTA_FAN_DURATION_HALF_HOUR;
                             break;
                         case 0x02: /* 1HR */
                             snprintf(syslogstr + strlen(syslogstr),
                                      sizeof(syslogstr) - strlen(syslogstr),
                                      " 1 hours manually");
-                            deltaactivetimer = (60 * 60); /* Sec */
+                            deltaduration = IR_DELTA_FAN_DURATION_1HR;
                             break;
                         case 0x03: /* 2HR */
                             snprintf(syslogstr + strlen(syslogstr),
                                      sizeof(syslogstr) - strlen(syslogstr),
                                      " 2 hours manually");
-                            deltaactivetimer = (2 * 60 * 60); /* Sec */
+                            deltaduration = IR_DELTA_FAN_DURATION_2HR;
                             break;
                         case 0x04: /* 3HR */
                             snprintf(syslogstr + strlen(syslogstr),
                                      sizeof(syslogstr) - strlen(syslogstr),
                                      " 3 hours manually");
-                            deltaactivetimer = (3 * 60 * 60); /* Sec */
+                            deltaduration = IR_DELTA_FAN_DURATION_3HR;
                             break;
                         case 0x05: /* 4HR */
                             snprintf(syslogstr + strlen(syslogstr),
                                      sizeof(syslogstr) - strlen(syslogstr),
                                      " 4 hours manually");
-                            deltaactivetimer = (4 * 60 * 60); /* Sec */
+                            deltaduration = IR_DELTA_FAN_DURATION_4HR;
                             break;
                         case 0x06: /* 6HR */
                             snprintf(syslogstr + strlen(syslogstr),
                                      sizeof(syslogstr) - strlen(syslogstr),
                                      " 6 hours manually");
-                            deltaactivetimer = (6 * 60 * 60); /* Sec */
+                            deltaduration = IR_DELTA_FAN_DURATION_6HR;
                             break;
                         case 0x07: /* Forever */
                             snprintf(syslogstr + strlen(syslogstr),
                                      sizeof(syslogstr) - strlen(syslogstr),
                                      " continued manually");
-                            deltaactivetimer = 0;
+                            deltaduration = IR_DELTA_FAN_DURATION_FOREVER;
                             break;
                         default:
                             snprintf(syslogstr + strlen(syslogstr),
                                      sizeof(syslogstr) - strlen(syslogstr),
                                      " unknown time manually");
-                            deltaactivetimer = 0;
+                            deltaduration = IR_DELTA_FAN_DURATION_FOREVER;
                             break;
                     }
                 }
 
-                if (gsync_delta_manual_timer_handle != NULL)
-                {
-                    if (esp_timer_is_active(gsync_delta_manual_timer_handle))
-                    {
-                        ESP_ERROR_CHECK(
-                            esp_timer_stop(gsync_delta_manual_timer_handle));
-                    }
-                }
-                else
-                {
-                    ESP_ERROR_CHECK(
-                        esp_timer_create(&sync_delta_manual_timer_args,
-                                         &gsync_delta_manual_timer_handle));
-                }
-
                 syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_INFO,
-                               syslogstr);
+                               "%s", syslogstr);
 
-                if (deltaactivetimer && rmt_ismanualfanactive())
+                /* The remote set the fan and its timer already, the lease
+                   only keeps the other modes pending until it ends */
+                if (deltamanualon)
                 {
-                    // Set working time is not forever, start timer
-                    ESP_ERROR_CHECK(
-                        esp_timer_start_once(gsync_delta_manual_timer_handle,
-                                             (deltaactivetimer * 1000 * 1000)));
-                    syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_DEBUG,
-                                   "Start delta manual fan %d timer",
-                                   deltaactivetimer);
+                    ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_MANUAL,
+                                       IR_DELTA_FAN_TIGGER_ACTIVE_ON,
+                                       deltaduration);
                 }
 
                 /* TODO 1CE3 is delta_swing */
@@ -782,70 +784,6 @@ static void ir_parse_ir_frame(rmt_symbol_word_t *rmt_nec_symbols,
     }
 }
 
-/**
- * @brief Check whether a RMT symbol represents NEC logic zero
- */
-static bool ir_parse_logic0(rmt_symbol_word_t *rmt_nec_symbols, char type)
-{
-    int zero_dur_0 = 0;
-    int zero_dur_1 = 0;
-    switch (type)
-    {
-        case IR_TYPE_HITACHI:
-            zero_dur_0 = HTA_PAYLOAD_ZERO_DURATION_0;
-            zero_dur_1 = HTA_PAYLOAD_ZERO_DURATION_1;
-            break;
-        case IR_TYPE_ZERO:
-            zero_dur_0 = ZERO_PAYLOAD_ZERO_DURATION_0;
-            zero_dur_1 = ZERO_PAYLOAD_ZERO_DURATION_1;
-            break;
-        case IR_TYPE_DELTA:
-            zero_dur_0 = DELTA_PAYLOAD_ZERO_DURATION_0;
-            zero_dur_1 = DELTA_PAYLOAD_ZERO_DURATION_1;
-            break;
-        case IR_TYPE_DYSON:
-            zero_dur_0 = DYSON_PAYLOAD_ZERO_DURATION_0;
-            zero_dur_1 = DYSON_PAYLOAD_ZERO_DURATION_1;
-            break;
-        default:
-            break;
-    }
-    return ir_check_in_range(rmt_nec_symbols->duration0, zero_dur_0) &&
-           ir_check_in_range(rmt_nec_symbols->duration1, zero_dur_1);
-}
-
-/**
- * @brief Check whether a RMT symbol represents NEC logic one
- */
-static bool ir_parse_logic1(rmt_symbol_word_t *rmt_nec_symbols, char type)
-{
-    int one_dur_0 = 0;
-    int one_dur_1 = 0;
-    switch (type)
-    {
-        case IR_TYPE_HITACHI:
-            one_dur_0 = HTA_PAYLOAD_ONE_DURATION_0;
-            one_dur_1 = HTA_PAYLOAD_ONE_DURATION_1;
-            break;
-        case IR_TYPE_ZERO:
-            one_dur_0 = ZERO_PAYLOAD_ONE_DURATION_0;
-            one_dur_1 = ZERO_PAYLOAD_ONE_DURATION_1;
-            break;
-        case IR_TYPE_DELTA:
-            one_dur_0 = DELTA_PAYLOAD_ONE_DURATION_0;
-            one_dur_1 = DELTA_PAYLOAD_ONE_DURATION_1;
-            break;
-        case IR_TYPE_DYSON:
-            one_dur_0 = DYSON_PAYLOAD_ONE_DURATION_0;
-            one_dur_1 = DYSON_PAYLOAD_ONE_DURATION_1;
-            break;
-        default:
-            break;
-    }
-    return ir_check_in_range(rmt_nec_symbols->duration0, one_dur_0) &&
-           ir_check_in_range(rmt_nec_symbols->duration1, one_dur_1);
-}
-
 static bool ir_rmt_rx_done_callback(rmt_channel_handle_t channel,
                                     const rmt_rx_done_event_data_t *edata,
                                     void *user_data)
@@ -895,6 +833,13 @@ static void ir_update_hap_zerofan_status(int active, int speed, int swing)
     hap_update_value(HAP_ACCESSORY_ZERO_FAN, HAP_CHARACTER_FAN_SPEED, &speed);
 }
 
+static void ir_update_hap_dysonfan_status(int active, int speed, int swing)
+{
+    hap_update_value(HAP_ACCESSORY_DYSON_FAN, HAP_CHARACTER_ACTIVE, &active);
+    hap_update_value(HAP_ACCESSORY_DYSON_FAN, HAP_CHARACTER_FAN_SWING, &swing);
+    hap_update_value(HAP_ACCESSORY_DYSON_FAN, HAP_CHARACTER_FAN_SPEED, &speed);
+}
+
 static void ir_update_deltafan_status(int active, int speed)
 {
     uint8_t sys_mac[6];
@@ -916,11 +861,18 @@ void task_rmt(void *pvParameters)
         .mem_block_symbols =
             RMT_RX_MEM_BLK_SYMB,  // amount of RMT symbols that the channel can
                                   // store at a time
+#if CONFIG_IR_RMT_RX_WITH_DMA
+        .flags.with_dma = true,
+#else
         .flags.with_dma = false,
+#endif
         .gpio_num = RMT_RX_GPIO_NUM,
     };
     rmt_channel_handle_t rx_channel = NULL;
     int beepwr[RMT_CHECK_TIMES] = {0}, retry = 0, checkbee = 0;
+    int noisepwr[RMT_CHECK_TIMES] = {0};
+    int64_t tx_first_us = 0, tx_heard_us = 0;
+    uint8_t rx_armed = 0, rx_scratch = 0;
 
     gsemaRMTCfg = xSemaphoreCreateBinary();
     if (gsemaRMTCfg != NULL)
@@ -928,16 +880,44 @@ void task_rmt(void *pvParameters)
         xSemaphoreGive(gsemaRMTCfg);
     }
 
+    gsemaRmtTxSlot = xSemaphoreCreateBinary();
+    if (gsemaRmtTxSlot != NULL)
+    {
+        xSemaphoreGive(gsemaRmtTxSlot);
+    }
+
     ESP_ERROR_CHECK(rmt_new_rx_channel(&rx_channel_cfg, &rx_channel));
 
     ESP_LOGI(TAG_IR, "register RX done callback");
 
-    gqueue_rmt_tx = xQueueCreate(10, sizeof(rmt_msg_t));
+    /* Only carries the IR type, the state lives in grmt_txslot */
+    gqueue_rmt_tx = xQueueCreate(IR_TYPE_MAX, sizeof(char));
 
     QueueHandle_t rmt_rx_queue =
-        xQueueCreate(5, sizeof(rmt_rx_done_event_data_t));
+        xQueueCreate(RMT_RX_EVENT_NUM, sizeof(rmt_rx_done_event_data_t));
     assert(gqueue_rmt_tx);
     assert(rmt_rx_queue);
+
+    /* Either direction wakes task_rmt at once. Members are only read after
+       the set returned them, so every handle in it has an item behind it. */
+    QueueSetHandle_t rmt_queue_set =
+        xQueueCreateSet(RMT_RX_EVENT_NUM + IR_TYPE_MAX);
+    QueueSetMemberHandle_t rmt_member = NULL;
+    assert(rmt_queue_set);
+    xQueueAddToSet(rmt_rx_queue, rmt_queue_set);
+    xQueueAddToSet(gqueue_rmt_tx, rmt_queue_set);
+
+    /* Buffer 0 is armed first, the others wait for frames */
+    gqueue_rmt_rx_parse =
+        xQueueCreate(RMT_RX_BUFFER_NUM, sizeof(rmt_rx_frame_t));
+    gqueue_rmt_rx_free = xQueueCreate(RMT_RX_BUFFER_NUM, sizeof(uint8_t));
+    assert(gqueue_rmt_rx_parse);
+    assert(gqueue_rmt_rx_free);
+    for (uint8_t i = 1; i < RMT_RX_BUFFER_NUM; i++)
+    {
+        xQueueSend(gqueue_rmt_rx_free, &i, 0);
+    }
+    xTaskCreate(task_ir_rx, "IRRX", 4096, NULL, 5, NULL);
     rmt_rx_event_callbacks_t cbs = {
         .on_recv_done = ir_rmt_rx_done_callback,
     };
@@ -967,7 +947,11 @@ void task_rmt(void *pvParameters)
             4,  // number of transactions that allowed to pending in the
                 // background, this example won't queue multiple transactions,
                 // so queue depth > 1 is sufficient
+#if CONFIG_IR_RMT_TX_WITH_DMA
+        .flags.with_dma = true,
+#else
         .flags.with_dma = false,
+#endif
         .gpio_num = RMT_TX_GPIO_NUM,
     };
     rmt_channel_handle_t tx_channel = NULL;
@@ -995,131 +979,328 @@ void task_rmt(void *pvParameters)
         .loop_count = 0,  // no loop
     };
 
-    ESP_LOGI(TAG_IR, "install IR NEC encoder");
-    ir_hta_encoder_config_t hta_encoder_cfg = {
-        .resolution = IR_RESOLUTION_HZ,
-    };
-    ir_zro_encoder_config_t zro_encoder_cfg = {
-        .resolution = IR_RESOLUTION_HZ,
-    };
-    ir_delta_encoder_config_t delta_encoder_cfg = {
-        .resolution = IR_RESOLUTION_HZ,
-    };
-    rmt_encoder_handle_t hta_encoder = NULL;
-    rmt_encoder_handle_t zro_encoder = NULL;
-    rmt_encoder_handle_t delta_encoder = NULL;
-
-    ESP_ERROR_CHECK(rmt_new_ir_hta_encoder(&hta_encoder_cfg, &hta_encoder));
-    ESP_ERROR_CHECK(rmt_new_ir_zro_encoder(&zro_encoder_cfg, &zro_encoder));
-    ESP_ERROR_CHECK(
-        rmt_new_ir_delta_encoder(&delta_encoder_cfg, &delta_encoder));
+    ESP_LOGI(TAG_IR, "install IR copy encoder");
+    rmt_encoder_handle_t copy_encoder = NULL;
+    rmt_copy_encoder_config_t copy_encoder_cfg = {};
+    const ir_protocol_t *tx_proto = NULL;
+    uint8_t tx_payload[IR_PROTOCOL_MAX_PAYLOAD];
+    size_t tx_payload_len = 0;
+    const rmt_symbol_word_t *tx_symbols = NULL;
+    size_t tx_symbols_num = 0;
+
+    /* Every frame is built from the protocol table as RMT symbols */
+    ESP_ERROR_CHECK(rmt_new_copy_encoder(&copy_encoder_cfg, &copy_encoder));
+    ir_symbol_cache_init(IR_RESOLUTION_HZ);
+    ir_protocol_init();
+    ir_learn_init();
+    ir_stats_init();
+    timer_wheel_add(&ir_hitachiac_delay_timer_callback, NULL,
+                    "hitachiac_delay_timer", &ghitachiac_delay_timer);
+    for (int mode = 0; mode < IR_DELTA_FAN_TIGGER_MODE_OFF; mode++)
+    {
+        timer_wheel_add(ir_deltafan_lease_expired, (void *)(intptr_t)mode,
+                        (const char *)grmt_deltaschedulerName[mode],
+                        &grmt_deltalease_timer[mode]);
+    }
 
     ESP_LOGI(TAG_IR, "enable RMT TX and RX channels");
     ESP_ERROR_CHECK(rmt_enable(tx_channel));
     ESP_ERROR_CHECK(rmt_enable(rx_channel));
     rmt_rx_gpio_enable();
 
-    // save the received RMT symbols
-    static rmt_symbol_word_t
-        raw_symbols[RMT_RX_MEM_BLK_SYMB];  // 64 symbols should be sufficient
-                                           // for a standard NEC frame
     rmt_rx_done_event_data_t rx_data;
     rmt_tx_done_event_data_t tx_data;
     // ready to receive
-    rmt_restart_receive(rx_channel, raw_symbols, sizeof(raw_symbols),
-                        &receive_config);
+    rmt_restart_receive(rx_channel, grmt_rx_symbols[rx_armed],
+                        sizeof(grmt_rx_symbols[0]), &receive_config);
     system_task_created(TASK_RMT_ID);
     system_task_all_ready();
 
     while (1)
     {
         rmt_msg_t rmt_msg = {};
-
-        // wait for RX done signal
-        if (rmt_rx_queue && xQueueReceive(rmt_rx_queue, &rx_data,
-                                          pdMS_TO_TICKS(1000)) == pdPASS)
+        char tx_type = 0;
+        char tx_pending[IR_TYPE_MAX];
+        int tx_npending = 0;
+        bool tx_more = false;
+
+        /* The timeout only drives the learning session */
+        rmt_member = xQueueSelectFromSet(
+            rmt_queue_set, pdMS_TO_TICKS(ir_learn_isactive()
+                                             ? RMT_LEARN_POLL_MS
+                                             : RMT_IDLE_POLL_MS));
+
+        if ((rmt_member == rmt_rx_queue) &&
+            (xQueueReceive(rmt_rx_queue, &rx_data, 0) == pdPASS))
         {
-            // parse the receive symbols and print the result
-            ir_parse_ir_frame(rx_data.received_symbols, rx_data.num_symbols);
-            rmt_restart_receive(rx_channel, raw_symbols, sizeof(raw_symbols),
-                                &receive_config);
+            /* Arm the other buffer first, task_ir_rx parses this one */
+            rx_armed = rmt_rx_dispatch(rx_armed, &rx_data);
+            rmt_restart_receive(rx_channel, grmt_rx_symbols[rx_armed],
+                                sizeof(grmt_rx_symbols[0]), &receive_config);
         }
+        ir_learn_poll();
+        ir_stats_poll();
 
-        if (gqueue_rmt_tx &&
-            xQueueReceive(gqueue_rmt_tx, &rmt_msg, pdMS_TO_TICKS(5)) == pdPASS)
+        if ((rmt_member == gqueue_rmt_tx) &&
+            (xQueueReceive(gqueue_rmt_tx, &tx_type, 0) == pdPASS))
         {
-            retry = 0;
-            rmt_form_tx_data(&rmt_msg);
             /* Pendding LD2410 */
             if (xSemaphoreTake(gsemaLD2410, portMAX_DELAY) == pdTRUE)
             {
                 rmt_rx_gpio_disable();
                 ESP_ERROR_CHECK(rmt_disable(rx_channel));
+                /* A frame done just before RX was disabled still owns the
+                   armed buffer, hand it over before it's armed again. Go
+                   through the set so no handle is left without its item,
+                   other IR types go to the back of gqueue_rmt_tx. */
+                while ((rmt_member = xQueueSelectFromSet(rmt_queue_set, 0)) !=
+                       NULL)
+                {
+                    if ((rmt_member == rmt_rx_queue) &&
+                        (xQueueReceive(rmt_rx_queue, &rx_data, 0) == pdPASS))
+                    {
+                        rx_armed = rmt_rx_dispatch(rx_armed, &rx_data);
+                    }
+                    else if ((rmt_member == gqueue_rmt_tx) &&
+                             (tx_npending < IR_TYPE_MAX) &&
+                             (xQueueReceive(gqueue_rmt_tx,
+                                            &tx_pending[tx_npending],
+                                            0) == pdPASS))
+                    {
+                        tx_npending++;
+                    }
+                }
+                for (int i = 0; i < tx_npending; i++)
+                {
+                    xQueueSend(gqueue_rmt_tx, &tx_pending[i], 0);
+                }
                 do
                 {
-                    checkbee = 0;
-                    memset(beepwr, 0, sizeof(beepwr));
-                    if (rmt_msg.type == IR_TYPE_HITACHI)
+                    tx_more = rmt_dequeue_msg(tx_type, &rmt_msg);
+                    if (((rmt_msg.type == IR_TYPE_ZERO) ||
+                         (rmt_msg.type == IR_TYPE_DYSON)) &&
+                        !rmt_msg.bstatusch && !rmt_msg.bfanspeedch &&
+                        !rmt_msg.bswingch)
                     {
-                        ESP_ERROR_CHECK(rmt_transmit(
-                            tx_channel, hta_encoder, &rmt_msg,
-                            sizeof(rmt_msg.data), &transmit_config));
+                        /* Toggles cancelled each other, nothing to send */
+                        syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_DEBUG,
+                                       "Skip empty IR %d", tx_type);
+                        continue;
                     }
-                    if (rmt_msg.type == IR_TYPE_ZERO)
+                    if (rmt_msg.type == IR_TYPE_LEARN)
                     {
-                        ESP_ERROR_CHECK(rmt_transmit(tx_channel, zro_encoder,
-                                                     &rmt_msg, 2,
-                                                     &transmit_config));
+                        /* Borrow a free RX buffer to expand the frames */
+                        if (xQueueReceive(gqueue_rmt_rx_free, &rx_scratch,
+                                          pdMS_TO_TICKS(200)) != pdPASS)
+                        {
+                            syslog_handler(SYSLOG_FACILITY_RMT,
+                                           SYSLOG_LEVEL_ERROR,
+                                           "No buffer for learned IR");
+                            continue;
+                        }
+                        rmt_tx_latency_record(&rmt_msg);
+                        ir_transmit_learn(tx_channel, copy_encoder,
+                                          &transmit_config, transmit_queue,
+                                          rmt_msg.learnmask,
+                                          grmt_rx_symbols[rx_scratch],
+                                          RMT_RX_MEM_BLK_SYMB);
+                        xQueueSend(gqueue_rmt_rx_free, &rx_scratch, 0);
+                        ir_stats_record(rmt_msg.type, 1, 0, 0, 0, 0, 0);
+                        continue;
                     }
-                    if (rmt_msg.type == IR_TYPE_DELTA)
+                    retry = 0;
+                    tx_first_us = esp_timer_get_time();
+                    tx_heard_us = 0;
+                    if (rmt_form_tx_data(&rmt_msg) != SYSTEM_ERROR_NONE)
                     {
-                        ESP_ERROR_CHECK(rmt_transmit(tx_channel, delta_encoder,
-                                                     &rmt_msg, sizeof(rmt_msg),
-                                                     &transmit_config));
+                        continue;
                     }
-
-                    do
+                    /* Encode once, retries send the same symbols */
+                    tx_symbols = NULL;
+                    tx_proto = ir_protocol_get(rmt_msg.type);
+                    if (tx_proto != NULL)
                     {
-                        max9814_check_bee(rmt_msg.targetfreq, 0,
-                                          &beepwr[checkbee], NULL);
-                        checkbee++;
-                    } while (RMT_ISNOT_HEAR && checkbee < RMT_CHECK_TIMES);
-
-                    if (xQueueReceive(transmit_queue, &tx_data,
-                                      pdMS_TO_TICKS(100)) != pdPASS)
+                        tx_payload_len =
+                            ir_protocol_pack(tx_proto, rmt_msg.data,
+                                             rmt_msg.time, tx_payload);
+                        tx_symbols =
+                            ir_symbol_cache_get(tx_proto, tx_payload,
+                                                tx_payload_len, &tx_symbols_num);
+                    }
+                    if (tx_symbols == NULL)
                     {
                         syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_ERROR,
-                                       "TX fail");
+                                       "Encode IR %d fail", rmt_msg.type);
+                        continue;
                     }
-                    syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_DEBUG,
-                                   "TX %d.%d bee %d Hz >%d pwr = %d,%d,%d",
-                                   retry + 1, checkbee, rmt_msg.targetfreq,
-                                   rmt_msg.pwrthreshold, beepwr[0], beepwr[1],
-                                   beepwr[2]);
-
-                    rmt_tx_wait_all_done(tx_channel, 50);
+                    do
+                    {
+                        checkbee = 0;
+                        memset(beepwr, 0, sizeof(beepwr));
+                        memset(noisepwr, 0, sizeof(noisepwr));
+                        rmt_tx_latency_record(&rmt_msg);
+                        ESP_ERROR_CHECK(rmt_transmit(
+                            tx_channel, copy_encoder, tx_symbols,
+                            tx_symbols_num * sizeof(rmt_symbol_word_t),
+                            &transmit_config));
 
-                    retry++;
-                    vTaskDelay(100 / portTICK_PERIOD_MS);
-                } while (RMT_ISNOT_HEAR && retry < RMT_RETRY_TIMES);
+                        do
+                        {
+                            /* No beep to listen for, beepwr stays 0 and the
+                               frame counts as unchecked */
+                            if (rmt_msg.targetfreq > 0)
+                            {
+                                max9814_check_bee(
+                                    rmt_msg.targetfreq,
+                                    rmt_msg.targetfreq -
+                                        IR_STATS_NOISE_FREQ_OFFSET,
+                                    &beepwr[checkbee], &noisepwr[checkbee]);
+                                if (beepwr[checkbee] >= rmt_msg.pwrthreshold)
+                                {
+                                    tx_heard_us = esp_timer_get_time();
+                                }
+                            }
+                            checkbee++;
+                        } while (RMT_ISNOT_HEAR && checkbee < RMT_CHECK_TIMES);
+
+                        if (xQueueReceive(transmit_queue, &tx_data,
+                                          pdMS_TO_TICKS(100)) != pdPASS)
+                        {
+                            syslog_handler(SYSLOG_FACILITY_RMT,
+                                           SYSLOG_LEVEL_ERROR, "TX fail");
+                        }
+                        syslog_handler(
+                            SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_DEBUG,
+                            "TX %d.%d bee %d Hz >%d pwr = %d,%d,%d", retry + 1,
+                            checkbee, rmt_msg.targetfreq, rmt_msg.pwrthreshold,
+                            beepwr[0], beepwr[1], beepwr[2]);
+
+                        rmt_tx_wait_all_done(tx_channel, 50);
+
+                        retry++;
+                        vTaskDelay(100 / portTICK_PERIOD_MS);
+                    } while (RMT_ISNOT_HEAR && retry < RMT_RETRY_TIMES);
+                    ir_stats_record(rmt_msg.type, retry, checkbee,
+                                    beepwr[checkbee - 1], noisepwr[checkbee - 1],
+                                    rmt_msg.pwrthreshold,
+                                    tx_heard_us ? (tx_heard_us - tx_first_us) /
+                                                      1000
+                                                : 0);
+                } while (tx_more);
                 ESP_ERROR_CHECK(rmt_enable(rx_channel));
                 rmt_rx_gpio_enable();
                 xSemaphoreGive(gsemaLD2410);
             }
-            rmt_restart_receive(rx_channel, raw_symbols, sizeof(raw_symbols),
-                                &receive_config);
+            rmt_restart_receive(rx_channel, grmt_rx_symbols[rx_armed],
+                                sizeof(grmt_rx_symbols[0]), &receive_config);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Hand a received buffer to task_ir_rx and pick the next one to arm
+ *
+ * @return Buffer to arm, the same one if task_ir_rx still holds all the
+ *         others, the frame in it is dropped then
+ */
+static uint8_t rmt_rx_dispatch(uint8_t armed,
+                               const rmt_rx_done_event_data_t *rx_data)
+{
+    rmt_rx_frame_t frame = {
+        .buffer = armed,
+        .num_symbols = rx_data->num_symbols,
+    };
+    uint8_t next = armed;
+
+    grmt_rx_frames++;
+    if (xQueueReceive(gqueue_rmt_rx_free, &next, 0) != pdPASS)
+    {
+        grmt_rx_dropped++;
+        return armed;
+    }
+    if (ir_learn_isactive())
+    {
+        /* Raw frames belong to the learner while it's waiting, it only
+           copies them */
+        ir_learn_feed(grmt_rx_symbols[armed], rx_data->num_symbols);
+        xQueueSend(gqueue_rmt_rx_free, &armed, 0);
+    }
+    else
+    {
+        xQueueSend(gqueue_rmt_rx_parse, &frame, 0);
+    }
+    return next;
+}
+
+static void task_ir_rx(void *pvParameters)
+{
+    rmt_rx_frame_t frame;
+    uint32_t dropped = 0;
+
+    while (1)
+    {
+        if (xQueueReceive(gqueue_rmt_rx_parse, &frame, portMAX_DELAY) !=
+            pdPASS)
+        {
+            continue;
+        }
+        // parse the receive symbols and print the result
+        ir_parse_ir_frame(grmt_rx_symbols[frame.buffer], frame.num_symbols);
+        xQueueSend(gqueue_rmt_rx_free, &frame.buffer, 0);
+
+        /* Report here, task_rmt only counts to re-arm quickly */
+        if (dropped != grmt_rx_dropped)
+        {
+            dropped = grmt_rx_dropped;
+            syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_WARNING,
+                           "IR RX dropped %lu of %lu frames", dropped,
+                           grmt_rx_frames);
         }
     }
     vTaskDelete(NULL);
 }
 
+int rmt_get_tx_latency(char type, rmt_tx_latency_t *latency)
+{
+    if (gsemaRmtTxSlot == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (rmt %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (latency == NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if ((type <= 0) || (type >= IR_TYPE_MAX))
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    if (xSemaphoreTake(gsemaRmtTxSlot, portMAX_DELAY) == pdTRUE)
+    {
+        memcpy(latency, &grmt_tx_latency[(int)type], sizeof(rmt_tx_latency_t));
+        xSemaphoreGive(gsemaRmtTxSlot);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+void rmt_get_rx_stats(uint32_t *frames, uint32_t *dropped)
+{
+    if (frames != NULL)
+    {
+        *frames = grmt_rx_frames;
+    }
+    if (dropped != NULL)
+    {
+        *dropped = grmt_rx_dropped;
+    }
+}
+
 int ir_hitachiac_tigger(rmt_hattg_msg_t msg)
 {
     rmt_msg_t rmt_msg;
     int ori_mode = 0, ori_actype = 0, ori_acspeed = 0;
-    esp_timer_create_args_t hitachiac_delay_timer_args = {
-        .callback = &ir_hitachiac_delay_timer_callback,
-        .name = "hitachiac_delay_timer"};
 #if 0    
     dbg_printf("\n Hitachi Tigger Message:\n");
     dbg_printf("   Active:%d, %d\n",msg.bactivech, msg.active);
@@ -1136,20 +1317,12 @@ int ir_hitachiac_tigger(rmt_hattg_msg_t msg)
     if (msg.bactivech)
     {
         rmt_msg.bstatusch = true;
-        if (ghitachiac_delay_timer_handle != NULL)
-        {
-            if (esp_timer_is_active(ghitachiac_delay_timer_handle))
-            {
-                syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_DEBUG,
-                               "Hitachi AC tiggered stop fan only timer");
-                ESP_ERROR_CHECK(esp_timer_stop(ghitachiac_delay_timer_handle));
-                oled_fan_countdown_stop();
-            }
-        }
-        else
+        if (timer_wheel_is_active(ghitachiac_delay_timer))
         {
-            ESP_ERROR_CHECK(esp_timer_create(&hitachiac_delay_timer_args,
-                                             &ghitachiac_delay_timer_handle));
+            syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_DEBUG,
+                           "Hitachi AC tiggered stop fan only timer");
+            timer_wheel_stop(ghitachiac_delay_timer);
+            oled_fan_countdown_stop();
         }
 
         if (msg.active == HAP_ACTIVE_ON)
@@ -1188,8 +1361,7 @@ int ir_hitachiac_tigger(rmt_hattg_msg_t msg)
                     SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_DEBUG,
                     "Hitachi AC tiggered off from %s, set fan only 10 minutes",
                     (ori_mode == HAP_AC_MODE_COOLER ? "Cooler" : "Auto"));
-                ESP_ERROR_CHECK(esp_timer_start_once(
-                    ghitachiac_delay_timer_handle, (10 * 60 * 1000 * 1000)));
+                timer_wheel_start(ghitachiac_delay_timer, 10 * 60 * 1000);
                 oled_fan_countdown_start(10 * 60);
             }
             else
@@ -1273,11 +1445,17 @@ int rmt_form_tx_data(rmt_msg_t *rmt_msg)
 {
     uint16_t HtaTempGap = HITACHI_GAP_TEMPERATURE;
     int target_temp = 0;
+    int dysonkey = DYSON_KEY_POWER;
     syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
                    "Form %d data (1.Hitachi, 2.+-0, 3.Delta)", rmt_msg->type);
     switch (rmt_msg->type)
     {
         case IR_TYPE_HITACHI:
+            /* grmt_htaBuffer is shared with task_ir_rx */
+            if (xSemaphoreTake(gsemaRmtTxSlot, portMAX_DELAY) != pdTRUE)
+            {
+                return SYSTEM_ERROR_NOT_READY;
+            }
             if (rmt_msg->bstatusch)
             {
                 syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_DEBUG,
@@ -1405,6 +1583,7 @@ int rmt_form_tx_data(rmt_msg_t *rmt_msg)
                     ~grmt_htaBuffer[HITACHI_IRP_OPCODE_BYTE];
             }
             memcpy(rmt_msg->data, grmt_htaBuffer, 44);
+            xSemaphoreGive(gsemaRmtTxSlot);
             break;
         case IR_TYPE_DELTA:
             if (rmt_msg->bmodech)
@@ -1515,6 +1694,30 @@ int rmt_form_tx_data(rmt_msg_t *rmt_msg)
                 memcpy(rmt_msg->data, grmt_zroBuffer, sizeof(grmt_zroBuffer));
             }
             break;
+        case IR_TYPE_DYSON:
+            if (rmt_msg->bstatusch)
+            {
+                dysonkey = DYSON_KEY_POWER;
+            }
+
+            if (rmt_msg->bfanspeedch)
+            {
+                dysonkey = (rmt_msg->fanspeed > 0) ? DYSON_KEY_SPEEDUP
+                                                   : DYSON_KEY_SPEEDDN;
+            }
+
+            if (rmt_msg->bswingch)
+            {
+                dysonkey = DYSON_KEY_SWING;
+            }
+            if (ir_dysonfan_getkey(dysonkey, rmt_msg->data) !=
+                SYSTEM_ERROR_NONE)
+            {
+                syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_ERROR,
+                               "Dyson Fan key %d is not learned", dysonkey);
+                return SYSTEM_ERROR_INVALID_PARAMETER;
+            }
+            break;
         default:
             break;
     }
@@ -1522,99 +1725,168 @@ int rmt_form_tx_data(rmt_msg_t *rmt_msg)
     return SYSTEM_ERROR_NONE;
 }
 
-int ir_zerofan_tigger(rmt_zftg_msg_t msg)
+/**
+ * @brief Queue relative fan keys, +-0 and Dyson Fan share it
+ *
+ * @param[in] sema Tigger semaphore of the fan, keeps its keys in order
+ */
+static int ir_relfan_tigger(char type, SemaphoreHandle_t sema,
+                            const char *name, int targetfreq, int pwrthreshold,
+                            rmt_zftg_msg_t msg)
 {
     rmt_msg_t rmt_msg;
-    int idx = 0, repeat = 0;
     memset(&rmt_msg, 0, sizeof(rmt_msg_t));
 #if 0
-    dbg_printf("\n Zero Tigger Message:\n");
+    dbg_printf("\n %s Tigger Message:\n", name);
     dbg_printf("   Active:%d, %d\n",msg.bactivech,msg.active);
     dbg_printf("    Speed:%d, %d\n",msg.bfanspeedch,msg.fanspeed);
     dbg_printf("    Swing:%d, %d\n\n",msg.bswingch,msg.swing);
 #endif
-    if (gsemaRmtZeroTig == NULL)
+    if (sema == NULL)
     {
         return SYSTEM_ERROR_NOT_READY;
     }
 
-    if (xSemaphoreTake(gsemaRmtZeroTig, portMAX_DELAY) == pdTRUE)
+    if (xSemaphoreTake(sema, portMAX_DELAY) == pdTRUE)
     {
-        rmt_msg.type = IR_TYPE_ZERO;
+        rmt_msg.type = type;
+        rmt_msg.targetfreq = targetfreq;
+        rmt_msg.pwrthreshold = pwrthreshold;
         if (msg.bactivech)
         {
             rmt_msg.bstatusch = true;
-            rmt_msg.targetfreq = MAX9814_ZERO_FAN_BEE_FREQ;
-            rmt_msg.pwrthreshold = MAX9814_ZERO_FAN_BEE_THRESHOLD;
-            /* SendIR */
-            if (!rmt_enqueue_msg(&rmt_msg))
-            {
-                xSemaphoreGive(gsemaRmtZeroTig);
-                syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
-                               "EnQueue Zero Fan IR active fail");
-                return SYSTEM_ERROR_NOT_READY;
-            }
-            syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
-                           "EnQueue Zero Fan IR %d active", rmt_msg.type);
         }
 
         if (msg.bfanspeedch)
         {
+            /* Speed is sent as |fanspeed| steps, task_rmt drains them */
             rmt_msg.bfanspeedch = true;
-            if (msg.fanspeed > 0)
-            {
-                rmt_msg.fanspeed = 1;
-            }
-            if (msg.fanspeed < 0)
-            {
-                rmt_msg.fanspeed = -1;
-            }
-            rmt_msg.targetfreq = MAX9814_ZERO_FAN_BEE_FREQ;
-            rmt_msg.pwrthreshold = MAX9814_ZERO_FAN_BEE_THRESHOLD;
-            repeat = abs(msg.fanspeed);
-            /* SendIR */
-            for (idx = 0; idx < repeat; idx++)
-            {
-                if (!rmt_enqueue_msg(&rmt_msg))
-                {
-                    xSemaphoreGive(gsemaRmtZeroTig);
-                    syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
-                                   "EnQueue Zero Fan IR speed fail in %d/%d",
-                                   idx + 1, repeat);
-                    return SYSTEM_ERROR_NOT_READY;
-                }
-                vTaskDelay(50 / portTICK_PERIOD_MS);
-            }
-            syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
-                           "EnQueue Zero Fan IR speed %d times", repeat);
+            rmt_msg.fanspeed = msg.fanspeed;
         }
 
         if (msg.bswingch)
         {
             rmt_msg.bswingch = true;
-            rmt_msg.targetfreq = MAX9814_ZERO_FAN_BEE_FREQ;
-            rmt_msg.pwrthreshold = MAX9814_ZERO_FAN_BEE_THRESHOLD;
-            /* SendIR */
-            if (!rmt_enqueue_msg(&rmt_msg))
-            {
-                xSemaphoreGive(gsemaRmtZeroTig);
-                syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
-                               "EnQueue Zero Fan IR swing fail");
-                return SYSTEM_ERROR_NOT_READY;
-            }
-            syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
-                           "EnQueue Zero Fan IR %d swing", rmt_msg.type);
         }
-        xSemaphoreGive(gsemaRmtZeroTig);
+
+        /* SendIR */
+        if (!rmt_enqueue_msg(&rmt_msg))
+        {
+            xSemaphoreGive(sema);
+            syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                           "EnQueue %s Fan IR fail", name);
+            return SYSTEM_ERROR_NOT_READY;
+        }
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
+                       "EnQueue %s Fan IR active %d speed %d swing %d", name,
+                       rmt_msg.bstatusch, rmt_msg.fanspeed, rmt_msg.bswingch);
+        xSemaphoreGive(sema);
     }
     /* Success */
     return SYSTEM_ERROR_NONE;
 }
 
+int ir_zerofan_tigger(rmt_zftg_msg_t msg)
+{
+    return ir_relfan_tigger(IR_TYPE_ZERO, gsemaRmtZeroTig, "Zero",
+                            MAX9814_ZERO_FAN_BEE_FREQ,
+                            MAX9814_ZERO_FAN_BEE_THRESHOLD, msg);
+}
+
+int ir_dysonfan_tigger(rmt_dftg_msg_t msg)
+{
+    return ir_relfan_tigger(IR_TYPE_DYSON, gsemaRmtDysonTig, "Dyson",
+                            MAX9814_DYSON_FAN_BEE_FREQ,
+                            MAX9814_DYSON_FAN_BEE_THRESHOLD, msg);
+}
+
+int ir_learncmd_tigger(int index)
+{
+    rmt_msg_t rmt_msg;
+    memset(&rmt_msg, 0, sizeof(rmt_msg_t));
+
+    if ((index < 0) || (index >= IR_LEARN_MAX_ENTRIES))
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+
+    rmt_msg.type = IR_TYPE_LEARN;
+    rmt_msg.learnmask = 1 << index;
+    if (!rmt_enqueue_msg(&rmt_msg))
+    {
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "EnQueue learned IR %d fail", index);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
+                   "EnQueue learned IR %d", index);
+    return SYSTEM_ERROR_NONE;
+}
+
+/* Seconds of a IR_DELTA_FAN_DURATION_XXX, 0 is forever */
+static uint32_t ir_deltafan_duration_seconds(int duration)
+{
+    switch (duration)
+    {
+        case IR_DELTA_FAN_DURATION_HALF_HOUR:
+            return 30 * 60;
+        case IR_DELTA_FAN_DURATION_1HR:
+        case IR_DELTA_FAN_DURATION_2HR:
+        case IR_DELTA_FAN_DURATION_3HR:
+        case IR_DELTA_FAN_DURATION_4HR:
+        case IR_DELTA_FAN_DURATION_6HR:
+            return duration * 60 * 60;
+        case IR_DELTA_FAN_DURATION_FOREVER:
+        default:
+            return 0;
+    }
+}
+
+/* Shortest fan timer that still covers the rest of a lease, the lease ends
+   first and hands the fan to the next mode */
+static int ir_deltafan_duration_cover(uint32_t seconds)
+{
+    static const int durations[] = {
+        IR_DELTA_FAN_DURATION_HALF_HOUR, IR_DELTA_FAN_DURATION_1HR,
+        IR_DELTA_FAN_DURATION_2HR,       IR_DELTA_FAN_DURATION_3HR,
+        IR_DELTA_FAN_DURATION_4HR,       IR_DELTA_FAN_DURATION_6HR};
+
+    if (seconds == 0)
+    {
+        return IR_DELTA_FAN_DURATION_FOREVER;
+    }
+    for (int i = 0; i < sizeof(durations) / sizeof(durations[0]); i++)
+    {
+        if (seconds <= ir_deltafan_duration_seconds(durations[i]))
+        {
+            return durations[i];
+        }
+    }
+    return IR_DELTA_FAN_DURATION_FOREVER;
+}
+
+/* Call with gsemaRmtDeltaSche taken */
+static inline int ir_deltafan_running_mode(void)
+{
+    return grmt_deltalease_mask ? __builtin_ctz(grmt_deltalease_mask)
+                                : IR_DELTA_FAN_TIGGER_MODE_OFF;
+}
+
+/**
+ * @brief Take (ON) or give back (OFF) the Delta Fan lease of a mode
+ *
+ * Modes are ordered by priority, the fan runs the highest one holding a
+ * lease. IR is only sent when that changes or its lease is renewed, and
+ * never on behalf of the remote (manual mode), which set the fan itself.
+ *
+ * @param[in] duration IR_DELTA_FAN_DURATION_XXX, the lease ends by itself
+ *                     unless it's forever
+ */
 int ir_deltafan_tigger(int mode, int active, int duration)
 {
-    int running_mode = IR_DELTA_FAN_TIGGER_MODE_MAX;
-    int i = 0, repeat = 0;
+    int before = IR_DELTA_FAN_TIGGER_MODE_OFF;
+    int running_mode = IR_DELTA_FAN_TIGGER_MODE_OFF;
+    uint32_t seconds = 0;
     rmt_msg_t rmt_msg;
 
     memset(&rmt_msg, 0, sizeof(rmt_msg_t));
@@ -1625,105 +1897,52 @@ int ir_deltafan_tigger(int mode, int active, int duration)
                        "Semaphore not ready (rmt %d)", __LINE__);
         return SYSTEM_ERROR_NOT_READY;
     }
+    if ((mode < 0) || (mode >= IR_DELTA_FAN_TIGGER_MODE_OFF))
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
 
     if (xSemaphoreTake(gsemaRmtDeltaSche, portMAX_DELAY) == pdTRUE)
     {
-        for (i = 0; i < IR_DELTA_FAN_TIGGER_MODE_MAX; i++)
+        before = ir_deltafan_running_mode();
+        if (active == IR_DELTA_FAN_TIGGER_ACTIVE_ON)
         {
-            if (active == IR_DELTA_FAN_TIGGER_ACTIVE_ON)
+            grmt_deltalease_mask |= (1 << mode);
+            seconds = ir_deltafan_duration_seconds(duration);
+            if (seconds)
             {
-                if (i < mode)
-                {
-                    if (grmt_deltascheduler[i] > DELTA_FAN_SCHDULER_IDEL)
-                    {
-                        /* High priority mode is active, set current mode to
-                         * pending, keep current mode */
-                        grmt_deltascheduler[mode] = DELTA_FAN_SCHDULER_PENDING;
-                        syslog_handler(
-                            SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
-                            "Scheduler pend %s, because Hier Pri FAN %s ON",
-                            grmt_deltaschedulerName[mode],
-                            grmt_deltaschedulerName[i]);
-                        break;
-                    }
-                }
-                else if (i == mode)
-                {
-                    /* Current mode is highest mode and active */
-                    grmt_deltascheduler[mode] = DELTA_FAN_SCHDULER_ACTIVE;
-                    syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
-                                   "Scheduler active %s",
-                                   grmt_deltaschedulerName[mode]);
-                    running_mode = mode;
-                }
-                else
-                {
-                    /* Set lower mode from active to pending */
-                    if (grmt_deltascheduler[i] == DELTA_FAN_SCHDULER_ACTIVE)
-                    {
-                        grmt_deltascheduler[i] = DELTA_FAN_SCHDULER_PENDING;
-                        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
-                                       "Scheduler pend Lower Pri FAN %s",
-                                       grmt_deltaschedulerName[i]);
-                    }
-                }
+                timer_wheel_start(grmt_deltalease_timer[mode], seconds * 1000);
             }
-
-            if (active == IR_DELTA_FAN_TIGGER_ACTIVE_OFF)
+            else
             {
-                if (i < mode)
-                {
-                    if (grmt_deltascheduler[i] > DELTA_FAN_SCHDULER_IDEL)
-                    {
-                        /* High priority mode is active or pending, Do nothing
-                         */
-                        /* Set current mode to idel */
-                        grmt_deltascheduler[mode] = DELTA_FAN_SCHDULER_IDEL;
-                        syslog_handler(
-                            SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
-                            "Scheduler idel %s and keep Hier pri Fan %s ON",
-                            grmt_deltaschedulerName[mode],
-                            grmt_deltaschedulerName[i]);
-                        running_mode = i;
-                        break;
-                    }
-                }
-                else if (i == mode)
-                {
-                    /* Set current mode to idel */
-                    grmt_deltascheduler[mode] = DELTA_FAN_SCHDULER_IDEL;
-                    syslog_handler(
-                        SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
-                        "Scheduler idel %s then look for lower pend Fan",
-                        grmt_deltaschedulerName[mode]);
-                }
-                else
-                {
-                    if (grmt_deltascheduler[i] > DELTA_FAN_SCHDULER_IDEL)
-                    {
-                        /* Active the next high mode */
-                        grmt_deltascheduler[i] = DELTA_FAN_SCHDULER_ACTIVE;
-                        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
-                                       "Active next high pri %s",
-                                       grmt_deltaschedulerName[i]);
-                        running_mode = i;
-                        break;
-                    }
-                }
-                /* There isn't other pending mode, turn off fan */
-                running_mode = IR_DELTA_FAN_TIGGER_MODE_OFF;
+                timer_wheel_stop(grmt_deltalease_timer[mode]);
             }
         }
-
+        else
+        {
+            grmt_deltalease_mask &= ~(1 << mode);
+            timer_wheel_stop(grmt_deltalease_timer[mode]);
+        }
+        running_mode = ir_deltafan_running_mode();
         syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_DEBUG,
-                       "Scheduler result: %s",
+                       "Scheduler %s %s, leases 0x%02x, result: %s",
+                       (active == IR_DELTA_FAN_TIGGER_ACTIVE_ON) ? "lease"
+                                                                 : "release",
+                       grmt_deltaschedulerName[mode], grmt_deltalease_mask,
                        grmt_deltaschedulerName[running_mode]);
-        if (running_mode < IR_DELTA_FAN_TIGGER_MODE_MAX)
+
+        if ((running_mode != before) || (running_mode == mode))
         {
             rmt_msg.bmodech = true;
             rmt_msg.mode = running_mode;
             rmt_msg.bdurationch = true;
-            rmt_msg.duration = duration;
+            rmt_msg.duration =
+                (running_mode == IR_DELTA_FAN_TIGGER_MODE_OFF)
+                    ? duration
+                    : ir_deltafan_duration_cover(
+                          timer_wheel_remaining(
+                              grmt_deltalease_timer[running_mode]) /
+                          1000);
 
             // Sync to homekit
             ir_update_deltafan_status(rmt_ismanualfanactive(), 0);
@@ -1734,7 +1953,6 @@ int ir_deltafan_tigger(int mode, int active, int duration)
             if (mode != IR_DELTA_FAN_TIGGER_MODE_MANUAL)
             {
                 rmt_msg.type = IR_TYPE_DELTA;
-                rmt_msg.repeat = repeat;
                 rmt_msg.targetfreq = MAX9814_DELTA_FAN_BEE_FREQ;
                 rmt_msg.pwrthreshold = MAX9814_DELTA_FAN_BEE_THRESHOLD;
                 /* SendIR */
@@ -1754,34 +1972,52 @@ int ir_deltafan_tigger(int mode, int active, int duration)
     return true;
 }
 
-int ir_get_deltascheduler(int index, uint8_t *sheduler)
+bool ir_deltafan_isleased(int mode)
 {
+    bool ret = false;
+
     if (gsemaRmtDeltaSche == NULL)
     {
-        return SYSTEM_ERROR_NOT_READY;
-    }
-    if (sheduler == NULL)
-    {
-        return SYSTEM_ERROR_INVALID_POINTER;
+        syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (rmt %d)", __LINE__);
+        return false;
     }
     if (xSemaphoreTake(gsemaRmtDeltaSche, portMAX_DELAY) == pdTRUE)
     {
-        *sheduler = grmt_deltascheduler[index];
+        ret = (grmt_deltalease_mask >> mode) & 1;
         xSemaphoreGive(gsemaRmtDeltaSche);
     }
-    return SYSTEM_ERROR_NONE;
+    return ret;
 }
 
-int ir_set_deltascheduler(int index, uint8_t scheduler)
+int ir_get_deltascheduler(int index, uint8_t *sheduler)
 {
     if (gsemaRmtDeltaSche == NULL)
     {
         return SYSTEM_ERROR_NOT_READY;
     }
-
+    if (sheduler == NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if ((index < 0) || (index >= IR_DELTA_FAN_TIGGER_MODE_MAX))
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
     if (xSemaphoreTake(gsemaRmtDeltaSche, portMAX_DELAY) == pdTRUE)
     {
-        grmt_deltascheduler[index] = scheduler;
+        if (!((grmt_deltalease_mask >> index) & 1))
+        {
+            *sheduler = DELTA_FAN_SCHDULER_IDEL;
+        }
+        else if (index == ir_deltafan_running_mode())
+        {
+            *sheduler = DELTA_FAN_SCHDULER_ACTIVE;
+        }
+        else
+        {
+            *sheduler = DELTA_FAN_SCHDULER_PENDING;
+        }
         xSemaphoreGive(gsemaRmtDeltaSche);
     }
     return SYSTEM_ERROR_NONE;
@@ -1803,16 +2039,17 @@ void ir_hitachiac_delay_timer_callback()
     return;
 }
 
-void ir_sync_delta_manual_timer_callback()
+static void ir_deltafan_lease_expired(void *arg)
 {
-    // Sync Delta fan status to scheduler
+    int mode = (int)(intptr_t)arg;
+
     syslog_handler(SYSLOG_FACILITY_IR, SYSLOG_LEVEL_INFO,
-                   "Timeout, turn off fan (manual)");
-    ir_deltafan_tigger(IR_DELTA_FAN_TIGGER_MODE_MANUAL,
-                       IR_DELTA_FAN_TIGGER_ACTIVE_OFF,
+                   "Timeout, turn off fan (%s)",
+                   grmt_deltaschedulerName[mode]);
+    ir_deltafan_tigger(mode, IR_DELTA_FAN_TIGGER_ACTIVE_OFF,
                        IR_DELTA_FAN_DURATION_FOREVER);
-    return;
 }
+
 static void rmt_restart_receive(rmt_channel_handle_t channel,
                                 rmt_symbol_word_t *symbols, size_t symbols_size,
                                 const rmt_receive_config_t *config)
@@ -1825,3 +2062,51 @@ static void rmt_restart_receive(rmt_channel_handle_t channel,
     }
     ESP_ERROR_CHECK(err);
 }
+
+/* Send every frame of the learned commands in learnmask. There isn't a beep
+   to confirm them, so each is sent once without retry. */
+static void ir_transmit_learn(rmt_channel_handle_t tx_channel,
+                              rmt_encoder_handle_t encoder,
+                              const rmt_transmit_config_t *config,
+                              QueueHandle_t transmit_queue, uint16_t learnmask,
+                              rmt_symbol_word_t *symbols, size_t max_symbols)
+{
+    rmt_tx_done_event_data_t tx_data;
+    uint32_t gap_ms = 0;
+    size_t num = 0;
+    int frame = 0;
+
+    for (int index = 0; index < IR_LEARN_MAX_ENTRIES; index++)
+    {
+        if (!(learnmask & (1 << index)))
+        {
+            continue;
+        }
+        for (frame = 0;; frame++)
+        {
+            num = ir_learn_get_frame(index, frame, symbols, max_symbols,
+                                     &gap_ms);
+            if (num == 0)
+            {
+                break;
+            }
+            if ((frame > 0) && (gap_ms > 0))
+            {
+                vTaskDelay(pdMS_TO_TICKS(gap_ms));
+            }
+            ESP_ERROR_CHECK(rmt_transmit(tx_channel, encoder, symbols,
+                                         num * sizeof(rmt_symbol_word_t),
+                                         config));
+            if (xQueueReceive(transmit_queue, &tx_data, pdMS_TO_TICKS(200)) !=
+                pdPASS)
+            {
+                syslog_handler(SYSLOG_FACILITY_RMT, SYSLOG_LEVEL_ERROR,
+                               "TX fail");
+            }
+            rmt_tx_wait_all_done(tx_channel, 50);
+        }
+        syslog_handler(SYSLOG_FACILITY_RMT,
+                       (frame > 0) ? SYSLOG_LEVEL_DEBUG : SYSLOG_LEVEL_ERROR,
+                       "TX learned IR %d, %d frames", index, frame);
+    }
+}
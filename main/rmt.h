@@ -35,6 +35,8 @@ extern "C" {
 #define IR_TYPE_ZERO     2
 #define IR_TYPE_DELTA    3
 #define IR_TYPE_DYSON    4
+#define IR_TYPE_LEARN    5
+#define IR_TYPE_MAX      6
 
 /* Define Hitachi IR Protocol */
 #define HITACHI_IRP_OPCODE_BYTE         11
@@ -90,7 +92,7 @@ extern "C" {
 #define HTA_PAYLOAD_ONE_DURATION_1      1300
 #define HTA_REPEAT_CODE_DURATION_0      3400
 #define HTA_REPEAT_CODE_DURATION_1      1600
-#define HTA_END_CODE_DURATION_0         450
+#define HTA_END_CODE_DURATION_0         420
 #define HTA_END_CODE_DURATION_1         0
 #define IR_HTA_DECODE_MARGIN            400     // Tolerance for parsing RMT symbols into bit stream
 
@@ -113,17 +115,17 @@ extern "C" {
 /**
  * @brief Delta timing spec
  */
-#define DELTA_LEADING_CODE_DURATION_0     9000
-#define DELTA_LEADING_CODE_DURATION_1     4450
-#define DELTA_PAYLOAD_ZERO_DURATION_0     590
-#define DELTA_PAYLOAD_ZERO_DURATION_1     550
-#define DELTA_PAYLOAD_ONE_DURATION_0      590
-#define DELTA_PAYLOAD_ONE_DURATION_1      1640
+#define DELTA_LEADING_CODE_DURATION_0     8950
+#define DELTA_LEADING_CODE_DURATION_1     4500
+#define DELTA_PAYLOAD_ZERO_DURATION_0     540
+#define DELTA_PAYLOAD_ZERO_DURATION_1     600
+#define DELTA_PAYLOAD_ONE_DURATION_0      540
+#define DELTA_PAYLOAD_ONE_DURATION_1      1690
 #define DELTA_END_CODE_DURATION_0         590
 #define DELTA_END_CODE_DURATION_1         0
 #define DELTA_REPEAT_CODE_DURATION_0      590
 #define DELTA_REPEAT_CODE_DURATION_1      19910
-#define IR_DELTA_DECODE_MARGIN            20     // Tolerance for parsing RMT symbols into bit stream
+#define IR_DELTA_DECODE_MARGIN            400    // Tolerance for parsing RMT symbols into bit stream, the remote is ~50us off
 
 /**
  * @brief Dyson timing spec
@@ -136,15 +138,19 @@ extern "C" {
 #define DYSON_PAYLOAD_ONE_DURATION_1      1300
 #define DYSON_END_CODE_DURATION_0         800
 #define DYSON_END_CODE_DURATION_1         0
-#define IR_DYSON_DECODE_MARGIN            100     // Tolerance for parsing RMT symbols into bit stream
+#define IR_DYSON_DECODE_MARGIN            300     // Tolerance for parsing RMT symbols into bit stream, < half of 1300-650
 
 #define RMT_RX_MEM_BLK_SYMB 384
+#define RMT_RX_BUFFER_NUM   2   /* Ping-pong, one armed while one is parsed */
+#define RMT_RX_EVENT_NUM    5
+#define RMT_LEARN_POLL_MS   100
+#define RMT_IDLE_POLL_MS    1000
 #define RMT_TX_MEM_BLK_SYMB 128
 
 #define IR_DELTA_FAN_TIGGER_ACTIVE_ON       1
 #define IR_DELTA_FAN_TIGGER_ACTIVE_OFF      2
 
-/* Defined based on priority */
+/* Defined based on priority, bit n of the lease mask */
 #define IR_DELTA_FAN_TIGGER_MODE_MANUAL   0
 #define IR_DELTA_FAN_TIGGER_MODE_EXHAUST  1
 #define IR_DELTA_FAN_TIGGER_MODE_WARM     2
@@ -186,8 +192,17 @@ typedef struct {
     int hith;
     int loth;
     int duration;
+    uint16_t learnmask;     /* IR_TYPE_LEARN, learned commands to send */
+    int64_t enqueue_us;     /* First request of the slot, esp_timer time */
 } rmt_msg_t;
 
+typedef struct {
+    uint32_t count;
+    int64_t last_us;
+    int64_t max_us;
+    int64_t total_us;
+} rmt_tx_latency_t;
+
 typedef struct {
     bool bmodech;       /* Cold, Warm, Auto */
     bool bactivech;     /* On, Off */
@@ -212,19 +227,25 @@ typedef struct {
     int swing;
 } rmt_zftg_msg_t;
 
+/* Dyson Fan uses the same relative keys as +-0 Fan */
+typedef rmt_zftg_msg_t rmt_dftg_msg_t;
+
 extern QueueHandle_t gqueue_rmt_tx;
 
 void task_rmt(void *pvParameters);
 int ir_deltafan_tigger(int mode, int active, int duration);
 int ir_hitachiac_tigger(rmt_hattg_msg_t msg);
 int ir_zerofan_tigger(rmt_zftg_msg_t msg);
+int ir_dysonfan_tigger(rmt_dftg_msg_t msg);
+int ir_learncmd_tigger(int index);
 void ir_hitachiac_delay_timer_callback();
-void ir_sync_delta_manual_timer_callback();
 int ir_get_deltascheduler(int, uint8_t *);
-int ir_set_deltascheduler(int, uint8_t);
+bool ir_deltafan_isleased(int mode);
 int ir_set_hitachi_config(uint8_t config);
 int ir_get_hitachi_config(uint8_t *config);
 int rmt_form_tx_data(rmt_msg_t *rmt_msg);
+void rmt_get_rx_stats(uint32_t *frames, uint32_t *dropped);
+int rmt_get_tx_latency(char type, rmt_tx_latency_t *latency);
 #ifdef __cplusplus
 }
 #endif
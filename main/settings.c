@@ -0,0 +1,255 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+#include "nvs.h"
+#include "settings.h"
+#include "syslog.h"
+#include "system.h"
+#include "timer_wheel.h"
+
+#define SETTINGS_TYPE_I32   0
+#define SETTINGS_TYPE_U32   1
+#define SETTINGS_TYPE_STR   2
+
+typedef struct
+{
+    const char *space;      /* NULL once written */
+    char key[SETTINGS_MAXLEN_KEY + 1];
+    uint8_t type;
+    int32_t value;
+    char str[SETTINGS_MAXLEN_STR + 1];
+} settings_entry_t;
+
+static settings_entry_t gsettings_pending[SETTINGS_MAX_PENDING];
+static int gsettings_count = 0;
+static int gsettings_timer = TIMER_WHEEL_INVALID;
+static SemaphoreHandle_t gsemaSettings = NULL;
+
+static esp_err_t settings_set_entry(nvs_handle_t handle,
+                                    const settings_entry_t *entry)
+{
+    switch (entry->type)
+    {
+    case SETTINGS_TYPE_I32:
+        return nvs_set_i32(handle, entry->key, entry->value);
+    case SETTINGS_TYPE_U32:
+        return nvs_set_u32(handle, entry->key, (uint32_t)entry->value);
+    default:
+        return nvs_set_str(handle, entry->key, entry->str);
+    }
+}
+
+/* One open and one commit per namespace, entries are consumed */
+static void settings_write(settings_entry_t *entries, int num)
+{
+    nvs_handle_t handle;
+    esp_err_t ret;
+    int keys = 0;
+
+    for (int i = 0; i < num; i++)
+    {
+        if (entries[i].space == NULL)
+        {
+            continue;
+        }
+        const char *space = entries[i].space;
+
+        ret = nvs_open(space, NVS_READWRITE, &handle);
+        keys = 0;
+        for (int j = i; j < num; j++)
+        {
+            if ((entries[j].space == NULL) || strcmp(entries[j].space, space))
+            {
+                continue;
+            }
+            if ((ret == ESP_OK) &&
+                (settings_set_entry(handle, &entries[j]) == ESP_OK))
+            {
+                keys++;
+            }
+            entries[j].space = NULL;
+        }
+        if (ret != ESP_OK)
+        {
+            syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_ERROR,
+                           "NVS open failed for name %s error %s", space,
+                           esp_err_to_name(ret));
+            continue;
+        }
+        ret = nvs_commit(handle);
+        nvs_close(handle);
+        if (ret != ESP_OK)
+        {
+            syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_ERROR,
+                           "NVS commit failed for name %s error %s", space,
+                           esp_err_to_name(ret));
+            continue;
+        }
+        syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_DEBUG,
+                       "Config saved %d keys in %s", keys, space);
+    }
+}
+
+/* Call with gsemaSettings taken */
+static void settings_flush(void)
+{
+    settings_write(gsettings_pending, gsettings_count);
+    gsettings_count = 0;
+}
+
+static void settings_timeout(void *arg)
+{
+    settings_commit();
+}
+
+static void settings_shutdown(void)
+{
+    if ((gsemaSettings != NULL) &&
+        (xSemaphoreTake(gsemaSettings, pdMS_TO_TICKS(100)) == pdTRUE))
+    {
+        settings_flush();
+        xSemaphoreGive(gsemaSettings);
+    }
+}
+
+static int settings_stage(const settings_entry_t *entry)
+{
+    settings_entry_t *slot = NULL;
+
+    if (gsemaSettings == NULL)
+    {
+        settings_entry_t now = *entry;
+
+        settings_write(&now, 1);
+        return SYSTEM_ERROR_NONE;
+    }
+    if (xSemaphoreTake(gsemaSettings, portMAX_DELAY) == pdTRUE)
+    {
+        for (int i = 0; i < gsettings_count; i++)
+        {
+            if (!strcmp(gsettings_pending[i].space, entry->space) &&
+                !strcmp(gsettings_pending[i].key, entry->key))
+            {
+                slot = &gsettings_pending[i];
+                break;
+            }
+        }
+        if (slot == NULL)
+        {
+            if (gsettings_count == SETTINGS_MAX_PENDING)
+            {
+                settings_flush();
+            }
+            slot = &gsettings_pending[gsettings_count++];
+        }
+        *slot = *entry;
+        xSemaphoreGive(gsemaSettings);
+    }
+    /* Every change pushes the commit back */
+    timer_wheel_start(gsettings_timer, SETTINGS_COMMIT_DELAY_MS);
+    return SYSTEM_ERROR_NONE;
+}
+
+static int settings_check(const char *space, const char *key)
+{
+    if ((space == NULL) || (key == NULL))
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if (strlen(key) > SETTINGS_MAXLEN_KEY)
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+void settings_init(void)
+{
+    if (gsemaSettings != NULL)
+    {
+        return;
+    }
+    if (timer_wheel_add(settings_timeout, NULL, "Settings", &gsettings_timer) !=
+        SYSTEM_ERROR_NONE)
+    {
+        return;
+    }
+    gsemaSettings = xSemaphoreCreateBinary();
+    if (gsemaSettings == NULL)
+    {
+        return;
+    }
+    xSemaphoreGive(gsemaSettings);
+    esp_register_shutdown_handler(settings_shutdown);
+}
+
+int settings_set_i32(const char *space, const char *key, int32_t value)
+{
+    settings_entry_t entry = {.space = space, .type = SETTINGS_TYPE_I32,
+                              .value = value};
+    int ret = settings_check(space, key);
+
+    if (ret != SYSTEM_ERROR_NONE)
+    {
+        return ret;
+    }
+    strcpy(entry.key, key);
+    return settings_stage(&entry);
+}
+
+int settings_set_u32(const char *space, const char *key, uint32_t value)
+{
+    settings_entry_t entry = {.space = space, .type = SETTINGS_TYPE_U32,
+                              .value = (int32_t)value};
+    int ret = settings_check(space, key);
+
+    if (ret != SYSTEM_ERROR_NONE)
+    {
+        return ret;
+    }
+    strcpy(entry.key, key);
+    return settings_stage(&entry);
+}
+
+int settings_set_str(const char *space, const char *key, const char *value)
+{
+    settings_entry_t entry = {.space = space, .type = SETTINGS_TYPE_STR};
+    int ret = settings_check(space, key);
+
+    if (ret != SYSTEM_ERROR_NONE)
+    {
+        return ret;
+    }
+    if (value == NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if (strlen(value) > SETTINGS_MAXLEN_STR)
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    strcpy(entry.key, key);
+    strcpy(entry.str, value);
+    return settings_stage(&entry);
+}
+
+void settings_commit(void)
+{
+    if (gsemaSettings == NULL)
+    {
+        return;
+    }
+    timer_wheel_stop(gsettings_timer);
+    if (xSemaphoreTake(gsemaSettings, portMAX_DELAY) == pdTRUE)
+    {
+        settings_flush();
+        xSemaphoreGive(gsemaSettings);
+    }
+}
@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SETTINGS_MAX_PENDING        16
+#define SETTINGS_MAXLEN_KEY         15      /* NVS limit */
+#define SETTINGS_MAXLEN_STR         32
+#define SETTINGS_COMMIT_DELAY_MS    2000    /* Quiet time before a commit */
+
+/**
+ * @brief Start deferring NVS writes, call it after timer_wheel_init()
+ *
+ * Settings written before are stored at once.
+ */
+void settings_init(void);
+
+/**
+ * @brief Stage one setting of a namespace
+ *
+ * A newer value of the same key replaces the staged one. Staged settings are
+ * written once SETTINGS_COMMIT_DELAY_MS pass without a change, with one open
+ * and one commit per namespace, or when the device restarts.
+ *
+ * @param[in] space Namespace, it must stay valid until the commit
+ */
+int settings_set_i32(const char *space, const char *key, int32_t value);
+int settings_set_u32(const char *space, const char *key, uint32_t value);
+
+/**
+ * @param[in] value SETTINGS_MAXLEN_STR characters at most
+ */
+int settings_set_str(const char *space, const char *key, const char *value);
+
+/**
+ * @brief Write the staged settings now
+ */
+void settings_commit(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -37,7 +37,7 @@ void task_sntpc(void *pvParameter)
 
     while (1) 
     {
-        syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_INFO,"Free Heap: %d,%03d bytes", heap_caps_get_free_size(MALLOC_CAP_8BIT)/1000,heap_caps_get_free_size(MALLOC_CAP_8BIT)%1000);
+        syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_INFO,"Free Heap: %d,%03d bytes", (int)(heap_caps_get_free_size(MALLOC_CAP_8BIT)/1000),(int)(heap_caps_get_free_size(MALLOC_CAP_8BIT)%1000));
         vTaskDelay((24*60*60*1000) / portTICK_PERIOD_MS); // Per 1 Day
     }
 }
\ No newline at end of file
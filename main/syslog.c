@@ -3,11 +3,21 @@
  *
  * SPDX-License-Identifier: Apache-2.0
  */
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <sys/param.h>
+#include <sys/time.h>
+#include <time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "logring.h"
 #include "syslog.h"
+#include "syslog_args.h"
 #include "system.h"
 #include "lwip/sockets.h"
 
@@ -16,11 +26,112 @@ char gsyslog_facility_str[SYSLOG_FACILITY_MAXNUM][SYSLOG_MAXLEN_FACILITY_STR+1]
 char gsyslog_level_str[SYSLOG_LEVEL_MAXNUM][SYSLOG_MAXLEN_LEVEL_STR+1] = {"Debug","Info","Warning","Alert","Error"};
 
 static const char *TAG_SYSLOG = "Syslog";
-static void syslog_send(const char *message);
+static void task_syslog(void *pvParameters);
 char gsyslog_switch[SYSLOG_FACILITY_MAXNUM]={SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT,SYSLOG_LEVEL_DEFAULT};
 
 SemaphoreHandle_t gsemaSyslog = NULL;
 
+_Static_assert((SYSLOG_RING_SLOTS & (SYSLOG_RING_SLOTS - 1)) == 0,
+               "SYSLOG_RING_SLOTS must be a power of 2");
+
+
+/*
+ * Bounded MPSC ring of binary records. A slot is free for position p when
+ * its seq is p, and ready to send when its seq is p+1. Producers claim a
+ * position with one CAS on the head and never wait, the sender task is the
+ * only consumer. A memory dump of it is decoded by syslog_decode.py.
+ */
+static syslog_record_t gsyslog_ring[SYSLOG_RING_SLOTS];
+static atomic_uint gsyslog_ring_head;   /* Next position to claim */
+static atomic_uint gsyslog_ring_tail;   /* Next position to send */
+static atomic_uint gsyslog_queued;
+static atomic_uint gsyslog_dropped;
+static atomic_uint gsyslog_sequence;
+static uint32_t gsyslog_sent = 0;
+static uint32_t gsyslog_batches = 0;
+static uint32_t gsyslog_send_failed = 0;
+static TaskHandle_t gsyslog_task = NULL;
+
+/* RFC 5424 severities of SYSLOG_LEVEL_xxx */
+static const uint8_t gsyslog_severity[SYSLOG_LEVEL_MAXNUM] = {7, 6, 4, 1, 3};
+
+/* Sender task only */
+static char gsyslog_batch[SYSLOG_BATCH_MAXLEN];
+static int gsyslog_batch_len = 0;
+static int gsyslog_batch_lines = 0;
+static int gsyslog_sock = -1;
+#if CONFIG_SYSLOG_TCP
+static in_addr_t gsyslog_sock_addr = 0;     /* Server of the TCP connection */
+static TickType_t gsyslog_connect_tick = 0; /* Last failed connect */
+#endif
+static char gsyslog_hostname[13] = "-";
+
+static syslog_record_t *syslog_ring_claim(unsigned int *pos)
+{
+    syslog_record_t *slot = NULL;
+    unsigned int head = atomic_load_explicit(&gsyslog_ring_head, memory_order_relaxed);
+    int diff = 0;
+
+    while(1)
+    {
+        slot = &gsyslog_ring[head & (SYSLOG_RING_SLOTS - 1)];
+        diff = (int)(atomic_load_explicit(&slot->seq, memory_order_acquire) - head);
+        if(diff == 0)
+        {
+            if(atomic_compare_exchange_weak_explicit(&gsyslog_ring_head, &head, head + 1,
+                                                     memory_order_relaxed, memory_order_relaxed))
+            {
+                *pos = head;
+                return slot;
+            }
+        }
+        else if(diff < 0)
+        {
+            /* Sender is a full ring behind */
+            atomic_fetch_add_explicit(&gsyslog_dropped, 1, memory_order_relaxed);
+            return NULL;
+        }
+        else
+        {
+            head = atomic_load_explicit(&gsyslog_ring_head, memory_order_relaxed);
+        }
+    }
+}
+
+static void syslog_ring_publish(syslog_record_t *slot, unsigned int pos)
+{
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    atomic_fetch_add_explicit(&gsyslog_queued, 1, memory_order_relaxed);
+    if((pos - atomic_load_explicit(&gsyslog_ring_tail, memory_order_relaxed)) >= SYSLOG_RING_SLOTS / 2 &&
+       gsyslog_task != NULL)
+    {
+        xTaskNotifyGive(gsyslog_task);
+    }
+}
+
+
+/* Sender task only */
+static syslog_record_t *syslog_ring_peek(void)
+{
+    unsigned int tail = atomic_load_explicit(&gsyslog_ring_tail, memory_order_relaxed);
+    syslog_record_t *slot = &gsyslog_ring[tail & (SYSLOG_RING_SLOTS - 1)];
+
+    if(atomic_load_explicit(&slot->seq, memory_order_acquire) != tail + 1)
+    {
+        return NULL;
+    }
+    return slot;
+}
+
+/* Sender task only */
+static void syslog_ring_release(syslog_record_t *slot)
+{
+    unsigned int tail = atomic_load_explicit(&gsyslog_ring_tail, memory_order_relaxed);
+
+    atomic_store_explicit(&slot->seq, tail + SYSLOG_RING_SLOTS, memory_order_release);
+    atomic_store_explicit(&gsyslog_ring_tail, tail + 1, memory_order_relaxed);
+}
+
 int syslog_get_facility_level(uint32_t facility, uint32_t* level)
 {
     if(gsemaSyslog==NULL)
@@ -37,7 +148,7 @@ int syslog_get_facility_level(uint32_t facility, uint32_t* level)
     {
         *level = gsyslog_switch[facility];
         xSemaphoreGive(gsemaSyslog);
-        syslog_handler(SYSLOG_FACILITY_SYSLOG, SYSLOG_LEVEL_DEBUG,"Get facility %d level %d",facility,level);        
+        syslog_handler(SYSLOG_FACILITY_SYSLOG, SYSLOG_LEVEL_DEBUG,"Get facility %d level %d",facility,*level);        
     }
     return SYSTEM_ERROR_NONE;
 }
@@ -123,53 +234,50 @@ int syslog_set_level_status(uint32_t facility, uint32_t level, bool status)
     return SYSTEM_ERROR_NONE;
 }
 
+int syslog_get_stats(syslog_stats_t *stats)
+{
+    if(stats==NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    stats->queued = atomic_load_explicit(&gsyslog_queued, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&gsyslog_dropped, memory_order_relaxed);
+    stats->sent = gsyslog_sent;
+    stats->batches = gsyslog_batches;
+    stats->send_failed = gsyslog_send_failed;
+    return SYSTEM_ERROR_NONE;
+}
+
 void syslog_handler(uint32_t facility, uint32_t level, const char *fmt, ...)
 {
-    char msg_buf[256]={0};
-    char final_buf[512]={0};
-    bool bsend = false;
-    bool blog = false;
+    syslog_record_t *slot = NULL;
+    unsigned int pos = 0, sequence = 0;
     va_list args;
 
-    if (gsemaSyslog==NULL)
+    if (gsyslog_task==NULL || facility>=SYSLOG_FACILITY_MAXNUM || level>=SYSLOG_LEVEL_MAXNUM)
         return;
 
-    if (xSemaphoreTake(gsemaSyslog, portMAX_DELAY) == pdTRUE) 
+    /* A byte read is atomic, the switch doesn't need gsemaSyslog here */
+    if (!(gsyslog_switch[facility] & (char)(0x01 << level)))
     {
-        if ((gsyslog_switch[facility] & (char)(0x01 << level)) )
-        {
-            bsend = true;
-        }
-        
-        /*if((facility==SYSLOG_FACILITY_WEB||facility==SYSLOG_FACILITY_ANN)&&level==SYSLOG_LEVEL_DEBUG)
-        {
-            blog = true;
-        }*/
-        xSemaphoreGive(gsemaSyslog);
-
-        if(!bsend&&!blog)
-        {
-            return;
-        }
-        
-        va_start(args, fmt);
-        int len = vsnprintf(msg_buf, sizeof(msg_buf), fmt, args);
-        va_end(args);
-
-        snprintf(final_buf, sizeof(final_buf), "<%s><%s> %s", gsyslog_facility_str[facility],gsyslog_level_str[level], msg_buf);
+        return;
+    }
 
-        if (len > 0)
-        {
-            if(blog)
-            {
-                printf("%s\n",final_buf);
-            }
-            if(bsend)
-            {
-                syslog_send(final_buf);
-            }
-        }
+    /* Taken before the ring, so the receiver sees a gap for a drop */
+    sequence = atomic_fetch_add_explicit(&gsyslog_sequence, 1, memory_order_relaxed) + 1;
+    slot = syslog_ring_claim(&pos);
+    if(slot==NULL)
+    {
+        return;
     }
+    slot->sequence = sequence;
+    slot->facility = facility;
+    slot->level = level;
+    slot->time_ms = esp_timer_get_time() / 1000;
+    va_start(args, fmt);
+    syslog_args_capture(&slot->args, fmt, args);
+    va_end(args);
+    syslog_ring_publish(slot, pos);
     return;    
 }
 
@@ -188,6 +296,10 @@ void syslog_restoreconfig(void)
     {
         return;
     }
+    for(int i = 0; i < SYSLOG_RING_SLOTS; i++)
+    {
+        atomic_init(&gsyslog_ring[i].seq, i);
+    }
     ret = nvs_open(SYSLOG_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG_NVS, "NVS open failed: %s", esp_err_to_name(ret));
@@ -224,6 +336,8 @@ void syslog_restoreconfig(void)
         fclose(f);
     }
     xSemaphoreGive(gsemaSyslog);
+    xTaskCreate(task_syslog, SYSLOG_TASK_NAME, SYSLOG_TASK_STACKSIZE, NULL,
+                SYSLOG_TASK_PRIORITY, &gsyslog_task);
     return;
 }
 
@@ -263,29 +377,231 @@ void syslog_saveconfig(char *key, char *serverip)
     return;
 }
 
-static void syslog_send(const char *message)
+static in_addr_t syslog_server_addr(void)
+{
+    in_addr_t addr = INADDR_NONE;
+
+    if (xSemaphoreTake(gsemaSyslog, portMAX_DELAY) == pdTRUE) 
+    {
+        addr = inet_addr(gsyslog_server_ip);
+        xSemaphoreGive(gsemaSyslog);
+    }
+    return addr;
+}
+
+#if CONFIG_SYSLOG_TCP
+static int syslog_connect(in_addr_t addr)
 {
-    int sock;
     struct sockaddr_in server_addr;
+    struct timeval timeout = {.tv_sec = SYSLOG_TCP_TIMEOUT_MS / 1000,
+                              .tv_usec = (SYSLOG_TCP_TIMEOUT_MS % 1000) * 1000};
 
-    if(system_isrebooting())
+    if(gsyslog_sock >= 0 && gsyslog_sock_addr == addr)
     {
-        return;
+        return 0;
+    }
+    if(gsyslog_sock >= 0)
+    {
+        /* Server changed */
+        close(gsyslog_sock);
+        gsyslog_sock = -1;
+    }
+    if(gsyslog_connect_tick != 0 &&
+       xTaskGetTickCount() - gsyslog_connect_tick < pdMS_TO_TICKS(SYSLOG_TCP_RETRY_MS))
+    {
+        return -1;
     }
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock < 0) {
+
+    gsyslog_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (gsyslog_sock < 0) {
         ESP_LOGE(TAG_SYSLOG, "Error creating socket");
-        return;
+        return -1;
+    }
+    setsockopt(gsyslog_sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(SYSLOG_SERVER_PORT);
+    server_addr.sin_addr.s_addr = addr;
+    if (connect(gsyslog_sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        ESP_LOGE(TAG_SYSLOG, "Error connecting to server");
+        close(gsyslog_sock);
+        gsyslog_sock = -1;
+        gsyslog_connect_tick = xTaskGetTickCount() | 1;
+        return -1;
+    }
+    gsyslog_sock_addr = addr;
+    gsyslog_connect_tick = 0;
+    return 0;
+}
+
+static int syslog_send(const char *batch, int len)
+{
+    int sent = 0, ret = 0;
+
+    if(syslog_connect(syslog_server_addr()) < 0)
+    {
+        return -1;
+    }
+    while(sent < len)
+    {
+        ret = send(gsyslog_sock, batch + sent, len - sent, 0);
+        if(ret <= 0)
+        {
+            ESP_LOGE(TAG_SYSLOG, "Error sending message");
+            close(gsyslog_sock);
+            gsyslog_sock = -1;
+            return -1;
+        }
+        sent += ret;
+    }
+    return 0;
+}
+#else
+static int syslog_send(const char *batch, int len)
+{
+    struct sockaddr_in server_addr;
+
+    if(gsyslog_sock < 0)
+    {
+        gsyslog_sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (gsyslog_sock < 0) {
+            ESP_LOGE(TAG_SYSLOG, "Error creating socket");
+            return -1;
+        }
     }
 
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(SYSLOG_SERVER_PORT);
-    server_addr.sin_addr.s_addr = inet_addr(gsyslog_server_ip);
+    server_addr.sin_addr.s_addr = syslog_server_addr();
 
-    if (sendto(sock, message, strlen(message), 0, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+    if (sendto(gsyslog_sock, batch, len, 0, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
         ESP_LOGE(TAG_SYSLOG, "Error sending message");
+        /* Start over with a new socket, the netif may have been restarted */
+        close(gsyslog_sock);
+        gsyslog_sock = -1;
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+static void syslog_flush(void)
+{
+    if(gsyslog_batch_len == 0)
+    {
+        return;
+    }
+    if(!system_isrebooting() && syslog_send(gsyslog_batch, gsyslog_batch_len) == 0)
+    {
+        gsyslog_sent += gsyslog_batch_lines;
+        gsyslog_batches++;
+    }
+    else
+    {
+        gsyslog_send_failed += gsyslog_batch_lines;
+    }
+    gsyslog_batch_len = 0;
+    gsyslog_batch_lines = 0;
+}
+
+/*
+ * <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID [meta ...] MSG
+ * The facility name goes to MSGID, everything is sent as local0.
+ */
+static void syslog_queue_message(uint32_t facility, uint32_t level, uint32_t time_ms,
+                                 uint32_t sequence, const char *text)
+{
+    static char message[SYSLOG_MSG_MAXLEN + 128];
+    char timestamp[32] = "-";
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    struct timeval tv;
+    struct tm tm;
+    time_t sec;
+    int len = 0, prefix = 0, ms = 0;
+
+    gettimeofday(&tv, NULL);
+    if(tv.tv_sec >= SYSLOG_TIME_VALID)
+    {
+        /* Wall clock of the call, not of the send. time_ms wraps after
+           49.7 days, the age is taken in the same 32 bits. */
+        uint32_t age_ms = (uint32_t)now_ms - time_ms;
+        int64_t wall_ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000 -
+                          age_ms;
+        sec = wall_ms / 1000;
+        ms = wall_ms % 1000;
+        gmtime_r(&sec, &tm);
+        snprintf(timestamp, sizeof(timestamp), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                 tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
+                 tm.tm_sec, ms);
     }
+    len = snprintf(message, sizeof(message),
+                   "<%d>1 %s %s %s - %s [meta sequenceId=\"%lu\" sysUpTime=\"%lu\"] %s",
+                   SYSLOG_RFC5424_FACILITY * 8 + gsyslog_severity[level], timestamp,
+                   gsyslog_hostname, SYSLOG_APP_NAME, gsyslog_facility_str[facility],
+                   (unsigned long)(sequence & 0x7FFFFFFF), (unsigned long)(time_ms / 10), text);
+    len = MIN(len, (int)sizeof(message) - 1);
 
-    close(sock);
-}
\ No newline at end of file
+#if CONFIG_SYSLOG_TCP
+    /* RFC 6587 octet counting, frames are packed back to back */
+    prefix = snprintf(NULL, 0, "%d ", len);
+#endif
+    if(gsyslog_batch_len + prefix + len > sizeof(gsyslog_batch))
+    {
+        syslog_flush();
+    }
+#if CONFIG_SYSLOG_TCP
+    gsyslog_batch_len += snprintf(gsyslog_batch + gsyslog_batch_len,
+                                  sizeof(gsyslog_batch) - gsyslog_batch_len, "%d ", len);
+#endif
+    memcpy(gsyslog_batch + gsyslog_batch_len, message, len);
+    gsyslog_batch_len += len;
+    gsyslog_batch_lines++;
+#if !CONFIG_SYSLOG_TCP
+    /* RFC 5426, one message per datagram */
+    syslog_flush();
+#endif
+}
+
+static void task_syslog(void *pvParameters)
+{
+    static char text[SYSLOG_MSG_MAXLEN];
+    syslog_record_t *slot = NULL;
+    uint32_t dropped = 0, reported = 0;
+    uint8_t mac[6];
+    int len = 0;
+
+    if(esp_read_mac(mac, ESP_MAC_WIFI_STA) == ESP_OK)
+    {
+        snprintf(gsyslog_hostname, sizeof(gsyslog_hostname), "%02X%02X%02X%02X%02X%02X",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    }
+
+    while(1)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SYSLOG_FLUSH_MS));
+
+        dropped = atomic_load_explicit(&gsyslog_dropped, memory_order_relaxed);
+        if(dropped != reported)
+        {
+            snprintf(text, sizeof(text), "Dropped %lu messages", (unsigned long)(dropped - reported));
+            syslog_queue_message(SYSLOG_FACILITY_SYSLOG, SYSLOG_LEVEL_WARNING,
+                                 esp_timer_get_time() / 1000,
+                                 atomic_fetch_add_explicit(&gsyslog_sequence, 1, memory_order_relaxed) + 1,
+                                 text);
+            reported = dropped;
+        }
+        while((slot = syslog_ring_peek()) != NULL)
+        {
+            len = syslog_args_format(&slot->args, text, sizeof(text));
+            if(slot->level >= CONFIG_SYSLOG_FLASH_MIN_LEVEL)
+            {
+                logring_append(slot->facility, slot->level, slot->sequence, slot->time_ms, text, len);
+            }
+            syslog_queue_message(slot->facility, slot->level, slot->time_ms, slot->sequence, text);
+            syslog_ring_release(slot);
+        }
+        syslog_flush();
+        logring_poll();
+    }
+}
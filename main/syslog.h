@@ -6,6 +6,7 @@
 #pragma once
 
 #include <stdint.h>
+#include "sdkconfig.h"
 #include "driver/rmt_encoder.h"
 
 #ifdef __cplusplus
@@ -17,7 +18,19 @@ extern "C" {
 #define SYSLOG_MAXLEN_IP                15
 #define SYSLOG_MAXLEN_FACILITY_STR      15
 #define SYSLOG_MAXLEN_LEVEL_STR         10
-#define SYSLOG_SERVER_PORT 8514
+#define SYSLOG_SERVER_PORT              CONFIG_SYSLOG_SERVER_PORT
+#define SYSLOG_APP_NAME                 "RoomAssist"
+#define SYSLOG_RFC5424_FACILITY         16      /* local0 */
+#define SYSLOG_TIME_VALID               1451606400  /* 2016-01-01, SNTP synced */
+#define SYSLOG_TCP_TIMEOUT_MS           2000
+#define SYSLOG_TCP_RETRY_MS             5000
+#define SYSLOG_RING_SLOTS               64      /* Power of 2 */
+#define SYSLOG_MSG_MAXLEN               240     /* Text of one message */
+#define SYSLOG_BATCH_MAXLEN             1400    /* One TCP write, below the MTU */
+#define SYSLOG_FLUSH_MS                 200     /* Or when half the ring is used */
+#define SYSLOG_TASK_NAME                "Syslog"
+#define SYSLOG_TASK_STACKSIZE           4096
+#define SYSLOG_TASK_PRIORITY            3
 
 #define SYSLOG_FACILITY_AIRQUALITY      0
 #define SYSLOG_FACILITY_ANN             1
@@ -57,9 +70,26 @@ extern "C" {
 
 #define SYSLOG_CFG_PATH                  "/spiffs/slg_sw.bin"
 
+typedef struct
+{
+    uint32_t queued;        /* Messages taken by the ring */
+    uint32_t dropped;       /* Ring full */
+    uint32_t sent;          /* Messages in sent datagrams */
+    uint32_t batches;       /* Datagrams or TCP writes */
+    uint32_t send_failed;   /* Messages lost by socket errors */
+} syslog_stats_t;
+
 extern char gsyslog_facility_str[SYSLOG_FACILITY_MAXNUM][SYSLOG_MAXLEN_FACILITY_STR+1];
 extern char gsyslog_level_str[SYSLOG_LEVEL_MAXNUM][SYSLOG_MAXLEN_LEVEL_STR+1];
-void syslog_handler(uint32_t facility, uint32_t level, const char *fmt, ...);
+/**
+ * @brief Queue a message, it's formatted later by the syslog task
+ *
+ * Only the arguments are copied, %s strings included, so fmt itself must
+ * stay valid: it has to be a string literal, print run time text through
+ * "%s". The build rejects other formats with -Werror=format-nonliteral.
+ */
+void syslog_handler(uint32_t facility, uint32_t level, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
 void syslog_restoreconfig(void);
 void syslog_saveconfig(char *key, char *serverip);
 int syslog_set_facility_level(uint32_t facility, uint32_t level);
@@ -67,6 +97,7 @@ int syslog_get_facility_level(uint32_t facility, uint32_t* level);
 int syslog_set_server_ip(char *ip, int len);
 int syslog_get_server_ip(char *ip, int len);
 int syslog_set_level_status(uint32_t facility, uint32_t level, bool status);
+int syslog_get_stats(syslog_stats_t *stats);
 
 #ifdef __cplusplus
 }
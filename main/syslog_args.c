@@ -0,0 +1,322 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+#include "syslog_args.h"
+
+/* How an argument is stored in a record and passed back to snprintf */
+typedef enum
+{
+    SYSLOG_ARG_NONE = 0,
+    SYSLOG_ARG_INT,         /* 4 bytes */
+    SYSLOG_ARG_LONG,        /* 8 bytes from here on */
+    SYSLOG_ARG_LLONG,
+    SYSLOG_ARG_SIZE,
+    SYSLOG_ARG_PTRDIFF,
+    SYSLOG_ARG_INTMAX,
+    SYSLOG_ARG_PTR,
+    SYSLOG_ARG_DOUBLE,
+    SYSLOG_ARG_STR,         /* NUL terminated bytes */
+} syslog_arg_t;
+
+/*
+ * Walk a conversion spec after its '%'. Width and precision stars are
+ * reported through stars, the return is the conversion character.
+ */
+static const char *syslog_parse_spec(const char *p, int *stars, syslog_arg_t *type)
+{
+    int longs = 0;
+    char size = 0;
+
+    *stars = 0;
+    while(*p && strchr("-+ #0123456789.*", *p))
+    {
+        if(*p == '*')
+        {
+            (*stars)++;
+        }
+        p++;
+    }
+    while(*p && strchr("hlLzjt", *p))
+    {
+        if(*p == 'l')
+        {
+            longs++;
+        }
+        else if(*p != 'h')
+        {
+            size = *p;
+        }
+        p++;
+    }
+    switch(*p)
+    {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            *type = (size == 'z') ? SYSLOG_ARG_SIZE :
+                    (size == 't') ? SYSLOG_ARG_PTRDIFF :
+                    (size == 'j') ? SYSLOG_ARG_INTMAX :
+                    (longs >= 2) ? SYSLOG_ARG_LLONG :
+                    (longs == 1) ? SYSLOG_ARG_LONG : SYSLOG_ARG_INT;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            *type = SYSLOG_ARG_DOUBLE;
+            break;
+        case 'p':
+            *type = SYSLOG_ARG_PTR;
+            break;
+        case 's':
+            *type = SYSLOG_ARG_STR;
+            break;
+        default:
+            /* %n or something unknown, nothing is taken for it */
+            *type = SYSLOG_ARG_NONE;
+            break;
+    }
+    return p;
+}
+
+static bool syslog_put(syslog_args_t *args, const void *value, int size)
+{
+    if(args->len + size > SYSLOG_ARG_MAXLEN)
+    {
+        args->truncated = true;
+        return false;
+    }
+    memcpy(&args->data[args->len], value, size);
+    args->len += size;
+    return true;
+}
+
+/*
+ * Copy what the format string asks for into the record, nothing is
+ * formatted here. Strings are copied since they often live on the caller's
+ * stack.
+ */
+void syslog_args_capture(syslog_args_t *args, const char *fmt, va_list ap)
+{
+    const char *p = fmt;
+    syslog_arg_t type;
+    int stars = 0, word = 0;
+    int64_t dword = 0;
+    double real = 0;
+    const char *str = NULL;
+    size_t n = 0;
+    bool ok = true;
+
+    args->fmt = fmt;
+    args->len = 0;
+    args->truncated = false;
+    while(ok && (p = strchr(p, '%')) != NULL)
+    {
+        if(*++p == '%')
+        {
+            p++;
+            continue;
+        }
+        p = syslog_parse_spec(p, &stars, &type);
+        while(ok && stars-- > 0)
+        {
+            word = va_arg(ap, int);
+            ok = syslog_put(args, &word, sizeof(word));
+        }
+        if(!ok)
+        {
+            break;
+        }
+        switch(type)
+        {
+            case SYSLOG_ARG_INT:
+                word = va_arg(ap, int);
+                ok = syslog_put(args, &word, sizeof(word));
+                break;
+            case SYSLOG_ARG_LONG:
+                dword = va_arg(ap, long);
+                ok = syslog_put(args, &dword, sizeof(dword));
+                break;
+            case SYSLOG_ARG_LLONG:
+                dword = va_arg(ap, long long);
+                ok = syslog_put(args, &dword, sizeof(dword));
+                break;
+            case SYSLOG_ARG_SIZE:
+                dword = va_arg(ap, size_t);
+                ok = syslog_put(args, &dword, sizeof(dword));
+                break;
+            case SYSLOG_ARG_PTRDIFF:
+                dword = va_arg(ap, ptrdiff_t);
+                ok = syslog_put(args, &dword, sizeof(dword));
+                break;
+            case SYSLOG_ARG_INTMAX:
+                dword = va_arg(ap, intmax_t);
+                ok = syslog_put(args, &dword, sizeof(dword));
+                break;
+            case SYSLOG_ARG_PTR:
+                dword = (uintptr_t)va_arg(ap, void *);
+                ok = syslog_put(args, &dword, sizeof(dword));
+                break;
+            case SYSLOG_ARG_DOUBLE:
+                real = va_arg(ap, double);
+                ok = syslog_put(args, &real, sizeof(real));
+                break;
+            case SYSLOG_ARG_STR:
+                str = va_arg(ap, const char *);
+                str = (str == NULL) ? "(null)" : str;
+                if(args->len + 1 > SYSLOG_ARG_MAXLEN)
+                {
+                    /* Not even room for the NUL */
+                    args->truncated = true;
+                    ok = false;
+                    break;
+                }
+                /* Room left for the characters, the NUL takes the last byte */
+                n = strnlen(str, SYSLOG_ARG_MAXLEN - args->len - 1);
+                if(str[n] != '\0')
+                {
+                    /* Keep what fits, the rest of the record is lost */
+                    args->truncated = true;
+                    ok = false;
+                }
+                memcpy(&args->data[args->len], str, n);
+                args->data[args->len + n] = '\0';
+                args->len += n + 1;
+                break;
+            default:
+                if(*p == 'n')
+                {
+                    (void)va_arg(ap, void *);
+                }
+                break;
+        }
+        if(*p)
+        {
+            p++;
+        }
+    }
+}
+
+/*
+ * Call snprintf once per conversion with the value from the record. The
+ * conversions come from the literal checked at the syslog_handler call.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+int syslog_args_format(const syslog_args_t *args, char *out, int size)
+{
+    const char *p = args->fmt, *spec = NULL;
+    char conv[24];
+    int pos = 0, off = 0, stars = 0, word = 0, n = 0, k = 0;
+    int64_t dword = 0;
+    double real = 0;
+    syslog_arg_t type;
+
+#define SYSLOG_GET(v)                                           \
+    do                                                          \
+    {                                                           \
+        if(off + (int)sizeof(v) > args->len)                    \
+        {                                                       \
+            goto truncated;                                     \
+        }                                                       \
+        memcpy(&(v), &args->data[off], sizeof(v));              \
+        off += sizeof(v);                                       \
+    } while(0)
+
+    while(*p && pos < size - 1)
+    {
+        if(*p != '%')
+        {
+            out[pos++] = *p++;
+            continue;
+        }
+        if(p[1] == '%')
+        {
+            out[pos++] = '%';
+            p += 2;
+            continue;
+        }
+        spec = p;
+        p = syslog_parse_spec(p + 1, &stars, &type);
+        if(*p)
+        {
+            p++;
+        }
+        /* Rebuild the spec with the stars replaced by their values */
+        for(k = 0; spec < p && k < (int)sizeof(conv) - 12; spec++)
+        {
+            if(*spec == '*')
+            {
+                SYSLOG_GET(word);
+                k += snprintf(&conv[k], sizeof(conv) - k, "%d", word);
+            }
+            else
+            {
+                conv[k++] = *spec;
+            }
+        }
+        conv[k] = '\0';
+        switch(type)
+        {
+            case SYSLOG_ARG_INT:
+                SYSLOG_GET(word);
+                n = snprintf(&out[pos], size - pos, conv, word);
+                break;
+            case SYSLOG_ARG_LONG:
+                SYSLOG_GET(dword);
+                n = snprintf(&out[pos], size - pos, conv, (long)dword);
+                break;
+            case SYSLOG_ARG_LLONG:
+                SYSLOG_GET(dword);
+                n = snprintf(&out[pos], size - pos, conv, (long long)dword);
+                break;
+            case SYSLOG_ARG_SIZE:
+                SYSLOG_GET(dword);
+                n = snprintf(&out[pos], size - pos, conv, (size_t)dword);
+                break;
+            case SYSLOG_ARG_PTRDIFF:
+                SYSLOG_GET(dword);
+                n = snprintf(&out[pos], size - pos, conv, (ptrdiff_t)dword);
+                break;
+            case SYSLOG_ARG_INTMAX:
+                SYSLOG_GET(dword);
+                n = snprintf(&out[pos], size - pos, conv, (intmax_t)dword);
+                break;
+            case SYSLOG_ARG_PTR:
+                SYSLOG_GET(dword);
+                n = snprintf(&out[pos], size - pos, conv, (void *)(uintptr_t)dword);
+                break;
+            case SYSLOG_ARG_DOUBLE:
+                SYSLOG_GET(real);
+                n = snprintf(&out[pos], size - pos, conv, real);
+                break;
+            case SYSLOG_ARG_STR:
+                if(off >= args->len)
+                {
+                    goto truncated;
+                }
+                n = snprintf(&out[pos], size - pos, conv, (const char *)&args->data[off]);
+                off += strlen((const char *)&args->data[off]) + 1;
+                break;
+            default:
+                n = 0;
+                break;
+        }
+        pos += MAX(n, 0);
+    }
+    if(args->truncated)
+    {
+        goto truncated;
+    }
+    pos = MIN(pos, size - 1);
+    out[pos] = '\0';
+    return pos;
+
+truncated:
+    pos = MIN(pos, size - 4);
+    pos += snprintf(&out[pos], size - pos, "...");
+    return MIN(pos, size - 1);
+#undef SYSLOG_GET
+}
+#pragma GCC diagnostic pop
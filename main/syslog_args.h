@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYSLOG_ARG_MAXLEN               160     /* Room for a 128 byte %s and
+                                                   a few numbers */
+
+/**
+ * @brief Arguments of one message, kept raw until the syslog task formats it
+ */
+typedef struct
+{
+    const char *fmt;        /* A literal, it outlives the record */
+    uint8_t len;            /* Bytes used in data */
+    uint8_t truncated;      /* Arguments didn't fit in data */
+    uint8_t data[SYSLOG_ARG_MAXLEN];
+} syslog_args_t;
+
+_Static_assert(SYSLOG_ARG_MAXLEN <= UINT8_MAX, "Record length is 8 bits");
+
+/**
+ * @brief One message in the syslog ring
+ *
+ * syslog_decode.py reads this layout out of a memory dump, keep it in step.
+ */
+typedef struct
+{
+    atomic_uint seq;        /* Ring position, see syslog.c */
+    uint8_t facility;
+    uint8_t level;
+    uint32_t time_ms;       /* Since boot */
+    uint32_t sequence;      /* Dropped messages leave a gap */
+    syslog_args_t args;
+} syslog_record_t;
+
+/**
+ * @brief Copy what fmt asks for out of ap, %s strings included
+ *
+ * Arguments that don't fit are dropped and the record is marked truncated.
+ */
+void syslog_args_capture(syslog_args_t *args, const char *fmt, va_list ap);
+
+/**
+ * @brief Print the captured arguments with their format
+ *
+ * @return Length of out, a truncated record ends with "..."
+ */
+int syslog_args_format(const syslog_args_t *args, char *out, int size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -43,6 +43,8 @@ SemaphoreHandle_t gsemaRmtHitachiTig =
     NULL;  // Created in app_main.c, protect hitachi data
 SemaphoreHandle_t gsemaRmtZeroTig =
     NULL;  // Created in app_main.c, protect zero fan data
+SemaphoreHandle_t gsemaRmtDysonTig =
+    NULL;  // Created in app_main.c, protect dyson fan data
 SemaphoreHandle_t gsemaSYSTEMCfg =
     NULL;  // Created in app_main.c, protect system data
 
@@ -163,7 +165,7 @@ int dbg_printf(const char *fmt, ...)
 
   if (len > 0)
   {
-    printf(buf);
+    printf("%s", buf);
   }
 
   return len;
@@ -64,6 +64,7 @@ extern SemaphoreHandle_t gsemaLED;
 extern SemaphoreHandle_t gsemaRmtDeltaSche;
 extern SemaphoreHandle_t gsemaRmtHitachiTig;
 extern SemaphoreHandle_t gsemaRmtZeroTig;
+extern SemaphoreHandle_t gsemaRmtDysonTig;
 extern SemaphoreHandle_t gsemaSYSTEMCfg;
 
 int dbg_printf(const char *fmt, ...);
@@ -7,19 +7,50 @@
 #include <stdio.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "syslog.h"
 #include "system.h"
+#include "task_monitor.h"
 
 #define MONITOR_TAG "MONITOR"
 
+// Kept for the metrics page so a scrape doesn't walk the task list
+static task_monitor_info_t gtask_monitor_info[TASK_MONITOR_MAX_TASKS];
+static int gtask_monitor_count = 0;
+static SemaphoreHandle_t gsemaTaskMonitor = NULL;
+
+int task_monitor_get_info(int index, task_monitor_info_t *info)
+{
+    int ret = SYSTEM_ERROR_INVALID_PARAMETER;
+
+    if (gsemaTaskMonitor == NULL) {
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (info == NULL) {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    xSemaphoreTake(gsemaTaskMonitor, portMAX_DELAY);
+    if ((index >= 0) && (index < gtask_monitor_count)) {
+        *info = gtask_monitor_info[index];
+        ret = SYSTEM_ERROR_NONE;
+    }
+    xSemaphoreGive(gsemaTaskMonitor);
+    return ret;
+}
+
 void task_monitor(void *pvParameters)
 {
     TaskStatus_t *pxTaskStatusArray;
     volatile UBaseType_t uxArraySize, x;
     uint32_t ulTotalRunTime;
 
+    gsemaTaskMonitor = xSemaphoreCreateBinary();
+    if (gsemaTaskMonitor != NULL) {
+        xSemaphoreGive(gsemaTaskMonitor);
+    }
+
     // Wait for system stabilization
     vTaskDelay(pdMS_TO_TICKS(10000));
 
@@ -62,6 +93,18 @@ void task_monitor(void *pvParameters)
                                (unsigned int)free_stack);
             }
             syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_INFO, "---------------------------");
+
+            if (gsemaTaskMonitor != NULL) {
+                xSemaphoreTake(gsemaTaskMonitor, portMAX_DELAY);
+                gtask_monitor_count = 0;
+                for (x = 0; (x < uxArraySize) && (gtask_monitor_count < TASK_MONITOR_MAX_TASKS); x++) {
+                    task_monitor_info_t *info = &gtask_monitor_info[gtask_monitor_count++];
+
+                    snprintf(info->name, sizeof(info->name), "%s", pxTaskStatusArray[x].pcTaskName);
+                    info->stack_free = pxTaskStatusArray[x].usStackHighWaterMark;
+                }
+                xSemaphoreGive(gsemaTaskMonitor);
+            }
             
             // Free the array.
             vPortFree(pxTaskStatusArray);
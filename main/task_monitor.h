@@ -1,3 +1,16 @@
 #pragma once
 
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+#define TASK_MONITOR_MAX_TASKS 24
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t stack_free;    // Bytes, lowest since the task started
+} task_monitor_info_t;
+
 void task_monitor(void *pvParameters);
+
+// Tasks of the last check, it returns SYSTEM_ERROR_INVALID_PARAMETER past the last one
+int task_monitor_get_info(int index, task_monitor_info_t *info);
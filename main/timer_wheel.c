@@ -0,0 +1,405 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "timer_wheel.h"
+#include "system.h"
+#include "syslog.h"
+
+#define TIMER_WHEEL_MASK    (TIMER_WHEEL_SLOTS - 1)
+
+_Static_assert(TIMER_WHEEL_MAX_TIMERS <= INT8_MAX,
+               "Timer ids must fit in int8_t");
+
+typedef struct
+{
+    timer_wheel_cb_t callback;
+    void *arg;
+    const char *name;
+    uint32_t expires;   /* Absolute tick */
+    int8_t level;
+    int8_t slot;        /* TIMER_WHEEL_INVALID if not armed */
+    int8_t prev;
+    int8_t next;
+    uint32_t starts;
+    uint32_t stops;
+    uint32_t fires;
+    uint32_t callback_max_us;
+} timer_wheel_entry_t;
+
+/*
+ * Level n slot i holds the timers whose expiry tick has i in bits
+ * [6n, 6n+6). A level is cascaded into the ones below when the level under
+ * it wraps, so every timer reaches level 0 in the tick it expires.
+ */
+static timer_wheel_entry_t gtimer_wheel_entry[TIMER_WHEEL_MAX_TIMERS];
+static int8_t gtimer_wheel_slot[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+static int gtimer_wheel_num = 0;        /* Registered */
+static uint32_t gtimer_wheel_now = 0;   /* Ticks dispatched */
+static timer_wheel_stats_t gtimer_wheel_stats;
+static esp_timer_handle_t gtimer_wheel_handle = NULL;
+static TaskHandle_t gtimer_wheel_task = NULL;
+static SemaphoreHandle_t gsemaTimerWheel = NULL;
+
+static void timer_wheel_tick(void *arg);
+static void task_timer_wheel(void *pvParameters);
+
+/* Call with gsemaTimerWheel taken */
+static void timer_wheel_link(int id)
+{
+    timer_wheel_entry_t *entry = &gtimer_wheel_entry[id];
+    uint32_t delta = entry->expires - gtimer_wheel_now;
+    int level = 0;
+
+    while ((level < TIMER_WHEEL_LEVELS - 1) &&
+           (delta >= (1UL << ((level + 1) * TIMER_WHEEL_LEVEL_BITS))))
+    {
+        level++;
+    }
+    entry->level = level;
+    entry->slot = (entry->expires >> (level * TIMER_WHEEL_LEVEL_BITS)) &
+                  TIMER_WHEEL_MASK;
+    entry->prev = TIMER_WHEEL_INVALID;
+    entry->next = gtimer_wheel_slot[level][entry->slot];
+    if (entry->next != TIMER_WHEEL_INVALID)
+    {
+        gtimer_wheel_entry[entry->next].prev = id;
+    }
+    gtimer_wheel_slot[level][entry->slot] = id;
+}
+
+/* Call with gsemaTimerWheel taken */
+static void timer_wheel_unlink(int id)
+{
+    timer_wheel_entry_t *entry = &gtimer_wheel_entry[id];
+
+    if (entry->prev != TIMER_WHEEL_INVALID)
+    {
+        gtimer_wheel_entry[entry->prev].next = entry->next;
+    }
+    else
+    {
+        gtimer_wheel_slot[entry->level][entry->slot] = entry->next;
+    }
+    if (entry->next != TIMER_WHEEL_INVALID)
+    {
+        gtimer_wheel_entry[entry->next].prev = entry->prev;
+    }
+    entry->slot = TIMER_WHEEL_INVALID;
+    if (--gtimer_wheel_stats.armed == 0)
+    {
+        /* Nothing left to expire, let the CPU sleep */
+        esp_timer_stop(gtimer_wheel_handle);
+    }
+}
+
+/* Call with gsemaTimerWheel taken */
+static void timer_wheel_cascade(int level)
+{
+    int slot = (gtimer_wheel_now >> (level * TIMER_WHEEL_LEVEL_BITS)) &
+               TIMER_WHEEL_MASK;
+    int id = gtimer_wheel_slot[level][slot];
+    int next = 0;
+
+    /* Detach the whole slot first, a timer may land in it again */
+    gtimer_wheel_slot[level][slot] = TIMER_WHEEL_INVALID;
+    for (; id != TIMER_WHEEL_INVALID; id = next)
+    {
+        next = gtimer_wheel_entry[id].next;
+        timer_wheel_link(id);
+        gtimer_wheel_stats.cascades++;
+    }
+}
+
+void timer_wheel_init(void)
+{
+    esp_timer_create_args_t tick_timer_args = {
+        .callback = &timer_wheel_tick,
+        .name = "timer_wheel"
+    };
+
+    if (gsemaTimerWheel != NULL)
+    {
+        return;
+    }
+    memset(gtimer_wheel_slot, TIMER_WHEEL_INVALID, sizeof(gtimer_wheel_slot));
+    memset(&gtimer_wheel_stats, 0, sizeof(gtimer_wheel_stats));
+    ESP_ERROR_CHECK(esp_timer_create(&tick_timer_args, &gtimer_wheel_handle));
+    gsemaTimerWheel = xSemaphoreCreateBinary();
+    if (gsemaTimerWheel != NULL)
+    {
+        xSemaphoreGive(gsemaTimerWheel);
+    }
+    xTaskCreate(task_timer_wheel, TIMER_WHEEL_TASK_NAME,
+                TIMER_WHEEL_TASK_STACKSIZE, NULL, TIMER_WHEEL_TASK_PRIORITY,
+                &gtimer_wheel_task);
+}
+
+int timer_wheel_add(timer_wheel_cb_t callback, void *arg, const char *name,
+                    int *id)
+{
+    int ret = SYSTEM_ERROR_NONE;
+
+    if (gsemaTimerWheel == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (timer wheel %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if ((callback == NULL) || (id == NULL))
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if (xSemaphoreTake(gsemaTimerWheel, portMAX_DELAY) == pdTRUE)
+    {
+        if (gtimer_wheel_num < TIMER_WHEEL_MAX_TIMERS)
+        {
+            *id = gtimer_wheel_num++;
+            memset(&gtimer_wheel_entry[*id], 0, sizeof(timer_wheel_entry_t));
+            gtimer_wheel_entry[*id].callback = callback;
+            gtimer_wheel_entry[*id].arg = arg;
+            gtimer_wheel_entry[*id].name = name;
+            gtimer_wheel_entry[*id].slot = TIMER_WHEEL_INVALID;
+            gtimer_wheel_stats.timers = gtimer_wheel_num;
+        }
+        else
+        {
+            syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_ERROR,
+                           "No timer left for %s", name);
+            ret = SYSTEM_ERROR_INVALID_PARAMETER;
+        }
+        xSemaphoreGive(gsemaTimerWheel);
+    }
+    return ret;
+}
+
+int timer_wheel_start(int id, uint32_t delay_ms)
+{
+    timer_wheel_entry_t *entry = NULL;
+    uint32_t ticks = delay_ms / TIMER_WHEEL_TICK_MS +
+                     ((delay_ms % TIMER_WHEEL_TICK_MS) ? 1 : 0);
+
+    if (gsemaTimerWheel == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (timer wheel %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if ((id < 0) || (id >= gtimer_wheel_num))
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    ticks = (ticks == 0) ? 1 : MIN(ticks, TIMER_WHEEL_MAX_TICKS);
+    if (xSemaphoreTake(gsemaTimerWheel, portMAX_DELAY) == pdTRUE)
+    {
+        entry = &gtimer_wheel_entry[id];
+        if (entry->slot != TIMER_WHEEL_INVALID)
+        {
+            timer_wheel_unlink(id);
+        }
+        entry->expires = gtimer_wheel_now + ticks;
+        entry->starts++;
+        timer_wheel_link(id);
+        if (gtimer_wheel_stats.armed++ == 0)
+        {
+            ESP_ERROR_CHECK(esp_timer_start_periodic(
+                gtimer_wheel_handle, TIMER_WHEEL_TICK_MS * 1000));
+        }
+        gtimer_wheel_stats.armed_max = MAX(gtimer_wheel_stats.armed_max,
+                                           gtimer_wheel_stats.armed);
+        xSemaphoreGive(gsemaTimerWheel);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+int timer_wheel_stop(int id)
+{
+    if (gsemaTimerWheel == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (timer wheel %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if ((id < 0) || (id >= gtimer_wheel_num))
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    if (xSemaphoreTake(gsemaTimerWheel, portMAX_DELAY) == pdTRUE)
+    {
+        if (gtimer_wheel_entry[id].slot != TIMER_WHEEL_INVALID)
+        {
+            timer_wheel_unlink(id);
+            gtimer_wheel_entry[id].stops++;
+        }
+        xSemaphoreGive(gsemaTimerWheel);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+bool timer_wheel_is_active(int id)
+{
+    return timer_wheel_remaining(id) > 0;
+}
+
+uint32_t timer_wheel_remaining(int id)
+{
+    uint32_t ticks = 0;
+
+    if ((gsemaTimerWheel == NULL) || (id < 0) || (id >= gtimer_wheel_num))
+    {
+        return 0;
+    }
+    if (xSemaphoreTake(gsemaTimerWheel, portMAX_DELAY) == pdTRUE)
+    {
+        if (gtimer_wheel_entry[id].slot != TIMER_WHEEL_INVALID)
+        {
+            /* At least 1, the dispatch task may be a tick behind */
+            ticks = MAX(gtimer_wheel_entry[id].expires - gtimer_wheel_now, 1);
+        }
+        xSemaphoreGive(gsemaTimerWheel);
+    }
+    return ticks * TIMER_WHEEL_TICK_MS;
+}
+
+int timer_wheel_get_stats(timer_wheel_stats_t *stats)
+{
+    if (gsemaTimerWheel == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (timer wheel %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (stats == NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if (xSemaphoreTake(gsemaTimerWheel, portMAX_DELAY) == pdTRUE)
+    {
+        memcpy(stats, &gtimer_wheel_stats, sizeof(timer_wheel_stats_t));
+        xSemaphoreGive(gsemaTimerWheel);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+int timer_wheel_get_info(int id, timer_wheel_info_t *info)
+{
+    timer_wheel_entry_t *entry = NULL;
+
+    if (gsemaTimerWheel == NULL)
+    {
+        syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_ERROR,
+                       "Semaphore not ready (timer wheel %d)", __LINE__);
+        return SYSTEM_ERROR_NOT_READY;
+    }
+    if (info == NULL)
+    {
+        return SYSTEM_ERROR_INVALID_POINTER;
+    }
+    if ((id < 0) || (id >= gtimer_wheel_num))
+    {
+        return SYSTEM_ERROR_INVALID_PARAMETER;
+    }
+    if (xSemaphoreTake(gsemaTimerWheel, portMAX_DELAY) == pdTRUE)
+    {
+        entry = &gtimer_wheel_entry[id];
+        info->name = entry->name;
+        info->starts = entry->starts;
+        info->stops = entry->stops;
+        info->fires = entry->fires;
+        info->callback_max_us = entry->callback_max_us;
+        info->active = (entry->slot != TIMER_WHEEL_INVALID);
+        info->level = info->active ? entry->level : 0;
+        info->remaining_ms =
+            info->active ? MAX(entry->expires - gtimer_wheel_now, 1) *
+                               TIMER_WHEEL_TICK_MS
+                         : 0;
+        xSemaphoreGive(gsemaTimerWheel);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+/* esp_timer task, hand the tick over so callbacks never hold it up */
+static void timer_wheel_tick(void *arg)
+{
+    xTaskNotifyGive(gtimer_wheel_task);
+}
+
+static void timer_wheel_dispatch(void)
+{
+    int8_t expired[TIMER_WHEEL_MAX_TIMERS];
+    int num = 0, id = 0, next = 0, level = 0;
+    int64_t start_us = esp_timer_get_time(), callback_us = 0;
+
+    if (xSemaphoreTake(gsemaTimerWheel, portMAX_DELAY) == pdTRUE)
+    {
+        gtimer_wheel_now++;
+        gtimer_wheel_stats.ticks++;
+        /* Find the highest level whose lower levels all wrapped */
+        while ((level < TIMER_WHEEL_LEVELS - 1) &&
+               (((gtimer_wheel_now >> (level * TIMER_WHEEL_LEVEL_BITS)) &
+                 TIMER_WHEEL_MASK) == 0))
+        {
+            level++;
+        }
+        for (; level > 0; level--)
+        {
+            timer_wheel_cascade(level);
+        }
+
+        for (id = gtimer_wheel_slot[0][gtimer_wheel_now & TIMER_WHEEL_MASK];
+             id != TIMER_WHEEL_INVALID; id = next)
+        {
+            next = gtimer_wheel_entry[id].next;
+            timer_wheel_unlink(id);
+            gtimer_wheel_entry[id].fires++;
+            expired[num++] = id;
+        }
+        gtimer_wheel_stats.fires += num;
+        xSemaphoreGive(gsemaTimerWheel);
+    }
+
+    /* Callbacks may arm timers again, so they run unlocked */
+    for (int i = 0; i < num; i++)
+    {
+        syslog_handler(SYSLOG_FACILITY_SYSTEM, SYSLOG_LEVEL_DEBUG,
+                       "Timer %s expired", gtimer_wheel_entry[expired[i]].name);
+        callback_us = esp_timer_get_time();
+        gtimer_wheel_entry[expired[i]].callback(
+            gtimer_wheel_entry[expired[i]].arg);
+        callback_us = esp_timer_get_time() - callback_us;
+        if (callback_us > gtimer_wheel_entry[expired[i]].callback_max_us)
+        {
+            gtimer_wheel_entry[expired[i]].callback_max_us = callback_us;
+        }
+    }
+
+    start_us = esp_timer_get_time() - start_us;
+    if (start_us > gtimer_wheel_stats.dispatch_max_us)
+    {
+        gtimer_wheel_stats.dispatch_max_us = start_us;
+    }
+}
+
+static void task_timer_wheel(void *pvParameters)
+{
+    uint32_t pending = 0;
+
+    while (1)
+    {
+        /* One tick per notification, a slow callback only delays the rest */
+        pending = ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+        if (pending > 1)
+        {
+            gtimer_wheel_stats.late_ticks++;
+        }
+        timer_wheel_dispatch();
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TIMER_WHEEL_TICK_MS         1000
+#define TIMER_WHEEL_LEVELS          3
+#define TIMER_WHEEL_LEVEL_BITS      6
+#define TIMER_WHEEL_SLOTS           (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_MAX_TICKS       ((1UL << (TIMER_WHEEL_LEVELS * \
+                                      TIMER_WHEEL_LEVEL_BITS)) - 1)  /* ~72h */
+#define TIMER_WHEEL_MAX_TIMERS      16
+#define TIMER_WHEEL_INVALID         (-1)
+#define TIMER_WHEEL_TASK_NAME       "TimerWheel"
+#define TIMER_WHEEL_TASK_STACKSIZE  4096
+#define TIMER_WHEEL_TASK_PRIORITY   6
+
+typedef void (*timer_wheel_cb_t)(void *arg);
+
+/**
+ * @brief Counters of the whole wheel
+ */
+typedef struct
+{
+    uint32_t ticks;             /* Ticks dispatched */
+    uint32_t cascades;          /* Timers moved down a level */
+    uint32_t fires;
+    uint32_t late_ticks;        /* Ticks queued behind a slow dispatch */
+    uint32_t dispatch_max_us;   /* Longest tick, callbacks included */
+    uint16_t timers;            /* Registered */
+    uint16_t armed;
+    uint16_t armed_max;
+} timer_wheel_stats_t;
+
+/**
+ * @brief Counters of one timer
+ */
+typedef struct
+{
+    const char *name;
+    uint32_t starts;
+    uint32_t stops;             /* Stopped while armed */
+    uint32_t fires;
+    uint32_t callback_max_us;
+    uint32_t remaining_ms;      /* 0 if not armed */
+    uint8_t level;              /* Wheel level while armed */
+    bool active;
+} timer_wheel_info_t;
+
+/**
+ * @brief Create the tick timer and the dispatch task, call it before any
+ *        timer_wheel_add()
+ *
+ * One esp_timer wakes the dispatch task every tick while a timer is armed.
+ * The task cascades the upper levels and runs the expired callbacks.
+ */
+void timer_wheel_init(void);
+
+/**
+ * @brief Register a one shot timer, it isn't armed yet
+ *
+ * @param[in] callback Runs in the dispatch task, it may block for a while and
+ *                     may arm timers again
+ * @param[out] id Handle for the other calls
+ */
+int timer_wheel_add(timer_wheel_cb_t callback, void *arg, const char *name,
+                    int *id);
+
+/**
+ * @brief Arm the timer, or re-arm it if it's armed already
+ *
+ * @param[in] delay_ms Fires within one TIMER_WHEEL_TICK_MS of it, capped to
+ *                     TIMER_WHEEL_MAX_TICKS
+ */
+int timer_wheel_start(int id, uint32_t delay_ms);
+int timer_wheel_stop(int id);
+bool timer_wheel_is_active(int id);
+
+/**
+ * @return Milliseconds until the timer fires, 0 if it isn't armed
+ */
+uint32_t timer_wheel_remaining(int id);
+
+int timer_wheel_get_stats(timer_wheel_stats_t *stats);
+
+/**
+ * @param[in] id 0 to the number of registered timers - 1
+ */
+int timer_wheel_get_info(int id, timer_wheel_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,22 +8,36 @@
 #include "dht22.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
+#include "history.h"
+#include "http_form.h"
+#include "http_job.h"
 #include "homekit.h"
+#include "ir_learn.h"
+#include "ir_protocol.h"
+#include "ir_stats.h"
+#include "json_scan.h"
 #include "ld2410.h"
+#include "logring.h"
 #include "airquality.h"
+#include "cbor.h"
 #include "nu_ld2410.h"
 #include "oled.h"
 #include "ota.h"
 #include "rmt.h"
 #include "sdkconfig.h"
+#include "settings.h"
 #include "syslog.h"
 #include "system.h"
+#include "task_monitor.h"
 #include "thingspeak.h"
+#include "timer_wheel.h"
 #include <ctype.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/param.h>
+#include <unistd.h>
 
-static int handle_json_get_int(char *src, int *dst, char *obj);
 static int handle_json_get_str(char *src, char *dst, int len, char *obj);
 static esp_err_t http_api_autolearn_clear(httpd_req_t *req);
 static esp_err_t http_api_autolearn_nobody(httpd_req_t *req);
@@ -35,242 +49,380 @@ static esp_err_t http_api_dbgnobody(httpd_req_t *req);
 static esp_err_t http_api_dbgoff(httpd_req_t *req);
 static esp_err_t http_api_dbgsomebody(httpd_req_t *req);
 static esp_err_t http_api_erasedata(httpd_req_t *req);
+static esp_err_t http_api_irlearn_status(httpd_req_t *req);
+static esp_err_t http_api_irstats(httpd_req_t *req);
+static void http_printf_hist(httpd_req_t *req, const char *key,
+                             const uint16_t *hist, int num);
 static esp_err_t http_api_loading(httpd_req_t *req);
+static esp_err_t http_api_diagnostics(httpd_req_t *req);
+static esp_err_t http_api_history(httpd_req_t *req, const char *param);
+static esp_err_t http_api_job(httpd_req_t *req, const char *param,
+                              bool result);
+static int http_job_start(httpd_req_t *req, const char *name,
+                          http_job_fn_t fn);
+static int http_job_autolearn_save(void *arg, char **result, int *len);
+static int http_job_erasedata(void *arg, char **result, int *len);
+static int http_job_nu_export(void *arg, char **result, int *len);
 static esp_err_t http_api_reboot(httpd_req_t *req);
 static esp_err_t http_api_env_updt(httpd_req_t *req);
+static esp_err_t http_api_env_cbor(httpd_req_t *req);
+static bool http_accepts_cbor(httpd_req_t *req);
+static bool http_url_decode(char *dst, size_t size, const char *src);
+static esp_err_t fetch_vue_action(httpd_req_t *req, const char *param);
 static esp_err_t http_api_reset_baseline(httpd_req_t *req);
+/* Handler for GET requests to /syslog - Messages kept in the flash log */
+static esp_err_t http_syslog_download(httpd_req_t *req)
+{
+    static char text[LOGRING_TEXT_MAXLEN + 1];
+    char buffer[1024];
+    logring_record_t record;
+    logring_iter_t iter;
+    int len = 0;
+
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Content-Disposition",
+                       "attachment; filename=\"roomassist.log\"");
+
+    /* Include what is still buffered in RAM */
+    logring_flush();
+    logring_iter_init(&iter);
+    while (logring_iter_next(&iter, &record, text))
+    {
+        if (len + 32 + SYSLOG_MAXLEN_FACILITY_STR + SYSLOG_MAXLEN_LEVEL_STR +
+                record.len + 1 >
+            sizeof(buffer))
+        {
+            if (httpd_resp_send_chunk(req, buffer, len) != ESP_OK)
+            {
+                httpd_resp_sendstr_chunk(req, NULL);
+                return ESP_FAIL;
+            }
+            len = 0;
+        }
+        len += snprintf(buffer + len, sizeof(buffer) - len,
+                        "%u %lu %lu.%03lu %s %s %s\n", record.boot,
+                        (unsigned long)record.sequence,
+                        (unsigned long)(record.time_ms / 1000),
+                        (unsigned long)(record.time_ms % 1000),
+                        (record.level < SYSLOG_LEVEL_MAXNUM)
+                            ? gsyslog_level_str[record.level]
+                            : "-",
+                        (record.facility < SYSLOG_FACILITY_MAXNUM)
+                            ? gsyslog_facility_str[record.facility]
+                            : "-",
+                        text);
+    }
+    if (len > 0)
+    {
+        httpd_resp_send_chunk(req, buffer, len);
+    }
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+
 static int http_printf_end(httpd_req_t *req);
 static int http_printf(httpd_req_t *req, const char *fmt, ...);
+static void http_resp_begin(httpd_req_t *req);
+static int http_resp_flush(httpd_req_t *req);
+static int http_write(httpd_req_t *req, const char *data, int len);
+static int http_json_string(httpd_req_t *req, const char *str);
 static esp_err_t handle_nu_upload(httpd_req_t *req);
+static esp_err_t http_syslog_download(httpd_req_t *req);
+static esp_err_t http_events(httpd_req_t *req);
+static esp_err_t http_api(httpd_req_t *req);
+static esp_err_t http_metrics(httpd_req_t *req);
+
+/* Updated by http_timed, only the server task touches them */
+static uint32_t ghttp_requests = 0;
+static uint32_t ghttp_slow = 0;
+static uint32_t ghttp_slowest_ms = 0;
+
 // HTTP GET handler for fetching data
 esp_err_t fetch_vue(httpd_req_t *req)
 {
-    char param[32];
+    /* Sized by the query, the learned IR name comes URL-encoded */
+    size_t len = httpd_req_get_url_query_len(req);
+    char *param = NULL;
+    esp_err_t ret = ESP_FAIL;
+
+    http_resp_begin(req);
+    httpd_resp_set_type(req, "application/json");
+    if (len == 0)
+    {
+        httpd_resp_send_404(req);
+        return ESP_FAIL;
+    }
+    param = malloc(len + 1);
+    if (param == NULL)
+    {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    // Get URL
+    if (httpd_req_get_url_query_str(req, param, len + 1) == ESP_OK)
+    {
+        ret = fetch_vue_action(req, param);
+    }
+    else
+    {
+        httpd_resp_send_404(req);
+    }
+    free(param);
+    return ret;
+}
+
+/* Runs the action of a /fetchvue query */
+static esp_err_t fetch_vue_action(httpd_req_t *req, const char *param)
+{
     esp_err_t ret;
     int ota_msg = 0;
     uint8_t ota_status = OTA_DONE;
     int ota_progress = 0, ota_content_length = 0, ota_total_read_len = 0;
+    char action[16];
+    int iaction = 0;
 
-    httpd_resp_set_type(req, "application/json");
-    // Get URL
-    if (httpd_req_get_url_query_str(req, param, sizeof(param)) == ESP_OK)
+    // Get specific parameter
+    if (httpd_query_key_value(param, "action", action, sizeof(action)) ==
+        ESP_OK)
     {
-        char action[16];
-        int iaction = 0;
-        // Get specific parameter
-        if (httpd_query_key_value(param, "action", action, sizeof(action)) ==
-            ESP_OK)
+        // Action by parameter
+        iaction = atoi(action);
+        if (iaction == HTTP_ENV_UPDT)
         {
-            // Action by parameter
-            iaction = atoi(action);
-            syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_DEBUG,
-                           "http fetch vue %d", iaction);
-            http_printf(req, "{\"action-type\": %d,", iaction);
-            switch (iaction)
+            /* JSON or CBOR by Accept, caches must keep both apart */
+            httpd_resp_set_hdr(req, "Vary", "Accept");
+            if (http_accepts_cbor(req))
             {
-                case HTTP_LOADING_ID:
-                    http_api_loading(req);
-                    http_printf(req, "\"action-status\": %d}", HTTP_LOADING_ID);
-                    break;
-                case HTTP_AUTO_RESET_ID:
-                    http_api_autolearn_clear(req);
-                    http_printf(req, "\"action-status\": %d}",
-                                HTTP_ACTION_STATUS_SUCCESS);
-                    break;
-                case HTTP_AUTO_DISPLAY_LOOP_ID:
-                    http_printf(req, "\"action-status\": %d}",
-                                HTTP_ACTION_STATUS_SUCCESS);
-                    break;
-                case HTTP_AUTO_SAVE_ID:
-                    http_api_autolearn_save(req);
-                    http_printf(req, "\"action-status\": %d}",
-                                HTTP_ACTION_STATUS_SUCCESS);
-                    break;
-                case HTTP_AUTO_LSTNS_ID:
-                    if (http_api_autolearn_stillness(req) == ESP_OK)
-                    {
-                        http_printf(req, "\"action-status\": %d}",
-                                    HTTP_ACTION_STATUS_SUCCESS);
-                    }
-                    else
-                    {
-                        http_printf(req, "\"action-status\": %d}",
-                                    HTTP_ACTION_STATUS_FAIL);
-                    }
-                    break;
-                case HTTP_AUTO_LSB_ID:
-                    if (http_api_autolearn_somebody(req) == ESP_OK)
-                    {
-                        http_printf(req, "\"action-status\": %d}",
-                                    HTTP_ACTION_STATUS_SUCCESS);
-                    }
-                    else
-                    {
-                        http_printf(req, "\"action-status\": %d}",
-                                    HTTP_ACTION_STATUS_FAIL);
-                    }
-                    break;
-                case HTTP_AUTO_LNB_ID:
-                    if (http_api_autolearn_nobody(req) == ESP_OK)
-                    {
-                        http_printf(req, "\"action-status\": %d}",
-                                    HTTP_ACTION_STATUS_SUCCESS);
-                    }
-                    else
-                    {
-                        http_printf(req, "\"action-status\": %d}",
-                                    HTTP_ACTION_STATUS_FAIL);
-                    }
-                    break;
-                case HTTP_AUTO_LSTOP_ID:
-                    http_api_autolearn_stop(req);
-                    http_printf(req, "\"action-status\": %d}",
-                                HTTP_ACTION_STATUS_SUCCESS);
-                    break;
-                case HTTP_DEBUG_SOMEBODY_ID:
-                    http_api_dbgsomebody(req);
-                    http_printf(req, "\"action-status\": %d}",
-                                HTTP_ACTION_STATUS_SUCCESS);
-                    break;
-                case HTTP_DEBUG_NOBODY_ID:
-                    http_api_dbgnobody(req);
-                    http_printf(req, "\"action-status\": %d}",
-                                HTTP_ACTION_STATUS_SUCCESS);
-                    break;
-                case HTTP_DEBUG_OFF_ID:
-                    http_api_dbgoff(req);
-                    http_printf(req, "\"action-status\": %d}",
-                                HTTP_ACTION_STATUS_SUCCESS);
-                    break;
-                case HTTP_OTA_ID:
-                    nvs_handle_t nvs_handle;
-                    ota_getstatus(&ota_status);
-                    if (ota_status != OTA_IN_PROGRESS)
-                    {
-                        ret = nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE,
-                                       &nvs_handle);
-                        if (ret == ESP_OK)
-                        {
-                            nvs_set_u8(nvs_handle, OTA_NVS_STATUS_KEY,
-                                       ota_status);
-                            nvs_close(nvs_handle);
-                        }
-                        system_task_creating(TASK_OTA_ID);
-                        xTaskCreate(&task_ota, "task_ota", 8192, NULL, 5, NULL);
-                        /* fall through */
-                    }
-                case HTTP_OTA_PROGRESS_ID:
-                    ota_getstatus(&ota_status);
-                    ota_getprogress(&ota_progress);
-                    ota_getcontent_len(&ota_content_length);
-                    ota_gettotal_readlen(&ota_total_read_len);
-                    http_printf(req, "\"ota-total-get\": %d,",
-                                ota_total_read_len);
-                    http_printf(req, "\"ota-content-length\": %d,",
-                                ota_content_length);
-                    http_printf(req, "\"ota-percent\": %d,", ota_progress);
-                    http_printf(req, "\"sysFirmwareupgradestatus\": %d,",
-                                ota_status); /* Firmware Upgrade Status */
-                    if (ota_progress == 100)
-                    {
-                        ota_msg = 1;
-                        xQueueSend(gqueue_ota, &ota_msg, portMAX_DELAY);
-                    }
+                return http_api_env_cbor(req);
+            }
+        }
+        syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_DEBUG,
+                       "http fetch vue %d", iaction);
+        http_printf(req, "{\"action-type\": %d,", iaction);
+        switch (iaction)
+        {
+            case HTTP_LOADING_ID:
+                http_api_loading(req);
+                http_printf(req, "\"action-status\": %d}", HTTP_LOADING_ID);
+                break;
+            case HTTP_AUTO_RESET_ID:
+                http_api_autolearn_clear(req);
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_AUTO_DISPLAY_LOOP_ID:
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_AUTO_SAVE_ID:
+                /* Writing the weights to flash waits for the learner */
+                http_printf(req, "\"action-status\": %d}",
+                            http_job_start(req, "save",
+                                           http_job_autolearn_save));
+                break;
+            case HTTP_AUTO_LSTNS_ID:
+                if (http_api_autolearn_stillness(req) == ESP_OK)
+                {
                     http_printf(req, "\"action-status\": %d}",
                                 HTTP_ACTION_STATUS_SUCCESS);
-                    break;
-                case HTTP_OTA_ABORT_ID:
-                    ota_abort();
-                    ota_getstatus(&ota_status);
-                    http_printf(req, "\"sysFirmwareupgradestatus\": %d,",
-                                ota_status);
+                }
+                else
+                {
                     http_printf(req, "\"action-status\": %d}",
-                                HTTP_ACTION_STATUS_SUCCESS);
-                    break;
-                case HTTP_REBOOT_ID:
+                                HTTP_ACTION_STATUS_FAIL);
+                }
+                break;
+            case HTTP_AUTO_LSB_ID:
+                if (http_api_autolearn_somebody(req) == ESP_OK)
+                {
                     http_printf(req, "\"action-status\": %d}",
                                 HTTP_ACTION_STATUS_SUCCESS);
-                    http_api_reboot(req);
-                    break;
-                case HTTP_ERASEDATA_ID:
+                }
+                else
+                {
                     http_printf(req, "\"action-status\": %d}",
-                                HTTP_ACTION_STATUS_SUCCESS);
-                    http_api_erasedata(req);
-                    break;
-                case HTTP_ENV_UPDT:
-                    http_api_env_updt(req);
+                                HTTP_ACTION_STATUS_FAIL);
+                }
+                break;
+            case HTTP_AUTO_LNB_ID:
+                if (http_api_autolearn_nobody(req) == ESP_OK)
+                {
                     http_printf(req, "\"action-status\": %d}",
                                 HTTP_ACTION_STATUS_SUCCESS);
-                    break;
-                case HTTP_RESET_BASELINE_ID:
-                    http_api_reset_baseline(req);
+                }
+                else
+                {
                     http_printf(req, "\"action-status\": %d}",
-                                HTTP_ACTION_STATUS_SUCCESS);
-                    break;
-                case HTTP_NU_DOWNLOAD_ID:
+                                HTTP_ACTION_STATUS_FAIL);
+                }
+                break;
+            case HTTP_AUTO_LSTOP_ID:
+                http_api_autolearn_stop(req);
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_DEBUG_SOMEBODY_ID:
+                http_api_dbgsomebody(req);
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_DEBUG_NOBODY_ID:
+                http_api_dbgnobody(req);
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_DEBUG_OFF_ID:
+                http_api_dbgoff(req);
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_OTA_ID:
+                nvs_handle_t nvs_handle;
+                ota_getstatus(&ota_status);
+                if (ota_status != OTA_IN_PROGRESS)
                 {
-                    /* Allocate buffers for Base64 encoded weights */
-                    char *w_ih_b64 = malloc(4096);
-                    char *w_ho_b64 = malloc(256);
-                    char *b_h_b64 = malloc(256);
-                    char *b_o_b64 = malloc(64);
-                    /* Large buffer for full JSON content (no newlines) */
-                    char *json_buf = malloc(8192);
-
-                    if (w_ih_b64 && w_ho_b64 && b_h_b64 && b_o_b64 && json_buf)
+                    ret = nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE,
+                                   &nvs_handle);
+                    if (ret == ESP_OK)
                     {
-                        if (nu_ld2410_get_weights_base64(w_ih_b64, w_ho_b64,
-                                                         b_h_b64, b_o_b64))
-                        {
-                            /* Build JSON content without newlines */
-                            int json_len =
-                                snprintf(json_buf, 8192,
-                                         "\"model\": \"" NU_MODEL_STR
-                                         "\","
-                                         "\"version\": 1,"
-                                         "\"input_size\": %d,"
-                                         "\"hidden_size\": %d,"
-                                         "\"output_size\": %d,"
-                                         "\"w_ih\": \"%s\","
-                                         "\"w_ho\": \"%s\","
-                                         "\"b_h\": \"%s\","
-                                         "\"b_o\": \"%s\","
-                                         "\"action-status\": %d}",
-                                         INPUT_SIZE, HIDDEN_SIZE, OUTPUT_SIZE,
-                                         w_ih_b64, w_ho_b64, b_h_b64, b_o_b64,
-                                         HTTP_ACTION_STATUS_SUCCESS);
-                            /* Send as single chunk (no newline added) */
-                            httpd_resp_send_chunk(req, json_buf, json_len);
-                        }
-                        else
-                        {
-                            http_printf(req, "\"action-status\": %d}",
-                                        HTTP_ACTION_STATUS_FAIL);
-                        }
+                        nvs_set_u8(nvs_handle, OTA_NVS_STATUS_KEY,
+                                   ota_status);
+                        nvs_close(nvs_handle);
                     }
-                    else
+                    system_task_creating(TASK_OTA_ID);
+                    xTaskCreate(&task_ota, "task_ota", 8192, NULL, 5, NULL);
+                    /* fall through */
+                }
+            case HTTP_OTA_PROGRESS_ID:
+                ota_getstatus(&ota_status);
+                ota_getprogress(&ota_progress);
+                ota_getcontent_len(&ota_content_length);
+                ota_gettotal_readlen(&ota_total_read_len);
+                http_printf(req, "\"ota-total-get\": %d,",
+                            ota_total_read_len);
+                http_printf(req, "\"ota-content-length\": %d,",
+                            ota_content_length);
+                http_printf(req, "\"ota-percent\": %d,", ota_progress);
+                http_printf(req, "\"sysFirmwareupgradestatus\": %d,",
+                            ota_status); /* Firmware Upgrade Status */
+                if (ota_progress == 100)
+                {
+                    ota_msg = 1;
+                    xQueueSend(gqueue_ota, &ota_msg, portMAX_DELAY);
+                }
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_OTA_ABORT_ID:
+                ota_abort();
+                ota_getstatus(&ota_status);
+                http_printf(req, "\"sysFirmwareupgradestatus\": %d,",
+                            ota_status);
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_REBOOT_ID:
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                http_resp_flush(req);
+                http_api_reboot(req);
+                break;
+            case HTTP_ERASEDATA_ID:
+                http_printf(req, "\"action-status\": %d}",
+                            http_job_start(req, "erase",
+                                           http_job_erasedata));
+                break;
+            case HTTP_ENV_UPDT:
+                http_api_env_updt(req);
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_RESET_BASELINE_ID:
+                http_api_reset_baseline(req);
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_NU_DOWNLOAD_ID:
+                http_printf(req, "\"action-status\": %d}",
+                            http_job_start(req, "export",
+                                           http_job_nu_export));
+                break;
+            case HTTP_IR_LEARN_ID:
+            {
+                /* Every byte of the name may come as %xx */
+                char encoded[IR_LEARN_NAME_LEN * 3];
+                char name[IR_LEARN_NAME_LEN];
+                int status = HTTP_ACTION_STATUS_FAIL;
+
+                if ((httpd_query_key_value(param, "name", encoded,
+                                           sizeof(encoded)) == ESP_OK) &&
+                    http_url_decode(name, sizeof(name), encoded) &&
+                    (ir_learn_start(name) == SYSTEM_ERROR_NONE))
+                {
+                    status = HTTP_ACTION_STATUS_SUCCESS;
+                }
+                http_printf(req, "\"action-status\": %d}", status);
+                break;
+            }
+            case HTTP_IR_LEARN_STATUS_ID:
+                http_api_irlearn_status(req);
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_IR_LEARN_SEND_ID:
+            case HTTP_IR_LEARN_DELETE_ID:
+            {
+                char index[8];
+                int status = HTTP_ACTION_STATUS_FAIL, err = 0;
+
+                if (httpd_query_key_value(param, "index", index,
+                                          sizeof(index)) == ESP_OK)
+                {
+                    err = (iaction == HTTP_IR_LEARN_SEND_ID)
+                              ? ir_learncmd_tigger(atoi(index))
+                              : ir_learn_delete(atoi(index));
+                    if (err == SYSTEM_ERROR_NONE)
                     {
-                        http_printf(req, "\"action-status\": %d}",
-                                    HTTP_ACTION_STATUS_FAIL);
+                        status = HTTP_ACTION_STATUS_SUCCESS;
                     }
-
-                    if (w_ih_b64) free(w_ih_b64);
-                    if (w_ho_b64) free(w_ho_b64);
-                    if (b_h_b64) free(b_h_b64);
-                    if (b_o_b64) free(b_o_b64);
-                    if (json_buf) free(json_buf);
-                    break;
                 }
-                default:
-                    httpd_resp_send_404(req);
-                    return ESP_FAIL;
-                    break;
+                http_printf(req, "\"action-status\": %d}", status);
+                break;
             }
-        }
-        else
-        {
-            httpd_resp_send_404(req);
-            return ESP_FAIL;
+            case HTTP_IR_LEARN_STOP_ID:
+                ir_learn_stop();
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_IR_STATS_ID:
+                http_api_irstats(req);
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_DIAG_ID:
+                http_api_diagnostics(req);
+                http_printf(req, "\"action-status\": %d}",
+                            HTTP_ACTION_STATUS_SUCCESS);
+                break;
+            case HTTP_HISTORY_ID:
+                http_printf(req, "\"action-status\": %d}",
+                            (http_api_history(req, param) == ESP_OK)
+                                ? HTTP_ACTION_STATUS_SUCCESS
+                                : HTTP_ACTION_STATUS_FAIL);
+                break;
+            case HTTP_JOB_ID:
+            case HTTP_JOB_RESULT_ID:
+                http_printf(req, "\"action-status\": %d}",
+                            (http_api_job(req, param,
+                                          iaction == HTTP_JOB_RESULT_ID) ==
+                             ESP_OK)
+                                ? HTTP_ACTION_STATUS_SUCCESS
+                                : HTTP_ACTION_STATUS_FAIL);
+                break;
+            default:
+                httpd_resp_send_404(req);
+                return ESP_FAIL;
+                break;
         }
     }
     else
@@ -282,64 +434,6 @@ esp_err_t fetch_vue(httpd_req_t *req)
     return ESP_OK;
 }
 
-static int handle_json_get_int(char *src, int *dst, char *obj)
-{
-    int i = 0, idstchar = 0;
-    char temp[64] = {};
-    char *strptr = NULL;
-    if (src)
-    {
-        strptr = strstr(src, obj);
-        if (strptr == NULL)
-        {
-            return false;
-        }
-        for (i = 0; i < 64; i++)
-        {
-            if (*(strptr + strlen(obj) + 2 + i) != '\"')
-            {
-                temp[idstchar] = *(strptr + strlen(obj) + 2 + i);
-                idstchar++;
-            }
-            else
-            {
-                break;
-            }
-        }
-    }
-    if (idstchar)
-    {
-        *dst = atoi(temp);
-        return true;
-    }
-    else
-    {
-        return false;
-    }
-}
-
-static int handle_json_get_bool(char *src, int *dst, char *obj)
-{
-    char *strptr = NULL;
-    if (src)
-    {
-        strptr = strstr(src, obj);
-        if (strptr == NULL)
-        {
-            return false;
-        }
-        if (*(strptr + strlen(obj) + 1) == 't')
-        {
-            *dst = 1;
-        }
-        else
-        {
-            *dst = 0;
-        }
-    }
-    return true;
-}
-
 static int handle_json_get_str(char *src, char *dst, int len, char *obj)
 {
     char *strptr = NULL;
@@ -369,304 +463,528 @@ static int handle_json_get_str(char *src, char *dst, int len, char *obj)
     return true;
 }
 
-// Handler for POST requests to /submitform
-esp_err_t handle_submitform(httpd_req_t *req)
+typedef struct
 {
-    char *content = NULL;
-    int ret, total_len = req->content_len, offset = 0;
-    int idel_val = -1;
-    char syslog_ip[16] = {};
-    char firmware_ip[16] = {};
-    char firmware_filename[33] = {};
-    char apikey[THINGSPEAK_API_KEYLENGTH + 1] = {};
-    int mq135high = 0;
-    int mq135low = 0;
-    int sgp41noxhigh = 0;
-    int sgp41noxlow = 0;
-    int temphigh = 0;
-    int templow = 0;
-    int humihigh = 0;
-    int humilow = 0;
-    int leddisplay = 0;
-    int ledsnooze = 0;
-    int facility = WEB_INPUT_INIT_VALUE;
-    char facility_list_text[(SYSLOG_FACILITY_MAXNUM) * 4] = {0};
-    int facility_ids[SYSLOG_FACILITY_MAXNUM] = {0};
-    int facility_count = 0;
-    int level = 0, leveltmp = 0;
-    char levelstr[10] = {};
-    int i = 0;
-    int orghightemp = 0, orglowtemp = 0, orghighhumi = 0, orglowhumi = 0;
-    int orgmq135thresholdhigh = 0, orgmq135thresholdlow = 0;
-    int orgsgp41noxhigh = 0, orgsgp41noxlow = 0;
-    char orgtpapikey[THINGSPEAK_API_KEYLENGTH + 1] = {0};
-    uint8_t sys_mac[6];
-    uint32_t delaytime = 0;
-    int oridisplaytime = 0, oriledsnoozetime = 0;
-    char ota_ip[OTA_MAXLEN_IP + 1], ota_filename[OTA_MAXLEN_FILENAME + 1],
-        syslog_server_ip[SYSLOG_MAXLEN_IP + 1];
-    uint32_t org_level = 0;
-
-    memset(ota_ip, 0, sizeof(ota_ip));
-    memset(ota_filename, 0, sizeof(ota_filename));
-    memset(syslog_server_ip, 0, sizeof(syslog_server_ip));
-
-    ota_getip(ota_ip, OTA_MAXLEN_IP);
-    ota_getfilename(ota_filename, OTA_MAXLEN_FILENAME);
-    syslog_get_server_ip(syslog_server_ip, SYSLOG_MAXLEN_IP);
-
-    ESP_ERROR_CHECK(esp_wifi_get_mac(WIFI_IF_STA, sys_mac));
-    // Allocate memory to hold the entire content
-    content = malloc(total_len + 1);
+    const json_field_t *fields;
+    int num;
+    void *base;
+    uint32_t *present;
+    bool strict;            /* Refuse unknown members and bad values */
+    const char *error;
+} http_json_body_t;
+
+static void http_json_member(void *arg, const char *key, int type,
+                             const char *value, int len)
+{
+    http_json_body_t *body = (http_json_body_t *)arg;
+    const json_field_t *field = NULL;
 
-    if (content == NULL)
+    if (body->error != NULL)
     {
-        return ESP_FAIL;  // Memory allocation failed
+        return;
     }
-    syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_DEBUG,
-                   "handle submitform: %s", content);
-    // Read the request body in chunks
-    while (offset < total_len)
+    field = json_field_find(body->fields, body->num, key);
+    if (field == NULL)
     {
-        int size_to_read = MIN(total_len - offset, total_len - offset);
-        ret = httpd_req_recv(req, content + offset, size_to_read);
+        body->error = body->strict ? "Unknown member" : NULL;
+        return;
+    }
+    if (!json_field_store(field, body->base, type, value, len))
+    {
+        body->error = body->strict ? "Invalid value" : NULL;
+        return;
+    }
+    *body->present |= 1UL << field->id;
+}
+
+/* Scan the body as it arrives into base, answers 400 if it's refused */
+static esp_err_t http_json_read(httpd_req_t *req, const json_field_t *fields,
+                                int num, void *base, uint32_t *present,
+                                bool strict)
+{
+    char chunk[HTTP_FORM_CHUNKSIZE];
+    http_json_body_t body = {.fields = fields, .num = num, .base = base,
+                             .present = present, .strict = strict};
+    json_scan_t scan;
+    int ret, offset = 0;
 
+    json_scan_init(&scan, http_json_member, &body);
+    while (offset < req->content_len)
+    {
+        ret = httpd_req_recv(req, chunk,
+                             MIN(req->content_len - offset, sizeof(chunk)));
         if (ret <= 0)
         {
             if (ret == HTTPD_SOCK_ERR_TIMEOUT)
             {
                 continue;  // Retry if timeout
             }
-            free(content);
             return ESP_FAIL;  // Read error
         }
         offset += ret;
-    }
-    // Null-terminate the received string
-    content[total_len] = '\0';
-#if !defined(LD2410_AUTOLEARN_NU)
-    handle_json_get_int(content, &door_val, "\"door\"");
-    handle_json_get_int(content, &act_val, "\"activeSensitivity\"");
-    handle_json_get_int(content, &sta_val, "\"staticSensitivity\"");
-#endif
-    handle_json_get_int(content, &idel_val, "\"idelTimes\"");
-    handle_json_get_str(content, syslog_ip, sizeof(syslog_ip) - 1,
-                        "\"syslogIp\"");
-    handle_json_get_str(content, firmware_ip, sizeof(firmware_ip) - 1,
-                        "\"firmwareIp\"");
-    handle_json_get_str(content, firmware_filename,
-                        sizeof(firmware_filename) - 1, "\"firmwareFilename\"");
-    handle_json_get_str(content, apikey, sizeof(apikey) - 1, "\"apikey\"");
-    if (IS_BATHROOM(sys_mac) || IS_SAMPLE(sys_mac))
-    {
-        handle_json_get_int(content, &mq135high, "\"mq135high\"");
-        handle_json_get_int(content, &mq135low, "\"mq135low\"");
-        handle_json_get_int(content, &sgp41noxhigh, "\"sgp41noxhigh\"");
-        handle_json_get_int(content, &sgp41noxlow, "\"sgp41noxlow\"");
-    }
-    handle_json_get_int(content, &temphigh, "\"temphigh\"");
-    handle_json_get_int(content, &templow, "\"templow\"");
-    handle_json_get_int(content, &humihigh, "\"humihigh\"");
-    handle_json_get_int(content, &humilow, "\"humilow\"");
-    handle_json_get_int(content, &leddisplay, "\"leddisplay\"");
-    handle_json_get_int(content, &ledsnooze, "\"ledsnooze\"");
-    handle_json_get_int(content, &facility, "\"facility\"");
-    handle_json_get_str(content, facility_list_text,
-                        sizeof(facility_list_text) - 1, "\"facilityList\"");
-    for (i = 0; i < SYSLOG_LEVEL_MAXNUM; i++)
-    {
-        snprintf(levelstr, sizeof(levelstr), "\"level%d\"", i);
-        handle_json_get_bool(content, &leveltmp, levelstr);
-        if (leveltmp)
-        {
-            level = level | 0x01 << i;
-        }
-        else
+        if (json_scan_feed(&scan, chunk, ret) != SYSTEM_ERROR_NONE)
         {
-            level = level & ~(0x01 << i);
+            break;
         }
     }
-    if (facility_list_text[0] != '\0')
+    if ((body.error == NULL) && !json_scan_done(&scan))
+    {
+        body.error = "Malformed JSON";
+    }
+    if (body.error != NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, body.error);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static bool http_is_airquality_board(void)
+{
+    uint8_t sys_mac[6];
+
+    ESP_ERROR_CHECK(esp_wifi_get_mac(WIFI_IF_STA, sys_mac));
+    return IS_BATHROOM(sys_mac) || IS_SAMPLE(sys_mac);
+}
+
+static void http_form_syslog(const http_form_t *form)
+{
+    char list[sizeof(form->facility_list)];
+    char syslog_server_ip[SYSLOG_MAXLEN_IP + 1] = {0};
+    int facility_ids[SYSLOG_FACILITY_MAXNUM] = {0};
+    int facility_count = 0;
+    char *saveptr = NULL, *token = NULL, *endptr = NULL;
+    uint32_t org_level = 0, level = 0;
+    bool changed = false;
+    long parsed = 0;
+
+    syslog_get_server_ip(syslog_server_ip, SYSLOG_MAXLEN_IP);
+    if (HTTP_FORM_HAS(form, HTTP_FORM_SYSLOG_IP) &&
+        strcmp(form->syslog_ip, syslog_server_ip))
     {
-        char parse_buf[sizeof(facility_list_text)] = {0};
-        char *saveptr = NULL;
-        char *token = NULL;
+        syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_DEBUG,
+                       "OrgSyslogServer: %s, NewSyslogServer: %s",
+                       syslog_server_ip, form->syslog_ip);
+        syslog_set_server_ip((char *)form->syslog_ip, strlen(form->syslog_ip));
+        changed = true;
+    }
 
-        strncpy(parse_buf, facility_list_text, sizeof(parse_buf) - 1);
-        token = strtok_r(parse_buf, ",", &saveptr);
-        while (token != NULL && facility_count < SYSLOG_FACILITY_MAXNUM)
+    if (HTTP_FORM_HAS(form, HTTP_FORM_FACILITY_LIST))
+    {
+        memcpy(list, form->facility_list, sizeof(list));
+        token = strtok_r(list, ",", &saveptr);
+        while ((token != NULL) && (facility_count < SYSLOG_FACILITY_MAXNUM))
         {
-            while (isspace((unsigned char)*token))
+            parsed = strtol(token, &endptr, 10);
+            while (isspace((unsigned char)*endptr))
             {
-                token++;
+                endptr++;
             }
-            if (*token == '\0')
+            if ((endptr != token) && (*endptr == '\0') && (parsed >= 0) &&
+                (parsed < SYSLOG_FACILITY_MAXNUM))
             {
-                token = strtok_r(NULL, ",", &saveptr);
-                continue;
-            }
-            char *end_trim = token + strlen(token) - 1;
-            while (end_trim >= token && isspace((unsigned char)*end_trim))
-            {
-                *end_trim = '\0';
-                end_trim--;
-            }
-            if (*token == '\0')
-            {
-                token = strtok_r(NULL, ",", &saveptr);
-                continue;
+                facility_ids[facility_count++] = (int)parsed;
             }
-            char *endptr = NULL;
-            long parsed = strtol(token, &endptr, 10);
-            if (endptr == token || parsed < 0 ||
-                parsed >= SYSLOG_FACILITY_MAXNUM)
+            token = strtok_r(NULL, ",", &saveptr);
+        }
+    }
+    if ((facility_count == 0) && HTTP_FORM_HAS(form, HTTP_FORM_FACILITY) &&
+        (form->facility >= 0) && (form->facility < SYSLOG_FACILITY_MAXNUM))
+    {
+        facility_ids[facility_count++] = form->facility;
+    }
+
+    for (int i = 0; i < facility_count; i++)
+    {
+        syslog_get_facility_level(facility_ids[i], &org_level);
+        /* Levels left out of the form keep their value */
+        level = org_level;
+        for (int l = 0; l < SYSLOG_LEVEL_MAXNUM; l++)
+        {
+            if (HTTP_FORM_HAS(form, HTTP_FORM_LEVEL + l))
             {
-                token = strtok_r(NULL, ",", &saveptr);
-                continue;
+                level = form->level[l] ? (level | (0x01 << l))
+                                       : (level & ~(0x01 << l));
             }
-            facility_ids[facility_count++] = (int)parsed;
-            token = strtok_r(NULL, ",", &saveptr);
         }
-        if (facility_count > 0)
+        syslog_handler(SYSLOG_FACILITY_SYSLOG, SYSLOG_LEVEL_DEBUG,
+                       "Handle syslog facility %d, level %d", facility_ids[i],
+                       level);
+        if (level != org_level)
+        {
+            syslog_set_facility_level(facility_ids[i], level);
+            changed = true;
+        }
+    }
+
+    if (changed)
+    {
+        /* Writes the server IP and the facility levels */
+        syslog_get_server_ip(syslog_server_ip, SYSLOG_MAXLEN_IP);
+        syslog_saveconfig(SYSLOG_NVS_SERVER_IP, syslog_server_ip);
+    }
+}
+
+static void http_form_apply(const http_form_t *form, bool airquality)
+{
+    char ota_ip[OTA_MAXLEN_IP + 1] = {0};
+    char ota_filename[OTA_MAXLEN_FILENAME + 1] = {0};
+    char org_apikey[THINGSPEAK_API_KEYLENGTH + 1] = {0};
+    uint32_t delaytime = 0;
+    int org = 0;
+
+    ld2410_getLeaveDelayTime(&delaytime);
+    if (HTTP_FORM_HAS(form, HTTP_FORM_IDEL_TIMES) && (form->idel_times >= 0) &&
+        ((uint32_t)form->idel_times != delaytime))
+    {
+        ld2410_setLeaveDelayTime((uint32_t)form->idel_times);
+        ld2410_saveconfig(LD2410_NVS_LEARNSTATUS_KEY, form->idel_times);
+    }
+
+    http_form_syslog(form);
+
+    ota_getip(ota_ip, OTA_MAXLEN_IP);
+    if (HTTP_FORM_HAS(form, HTTP_FORM_FIRMWARE_IP) &&
+        strcmp(form->firmware_ip, ota_ip))
+    {
+        ota_setip((char *)form->firmware_ip, strlen(form->firmware_ip));
+        ota_saveconfig(OTA_NVS_SERVER_IP, (char *)form->firmware_ip);
+    }
+    ota_getfilename(ota_filename, OTA_MAXLEN_FILENAME);
+    if (HTTP_FORM_HAS(form, HTTP_FORM_FIRMWARE_FILENAME) &&
+        strcmp(form->firmware_filename, ota_filename))
+    {
+        ota_setfilename((char *)form->firmware_filename,
+                        strlen(form->firmware_filename));
+        ota_saveconfig(OTA_NVS_FILENAME, (char *)form->firmware_filename);
+    }
+
+    thingspeak_getapikey(org_apikey, THINGSPEAK_API_KEYLENGTH);
+    if (HTTP_FORM_HAS(form, HTTP_FORM_APIKEY) &&
+        strcmp(form->apikey, org_apikey))
+    {
+        thingspeak_setapikey((char *)form->apikey, THINGSPEAK_API_KEYLENGTH);
+        thingspeak_saveconfig();
+    }
+
+    /* The air quality setters save their own threshold */
+    if (airquality)
+    {
+        airquality_get_voc_threshold_high(&org);
+        if (HTTP_FORM_HAS(form, HTTP_FORM_VOC_HIGH) && (form->voc_high != org))
+        {
+            airquality_set_voc_threshold_high(form->voc_high);
+        }
+        airquality_get_voc_threshold_low(&org);
+        if (HTTP_FORM_HAS(form, HTTP_FORM_VOC_LOW) && (form->voc_low != org))
+        {
+            airquality_set_voc_threshold_low(form->voc_low);
+        }
+        airquality_get_nox_threshold_high(&org);
+        if (HTTP_FORM_HAS(form, HTTP_FORM_NOX_HIGH) && (form->nox_high != org))
+        {
+            airquality_set_nox_threshold_high(form->nox_high);
+        }
+        airquality_get_nox_threshold_low(&org);
+        if (HTTP_FORM_HAS(form, HTTP_FORM_NOX_LOW) && (form->nox_low != org))
         {
-            facility = facility_ids[0];
+            airquality_set_nox_threshold_low(form->nox_low);
         }
     }
+
+    dht22_gethightemperature(&org);
+    if (HTTP_FORM_HAS(form, HTTP_FORM_TEMP_HIGH) && (form->temp_high != org))
+    {
+        dht22_sethightemperature(form->temp_high);
+        dht22_saveconfig(DHT22_NVS_TEMP_THRESHOLD_HIGH_KEY, form->temp_high);
+    }
+    dht22_getlowtemperature(&org);
+    if (HTTP_FORM_HAS(form, HTTP_FORM_TEMP_LOW) && (form->temp_low != org))
+    {
+        dht22_setlowtemperature(form->temp_low);
+        dht22_saveconfig(DHT22_NVS_TEMP_THRESHOLD_LOW_KEY, form->temp_low);
+    }
+    dht22_gethighhumidity(&org);
+    if (HTTP_FORM_HAS(form, HTTP_FORM_HUMI_HIGH) && (form->humi_high != org))
+    {
+        dht22_sethighhumidity(form->humi_high);
+        dht22_saveconfig(DHT22_NVS_HUMI_THRESHOLD_HIGH_KEY, form->humi_high);
+    }
+    dht22_getlowhumidity(&org);
+    if (HTTP_FORM_HAS(form, HTTP_FORM_HUMI_LOW) && (form->humi_low != org))
+    {
+        dht22_setlowhumidity(form->humi_low);
+        dht22_saveconfig(DHT22_NVS_HUMI_THRESHOLD_LOW_KEY, form->humi_low);
+    }
+
+    oled_getDisplayTime(&org);
+    if (HTTP_FORM_HAS(form, HTTP_FORM_LED_DISPLAY) &&
+        (form->led_display != org))
+    {
+        oled_setDisplayTime(form->led_display);
+        oled_saveconfig(OLED_NVS_DISPLAY_KEY, form->led_display);
+    }
+    oled_getSnoozeTime(&org);
+    if (HTTP_FORM_HAS(form, HTTP_FORM_LED_SNOOZE) && (form->led_snooze != org))
+    {
+        oled_setSnoozeTime(form->led_snooze);
+        oled_saveconfig(OLED_NVS_SNOOZE_KEY, form->led_snooze);
+    }
+}
+
+// Handler for POST requests to /submitform
+esp_err_t handle_submitform(httpd_req_t *req)
+{
+    http_form_t form = {0};
+
+    syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_DEBUG,
+                   "handle submitform: %d bytes", (int)req->content_len);
+    // Inputs left empty are skipped, so they keep their setting
+    if (http_json_read(req, ghttp_form_fields,
+                       sizeof(ghttp_form_fields) / sizeof(ghttp_form_fields[0]),
+                       &form, &form.present, false) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    http_form_apply(&form, http_is_airquality_board());
+
+    // Send response
+    const char resp[] = "Form data received and processed";
+    httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+}
+
+/*
+ * Resources under /api. GET answers the resource, PATCH takes an object with
+ * the members to change and answers the resource as updated. Settings are
+ * applied like the form and committed by the settings service.
+ */
+typedef struct
+{
+    const char *path;
+    void (*get)(httpd_req_t *req);
+    esp_err_t (*patch)(httpd_req_t *req);   /* NULL if read only */
+} http_resource_t;
+
+#define HTTP_IRLEARN_ACTIVE 0
+#define HTTP_IRLEARN_NAME 1
+
+typedef struct
+{
+    uint32_t present;
+    bool active;
+    char name[IR_LEARN_NAME_LEN];
+} http_irlearn_patch_t;
+
+static const json_field_t ghttp_irlearn_fields[] = {
+    {"active", JSON_FIELD_BOOL, HTTP_IRLEARN_ACTIVE,
+     offsetof(http_irlearn_patch_t, active), sizeof(bool)},
+    {"name", JSON_FIELD_STR, HTTP_IRLEARN_NAME,
+     offsetof(http_irlearn_patch_t, name), IR_LEARN_NAME_LEN},
+};
+
+static void http_rest_occupancy_get(httpd_req_t *req)
+{
+    uint32_t delaytime = 0;
+    float pred = 0;
+
     ld2410_getLeaveDelayTime(&delaytime);
-    if (idel_val >= 0 && idel_val != delaytime)
-    {
-        ld2410_saveconfig(LD2410_NVS_LEARNSTATUS_KEY, idel_val);
-        ld2410_setLeaveDelayTime((uint32_t)idel_val);
-    }
+    http_printf(req, "{\"occupancy\": %s, \"leaveDelay\": %lu",
+                ld2410_isOccupancyStatus() ? "true" : "false",
+                (unsigned long)delaytime);
+#if defined(LD2410_AUTOLEARN_NU)
+    nu_ld2410_getPred(&pred);
+    http_printf(req, ", \"pred\": %.3f, \"predNew\": %s", pred,
+                nu_ld2410_isnew() ? "true" : "false");
+#endif
+    http_printf(req, "}");
+}
 
-    syslog_get_server_ip(syslog_server_ip, SYSLOG_MAXLEN_IP);
-    bool ip_changed = (strcmp(syslog_ip, syslog_server_ip) != 0);
-    bool level_changed = false;
-    syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_DEBUG,
-                   "OrgSyslogServer: %s, NewSyslogServer: %s", syslog_server_ip,
-                   syslog_ip);
-    if (ip_changed)
-    {
-        syslog_set_server_ip(syslog_ip, strlen(syslog_ip));
-    }
+static esp_err_t http_rest_occupancy_patch(httpd_req_t *req)
+{
+    http_form_t form = {0};
 
-    if (facility_count > 0)
+    if (http_json_read(req, ghttp_occupancy_fields,
+                       sizeof(ghttp_occupancy_fields) /
+                           sizeof(ghttp_occupancy_fields[0]),
+                       &form, &form.present, true) != ESP_OK)
     {
-        for (i = 0; i < facility_count; i++)
-        {
-            int facility_id = facility_ids[i];
-            syslog_get_facility_level(facility_id, &org_level);
-            syslog_handler(SYSLOG_FACILITY_SYSLOG, SYSLOG_LEVEL_DEBUG,
-                           "Handle syslog facility %d, level %d", facility_id,
-                           level);
-            if (org_level != (uint32_t)level)
-            {
-                syslog_set_facility_level(facility_id, level);
-                level_changed = true;
-            }
-        }
+        return ESP_FAIL;
     }
-    else
+    if (HTTP_FORM_HAS(&form, HTTP_FORM_IDEL_TIMES) && (form.idel_times < 0))
     {
-        syslog_get_facility_level(facility, &org_level);
-        syslog_handler(SYSLOG_FACILITY_SYSLOG, SYSLOG_LEVEL_DEBUG,
-                       "Handle syslog facility %d, level %d", facility, level);
-        if ((facility != WEB_INPUT_INIT_VALUE) &&
-            (org_level != (uint32_t)level))
-        {
-            syslog_set_facility_level(facility, level);
-            level_changed = true;
-        }
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid value");
+        return ESP_FAIL;
     }
+    http_form_apply(&form, false);
+    return ESP_OK;
+}
 
-    if (ip_changed || level_changed)
-    {
-        syslog_saveconfig(SYSLOG_NVS_SERVER_IP, syslog_server_ip);
+static void http_rest_airquality_get(httpd_req_t *req)
+{
+    int high = 0, low = 0, index = 0;
+    float temperature = 0, humidity = 0;
+
+    dht22_getcurrenttemperature(&temperature);
+    dht22_getcurrenthumidity(&humidity);
+    http_printf(req, "{\"temperature\": %.1f, \"humidity\": %.1f", temperature,
+                humidity);
+    dht22_gethightemperature(&high);
+    dht22_getlowtemperature(&low);
+    http_printf(req, ", \"tempHigh\": %d, \"tempLow\": %d", high, low);
+    dht22_gethighhumidity(&high);
+    dht22_getlowhumidity(&low);
+    http_printf(req, ", \"humiHigh\": %d, \"humiLow\": %d", high, low);
+    if (http_is_airquality_board())
+    {
+        airquality_get_voc_index(&index);
+        airquality_get_voc_threshold_high(&high);
+        airquality_get_voc_threshold_low(&low);
+        http_printf(req, ", \"voc\": %d, \"vocHigh\": %d, \"vocLow\": %d",
+                    index, high, low);
+        airquality_get_nox_index(&index);
+        airquality_get_nox_threshold_high(&high);
+        airquality_get_nox_threshold_low(&low);
+        http_printf(req, ", \"nox\": %d, \"noxHigh\": %d, \"noxLow\": %d",
+                    index, high, low);
     }
+    http_printf(req, "}");
+}
+
+static esp_err_t http_rest_airquality_patch(httpd_req_t *req)
+{
+    http_form_t form = {0};
+    bool airquality = http_is_airquality_board();
 
-    if (strcmp(firmware_ip, ota_ip) || strcmp(firmware_filename, ota_filename))
+    if (http_json_read(req, ghttp_airquality_fields,
+                       sizeof(ghttp_airquality_fields) /
+                           sizeof(ghttp_airquality_fields[0]),
+                       &form, &form.present, true) != ESP_OK)
     {
-        ota_setip(firmware_ip, strlen(firmware_ip));
-        ota_setfilename(firmware_filename, strlen(firmware_filename));
-        ota_saveconfig(OTA_NVS_SERVER_IP, firmware_ip);
-        ota_saveconfig(OTA_NVS_FILENAME, firmware_filename);
+        return ESP_FAIL;
     }
-    thingspeak_getapikey(orgtpapikey, THINGSPEAK_API_KEYLENGTH);
-    if (strcmp(apikey, orgtpapikey))
+    if (!airquality &&
+        (form.present &
+         ((1UL << HTTP_FORM_VOC_HIGH) | (1UL << HTTP_FORM_VOC_LOW) |
+          (1UL << HTTP_FORM_NOX_HIGH) | (1UL << HTTP_FORM_NOX_LOW))))
     {
-        thingspeak_setapikey(apikey, THINGSPEAK_API_KEYLENGTH);
-        thingspeak_saveconfig();
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                            "No air quality sensor");
+        return ESP_FAIL;
     }
+    http_form_apply(&form, airquality);
+    return ESP_OK;
+}
 
-    if (IS_BATHROOM(sys_mac) || IS_SAMPLE(sys_mac))
-    {
-        airquality_get_voc_threshold_high(&orgmq135thresholdhigh);
-        airquality_get_voc_threshold_low(&orgmq135thresholdlow);
-        if (mq135high != orgmq135thresholdhigh)
-        {
-            airquality_set_voc_threshold_high(mq135high);
-        }
-        if (mq135low != orgmq135thresholdlow)
-        {
-            airquality_set_voc_threshold_low(mq135low);
-        }
-
-        airquality_get_nox_threshold_high(&orgsgp41noxhigh);
-        airquality_get_nox_threshold_low(&orgsgp41noxlow);
-        if (sgp41noxhigh != orgsgp41noxhigh)
-        {
-            airquality_set_nox_threshold_high(sgp41noxhigh);
-        }
-        if (sgp41noxlow != orgsgp41noxlow)
+static void http_rest_irlearn_get(httpd_req_t *req)
+{
+    ir_learn_entry_t entry;
+    int state = IR_LEARN_STATE_IDLE, presses = 0, count = 0, used = 0;
+
+    ir_learn_getstatus(&state, &presses);
+    ir_learn_getusage(&count, &used);
+    http_printf(req,
+                "{\"active\": %s, \"state\": %d, \"presses\": %d, "
+                "\"pressCount\": %d, \"used\": %d, \"size\": %d, "
+                "\"learned\": [",
+                ir_learn_isactive() ? "true" : "false", state, presses,
+                IR_LEARN_PRESS_COUNT, used, IR_LEARN_ARENA_SIZE);
+    for (int i = 0; i < count; i++)
+    {
+        if (ir_learn_getentry(i, &entry) != SYSTEM_ERROR_NONE)
         {
-            airquality_set_nox_threshold_low(sgp41noxlow);
+            break;
         }
+        http_printf(req, "%s{\"index\": %d, \"name\": ", (i > 0) ? "," : "",
+                    i);
+        http_json_string(req, entry.name);
+        http_printf(req, ", \"frames\": %d, \"symbols\": %d, \"bytes\": %d}",
+                    entry.frames, entry.symbols, entry.length);
     }
+    http_printf(req, "]}");
+}
 
-    dht22_gethightemperature(&orghightemp);
-    dht22_getlowtemperature(&orglowtemp);
-    dht22_gethighhumidity(&orghighhumi);
-    dht22_getlowhumidity(&orglowhumi);
+static esp_err_t http_rest_irlearn_patch(httpd_req_t *req)
+{
+    http_irlearn_patch_t patch = {0};
 
-    if (temphigh != orghightemp)
+    if (http_json_read(req, ghttp_irlearn_fields,
+                       sizeof(ghttp_irlearn_fields) /
+                           sizeof(ghttp_irlearn_fields[0]),
+                       &patch, &patch.present, true) != ESP_OK)
     {
-        dht22_sethightemperature(temphigh);
-        dht22_saveconfig(DHT22_NVS_TEMP_THRESHOLD_HIGH_KEY, temphigh);
+        return ESP_FAIL;
     }
-    if (templow != orglowtemp)
+    /* {"name": "tv"} starts learning it, {"active": false} stops */
+    if ((patch.present & (1UL << HTTP_IRLEARN_ACTIVE)) && !patch.active)
     {
-        dht22_setlowtemperature(templow);
-        dht22_saveconfig(DHT22_NVS_TEMP_THRESHOLD_LOW_KEY, templow);
+        ir_learn_stop();
     }
-
-    if (humihigh != orghighhumi)
+    else if (patch.present & (1UL << HTTP_IRLEARN_NAME))
     {
-        dht22_sethighhumidity(humihigh);
-        dht22_saveconfig(DHT22_NVS_HUMI_THRESHOLD_HIGH_KEY, humihigh);
+        if (ir_learn_start(patch.name) != SYSTEM_ERROR_NONE)
+        {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                                "Learning refused");
+            return ESP_FAIL;
+        }
     }
-    if (humilow != orglowhumi)
+    else if (patch.present & (1UL << HTTP_IRLEARN_ACTIVE))
     {
-        dht22_setlowhumidity(humilow);
-        dht22_saveconfig(DHT22_NVS_HUMI_THRESHOLD_LOW_KEY, humilow);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Name required");
+        return ESP_FAIL;
     }
+    return ESP_OK;
+}
+
+static const http_resource_t ghttp_resources[] = {
+    {"/api/airquality", http_rest_airquality_get, http_rest_airquality_patch},
+    {"/api/ir/learn", http_rest_irlearn_get, http_rest_irlearn_patch},
+    {"/api/occupancy", http_rest_occupancy_get, http_rest_occupancy_patch},
+};
+
+// Handler for GET and PATCH requests to /api/*
+static esp_err_t http_api(httpd_req_t *req)
+{
+    const http_resource_t *resource = NULL;
+    size_t len = strcspn(req->uri, "?");
 
-    oled_getDisplayTime(&oridisplaytime);
-    if (leddisplay != oridisplaytime)
+    for (int i = 0; i < sizeof(ghttp_resources) / sizeof(ghttp_resources[0]);
+         i++)
+    {
+        if ((strlen(ghttp_resources[i].path) == len) &&
+            (strncmp(req->uri, ghttp_resources[i].path, len) == 0))
+        {
+            resource = &ghttp_resources[i];
+            break;
+        }
+    }
+    if (resource == NULL)
     {
-        oled_setDisplayTime(leddisplay);
-        oled_saveconfig(OLED_NVS_DISPLAY_KEY, leddisplay);
+        httpd_resp_send_404(req);
+        return ESP_FAIL;
     }
-    oled_getSnoozeTime(&oriledsnoozetime);
-    if (ledsnooze != oriledsnoozetime)
+    if (req->method == HTTP_PATCH)
     {
-        oled_setSnoozeTime(ledsnooze);
-        oled_saveconfig(OLED_NVS_SNOOZE_KEY, ledsnooze);
+        if (resource->patch == NULL)
+        {
+            httpd_resp_set_hdr(req, "Allow", "GET");
+            httpd_resp_send_err(req, HTTPD_405_METHOD_NOT_ALLOWED,
+                                "Read only");
+            return ESP_FAIL;
+        }
+        if (resource->patch(req) != ESP_OK)
+        {
+            return ESP_FAIL;
+        }
     }
 
-    free(content);
-    // Send response
-    const char resp[] = "Form data received and processed";
-    httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
+    http_resp_begin(req);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    resource->get(req);
+    http_printf_end(req);
     return ESP_OK;
 }
 
@@ -784,6 +1102,9 @@ static esp_err_t http_api_erasedata(httpd_req_t *req)
 
     hap_stop();
 
+    // Write staged settings now, a restart after the erase would restore them
+    settings_commit();
+
     // Erase NVS data
     nvs_flash_erase_partition("nvs");
 
@@ -798,85 +1119,671 @@ static esp_err_t http_api_erasedata(httpd_req_t *req)
     return ESP_OK;
 }
 
+static esp_err_t http_api_irlearn_status(httpd_req_t *req)
+{
+    ir_learn_entry_t entry;
+    int state = IR_LEARN_STATE_IDLE, presses = 0, count = 0, used = 0;
+
+    ir_learn_getstatus(&state, &presses);
+    ir_learn_getusage(&count, &used);
+    http_printf(req, "\"irlearnstate\": %d,", state);
+    http_printf(req, "\"irlearnpress\": %d,", presses);
+    http_printf(req, "\"irlearnpresscount\": %d,", IR_LEARN_PRESS_COUNT);
+    http_printf(req, "\"irlearnused\": %d,", used);
+    http_printf(req, "\"irlearnsize\": %d,", IR_LEARN_ARENA_SIZE);
+    http_printf(req, "\"irlearncmd\": [");
+    for (int i = 0; i < count; i++)
+    {
+        if (ir_learn_getentry(i, &entry) != SYSTEM_ERROR_NONE)
+        {
+            break;
+        }
+        http_printf(req, "%s{\"name\": ", (i > 0) ? "," : "");
+        http_json_string(req, entry.name);
+        http_printf(req, ", \"frames\": %d, \"symbols\": %d, \"bytes\": %d}",
+                    entry.frames, entry.symbols, entry.length);
+    }
+    http_printf(req, "],");
+    return ESP_OK;
+}
+
+static void http_printf_hist(httpd_req_t *req, const char *key,
+                             const uint16_t *hist, int num)
+{
+    http_printf(req, "\"%s\": [", key);
+    for (int i = 0; i < num; i++)
+    {
+        http_printf(req, "%s%u", (i > 0) ? "," : "", hist[i]);
+    }
+    http_printf(req, "],");
+}
+
+static esp_err_t http_api_irstats(httpd_req_t *req)
+{
+    const ir_protocol_t *proto = NULL;
+    ir_stats_t stats;
+    ir_stats_record_t record;
+    rmt_tx_latency_t latency;
+    uint32_t rxframes = 0, rxdropped = 0;
+    bool first = true;
+
+    rmt_get_rx_stats(&rxframes, &rxdropped);
+    http_printf(req, "\"irrxframes\": %lu,", rxframes);
+    http_printf(req, "\"irrxdropped\": %lu,", rxdropped);
+    http_printf(req, "\"irretrytimes\": %d,", RMT_RETRY_TIMES);
+    http_printf(req, "\"irchecktimes\": %d,", RMT_CHECK_TIMES);
+    http_printf(req, "\"irstats\": [");
+    for (char type = IR_TYPE_HITACHI; type < IR_TYPE_MAX; type++)
+    {
+        if (ir_stats_get(type, &stats) != SYSTEM_ERROR_NONE)
+        {
+            continue;
+        }
+        memset(&latency, 0, sizeof(latency));
+        rmt_get_tx_latency(type, &latency);
+        proto = ir_protocol_get(type);
+        http_printf(req, "%s{\"type\": %d, \"name\": \"%s\",",
+                    first ? "" : ",", type,
+                    (proto != NULL) ? proto->name : "Learned");
+        http_printf(req,
+                    "\"frames\": %lu, \"attempts\": %lu, \"retries\": %lu, "
+                    "\"confirmed\": %lu, \"unconfirmed\": %lu, "
+                    "\"unchecked\": %lu,",
+                    stats.frames, stats.attempts, stats.retries,
+                    stats.confirmed, stats.unconfirmed, stats.unchecked);
+        http_printf_hist(req, "attempthist", stats.attempt_hist,
+                         IR_STATS_MAX_ATTEMPTS);
+        http_printf_hist(req, "checkhist", stats.check_hist,
+                         IR_STATS_MAX_CHECKS);
+        http_printf_hist(req, "confirmhist", stats.confirm_hist,
+                         IR_STATS_CONFIRM_BUCKETS);
+        http_printf_hist(req, "snrhist", stats.snr_hist, IR_STATS_SNR_BUCKETS);
+        http_printf(req,
+                    "\"latencyavg\": %lld, \"latencymax\": %lld}",
+                    latency.count ? latency.total_us / latency.count / 1000 : 0,
+                    latency.max_us / 1000);
+        first = false;
+    }
+    http_printf(req, "],");
+    http_printf(req, "\"irrecent\": [");
+    for (int i = 0; ir_stats_get_recent(i, &record) == SYSTEM_ERROR_NONE; i++)
+    {
+        http_printf(req,
+                    "%s{\"time\": %lu, \"type\": %d, \"attempts\": %d, "
+                    "\"checks\": %d, \"snr\": %d, \"confirm\": %d}",
+                    (i > 0) ? "," : "", record.time, record.type,
+                    record.attempts, record.checks, record.snr_db,
+                    (record.confirm_ms == IR_STATS_UNCONFIRMED)
+                        ? -1
+                        : record.confirm_ms);
+    }
+    http_printf(req, "],");
+    return ESP_OK;
+}
+
+static esp_err_t http_api_diagnostics(httpd_req_t *req)
+{
+    timer_wheel_stats_t stats;
+    timer_wheel_info_t info;
+    syslog_stats_t logstats;
+
+    if (syslog_get_stats(&logstats) == SYSTEM_ERROR_NONE)
+    {
+        http_printf(req,
+                    "\"syslogqueued\": %lu, \"syslogdropped\": %lu, "
+                    "\"syslogsent\": %lu, \"syslogbatches\": %lu, "
+                    "\"syslogfailed\": %lu,",
+                    logstats.queued, logstats.dropped, logstats.sent,
+                    logstats.batches, logstats.send_failed);
+    }
+
+    http_printf(req,
+                "\"httprequests\": %lu, \"httpslow\": %lu, "
+                "\"httpslowest\": %lu,",
+                ghttp_requests, ghttp_slow, ghttp_slowest_ms);
+
+    if (timer_wheel_get_stats(&stats) != SYSTEM_ERROR_NONE)
+    {
+        return ESP_FAIL;
+    }
+    http_printf(req,
+                "\"timerticks\": %lu, \"timercascades\": %lu, "
+                "\"timerfires\": %lu, \"timerlateticks\": %lu, "
+                "\"timerdispatchmax\": %lu,",
+                stats.ticks, stats.cascades, stats.fires, stats.late_ticks,
+                stats.dispatch_max_us);
+    http_printf(req, "\"timerarmed\": %u, \"timerarmedmax\": %u,",
+                stats.armed, stats.armed_max);
+    http_printf(req, "\"timers\": [");
+    for (int i = 0; timer_wheel_get_info(i, &info) == SYSTEM_ERROR_NONE; i++)
+    {
+        http_printf(req,
+                    "%s{\"name\": \"%s\", \"active\": %d, \"level\": %d, "
+                    "\"remaining\": %lu, \"starts\": %lu, \"stops\": %lu, "
+                    "\"fires\": %lu, \"callbackmax\": %lu}",
+                    (i > 0) ? "," : "", info.name ? info.name : "", info.active,
+                    info.level, info.remaining_ms / 1000, info.starts,
+                    info.stops, info.fires, info.callback_max_us);
+    }
+    http_printf(req, "],");
+    return ESP_OK;
+}
+
+/* Status of a job, id=job id, result=true also hands its output over */
+static esp_err_t http_api_job(httpd_req_t *req, const char *param,
+                              bool result)
+{
+    char value[8];
+    char *text = NULL;
+    int len = 0;
+    http_job_info_t info;
+    uint16_t id = 0;
+
+    if (httpd_query_key_value(param, "id", value, sizeof(value)) == ESP_OK)
+    {
+        id = (uint16_t)atoi(value);
+    }
+    if (http_job_get_info(id, &info) != SYSTEM_ERROR_NONE)
+    {
+        return ESP_FAIL;
+    }
+    http_printf(req, "\"job\": %u,", info.id);
+    http_printf(req, "\"jobname\": ");
+    http_json_string(req, info.name);
+    http_printf(req, ",\"jobstate\": %u,", info.state);
+    http_printf(req, "\"jobwait\": %lu, \"jobrun\": %lu,", info.wait_ms,
+                info.run_ms);
+    if (!result)
+    {
+        return ESP_OK;
+    }
+    if (http_job_take_result(id, &text, &len) != SYSTEM_ERROR_NONE)
+    {
+        return ESP_FAIL;
+    }
+    if (text != NULL)
+    {
+        http_write(req, text, len);
+        free(text);
+    }
+    return (info.state == HTTP_JOB_STATE_DONE) ? ESP_OK : ESP_FAIL;
+}
+
+/* Queue a long action and reply with its id, the page polls HTTP_JOB_ID */
+static int http_job_start(httpd_req_t *req, const char *name,
+                          http_job_fn_t fn)
+{
+    uint16_t id = 0;
+
+    if (http_job_submit(name, fn, NULL, &id) != SYSTEM_ERROR_NONE)
+    {
+        syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_WARNING,
+                       "Job %s rejected, too many jobs", name);
+        return HTTP_ACTION_STATUS_FAIL;
+    }
+    http_printf(req, "\"job\": %u,", id);
+    return HTTP_ACTION_STATUS_SUCCESS;
+}
+
+static int http_job_autolearn_save(void *arg, char **result, int *len)
+{
+    return (http_api_autolearn_save(NULL) == ESP_OK) ? SYSTEM_ERROR_NONE
+                                                    : SYSTEM_ERROR_NOT_READY;
+}
+
+static int http_job_erasedata(void *arg, char **result, int *len)
+{
+    /* Give the page time to see the job started before the device stops */
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    http_api_erasedata(NULL);
+    return SYSTEM_ERROR_NONE;
+}
+
+/* Weights as JSON members, HTTP_JOB_RESULT_ID adds them to its reply */
+static int http_job_nu_export(void *arg, char **result, int *len)
+{
+    /* Allocate buffers for Base64 encoded weights */
+    char *w_ih_b64 = malloc(4096);
+    char *w_ho_b64 = malloc(256);
+    char *b_h_b64 = malloc(256);
+    char *b_o_b64 = malloc(64);
+    /* Large buffer for full JSON content (no newlines) */
+    char *json_buf = malloc(8192);
+    int ret = SYSTEM_ERROR_NOT_READY;
+
+    if (w_ih_b64 && w_ho_b64 && b_h_b64 && b_o_b64 && json_buf &&
+        nu_ld2410_get_weights_base64(w_ih_b64, w_ho_b64, b_h_b64, b_o_b64))
+    {
+        /* Build JSON content without newlines */
+        *len = snprintf(json_buf, 8192,
+                        "\"model\": \"" NU_MODEL_STR "\","
+                        "\"version\": 1,"
+                        "\"input_size\": %d,"
+                        "\"hidden_size\": %d,"
+                        "\"output_size\": %d,"
+                        "\"w_ih\": \"%s\","
+                        "\"w_ho\": \"%s\","
+                        "\"b_h\": \"%s\","
+                        "\"b_o\": \"%s\",",
+                        INPUT_SIZE, HIDDEN_SIZE, OUTPUT_SIZE, w_ih_b64,
+                        w_ho_b64, b_h_b64, b_o_b64);
+        *len = MIN(*len, 8191);
+        *result = json_buf;
+        json_buf = NULL;
+        ret = SYSTEM_ERROR_NONE;
+    }
+
+    if (w_ih_b64) free(w_ih_b64);
+    if (w_ho_b64) free(w_ho_b64);
+    if (b_h_b64) free(b_h_b64);
+    if (b_o_b64) free(b_o_b64);
+    if (json_buf) free(json_buf);
+    return ret;
+}
+
 static esp_err_t http_api_reset_baseline(httpd_req_t *req)
 {
     airquality_reset_baseline();
     return ESP_OK;
 }
 
-static esp_err_t http_api_env_updt(httpd_req_t *req)
+/*
+ * State of the room for the page. One table describes it for the polled
+ * HTTP_ENV_UPDT, the /events stream and /api/history: the JSON keys of the
+ * page, and small integer keys for CBOR clients that ask for it with Accept.
+ * Numbers with digits are fixed point, CBOR sends them as decimal fractions
+ * so they keep their exact value.
+ */
+#define HTTP_ENV_INT            0
+#define HTTP_ENV_DECIMAL        1   /* int scaled by 10^digits */
+#define HTTP_ENV_ARRAY          2   /* uint8_t[digits] */
+
+#define HTTP_ENV_AIRQUALITY     0x01    /* Only on boards with the sensor */
+#define HTTP_ENV_LIVE           0x02    /* Pushed on /events as it changes */
+
+typedef struct
+{
+    int airquality;
+    int nox;
+    int voc;
+    int voc_high;
+    int voc_low;
+    int nox_high;
+    int nox_low;
+    uint8_t deltafan[IR_DELTA_FAN_TIGGER_MODE_MAX];
+    int temperature;            /* 0.1 C */
+    int temp_high;
+    int temp_low;
+    int humidity;               /* 0.1 % */
+    int humi_high;
+    int humi_low;
+    int pred;                   /* 0.001 */
+    int nuld2410new;
+    int occupancy;
+    int stillness;
+    int somebody;
+    int nobody;
+} http_env_state_t;
+
+typedef struct
+{
+    const char *name;
+    uint8_t id;
+    uint8_t type;
+    uint8_t digits;
+    uint8_t flags;
+    uint16_t offset;
+    const char *history;        /* Key of its /api/history array, or NULL */
+    uint8_t metric;             /* HISTORY_METRIC_* if history is set */
+} http_env_field_t;
+
+#define HTTP_ENV_FIELD(name, id, type, digits, flags, member) \
+    {name, id, type, digits, flags, offsetof(http_env_state_t, member), NULL, 0}
+
+/* A field history.c also records, in the same unit */
+#define HTTP_ENV_RECORDED(name, id, type, digits, flags, member, history,   \
+                          metric)                                         \
+    {name,    id, type, digits, flags, offsetof(http_env_state_t, member), \
+     history, metric}
+
+/* Ids are the CBOR keys, never reuse one */
+static const http_env_field_t ghttp_env_fields[] = {
+    HTTP_ENV_RECORDED("sgp41nox", 1, HTTP_ENV_INT, 0,
+                      HTTP_ENV_AIRQUALITY | HTTP_ENV_LIVE, nox, "historynox",
+                      HISTORY_METRIC_NOX),
+    HTTP_ENV_RECORDED("mq135currentdata", 2, HTTP_ENV_INT, 0,
+                      HTTP_ENV_AIRQUALITY | HTTP_ENV_LIVE, voc, "historyvoc",
+                      HISTORY_METRIC_VOC),
+    HTTP_ENV_FIELD("mq135thresholdhigh", 3, HTTP_ENV_INT, 0,
+                   HTTP_ENV_AIRQUALITY, voc_high),
+    HTTP_ENV_FIELD("mq135thresholdlow", 4, HTTP_ENV_INT, 0,
+                   HTTP_ENV_AIRQUALITY, voc_low),
+    HTTP_ENV_FIELD("sgp41noxhigh", 5, HTTP_ENV_INT, 0, HTTP_ENV_AIRQUALITY,
+                   nox_high),
+    HTTP_ENV_FIELD("sgp41noxlow", 6, HTTP_ENV_INT, 0, HTTP_ENV_AIRQUALITY,
+                   nox_low),
+    HTTP_ENV_FIELD("deltafanscheduler", 7, HTTP_ENV_ARRAY,
+                   IR_DELTA_FAN_TIGGER_MODE_MAX, HTTP_ENV_AIRQUALITY,
+                   deltafan),
+    HTTP_ENV_RECORDED("dht22currenttemp", 8, HTTP_ENV_DECIMAL, 1,
+                      HTTP_ENV_LIVE, temperature, "historytemp",
+                      HISTORY_METRIC_TEMPERATURE),
+    HTTP_ENV_FIELD("dht22thresholdtemphigh", 9, HTTP_ENV_INT, 0, 0,
+                   temp_high),
+    HTTP_ENV_FIELD("dht22thresholdtemplow", 10, HTTP_ENV_INT, 0, 0, temp_low),
+    HTTP_ENV_RECORDED("dht22currenthumi", 11, HTTP_ENV_DECIMAL, 1,
+                      HTTP_ENV_LIVE, humidity, "historyhumi",
+                      HISTORY_METRIC_HUMIDITY),
+    HTTP_ENV_FIELD("dht22thresholdhumihigh", 12, HTTP_ENV_INT, 0, 0,
+                   humi_high),
+    HTTP_ENV_FIELD("dht22thresholdhumilow", 13, HTTP_ENV_INT, 0, 0, humi_low),
+#if defined(LD2410_AUTOLEARN_NU)
+    HTTP_ENV_RECORDED("nuld2410pred", 14, HTTP_ENV_DECIMAL, 3, HTTP_ENV_LIVE,
+                      pred, "historypred", HISTORY_METRIC_PRED),
+    HTTP_ENV_FIELD("nuld2410new", 15, HTTP_ENV_INT, 0, HTTP_ENV_LIVE,
+                   nuld2410new),
+#endif
+    HTTP_ENV_FIELD("occupancy", 16, HTTP_ENV_INT, 0, HTTP_ENV_LIVE, occupancy),
+    HTTP_ENV_FIELD("sysLearnstillnessstatus", 17, HTTP_ENV_INT, 0,
+                   HTTP_ENV_LIVE, stillness),
+    HTTP_ENV_FIELD("sysLearnsomebodystatus", 18, HTTP_ENV_INT, 0,
+                   HTTP_ENV_LIVE, somebody),
+    HTTP_ENV_FIELD("sysLearnnobodystatus", 19, HTTP_ENV_INT, 0, HTTP_ENV_LIVE,
+                   nobody),
+};
+
+#define HTTP_ENV_NUM_FIELDS \
+    (sizeof(ghttp_env_fields) / sizeof(ghttp_env_fields[0]))
+
+static void http_env_get_state(http_env_state_t *state)
+{
+    float temperature = 0, humidity = 0, pred = 0;
+    uint8_t sys_mac[6];
+    char ANType = 0;
+
+    memset(state, 0, sizeof(*state));
+    if ((esp_wifi_get_mac(WIFI_IF_STA, sys_mac) == ESP_OK) &&
+        (IS_BATHROOM(sys_mac) || IS_SAMPLE(sys_mac)))
+    {
+        state->airquality = 1;
+        airquality_get_voc_index(&state->voc);
+        airquality_get_nox_index(&state->nox);
+        airquality_get_voc_threshold_high(&state->voc_high);
+        airquality_get_voc_threshold_low(&state->voc_low);
+        airquality_get_nox_threshold_high(&state->nox_high);
+        airquality_get_nox_threshold_low(&state->nox_low);
+        for (int i = 0; i < IR_DELTA_FAN_TIGGER_MODE_MAX; i++)
+        {
+            ir_get_deltascheduler(i, &state->deltafan[i]);
+        }
+    }
+    dht22_getcurrenttemperature(&temperature);
+    dht22_getcurrenthumidity(&humidity);
+    dht22_gethightemperature(&state->temp_high);
+    dht22_getlowtemperature(&state->temp_low);
+    dht22_gethighhumidity(&state->humi_high);
+    dht22_getlowhumidity(&state->humi_low);
+    state->temperature =
+        (int)(temperature * 10 + ((temperature < 0) ? -0.5f : 0.5f));
+    state->humidity = (int)(humidity * 10 + 0.5f);
+#if defined(LD2410_AUTOLEARN_NU)
+    nu_ld2410_getPred(&pred);
+    state->nuld2410new = nu_ld2410_isnew();
+#endif
+    state->pred = (int)(pred * 1000 + 0.5f);
+    state->occupancy = ld2410_isOccupancyStatus();
+    ld2410_getANType(&ANType);
+    state->stillness = ANType & LD2410_AN_TYPE_STILLNESS;
+    state->somebody = ANType & LD2410_AN_TYPE_SOMEONE;
+    state->nobody = ANType & LD2410_AN_TYPE_NOONE;
+}
+
+static bool http_env_has(const http_env_field_t *field,
+                         const http_env_state_t *state)
+{
+    return !(field->flags & HTTP_ENV_AIRQUALITY) || state->airquality;
+}
+
+static bool http_env_changed(const http_env_field_t *field,
+                             const http_env_state_t *now,
+                             const http_env_state_t *last)
+{
+    size_t size = (field->type == HTTP_ENV_ARRAY) ? field->digits : sizeof(int);
+
+    return memcmp((const char *)now + field->offset,
+                  (const char *)last + field->offset, size) != 0;
+}
+
+/* "key": value of one field, cut to size like snprintf but returns the
+   length written */
+static int http_env_format(char *buf, int size, const http_env_field_t *field,
+                           const http_env_state_t *state)
+{
+    static const int scale[] = {1, 10, 100, 1000};
+    const char *base = (const char *)state + field->offset;
+    int len = 0, value = 0;
+
+    len = snprintf(buf, size, "\"%s\": ", field->name);
+    switch (field->type)
+    {
+    case HTTP_ENV_DECIMAL:
+        value = *(const int *)base;
+        len += snprintf(buf + MIN(len, size - 1), size - MIN(len, size - 1),
+                        "%s%d.%0*d", (value < 0) ? "-" : "",
+                        abs(value) / scale[field->digits], field->digits,
+                        abs(value) % scale[field->digits]);
+        break;
+    case HTTP_ENV_ARRAY:
+        for (int n = 0; n < field->digits; n++)
+        {
+            len += snprintf(buf + MIN(len, size - 1),
+                            size - MIN(len, size - 1), "%s%d", n ? "," : "[",
+                            ((const uint8_t *)base)[n]);
+        }
+        len += snprintf(buf + MIN(len, size - 1), size - MIN(len, size - 1),
+                        "]");
+        break;
+    default:
+        len += snprintf(buf + MIN(len, size - 1), size - MIN(len, size - 1),
+                        "%d", *(const int *)base);
+        break;
+    }
+    return MIN(len, size - 1);
+}
+
+static esp_err_t http_api_env_updt(httpd_req_t *req)
+{
+    char text[HTTP_ENV_MAXLEN_FIELD];
+    http_env_state_t state;
+
+    http_env_get_state(&state);
+    for (int i = 0; i < HTTP_ENV_NUM_FIELDS; i++)
+    {
+        if (http_env_has(&ghttp_env_fields[i], &state))
+        {
+            http_env_format(text, sizeof(text), &ghttp_env_fields[i], &state);
+            http_printf(req, "%s,", text);
+        }
+    }
+    return ESP_OK;
+}
+
+/*
+ * History of one resolution, res=0 seconds, 1 minutes, 2 quarters, and
+ * since=uptime in seconds to get only newer samples. Every array holds the
+ * oldest value then the deltas, in the unit of its field of HTTP_ENV_UPDT.
+ */
+static esp_err_t http_api_history(httpd_req_t *req, const char *param)
+{
+    const http_env_field_t *field = NULL;
+    char value[16];
+    int32_t values[32];
+    int32_t prev = 0;
+    history_info_t info;
+    int level = HISTORY_LEVEL_SECOND, first = 0, read = 0, n = 0;
+    uint32_t since = 0;
+
+    if (httpd_query_key_value(param, "res", value, sizeof(value)) == ESP_OK)
+    {
+        level = atoi(value);
+    }
+    if (httpd_query_key_value(param, "since", value, sizeof(value)) == ESP_OK)
+    {
+        since = strtoul(value, NULL, 10);
+    }
+    if (history_get_info(level, &info) != SYSTEM_ERROR_NONE)
+    {
+        return ESP_FAIL;
+    }
+    first = history_first_since(&info, since);
+
+    http_printf(req, "\"historyres\": %d, \"historyperiod\": %lu,", level,
+                info.period_s);
+    http_printf(req, "\"historyend\": %lu, \"historynow\": %lu,", info.end_s,
+                (uint32_t)(esp_timer_get_time() / 1000000));
+    for (int f = 0; f < HTTP_ENV_NUM_FIELDS; f++)
+    {
+        field = &ghttp_env_fields[f];
+        if (field->history == NULL)
+        {
+            continue;
+        }
+        http_printf(req, "\"%s\": [", field->history);
+        for (int i = first; i < info.count; i += read)
+        {
+            if ((history_read(level, field->metric, i, values,
+                              sizeof(values) / sizeof(values[0]),
+                              &read) != SYSTEM_ERROR_NONE) ||
+                (read == 0))
+            {
+                break;
+            }
+            for (n = 0; n < read; n++)
+            {
+                http_printf(req, (i + n == first) ? "%ld" : ",%ld",
+                            (i + n == first) ? values[n] : values[n] - prev);
+                prev = values[n];
+            }
+        }
+        http_printf(req, "],");
+    }
+    return ESP_OK;
+}
+
+/* The same state as HTTP_ENV_UPDT in one CBOR map keyed by field id */
+static esp_err_t http_api_env_cbor(httpd_req_t *req)
+{
+    uint8_t buf[HTTP_ENV_CBOR_BUFSIZE];
+    cbor_writer_t writer;
+    http_env_state_t state;
+    const http_env_field_t *field = NULL;
+    const char *base = (const char *)&state;
+    int num = 0;
+
+    http_env_get_state(&state);
+    for (int i = 0; i < HTTP_ENV_NUM_FIELDS; i++)
+    {
+        num += http_env_has(&ghttp_env_fields[i], &state);
+    }
+    cbor_init(&writer, buf, sizeof(buf));
+    cbor_put_map(&writer, num);
+    for (int i = 0; i < HTTP_ENV_NUM_FIELDS; i++)
+    {
+        field = &ghttp_env_fields[i];
+        if (!http_env_has(field, &state))
+        {
+            continue;
+        }
+        cbor_put_int(&writer, field->id);
+        switch (field->type)
+        {
+        case HTTP_ENV_DECIMAL:
+            cbor_put_decimal(&writer, *(const int *)(base + field->offset),
+                             -field->digits);
+            break;
+        case HTTP_ENV_ARRAY:
+            cbor_put_array(&writer, field->digits);
+            for (int n = 0; n < field->digits; n++)
+            {
+                cbor_put_int(&writer,
+                             ((const uint8_t *)(base + field->offset))[n]);
+            }
+            break;
+        default:
+            cbor_put_int(&writer, *(const int *)(base + field->offset));
+            break;
+        }
+    }
+    if (writer.overflow)
+    {
+        syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_ERROR,
+                       "CBOR state over %d bytes", HTTP_ENV_CBOR_BUFSIZE);
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, "application/cbor");
+    return httpd_resp_send(req, (const char *)buf, writer.len);
+}
+
+/* True if the client asked for CBOR, q-values are not weighed */
+static bool http_accepts_cbor(httpd_req_t *req)
+{
+    size_t len = httpd_req_get_hdr_value_len(req, "Accept");
+    char *accept = NULL;
+    bool cbor = false;
+
+    if (len == 0)
+    {
+        return false;
+    }
+    /* Browsers send long lists, don't cut off a type at the end */
+    accept = malloc(len + 1);
+    if (accept == NULL)
+    {
+        return false;
+    }
+    cbor = (httpd_req_get_hdr_value_str(req, "Accept", accept, len + 1) ==
+            ESP_OK) &&
+           (strstr(accept, "application/cbor") != NULL);
+    free(accept);
+    return cbor;
+}
+
+/* Decode a query value, false if it's malformed or doesn't fit size */
+static bool http_url_decode(char *dst, size_t size, const char *src)
 {
-    int i = 0, temphigh = 0, templow = 0, humihigh = 0, humilow = 0;
-    float temperature = 0, humidity = 0;
-    int mq135aqi = 0, mq135thresholdhigh = 0, mq135thresholdlow = 0;
-    int sgp41noxhigh = 0, sgp41noxlow = 0;
-    uint8_t sys_mac[6], scheduler = 0;
-    char ANType = 0;
-    float pred = 0.0;
+    size_t len = 0;
+    char hex[3] = {0};
 
-    ESP_ERROR_CHECK(esp_wifi_get_mac(WIFI_IF_STA, sys_mac));
-    if (IS_BATHROOM(sys_mac) || IS_SAMPLE(sys_mac))
+    while (*src != '\0')
     {
-        airquality_get_voc_index(&mq135aqi);
-        int mq135nox = 0;
-        airquality_get_nox_index(&mq135nox);
-        http_printf(req, "\"sgp41nox\": %d,", mq135nox);
-        airquality_get_voc_threshold_high(&mq135thresholdhigh);
-        airquality_get_voc_threshold_low(&mq135thresholdlow);
-        airquality_get_nox_threshold_high(&sgp41noxhigh);
-        airquality_get_nox_threshold_low(&sgp41noxlow);
-        http_printf(req, "\"mq135currentdata\": %d,",
-                    mq135aqi); /* Current Air quality */
-        http_printf(req, "\"mq135thresholdhigh\": %d,",
-                    mq135thresholdhigh); /* Air quality worest threshold */
-        http_printf(req, "\"mq135thresholdlow\": %d,",
-                    mq135thresholdlow); /* Air quality best threshold */
-        http_printf(req, "\"sgp41noxhigh\": %d,", sgp41noxhigh);
-        http_printf(req, "\"sgp41noxlow\": %d,", sgp41noxlow);
-        http_printf(req, "\"deltafanscheduler\": ["); /* DeltaFan Scheduler */
-        for (i = 0; i < IR_DELTA_FAN_TIGGER_MODE_MAX - 1; i++)
+        if (len + 1 >= size)
         {
-            ir_get_deltascheduler(i, &scheduler);
-            http_printf(req, "%d,", scheduler);
+            return false;
+        }
+        if (*src == '%')
+        {
+            if (!isxdigit((unsigned char)src[1]) ||
+                !isxdigit((unsigned char)src[2]))
+            {
+                return false;
+            }
+            hex[0] = src[1];
+            hex[1] = src[2];
+            dst[len] = (char)strtol(hex, NULL, 16);
+            if (dst[len++] == '\0')
+            {
+                return false;
+            }
+            src += 3;
+        }
+        else
+        {
+            dst[len++] = (*src == '+') ? ' ' : *src;
+            src++;
         }
-        ir_get_deltascheduler(i, &scheduler);
-        http_printf(req, "%d],", scheduler);
     }
-    dht22_getcurrenttemperature(&temperature);
-    dht22_getcurrenthumidity(&humidity);
-    dht22_getcurrenttemperature(&temperature);
-    dht22_getcurrenthumidity(&humidity);
-    dht22_gethightemperature(&temphigh);
-    dht22_getlowtemperature(&templow);
-    dht22_gethighhumidity(&humihigh);
-    dht22_getlowhumidity(&humilow);
-    http_printf(req, "\"dht22currenttemp\": %.1f,",
-                temperature); /* Current Temperature */
-    http_printf(req, "\"dht22thresholdtemphigh\": %d,",
-                temphigh); /* High Temperature threshold */
-    http_printf(req, "\"dht22thresholdtemplow\": %d,",
-                templow); /* Low Temperature threshold */
-    http_printf(req, "\"dht22currenthumi\": %.1f,",
-                humidity); /* Current Humidity */
-    http_printf(req, "\"dht22thresholdhumihigh\": %d,",
-                humihigh); /* High Humidity threshold */
-    http_printf(req, "\"dht22thresholdhumilow\": %d,",
-                humilow); /* Low Humidity threshold */
-#if defined(LD2410_AUTOLEARN_NU)
-    nu_ld2410_getPred(&pred);
-    http_printf(req, "\"nuld2410pred\": %f,",
-                pred); /* Artificial Neural Network Prediction data */
-    http_printf(req, "\"nuld2410new\": %d,",
-                nu_ld2410_isnew()); /* ANN saved data is not latest */
-#endif
-    ld2410_getANType(&ANType);
-    http_printf(req, "\"sysLearnstillnessstatus\": %d,",
-                ANType & LD2410_AN_TYPE_STILLNESS); /* Learn Stillness Status */
-    http_printf(req, "\"sysLearnsomebodystatus\": %d,",
-                ANType & LD2410_AN_TYPE_SOMEONE); /* Learn Somebody Status */
-    http_printf(req, "\"sysLearnnobodystatus\": %d,",
-                ANType & LD2410_AN_TYPE_NOONE); /* Learn Nobody Statys */
-    return ESP_OK;
+    dst[len] = '\0';
+    return true;
 }
 
 static esp_err_t http_api_loading(httpd_req_t *req)
@@ -933,14 +1840,18 @@ static esp_err_t http_api_loading(httpd_req_t *req)
                 flag & LD2410_DBG_FLAG_NOBODY); /* Debug Nobody Status */
     http_printf(req, "\"sysFirmwareupgradestatus\": %d,",
                 ota_status); /* Firmware Upgrade Status */
-    http_printf(req, "\"syslogIp\": \"%s\",",
-                syslog_server_ip); /* Syslog server */
-    http_printf(req, "\"firmwareIp\": \"%s\",",
-                ota_ip); /* Firmware server IP */
-    http_printf(req, "\"firmwareFilename\": \"%s\",",
-                ota_filename); /* Firmware filename */
-    http_printf(req, "\"apikey\": \"%s\",",
-                thingspeak_apikey); /* ThingSpeak API key */
+    http_printf(req, "\"syslogIp\": ");
+    http_json_string(req, syslog_server_ip); /* Syslog server */
+    http_printf(req, ",");
+    http_printf(req, "\"firmwareIp\": ");
+    http_json_string(req, ota_ip); /* Firmware server IP */
+    http_printf(req, ",");
+    http_printf(req, "\"firmwareFilename\": ");
+    http_json_string(req, ota_filename); /* Firmware filename */
+    http_printf(req, ",");
+    http_printf(req, "\"apikey\": ");
+    http_json_string(req, thingspeak_apikey); /* ThingSpeak API key */
+    http_printf(req, ",");
     http_printf(req, "\"sysRebootstatus\": %d,",
                 system_isrebooting()); /* Reboot Status */
     http_printf(req, "\"sysErasestatus\": %d,",
@@ -1016,58 +1927,516 @@ static esp_err_t http_api_reboot(httpd_req_t *req)
     return ESP_OK;
 }
 
-esp_err_t http_homevue(httpd_req_t *req)
+/*
+ * Files of the SPIFFS image are stored as <name>.gz with their ETag in
+ * <name>.etag, see spiffs_gzip.py. An image without them is sent as is.
+ */
+static esp_err_t http_send_static(httpd_req_t *req, const char *name,
+                                  const char *type, const char *cache)
 {
-    const char *file_path = "/spiffs/index.html";
-    FILE *f = fopen(file_path, "r");
+    char path[48], etag[24] = "", match[24] = "";
+    char *buffer = NULL;
+    size_t read_bytes = 0;
+    bool gzipped = true;
+    FILE *f = NULL;
+
+    snprintf(path, sizeof(path), "/spiffs/%s.etag", name);
+    f = fopen(path, "r");
+    if (f != NULL)
+    {
+        etag[0] = '"';
+        read_bytes = fread(&etag[1], 1, sizeof(etag) - 3, f);
+        fclose(f);
+        if (read_bytes > 0)
+        {
+            etag[read_bytes + 1] = '"';
+            etag[read_bytes + 2] = '\0';
+        }
+        else
+        {
+            etag[0] = '\0';
+        }
+    }
+    if ((etag[0] != '\0') &&
+        (httpd_req_get_hdr_value_str(req, "If-None-Match", match,
+                                     sizeof(match)) == ESP_OK) &&
+        (strcmp(match, etag) == 0))
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_set_hdr(req, "ETag", etag);
+        httpd_resp_set_hdr(req, "Cache-Control", cache);
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    snprintf(path, sizeof(path), "/spiffs/%s.gz", name);
+    f = fopen(path, "r");
     if (f == NULL)
     {
-        ESP_LOGE("webpages", "Failed to open %s", file_path);
+        gzipped = false;
+        snprintf(path, sizeof(path), "/spiffs/%s", name);
+        f = fopen(path, "r");
+    }
+    if (f == NULL)
+    {
+        ESP_LOGE("webpages", "Failed to open %s", path);
+        return httpd_resp_send_404(req);
+    }
+    buffer = malloc(HTTP_FILE_BUFSIZE);
+    if (buffer == NULL)
+    {
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
-                            "Failed to open UI");
+                            "Out of memory");
+        fclose(f);
         return ESP_FAIL;
     }
 
-    httpd_resp_set_type(req, "text/html");
-
-    char buffer[256];
-    size_t read_bytes = 0;
-    while ((read_bytes = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    httpd_resp_set_type(req, type);
+    httpd_resp_set_hdr(req, "Cache-Control", cache);
+    if (etag[0] != '\0')
+    {
+        httpd_resp_set_hdr(req, "ETag", etag);
+    }
+    if (gzipped)
+    {
+        /* Every browser takes gzip, there is no plain copy to fall back to */
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    }
+    while ((read_bytes = fread(buffer, 1, HTTP_FILE_BUFSIZE, f)) > 0)
     {
         if (httpd_resp_send_chunk(req, buffer, read_bytes) != ESP_OK)
         {
             fclose(f);
+            free(buffer);
             httpd_resp_sendstr_chunk(req, NULL);
             return ESP_FAIL;
         }
     }
     fclose(f);
+    free(buffer);
     httpd_resp_sendstr_chunk(req, NULL);
     return ESP_OK;
 }
 
+esp_err_t http_homevue(httpd_req_t *req)
+{
+    /* Checked again on every load, a new SPIFFS image changes the ETag */
+    return http_send_static(req, "index.html", "text/html", "no-cache");
+}
+
+/*
+ * Live telemetry for the page over Server-Sent Events. A stream is a socket
+ * kept open after the handler returns, a timer queues a push in the server
+ * task every HTTP_SSE_PERIOD_MS and only the HTTP_ENV_LIVE fields that
+ * changed are sent, as in HTTP_ENV_UPDT.
+ */
+static httpd_handle_t ghttp_server = NULL;
+static int ghttp_sse_fds[HTTP_SSE_MAX_CLIENTS] = {-1, -1, -1};
+static int ghttp_sse_timer = TIMER_WHEEL_INVALID;
+static http_env_state_t ghttp_sse_last;
+static int64_t ghttp_sse_sent_us = 0;
+
+_Static_assert(HTTP_SSE_MAX_CLIENTS == 3, "Update ghttp_sse_fds initializer");
+_Static_assert(HTTP_SSE_MAX_CLIENTS < HTTP_MAX_OPEN_SOCKETS,
+               "Leave sockets the LRU purge can close for other clients");
+
+/* JSON object of the fields in now that differ from last, all if last is NULL */
+static int http_sse_format(char *buf, int size, const http_env_state_t *now,
+                           const http_env_state_t *last)
+{
+    const http_env_field_t *field = NULL;
+    int len = 0;
+
+    for (int i = 0; i < HTTP_ENV_NUM_FIELDS; i++)
+    {
+        field = &ghttp_env_fields[i];
+        if (!(field->flags & HTTP_ENV_LIVE) || !http_env_has(field, now) ||
+            ((last != NULL) && !http_env_changed(field, now, last)))
+        {
+            continue;
+        }
+        len += snprintf(buf + len, size - len, "%s", len ? "," : "{");
+        len = MIN(len, size - 1);
+        len += http_env_format(buf + len, size - len, field, now);
+    }
+    if (len > 0)
+    {
+        len += snprintf(buf + len, size - len, "}");
+    }
+    return MIN(len, size - 1);
+}
+
+static int http_sse_clients(void)
+{
+    int clients = 0;
+
+    for (int i = 0; i < HTTP_SSE_MAX_CLIENTS; i++)
+    {
+        clients += (ghttp_sse_fds[i] >= 0);
+    }
+    return clients;
+}
+
+/* Runs in the server task, from httpd_queue_work */
+static void http_sse_push(void *arg)
+{
+    char event[512];
+    char *data = event + 6;
+    http_env_state_t now;
+    int len = 0;
+
+    /* Streams look idle to the server, they would be the first sockets the
+       LRU purge closes */
+    for (int i = 0; i < HTTP_SSE_MAX_CLIENTS; i++)
+    {
+        if (ghttp_sse_fds[i] >= 0)
+        {
+            httpd_sess_update_lru_counter(ghttp_server, ghttp_sse_fds[i]);
+        }
+    }
+
+    http_env_get_state(&now);
+    len = http_sse_format(data, sizeof(event) - 6 - 3, &now, &ghttp_sse_last);
+    if (len > 0)
+    {
+        memcpy(event, "data: ", 6);
+        memcpy(data + len, "\n\n", 3);
+        len += 6 + 2;
+        ghttp_sse_last = now;
+    }
+    else if (esp_timer_get_time() - ghttp_sse_sent_us >=
+             (int64_t)HTTP_SSE_KEEPALIVE_MS * 1000)
+    {
+        /* Comment line, finds the streams whose peer went away */
+        len = snprintf(event, sizeof(event), ":\n\n");
+    }
+    if (len == 0)
+    {
+        return;
+    }
+
+    ghttp_sse_sent_us = esp_timer_get_time();
+    for (int i = 0; i < HTTP_SSE_MAX_CLIENTS; i++)
+    {
+        if ((ghttp_sse_fds[i] >= 0) &&
+            (httpd_socket_send(ghttp_server, ghttp_sse_fds[i], event, len, 0) <
+             0))
+        {
+            httpd_sess_trigger_close(ghttp_server, ghttp_sse_fds[i]);
+            ghttp_sse_fds[i] = -1;
+        }
+    }
+}
+
+static void http_sse_timer_callback(void *arg)
+{
+    if (http_sse_clients() == 0)
+    {
+        return;
+    }
+    httpd_queue_work(ghttp_server, http_sse_push, NULL);
+    timer_wheel_start(ghttp_sse_timer, HTTP_SSE_PERIOD_MS);
+}
+
+/* Handler for GET requests to /events - Telemetry stream */
+static esp_err_t http_events(httpd_req_t *req)
+{
+    static const char header[] = "HTTP/1.1 200 OK\r\n"
+                                 "Content-Type: text/event-stream\r\n"
+                                 "Cache-Control: no-cache\r\n"
+                                 "Connection: keep-alive\r\n\r\n";
+    char event[512];
+    http_env_state_t now;
+    int slot = -1, len = 0;
+
+    for (int i = 0; i < HTTP_SSE_MAX_CLIENTS; i++)
+    {
+        if (ghttp_sse_fds[i] < 0)
+        {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0)
+    {
+        /* The page polls HTTP_ENV_UPDT instead */
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Too many streams");
+        return ESP_OK;
+    }
+
+    /* Everything once, then only what changes */
+    http_env_get_state(&now);
+    len = snprintf(event, sizeof(event), "retry: 5000\ndata: ");
+    len += http_sse_format(event + len, sizeof(event) - len - 3, &now, NULL);
+    len += snprintf(event + len, sizeof(event) - len, "\n\n");
+    if ((httpd_send(req, header, sizeof(header) - 1) < 0) ||
+        (httpd_send(req, event, len) < 0))
+    {
+        return ESP_FAIL;
+    }
+    ghttp_sse_fds[slot] = httpd_req_to_sockfd(req);
+    syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_DEBUG,
+                   "http events stream %d opened", ghttp_sse_fds[slot]);
+    if (!timer_wheel_is_active(ghttp_sse_timer))
+    {
+        timer_wheel_start(ghttp_sse_timer, HTTP_SSE_PERIOD_MS);
+    }
+    return ESP_OK;
+}
+
+static void http_close_fn(httpd_handle_t hd, int sockfd)
+{
+    for (int i = 0; i < HTTP_SSE_MAX_CLIENTS; i++)
+    {
+        if (ghttp_sse_fds[i] == sockfd)
+        {
+            ghttp_sse_fds[i] = -1;
+        }
+    }
+    close(sockfd);
+}
+
+/*
+ * Prometheus scrape in OpenMetrics text, built with http_printf like the
+ * fetch_vue replies. Counters keep counting across scrapes, a reboot shows as
+ * a smaller uptime.
+ */
+static void http_metrics_family(httpd_req_t *req, const char *name,
+                                const char *type, const char *help)
+{
+    http_printf(req, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
+
+static void http_metrics_ir(httpd_req_t *req, const char *name,
+                            const char *help, size_t offset)
+{
+    const ir_protocol_t *proto = NULL;
+    ir_stats_t stats;
+
+    http_metrics_family(req, name, "counter", help);
+    for (char type = IR_TYPE_HITACHI; type < IR_TYPE_MAX; type++)
+    {
+        if (ir_stats_get(type, &stats) != SYSTEM_ERROR_NONE)
+        {
+            continue;
+        }
+        proto = ir_protocol_get(type);
+        http_printf(req, "%s_total{type=\"%s\"} %lu\n", name,
+                    (proto != NULL) ? proto->name : "Learned",
+                    *(uint32_t *)((char *)&stats + offset));
+    }
+}
+
+static esp_err_t http_metrics(httpd_req_t *req)
+{
+    http_env_state_t state;
+    task_monitor_info_t task;
+    wifi_ap_record_t ap;
+    uint32_t rxframes = 0, rxdropped = 0;
+
+    http_resp_begin(req);
+    httpd_resp_set_type(req, HTTP_METRICS_TYPE);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    http_env_get_state(&state);
+    http_metrics_family(req, "roomassist_temperature_celsius", "gauge",
+                        "Temperature of the DHT22");
+    http_printf(req, "roomassist_temperature_celsius %.1f\n",
+                state.temperature / 10.0f);
+    http_metrics_family(req, "roomassist_humidity_percent", "gauge",
+                        "Relative humidity of the DHT22");
+    http_printf(req, "roomassist_humidity_percent %.1f\n",
+                state.humidity / 10.0f);
+    if (state.airquality)
+    {
+        http_metrics_family(req, "roomassist_voc_index", "gauge",
+                            "VOC index of the SGP41");
+        http_printf(req, "roomassist_voc_index %d\n", state.voc);
+        http_metrics_family(req, "roomassist_nox_index", "gauge",
+                            "NOx index of the SGP41");
+        http_printf(req, "roomassist_nox_index %d\n", state.nox);
+    }
+    http_metrics_family(req, "roomassist_occupancy", "gauge",
+                        "1 if the room is occupied");
+    http_printf(req, "roomassist_occupancy %d\n", state.occupancy ? 1 : 0);
+#if defined(LD2410_AUTOLEARN_NU)
+    http_metrics_family(req, "roomassist_occupancy_prediction", "gauge",
+                        "Occupancy probability of the network");
+    http_printf(req, "roomassist_occupancy_prediction %.3f\n",
+                state.pred / 1000.0f);
+#endif
+
+    http_metrics_ir(req, "roomassist_ir_frames", "IR frames to send",
+                    offsetof(ir_stats_t, frames));
+    http_metrics_ir(req, "roomassist_ir_retries", "IR retransmissions",
+                    offsetof(ir_stats_t, retries));
+    http_metrics_ir(req, "roomassist_ir_confirmed", "IR frames beeped back",
+                    offsetof(ir_stats_t, confirmed));
+    http_metrics_ir(req, "roomassist_ir_unconfirmed",
+                    "IR frames without a beep after the last retry",
+                    offsetof(ir_stats_t, unconfirmed));
+    rmt_get_rx_stats(&rxframes, &rxdropped);
+    http_metrics_family(req, "roomassist_ir_rx_frames", "counter",
+                        "IR frames received");
+    http_printf(req, "roomassist_ir_rx_frames_total %lu\n", rxframes);
+    http_metrics_family(req, "roomassist_ir_rx_dropped", "counter",
+                        "IR frames dropped by the receiver");
+    http_printf(req, "roomassist_ir_rx_dropped_total %lu\n", rxdropped);
+
+    http_metrics_family(req, "roomassist_heap_free_bytes", "gauge",
+                        "Free heap");
+    http_printf(req, "roomassist_heap_free_bytes %lu\n",
+                esp_get_free_heap_size());
+    http_metrics_family(req, "roomassist_heap_min_free_bytes", "gauge",
+                        "Lowest free heap since boot");
+    http_printf(req, "roomassist_heap_min_free_bytes %lu\n",
+                esp_get_minimum_free_heap_size());
+    http_metrics_family(req, "roomassist_task_stack_free_bytes", "gauge",
+                        "Lowest free stack of a task");
+    for (int i = 0; task_monitor_get_info(i, &task) == SYSTEM_ERROR_NONE; i++)
+    {
+        http_printf(req, "roomassist_task_stack_free_bytes{task=\"%s\"} %lu\n",
+                    task.name, task.stack_free);
+    }
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+    {
+        http_metrics_family(req, "roomassist_wifi_rssi_dbm", "gauge",
+                            "Signal of the access point");
+        http_printf(req, "roomassist_wifi_rssi_dbm %d\n", ap.rssi);
+    }
+    http_metrics_family(req, "roomassist_uptime_seconds", "gauge",
+                        "Time since boot");
+    http_printf(req, "roomassist_uptime_seconds %lu\n",
+                (uint32_t)(esp_timer_get_time() / 1000000));
+    http_metrics_family(req, "roomassist_http_requests", "counter",
+                        "Requests handled by the web server");
+    http_printf(req, "roomassist_http_requests_total %lu\n", ghttp_requests);
+    http_metrics_family(req, "roomassist_http_slow_requests", "counter",
+                        "Requests that took longer than slow_ms of their "
+                        "handler");
+    http_printf(req, "roomassist_http_slow_requests_total %lu\n", ghttp_slow);
+    http_printf(req, "# EOF\n");
+    http_printf_end(req);
+    return ESP_OK;
+}
+
+/*
+ * Responses of fetch_vue are built in one buffer and sent as a chunk when it
+ * is full, instead of one chunk per field. Handlers run one at a time in the
+ * server task so a single buffer is enough.
+ */
+static char ghttp_resp_buf[HTTP_RESP_BUFSIZE];
+static int ghttp_resp_len = 0;
+
+static void http_resp_begin(httpd_req_t *req)
+{
+    ghttp_resp_len = 0;
+}
+
+static int http_resp_flush(httpd_req_t *req)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (ghttp_resp_len > 0)
+    {
+        ret = httpd_resp_send_chunk(req, ghttp_resp_buf, ghttp_resp_len);
+        ghttp_resp_len = 0;
+    }
+    return ret;
+}
+
+static int http_write(httpd_req_t *req, const char *data, int len)
+{
+    if (ghttp_resp_len + len > sizeof(ghttp_resp_buf))
+    {
+        http_resp_flush(req);
+    }
+    if (len > sizeof(ghttp_resp_buf))
+    {
+        return httpd_resp_send_chunk(req, data, len);
+    }
+    memcpy(&ghttp_resp_buf[ghttp_resp_len], data, len);
+    ghttp_resp_len += len;
+    return ESP_OK;
+}
+
 static int http_printf_end(httpd_req_t *req)
 {
+    http_resp_flush(req);
     httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
 
 static int http_printf(httpd_req_t *req, const char *fmt, ...)
 {
-    char buf[256] = {};
-    char outbuf[259] = {};
+    char *big = NULL;
     va_list args;
+    int len = 0;
+
     va_start(args, fmt);
-    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    len = vsnprintf(&ghttp_resp_buf[ghttp_resp_len],
+                    sizeof(ghttp_resp_buf) - ghttp_resp_len, fmt, args);
     va_end(args);
-    sprintf(outbuf, "%s\n", buf);
-    if (len > 0)
+    if (len < 0)
+    {
+        return len;
+    }
+    if (ghttp_resp_len + len < sizeof(ghttp_resp_buf))
+    {
+        ghttp_resp_len += len;
+        return len;
+    }
+
+    /* Did not fit, send what is before it and format again */
+    http_resp_flush(req);
+    if (len < sizeof(ghttp_resp_buf))
+    {
+        va_start(args, fmt);
+        vsnprintf(ghttp_resp_buf, sizeof(ghttp_resp_buf), fmt, args);
+        va_end(args);
+        ghttp_resp_len = len;
+        return len;
+    }
+    big = malloc(len + 1);
+    if (big != NULL)
     {
-        httpd_resp_send_chunk(req, outbuf, strlen(outbuf));
+        va_start(args, fmt);
+        vsnprintf(big, len + 1, fmt, args);
+        va_end(args);
+        httpd_resp_send_chunk(req, big, len);
+        free(big);
     }
     return len;
 }
 
+/* Quoted JSON string, for values that come from the user */
+static int http_json_string(httpd_req_t *req, const char *str)
+{
+    char esc[8];
+    const unsigned char *p = (const unsigned char *)str;
+
+    http_write(req, "\"", 1);
+    for (; (p != NULL) && (*p != '\0'); p++)
+    {
+        if ((*p == '"') || (*p == '\\'))
+        {
+            esc[0] = '\\';
+            esc[1] = *p;
+            http_write(req, esc, 2);
+        }
+        else if (*p < 0x20)
+        {
+            http_write(req, esc, snprintf(esc, sizeof(esc), "\\u%04x", *p));
+        }
+        else
+        {
+            http_write(req, (const char *)p, 1);
+        }
+    }
+    return http_write(req, "\"", 1);
+}
+
 /* Handler for POST requests to /nu_upload - Upload NU weights to memory */
 static esp_err_t handle_nu_upload(httpd_req_t *req)
 {
@@ -1187,39 +2556,130 @@ cleanup:
     return success ? ESP_OK : ESP_FAIL;
 }
 
+/* Handler of a URI and the time after which a request is logged as slow */
+typedef struct
+{
+    esp_err_t (*handler)(httpd_req_t *req);
+    uint32_t slow_ms;
+} http_route_t;
+
+static const http_route_t ghttp_route_homevue = {http_homevue,
+                                                 HTTP_STREAM_SLOW_MS};
+static const http_route_t ghttp_route_fetchvue = {fetch_vue,
+                                                  HTTP_HANDLER_SLOW_MS};
+static const http_route_t ghttp_route_submitform = {handle_submitform,
+                                                    HTTP_HANDLER_SLOW_MS};
+static const http_route_t ghttp_route_nu_upload = {handle_nu_upload,
+                                                   HTTP_STREAM_SLOW_MS};
+static const http_route_t ghttp_route_syslog = {http_syslog_download,
+                                                HTTP_STREAM_SLOW_MS};
+static const http_route_t ghttp_route_events = {http_events,
+                                                HTTP_HANDLER_SLOW_MS};
+static const http_route_t ghttp_route_api = {http_api, HTTP_HANDLER_SLOW_MS};
+static const http_route_t ghttp_route_metrics = {http_metrics,
+                                                 HTTP_HANDLER_SLOW_MS};
+
+/*
+ * Every handler runs in the one server task and blocks all other clients. A
+ * request is never cut short, one slower than slow_ms is only logged and
+ * counted so its work can be moved to a job.
+ */
+static esp_err_t http_timed(httpd_req_t *req)
+{
+    const http_route_t *route = req->user_ctx;
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = route->handler(req);
+    uint32_t elapsed_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+
+    ghttp_requests++;
+    if (elapsed_ms > ghttp_slowest_ms)
+    {
+        ghttp_slowest_ms = elapsed_ms;
+    }
+    if (elapsed_ms > route->slow_ms)
+    {
+        ghttp_slow++;
+        syslog_handler(SYSLOG_FACILITY_WEB, SYSLOG_LEVEL_WARNING,
+                       "%s took %lu ms, slow over %lu ms", req->uri,
+                       elapsed_ms, route->slow_ms);
+    }
+    return ret;
+}
+
 // Setup HTTP service
 httpd_handle_t http_server_start(void)
 {
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 8080;  // Using port 8080
-    config.max_uri_handlers = 12;
+    config.max_uri_handlers = 16;
     config.max_resp_headers = 10;
-
+    config.max_open_sockets = HTTP_MAX_OPEN_SOCKETS;
+    // Drop the least recently used socket instead of refusing a new client,
+    // http_sse_push keeps the event streams recent so they are not dropped
+    config.lru_purge_enable = true;
+    config.close_fn = http_close_fn;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+
+    http_job_init();
     if (httpd_start(&server, &config) == ESP_OK)
     {
         httpd_uri_t homevue_uri = {.uri = "/vue",
                                    .method = HTTP_GET,
-                                   .handler = http_homevue,
-                                   .user_ctx = NULL};
+                                   .handler = http_timed,
+                                   .user_ctx = (void *)&ghttp_route_homevue};
         httpd_uri_t fetch_vue_uri = {.uri = "/fetchvue",
                                      .method = HTTP_GET,
-                                     .handler = fetch_vue,
-                                     .user_ctx = NULL};
+                                     .handler = http_timed,
+                                     .user_ctx = (void *)&ghttp_route_fetchvue};
         // URI handler for /submitform (for handling POST requests)
-        httpd_uri_t submitform_uri = {.uri = "/submitform",
-                                      .method = HTTP_POST,
-                                      .handler = handle_submitform,
-                                      .user_ctx = NULL};
+        httpd_uri_t submitform_uri = {
+            .uri = "/submitform",
+            .method = HTTP_POST,
+            .handler = http_timed,
+            .user_ctx = (void *)&ghttp_route_submitform};
         // URI handler for /nu_upload (for uploading NU weights)
-        httpd_uri_t nu_upload_uri = {.uri = "/nu_upload",
-                                     .method = HTTP_POST,
-                                     .handler = handle_nu_upload,
-                                     .user_ctx = NULL};
+        httpd_uri_t nu_upload_uri = {
+            .uri = "/nu_upload",
+            .method = HTTP_POST,
+            .handler = http_timed,
+            .user_ctx = (void *)&ghttp_route_nu_upload};
+        // URI handler for /syslog (for downloading the flash log)
+        httpd_uri_t syslog_uri = {.uri = "/syslog",
+                                  .method = HTTP_GET,
+                                  .handler = http_timed,
+                                  .user_ctx = (void *)&ghttp_route_syslog};
+        // URI handler for /events (for the live telemetry stream)
+        httpd_uri_t events_uri = {.uri = "/events",
+                                  .method = HTTP_GET,
+                                  .handler = http_timed,
+                                  .user_ctx = (void *)&ghttp_route_events};
+        // URI handlers for /api/* (for the REST resources)
+        httpd_uri_t api_get_uri = {.uri = "/api/*",
+                                   .method = HTTP_GET,
+                                   .handler = http_timed,
+                                   .user_ctx = (void *)&ghttp_route_api};
+        httpd_uri_t api_patch_uri = {.uri = "/api/*",
+                                     .method = HTTP_PATCH,
+                                     .handler = http_timed,
+                                     .user_ctx = (void *)&ghttp_route_api};
+        // URI handler for /metrics (for Prometheus)
+        httpd_uri_t metrics_uri = {.uri = "/metrics",
+                                   .method = HTTP_GET,
+                                   .handler = http_timed,
+                                   .user_ctx = (void *)&ghttp_route_metrics};
         httpd_register_uri_handler(server, &homevue_uri);
         httpd_register_uri_handler(server, &fetch_vue_uri);
         httpd_register_uri_handler(server, &submitform_uri);
         httpd_register_uri_handler(server, &nu_upload_uri);
+        httpd_register_uri_handler(server, &syslog_uri);
+        httpd_register_uri_handler(server, &events_uri);
+        httpd_register_uri_handler(server, &api_get_uri);
+        httpd_register_uri_handler(server, &api_patch_uri);
+        httpd_register_uri_handler(server, &metrics_uri);
+        ghttp_server = server;
+        timer_wheel_add(http_sse_timer_callback, NULL, "SSE",
+                        &ghttp_sse_timer);
     }
     printf("\n HTTP task init down.\n");
     return server;
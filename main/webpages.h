@@ -41,6 +41,16 @@ extern "C"
 #define HTTP_RESET_BASELINE_ID 602
 #define HTTP_NU_DOWNLOAD_ID 701
 #define HTTP_NU_UPLOAD_ID 702
+#define HTTP_IR_LEARN_ID 801
+#define HTTP_IR_LEARN_STATUS_ID (HTTP_IR_LEARN_ID + 1)
+#define HTTP_IR_LEARN_SEND_ID (HTTP_IR_LEARN_ID + 2)
+#define HTTP_IR_LEARN_DELETE_ID (HTTP_IR_LEARN_ID + 3)
+#define HTTP_IR_LEARN_STOP_ID (HTTP_IR_LEARN_ID + 4)
+#define HTTP_IR_STATS_ID (HTTP_IR_LEARN_ID + 5)
+#define HTTP_DIAG_ID 901
+#define HTTP_HISTORY_ID 1001
+#define HTTP_JOB_ID 1101
+#define HTTP_JOB_RESULT_ID 1102
 #define HTTP_ACTION_STATUS_FAIL 0
 #define HTTP_ACTION_STATUS_SUCCESS 1
 
@@ -50,6 +60,20 @@ extern "C"
 #define PRED_HIS_REF_TIME 1500
 
 #define WEB_INPUT_INIT_VALUE 99
+#define HTTP_RESP_BUFSIZE 1460 /* One TCP segment */
+#define HTTP_FILE_BUFSIZE 4096
+#define HTTP_FORM_CHUNKSIZE 128
+#define HTTP_ENV_CBOR_BUFSIZE 192
+#define HTTP_ENV_MAXLEN_FIELD 64 /* "key": value of one state field */
+#define HTTP_SSE_MAX_CLIENTS 3
+#define HTTP_SSE_PERIOD_MS 1000
+#define HTTP_SSE_KEEPALIVE_MS 15000
+#define HTTP_MAX_OPEN_SOCKETS 12 /* HomeKit and telnet share CONFIG_LWIP_MAX_SOCKETS */
+/* Only logged and counted, a handler is never stopped */
+#define HTTP_HANDLER_SLOW_MS 500
+#define HTTP_STREAM_SLOW_MS 3000 /* Files, logs and uploads */
+#define HTTP_METRICS_TYPE \
+    "application/openmetrics-text; version=1.0.0; charset=utf-8"
 
     esp_err_t fetch_vue(httpd_req_t *req);
     esp_err_t handle_submitform(httpd_req_t *req);
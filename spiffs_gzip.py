@@ -0,0 +1,88 @@
+import argparse
+import gzip
+import hashlib
+import os
+import sys
+
+SPIFFS_PAGE = 256
+# SPIFFS needs free pages to collect garbage, keep a quarter of it free
+SPIFFS_USABLE = 0.75
+
+def parse_size(text):
+    text = text.strip().upper()
+    if text.endswith('K'):
+        return int(text[:-1], 0) * 1024
+    if text.endswith('M'):
+        return int(text[:-1], 0) * 1024 * 1024
+    return int(text, 0)
+
+def partition_size(csv_path, label):
+    with open(csv_path, 'r') as file:
+        for line in file:
+            fields = [field.strip() for field in line.split('#')[0].split(',')]
+            if len(fields) >= 5 and fields[0] == label:
+                return parse_size(fields[4])
+    return 0
+
+def flash_bytes(size):
+    # Data pages plus the object header and index pages
+    return (size + SPIFFS_PAGE - 1) // SPIFFS_PAGE * SPIFFS_PAGE + 2 * SPIFFS_PAGE
+
+# Build the SPIFFS image folder: every file of the source folders gzipped as
+# <name>.gz, with its ETag in <name>.etag for the web server.
+def gzip_assets(dst_dir, src_dirs):
+    used = 0
+    os.makedirs(dst_dir, exist_ok=True)
+    for name in sorted(os.listdir(dst_dir)):
+        if os.path.isfile(os.path.join(dst_dir, name)):
+            os.remove(os.path.join(dst_dir, name))
+
+    for src_dir in src_dirs:
+        if not os.path.isdir(src_dir):
+            continue
+        for name in sorted(os.listdir(src_dir)):
+            src = os.path.join(src_dir, name)
+            if name.startswith('.') or not os.path.isfile(src):
+                continue
+            with open(src, 'rb') as file:
+                data = file.read()
+            # mtime=0 so the same source always gives the same image
+            packed = gzip.compress(data, compresslevel=9, mtime=0)
+            etag = hashlib.sha1(packed).hexdigest()[:16]
+            with open(os.path.join(dst_dir, name + '.gz'), 'wb') as file:
+                file.write(packed)
+            with open(os.path.join(dst_dir, name + '.etag'), 'w') as file:
+                file.write(etag)
+            used += flash_bytes(len(packed)) + flash_bytes(len(etag))
+            print(f'{name}: {len(data)} -> {len(packed)} bytes')
+    return used
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('image_dir')
+    parser.add_argument('source_dir', nargs='+')
+    parser.add_argument('--partitions', help='Partition table to check the size against')
+    parser.add_argument('--partition', default='spiffs')
+    parser.add_argument('--reserve', action='append', default=[],
+                        help='File the device may write at run time')
+    args = parser.parse_args()
+
+    used = gzip_assets(args.image_dir, args.source_dir)
+    if args.partitions is None:
+        return
+
+    size = partition_size(args.partitions, args.partition)
+    if size == 0:
+        print(f'No {args.partition} partition in {args.partitions}')
+        sys.exit(1)
+    # OTA writes index.html unpacked next to the image
+    reserved = sum(flash_bytes(os.path.getsize(path)) for path in args.reserve)
+    budget = int(size * SPIFFS_USABLE)
+    print(f'{args.partition}: {used} bytes of files, {reserved} reserved, '
+          f'budget {budget} of {size}')
+    if used + reserved > budget:
+        print(f'{args.partition} is over budget by {used + reserved - budget} bytes')
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
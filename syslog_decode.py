@@ -0,0 +1,255 @@
+import argparse
+import os
+import re
+import struct
+import sys
+
+# Turn binary syslog records back into text. A record (syslog_record_t in
+# main/syslog_args.h) keeps the address of its format string and the raw
+# arguments, the format strings are read out of the firmware ELF.
+#
+# A dump of the ring of a running or crashed device, from gdb:
+#   dump binary value ring.bin gsyslog_ring
+# then:
+#   python syslog_decode.py --elf build/emulator.elf ring.bin
+
+MAIN_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'main')
+
+# Kinds of syslog_arg_t, what syslog_args_capture() stores for a spec
+ARG_NONE, ARG_INT, ARG_LONG, ARG_LLONG, ARG_SIZE, ARG_PTRDIFF, ARG_INTMAX, \
+    ARG_PTR, ARG_DOUBLE, ARG_STR = range(10)
+
+
+def read_define(path, name, default):
+    try:
+        with open(path, 'r') as file:
+            match = re.search(rf'#define\s+{name}\s+(\d+)', file.read())
+            if match:
+                return int(match.group(1))
+    except OSError:
+        pass
+    return default
+
+
+def read_names(path, array):
+    try:
+        with open(path, 'r', encoding='utf-8') as file:
+            match = re.search(rf'{array}\[[^=]*=\s*\{{([^}}]*)\}}', file.read())
+            if match:
+                return re.findall(r'"([^"]*)"', match.group(1))
+    except OSError:
+        pass
+    return []
+
+
+class Elf:
+    """Loadable sections of an ELF file, enough to read strings by address"""
+
+    def __init__(self, path):
+        with open(path, 'rb') as file:
+            self.data = file.read()
+        if self.data[:4] != b'\x7fELF':
+            raise ValueError(f'{path} is not an ELF file')
+        self.wide = self.data[4] == 2
+        order = '<' if self.data[5] == 1 else '>'
+        if self.wide:
+            shoff, = struct.unpack_from(order + 'Q', self.data, 0x28)
+            shentsize, shnum = struct.unpack_from(order + 'HH', self.data, 0x3A)
+        else:
+            shoff, = struct.unpack_from(order + 'I', self.data, 0x20)
+            shentsize, shnum = struct.unpack_from(order + 'HH', self.data, 0x2E)
+        self.sections = []
+        for i in range(shnum):
+            at = shoff + i * shentsize
+            if self.wide:
+                _, kind, flags, addr, offset, size = struct.unpack_from(
+                    order + 'IIQQQQ', self.data, at)
+            else:
+                _, kind, flags, addr, offset, size = struct.unpack_from(
+                    order + 'IIIIII', self.data, at)
+            # SHF_ALLOC and not SHT_NOBITS, the bytes are in the file
+            if (flags & 0x2) and kind != 8 and addr:
+                self.sections.append((addr, offset, size))
+
+    def string(self, address):
+        for addr, offset, size in self.sections:
+            if addr <= address < addr + size:
+                start = offset + address - addr
+                end = self.data.index(b'\0', start)
+                return self.data[start:end].decode('utf-8', 'replace')
+        return None
+
+
+def parse_spec(fmt, at):
+    """Walk a spec after its '%', like syslog_parse_spec()"""
+    longs = 0
+    size = ''
+    flags = ''
+    while at < len(fmt) and fmt[at] in '-+ #0123456789.*':
+        flags += fmt[at]
+        at += 1
+    while at < len(fmt) and fmt[at] in 'hlLzjt':
+        if fmt[at] == 'l':
+            longs += 1
+        elif fmt[at] != 'h':
+            size = fmt[at]
+        at += 1
+    conv = fmt[at] if at < len(fmt) else ''
+    if conv and conv in 'diuxXoc':
+        kind = {'z': ARG_SIZE, 't': ARG_PTRDIFF, 'j': ARG_INTMAX}.get(
+            size, ARG_LLONG if longs >= 2 else ARG_LONG if longs == 1 else ARG_INT)
+    elif conv and conv in 'fFeEgGaA':
+        kind = ARG_DOUBLE
+    elif conv == 'p':
+        kind = ARG_PTR
+    elif conv == 's':
+        kind = ARG_STR
+    else:
+        kind = ARG_NONE
+    return flags, conv, kind, at + 1
+
+
+class Truncated(Exception):
+    pass
+
+
+def format_args(fmt, data, truncated, ptr_size):
+    """Print the arguments with their format, like syslog_args_format()"""
+    # C sizes of the integer kinds, to print negative numbers as unsigned
+    bits = {ARG_INT: 32, ARG_LONG: ptr_size * 8, ARG_LLONG: 64,
+            ARG_SIZE: ptr_size * 8, ARG_PTRDIFF: ptr_size * 8, ARG_INTMAX: 64}
+    out = []
+    off = 0
+
+    def take(code, size):
+        nonlocal off
+        if off + size > len(data):
+            raise Truncated()
+        value, = struct.unpack_from('<' + code, data, off)
+        off += size
+        return value
+
+    at = 0
+    try:
+        while at < len(fmt):
+            if fmt[at] != '%':
+                out.append(fmt[at])
+                at += 1
+                continue
+            if fmt[at + 1:at + 2] == '%':
+                out.append('%')
+                at += 2
+                continue
+            flags, conv, kind, at = parse_spec(fmt, at + 1)
+            while '*' in flags:
+                flags = flags.replace('*', str(take('i', 4)), 1)
+            if kind == ARG_INT:
+                value = take('i', 4)
+            elif kind in (ARG_LONG, ARG_LLONG, ARG_SIZE, ARG_PTRDIFF,
+                          ARG_INTMAX, ARG_PTR):
+                value = take('q', 8)
+            elif kind == ARG_DOUBLE:
+                value = take('d', 8)
+            elif kind == ARG_STR:
+                if off >= len(data):
+                    raise Truncated()
+                end = data.index(b'\0', off) if b'\0' in data[off:] else len(data)
+                value = data[off:end].decode('utf-8', 'replace')
+                off = end + 1
+            else:
+                continue
+            if conv in 'uxXo':
+                value &= (1 << bits[kind]) - 1
+            if conv == 'c':
+                out.append(('%' + flags + 'c') % chr(value & 0xFF))
+            elif conv == 'p':
+                out.append(('%' + flags.replace('0', '') + 's') % hex(value))
+            elif conv in 'aA':
+                out.append(float.hex(value))
+            elif conv == 'o' and '#' in flags:
+                text = '%o' % value
+                out.append(('%' + flags.replace('#', '') + 's') %
+                           (text if text == '0' else '0' + text))
+            else:
+                out.append(('%' + flags + ('d' if conv in 'iu' else conv)) % value)
+        if truncated:
+            raise Truncated()
+    except Truncated:
+        out.append('...')
+    return ''.join(out)
+
+
+def record_layout(ptr_size, arg_maxlen):
+    """Offsets of syslog_record_t: seq, facility, level, time_ms, sequence,
+       then syslog_args_t fmt, len, truncated, data"""
+    def align(value, to):
+        return (value + to - 1) // to * to
+
+    args = align(16, ptr_size)
+    args_size = align(ptr_size + 2 + arg_maxlen, ptr_size)
+    return args, align(args + args_size, max(4, ptr_size))
+
+
+def decode(dump, elf, ptr_size, arg_maxlen, record_size=None):
+    args, size = record_layout(ptr_size, arg_maxlen)
+    size = record_size or size
+    records = []
+    for at in range(0, len(dump) - size + 1, size):
+        facility, level, time_ms, sequence = struct.unpack_from(
+            '<BBxxII', dump, at + 4)
+        address, = struct.unpack_from('<Q' if ptr_size == 8 else '<I', dump,
+                                      at + args)
+        length, truncated = struct.unpack_from('<BB', dump, at + args + ptr_size)
+        if address == 0 or length > arg_maxlen:
+            # Never used
+            continue
+        data = dump[at + args + ptr_size + 2:][:length]
+        fmt = elf.string(address)
+        if fmt is None:
+            text = f'<format at 0x{address:x} not in the ELF>'
+        else:
+            text = format_args(fmt, data, truncated, ptr_size)
+        records.append((sequence, time_ms, facility, level, text))
+    # The ring is circular, the sequence puts it back in order
+    return sorted(records)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Decode binary syslog records into text')
+    parser.add_argument('dump', help='Records, such as a dump of gsyslog_ring')
+    parser.add_argument('--elf', required=True,
+                        help='Firmware ELF the records were written by')
+    parser.add_argument('--ptr-size', type=int, default=4, choices=(4, 8),
+                        help='Pointer size of the target, 4 on the ESP32')
+    parser.add_argument('--record-size', type=int,
+                        help='Bytes per record if it is not the ESP32 layout')
+    parser.add_argument('--numeric', action='store_true',
+                        help='Print facility and level as numbers')
+    args = parser.parse_args()
+
+    arg_maxlen = read_define(os.path.join(MAIN_DIR, 'syslog_args.h'),
+                             'SYSLOG_ARG_MAXLEN', 160)
+    facilities = read_names(os.path.join(MAIN_DIR, 'syslog.c'),
+                            'gsyslog_facility_str')
+    levels = read_names(os.path.join(MAIN_DIR, 'syslog.c'), 'gsyslog_level_str')
+    with open(args.dump, 'rb') as file:
+        dump = file.read()
+    try:
+        elf = Elf(args.elf)
+    except (OSError, ValueError) as error:
+        print(error)
+        sys.exit(1)
+
+    for sequence, time_ms, facility, level, text in decode(
+            dump, elf, args.ptr_size, arg_maxlen, args.record_size):
+        if not args.numeric and facility < len(facilities):
+            facility = facilities[facility]
+        if not args.numeric and level < len(levels):
+            level = levels[level]
+        print(f'{sequence} {time_ms // 1000}.{time_ms % 1000:03d} '
+              f'{facility} {level}: {text}')
+
+
+if __name__ == '__main__':
+    main()